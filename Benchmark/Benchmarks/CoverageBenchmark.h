@@ -0,0 +1,23 @@
+#pragma once
+#include "../../Nanomites/Tracer/Platform.h"
+#include <vector>
+
+class BenchmarkReporter;
+class BenchmarkOptions;
+
+// Throughput of a fuzzing loop with nanomite edge coverage: reset map, replay the edges of one execution, evaluate map
+class CoverageBenchmark
+{
+public:
+  CoverageBenchmark();
+  ~CoverageBenchmark();
+
+  void Run(BenchmarkReporter& reporter, BenchmarkOptions& options);
+
+private:
+  void CreateExecution(DWORD siteCount, DWORD edgeCount);
+  void RunFuzzingLoop(BenchmarkReporter& reporter, DWORD iterations, bool withCoverage);
+
+private:
+  std::vector<DWORD> _execution; // Sequence of RVAs reached by resolved nanomites
+};
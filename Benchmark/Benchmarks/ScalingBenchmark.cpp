@@ -0,0 +1,127 @@
+#include <atomic>
+#include <thread>
+#include "ScalingBenchmark.h"
+#include "../Common/BenchmarkOptions.h"
+#include "../Common/BenchmarkReporter.h"
+#include "../Common/Stopwatch.h"
+#include "../Kernels/KernelImage.h"
+#include "../../Nanomites/Tracer/Tracer.h"
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+ScalingBenchmark::ScalingBenchmark()
+{
+  _kernelIndex = 0;
+  _runs = 1;
+  _pinThreads = true;
+}
+
+ScalingBenchmark::~ScalingBenchmark()
+{
+}
+
+void ScalingBenchmark::Run(BenchmarkReporter& reporter, BenchmarkOptions& options)
+{
+  if (!reporter.IsSelected("scaling")) return;
+
+  const DWORD iterations = (DWORD)options.GetInteger("iterations", 50000);
+  _runs = (DWORD)options.GetInteger("runs", 4);
+  _kernelIndex = (DWORD)options.GetInteger("kernel", 0);
+  _pinThreads = options.GetInteger("pin", 1) != 0;
+  DWORD maxThreads = (DWORD)options.GetInteger("threads", std::thread::hardware_concurrency());
+  if (iterations == 0 || _runs == 0 || maxThreads == 0 || _kernelIndex >= TrapKernelCount) return;
+
+  KernelImage image;
+  if (!image.Create(iterations)) return;
+
+  const ULONGLONG trapsPerThread = (ULONGLONG)iterations * TrapKernels[_kernelIndex].SiteCount * _runs;
+  double singleThreadRate = 0.0;
+
+  Tracer::Instance().StartTracing(image.GetImageBase(), image.GetSection(), image.GetMetadata());
+  for (DWORD threadCount : GetThreadCounts(maxThreads))
+  {
+    std::vector<double> threadNanoseconds;
+    const double wallNanoseconds = RunThreads(image, threadCount, threadNanoseconds);
+
+    double sum = 0.0, worst = 0.0;
+    for (double nanoseconds : threadNanoseconds)
+    {
+      sum += nanoseconds;
+      if (nanoseconds > worst) worst = nanoseconds;
+    }
+
+    const ULONGLONG traps = trapsPerThread * threadCount;
+    const double rate = traps * 1e9 / wallNanoseconds;
+    if (threadCount == 1) singleThreadRate = rate;
+
+    BenchmarkResult result;
+    result.Name = std::string("scaling/") + TrapKernels[_kernelIndex].Name + "/threads=" + std::to_string(threadCount);
+    result.Operations = traps;
+    result.Nanoseconds = wallNanoseconds;
+    result.AddMetric("traps_per_s", rate);
+    result.AddMetric("speedup", singleThreadRate == 0.0 ? 0.0 : rate / singleThreadRate);
+    result.AddMetric("efficiency", singleThreadRate == 0.0 ? 0.0 : rate / (singleThreadRate * threadCount));
+    result.AddMetric("thread_ns_per_trap_mean", sum / threadCount / trapsPerThread);
+    result.AddMetric("thread_ns_per_trap_max", worst / trapsPerThread);
+    result.AddMetric("pinned", _pinThreads ? 1.0 : 0.0);
+    reporter.Report(result);
+  }
+  Tracer::Instance().StopTracing();
+}
+
+double ScalingBenchmark::RunThreads(KernelImage& image, DWORD threadCount, std::vector<double>& threadNanoseconds)
+{
+  threadNanoseconds.assign(threadCount, 0.0);
+  std::atomic<DWORD> ready = 0;
+  std::atomic<bool> go = false;
+  std::vector<std::thread> threads;
+  const DWORD processorCount = std::thread::hardware_concurrency();
+
+  for (DWORD t = 0; t < threadCount; t++)
+  {
+    threads.emplace_back([&, t]()
+    {
+      if (_pinThreads && processorCount != 0) PinThread(t % processorCount);
+      ready++;
+      while (!go.load(std::memory_order_acquire)) YieldProcessor();
+
+      Stopwatch stopwatch;
+      for (DWORD r = 0; r < _runs; r++)
+      {
+        image.RunPatched(_kernelIndex);
+      }
+      threadNanoseconds[t] = stopwatch.ElapsedNanoseconds();
+    });
+  }
+
+  // Start all threads at once, so the wall time covers concurrent execution only
+  while (ready.load() != threadCount) YieldProcessor();
+  Stopwatch wall;
+  go.store(true, std::memory_order_release);
+  for (std::thread& thread : threads) thread.join();
+  return wall.ElapsedNanoseconds();
+}
+
+bool ScalingBenchmark::PinThread(DWORD processor)
+{
+  // One thread per logical processor, so the curve does not depend on where the scheduler places the threads
+#ifdef _WIN32
+  if (processor >= sizeof(DWORD_PTR) * 8) return false;
+  return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << processor) != 0;
+#else
+  cpu_set_t processors;
+  CPU_ZERO(&processors);
+  CPU_SET(processor, &processors);
+  return pthread_setaffinity_np(pthread_self(), sizeof(processors), &processors) == 0;
+#endif
+}
+
+std::vector<DWORD> ScalingBenchmark::GetThreadCounts(DWORD maxThreads)
+{
+  // 1, 2, 4, ... and maxThreads itself
+  std::vector<DWORD> counts;
+  for (DWORD count = 1; count < maxThreads; count *= 2) counts.push_back(count);
+  counts.push_back(maxThreads);
+  return counts;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "../../Nanomites/Tracer/Platform.h"
+#include <vector>
+
+class BenchmarkReporter;
+class BenchmarkOptions;
+class KernelImage;
+
+// Runs a patched TrapKernel on 1..N threads concurrently under the Tracer and reports the aggregate
+// trap rate, the per-thread latency and the efficiency relative to one thread. Thread t is pinned to
+// logical processor t unless --pin 0 is given.
+class ScalingBenchmark
+{
+public:
+  ScalingBenchmark();
+  ~ScalingBenchmark();
+
+  void Run(BenchmarkReporter& reporter, BenchmarkOptions& options);
+
+private:
+  double RunThreads(KernelImage& image, DWORD threadCount, std::vector<double>& threadNanoseconds);
+  static bool PinThread(DWORD processor);
+  std::vector<DWORD> GetThreadCounts(DWORD maxThreads);
+
+private:
+  DWORD _kernelIndex;
+  DWORD _runs;
+  bool _pinThreads;
+};
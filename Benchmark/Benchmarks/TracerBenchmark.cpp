@@ -0,0 +1,238 @@
+#include <cstring>
+#include <sstream>
+#include "TracerBenchmark.h"
+#include "../Common/BenchmarkOptions.h"
+#include "../Common/BenchmarkReporter.h"
+#include "../Common/ProcessMetrics.h"
+#include "../Common/Stopwatch.h"
+#include "../../Nanomites/Tracer/Tracer.h"
+#include "../../Nanomites/Tracer/Nanomite.h"
+#include "../../Nanomites/Tracer/NanomiteMetadata.h"
+
+#define CONTEXT_COUNT 256
+#define ACCESS_ORDER_MAX 0x400000
+
+TracerBenchmark::TracerBenchmark()
+{
+  _random = 0x9E3779B9;
+#if defined(_WIN64) || defined(__x86_64__)
+  _imageBase = 0x140000000;
+#else
+  _imageBase = 0x400000;
+#endif
+  _metadataBuffer = nullptr;
+  _siteCount = 0;
+  _contexts = nullptr;
+  _lookupBytes = 0;
+}
+
+TracerBenchmark::~TracerBenchmark()
+{
+  DeleteData();
+}
+
+void TracerBenchmark::Run(BenchmarkReporter& reporter, BenchmarkOptions& options)
+{
+  if (!reporter.IsSelected("tracer")) return;
+  _counter.Open();
+
+  SyntheticSettings settings;
+  settings.Density = options.GetDouble("density", 32.0);
+  settings.JmpRatio = options.GetDouble("jmp", 0.2);
+  settings.NearRatio = options.GetDouble("near", 0.3);
+  const ULONGLONG operations = options.GetInteger("operations", 4000000);
+
+  if (options.Has("sites"))
+  {
+    settings.SiteCount = (DWORD)options.GetInteger("sites", 0);
+    RunConfiguration(reporter, settings, operations);
+    return;
+  }
+
+  // Default sweep over the lookup size
+  for (DWORD siteCount : { 1000, 10000, 100000, 1000000 })
+  {
+    settings.SiteCount = siteCount;
+    RunConfiguration(reporter, settings, operations);
+  }
+}
+
+void TracerBenchmark::RunConfiguration(BenchmarkReporter& reporter, const SyntheticSettings& settings, ULONGLONG operations)
+{
+  CreateMetadata(settings);
+  CreateContexts();
+  CreateAccessOrder(operations);
+
+  // Install the synthetic metadata without exception handler
+  Tracer& tracer = Tracer::Instance();
+  SIZE_T privateBytes = ProcessMetrics::GetPrivateBytes();
+  tracer.Attach(_imageBase, &_section, reinterpret_cast<NanomiteMetadata*>(_metadataBuffer));
+  _lookupBytes = ProcessMetrics::GetPrivateBytes() - privateBytes;
+
+  std::ostringstream suffix;
+  suffix << "/sites=" << settings.SiteCount << "/density=" << settings.Density << "/jmp=" << settings.JmpRatio << "/near=" << settings.NearRatio;
+
+  RunGetNanomite(reporter, suffix.str());
+  RunExecuteJump(reporter, suffix.str());
+  RunResolveNanomite(reporter, suffix.str());
+
+  tracer.Detach();
+  DeleteData();
+}
+
+void TracerBenchmark::CreateMetadata(const SyntheticSettings& settings)
+{
+  _siteCount = settings.SiteCount;
+  const DWORD metadataSize = sizeof(NanomiteMetadata) + _siteCount * sizeof(Nanomite);
+  _metadataBuffer = new BYTE[metadataSize];
+  memset(_metadataBuffer, 0, metadataSize);
+  reinterpret_cast<NanomiteMetadata*>(_metadataBuffer)->ItemCount = _siteCount;
+  Nanomite* nanomites = reinterpret_cast<Nanomite*>(_metadataBuffer + sizeof(NanomiteMetadata));
+
+  const DWORD sectionRva = 0x1000;
+  const DWORD averageGap = (DWORD)(1024.0 / settings.Density);
+  DWORD rva = sectionRva;
+  for (DWORD i = 0; i < _siteCount; i++)
+  {
+    const bool isJmp = (NextRandom() % 10000) < settings.JmpRatio * 10000;
+    const bool isNear = (NextRandom() % 10000) < settings.NearRatio * 10000;
+
+    Nanomite& nanomite = nanomites[i];
+    nanomite.Rva = rva;
+    nanomite.JumpType = isJmp ? JumpType::JMP : JumpType::JO + NextRandom() % (JumpType::JCXZ - JumpType::JO + 1);
+    if (isNear && nanomite.JumpType == JumpType::JCXZ) nanomite.JumpType = JumpType::JNE; // JCXZ has no near encoding
+    nanomite.OpcodeLength = isNear ? (isJmp ? 5 : 6) : 2;
+    nanomite.JumpLength = isNear ? (DWORD)((int)(NextRandom() % 0x20000) - 0x10000) : (DWORD)((int)(NextRandom() % 0x100) - 0x80);
+
+    rva += nanomite.OpcodeLength + 1 + (averageGap > 2 ? NextRandom() % (2 * averageGap - 2) : 0);
+  }
+
+  _section.SetSectionStart(_imageBase + sectionRva);
+  _section.SetSectionEnd(_imageBase + rva - 1);
+  _section.SetSectionSize(rva - sectionRva);
+}
+
+void TracerBenchmark::CreateContexts()
+{
+  // EFlags bits evaluated by ExecuteJump: CF, PF, ZF, SF, OF
+  const DWORD flagMask = 0x00000001 | 0x00000004 | 0x00000040 | 0x00000080 | 0x00000800;
+  _contexts = new CONTEXT[CONTEXT_COUNT];
+  memset(_contexts, 0, CONTEXT_COUNT * sizeof(CONTEXT));
+  for (DWORD i = 0; i < CONTEXT_COUNT; i++)
+  {
+    const DWORD eflags = (NextRandom() & flagMask) | 0x00000202;
+    const DWORD counter = (NextRandom() % 10 == 0) ? 0 : NextRandom();
+#if defined(_WIN64)
+    _contexts[i].EFlags = eflags;
+    _contexts[i].Rcx = counter;
+#elif defined(_WIN32)
+    _contexts[i].EFlags = eflags;
+    _contexts[i].Ecx = counter;
+#elif defined(__x86_64__)
+    _contexts[i].uc_mcontext.gregs[REG_EFL] = eflags;
+    _contexts[i].uc_mcontext.gregs[REG_RCX] = counter;
+#else
+    _contexts[i].uc_mcontext.gregs[REG_EFL] = eflags;
+    _contexts[i].uc_mcontext.gregs[REG_ECX] = counter;
+#endif
+  }
+}
+
+void TracerBenchmark::CreateAccessOrder(ULONGLONG operations)
+{
+  // Random site order, so the lookup is not measured with a warm cache only
+  const Nanomite* nanomites = reinterpret_cast<Nanomite*>(_metadataBuffer + sizeof(NanomiteMetadata));
+  const ULONGLONG count = operations < ACCESS_ORDER_MAX ? operations : ACCESS_ORDER_MAX;
+  _accessOrder.clear();
+  _accessOrder.reserve((size_t)count);
+  for (ULONGLONG i = 0; i < count; i++)
+  {
+    _accessOrder.push_back(nanomites[NextRandom() % _siteCount].Rva);
+  }
+}
+
+void TracerBenchmark::DeleteData()
+{
+  if (_metadataBuffer != nullptr)
+  {
+    delete[] _metadataBuffer;
+    _metadataBuffer = nullptr;
+  }
+  if (_contexts != nullptr)
+  {
+    delete[] _contexts;
+    _contexts = nullptr;
+  }
+  _accessOrder.clear();
+  _accessOrder.shrink_to_fit();
+}
+
+void TracerBenchmark::RunGetNanomite(BenchmarkReporter& reporter, const std::string& suffix)
+{
+  Tracer& tracer = Tracer::Instance();
+  volatile DWORD sink = 0;
+
+  ULONGLONG events = _counter.Read();
+  Stopwatch stopwatch;
+  for (DWORD rva : _accessOrder)
+  {
+    sink = tracer.GetNanomite(rva)->JumpLength;
+  }
+  Report(reporter, "tracer/GetNanomite" + suffix, stopwatch.ElapsedNanoseconds(), _counter.Read() - events);
+}
+
+void TracerBenchmark::RunExecuteJump(BenchmarkReporter& reporter, const std::string& suffix)
+{
+  Tracer& tracer = Tracer::Instance();
+  std::vector<Nanomite*> nanomites;
+  nanomites.reserve(_accessOrder.size());
+  for (DWORD rva : _accessOrder) nanomites.push_back(tracer.GetNanomite(rva));
+  volatile DWORD taken = 0;
+
+  ULONGLONG events = _counter.Read();
+  Stopwatch stopwatch;
+  DWORD i = 0;
+  for (Nanomite* nanomite : nanomites)
+  {
+    taken += tracer.ExecuteJump(nanomite, &_contexts[i++ % CONTEXT_COUNT]) ? 1 : 0;
+  }
+  Report(reporter, "tracer/ExecuteJump" + suffix, stopwatch.ElapsedNanoseconds(), _counter.Read() - events);
+}
+
+void TracerBenchmark::RunResolveNanomite(BenchmarkReporter& reporter, const std::string& suffix)
+{
+  Tracer& tracer = Tracer::Instance();
+  volatile DWORD resolved = 0;
+
+  ULONGLONG events = _counter.Read();
+  Stopwatch stopwatch;
+  DWORD i = 0;
+  for (DWORD rva : _accessOrder)
+  {
+    PCONTEXT context = &_contexts[i++ % CONTEXT_COUNT];
+    tracer.SetInstructionPointer(context, _imageBase + rva);
+    resolved += tracer.ResolveNanomite(context) ? 1 : 0;
+  }
+  Report(reporter, "tracer/ResolveNanomite" + suffix, stopwatch.ElapsedNanoseconds(), _counter.Read() - events);
+}
+
+void TracerBenchmark::Report(BenchmarkReporter& reporter, const std::string& name, double elapsed, ULONGLONG events)
+{
+  BenchmarkResult result;
+  result.Name = name;
+  result.Operations = _accessOrder.size();
+  result.Nanoseconds = elapsed;
+  result.AddMetric(_counter.GetMetricName(), (double)events / (double)_accessOrder.size());
+  result.AddMetric("lookup_bytes", (double)_lookupBytes);
+  result.AddMetric("lookup_bytes_per_site", (double)_lookupBytes / (double)_siteCount);
+  result.AddMetric("peak_working_set", (double)ProcessMetrics::GetPeakWorkingSet());
+  reporter.Report(result);
+}
+
+DWORD TracerBenchmark::NextRandom()
+{
+  _random ^= _random << 13;
+  _random ^= _random >> 17;
+  _random ^= _random << 5;
+  return _random;
+}
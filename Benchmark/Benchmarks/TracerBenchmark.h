@@ -0,0 +1,55 @@
+#pragma once
+#include "../../Nanomites/Tracer/Platform.h"
+#include <string>
+#include <vector>
+#include "../Common/HardwareCounter.h"
+#include "../../Nanomites/Tracer/SectionInfo.h"
+
+class BenchmarkReporter;
+class BenchmarkOptions;
+struct NanomiteMetadata;
+
+struct SyntheticSettings
+{
+  DWORD SiteCount;
+  double Density;   // Sites per KB of protected section
+  double JmpRatio;  // Fraction of unconditional jumps
+  double NearRatio; // Fraction of near (rel32) encodings
+};
+
+// Microbenchmarks of the Tracer hot path (GetNanomite, ExecuteJump, ResolveNanomite) with synthetic
+// metadata and register contexts; no exceptions are raised. Besides ns/op each result reports the cache
+// misses or cycles per operation (see HardwareCounter) and the memory of the lookup.
+class TracerBenchmark
+{
+public:
+  TracerBenchmark();
+  ~TracerBenchmark();
+
+  void Run(BenchmarkReporter& reporter, BenchmarkOptions& options);
+
+private:
+  void RunConfiguration(BenchmarkReporter& reporter, const SyntheticSettings& settings, ULONGLONG operations);
+  void CreateMetadata(const SyntheticSettings& settings);
+  void CreateContexts();
+  void CreateAccessOrder(ULONGLONG operations);
+  void DeleteData();
+
+  void RunGetNanomite(BenchmarkReporter& reporter, const std::string& suffix);
+  void RunExecuteJump(BenchmarkReporter& reporter, const std::string& suffix);
+  void RunResolveNanomite(BenchmarkReporter& reporter, const std::string& suffix);
+  void Report(BenchmarkReporter& reporter, const std::string& name, double elapsed, ULONGLONG events);
+
+  DWORD NextRandom();
+
+private:
+  DWORD _random;
+  DWORD_PTR _imageBase;
+  SectionInfo _section;
+  BYTE* _metadataBuffer;
+  DWORD _siteCount;
+  CONTEXT* _contexts;
+  std::vector<DWORD> _accessOrder; // Site RVAs in the order they are resolved
+  SIZE_T _lookupBytes;
+  HardwareCounter _counter;
+};
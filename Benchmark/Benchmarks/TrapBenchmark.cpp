@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <vector>
+#include "TrapBenchmark.h"
+#include "../Common/BenchmarkOptions.h"
+#include "../Common/BenchmarkReporter.h"
+#include "../Common/ProcessMetrics.h"
+#include "../Common/Stopwatch.h"
+#include "../Kernels/KernelImage.h"
+#include "../../Nanomites/Tracer/Tracer.h"
+
+#define UNPATCHED_MIN_NANOSECONDS 100000000.0
+
+TrapBenchmark::TrapBenchmark()
+{
+  _repetitions = 5;
+}
+
+TrapBenchmark::~TrapBenchmark()
+{
+}
+
+void TrapBenchmark::Run(BenchmarkReporter& reporter, BenchmarkOptions& options)
+{
+  if (!reporter.IsSelected("trap")) return;
+
+  const DWORD iterations = (DWORD)options.GetInteger("iterations", 200000);
+  _repetitions = (DWORD)options.GetInteger("repetitions", 5);
+  if (iterations == 0 || _repetitions == 0) return;
+
+  KernelImage image;
+  if (!image.Create(iterations)) return;
+
+  for (DWORD k = 0; k < TrapKernelCount; k++)
+  {
+    const TrapKernel& kernel = TrapKernels[k];
+    std::vector<double> unpatched(_repetitions), patched(_repetitions), user(_repetitions), sys(_repetitions);
+    ULONGLONG traps = 0;
+    for (DWORD r = 0; r < _repetitions; r++)
+    {
+      unpatched[r] = MeasureUnpatched(image, k, iterations);
+
+      Tracer::Instance().StartTracing(image.GetImageBase(), image.GetSection(), image.GetMetadata());
+      patched[r] = MeasurePatched(image, k, user[r], sys[r], traps);
+      Tracer::Instance().StopTracing();
+    }
+
+    // Medians keep the results stable between runs
+    const double unpatchedNs = Median(unpatched.data(), _repetitions);
+    const double patchedNs = Median(patched.data(), _repetitions);
+    const double userSeconds = Median(user.data(), _repetitions);
+    const double sysSeconds = Median(sys.data(), _repetitions);
+    const ULONGLONG expectedTraps = (ULONGLONG)iterations * kernel.SiteCount;
+
+    BenchmarkResult result;
+    result.Name = std::string("trap/") + kernel.Name;
+    result.Operations = expectedTraps;
+    result.Nanoseconds = patchedNs;
+    result.AddMetric("traps_per_s", expectedTraps * 1e9 / patchedNs);
+    result.AddMetric("ns_per_trap_added", (patchedNs - unpatchedNs) / expectedTraps);
+    result.AddMetric("slowdown", patchedNs / unpatchedNs);
+    result.AddMetric("user_pct", 100.0 * userSeconds / (userSeconds + sysSeconds));
+    result.AddMetric("sys_pct", 100.0 * sysSeconds / (userSeconds + sysSeconds));
+    result.AddMetric("traps_counted", (double)traps);
+    reporter.Report(result);
+  }
+}
+
+double TrapBenchmark::MeasureUnpatched(KernelImage& image, DWORD kernelIndex, DWORD iterations)
+{
+  // A single unpatched run is too short to be measured, repeat it and scale to one run
+  DWORD runs = 0;
+  Stopwatch stopwatch;
+  double elapsed = 0.0;
+  do
+  {
+    image.RunUnpatched(kernelIndex);
+    runs++;
+    elapsed = stopwatch.ElapsedNanoseconds();
+  } while (elapsed < UNPATCHED_MIN_NANOSECONDS);
+  return elapsed / runs;
+}
+
+double TrapBenchmark::MeasurePatched(KernelImage& image, DWORD kernelIndex, double& userSeconds, double& kernelSeconds, ULONGLONG& traps)
+{
+  double userBefore, kernelBefore, userAfter, kernelAfter;
+  const ULONGLONG trapsBefore = Tracer::Instance().GetStatistics().GetTraps();
+  ProcessMetrics::GetProcessCpuTimes(userBefore, kernelBefore);
+
+  Stopwatch stopwatch;
+  image.RunPatched(kernelIndex);
+  const double elapsed = stopwatch.ElapsedNanoseconds();
+
+  ProcessMetrics::GetProcessCpuTimes(userAfter, kernelAfter);
+  userSeconds = userAfter - userBefore;
+  kernelSeconds = kernelAfter - kernelBefore;
+  traps = Tracer::Instance().GetStatistics().GetTraps() - trapsBefore;
+  return elapsed;
+}
+
+double TrapBenchmark::Median(double* values, DWORD count)
+{
+  std::sort(values, values + count);
+  return (count % 2 == 1) ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2.0;
+}
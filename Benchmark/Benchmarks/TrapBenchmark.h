@@ -0,0 +1,26 @@
+#pragma once
+#include "../../Nanomites/Tracer/Platform.h"
+
+class BenchmarkReporter;
+class BenchmarkOptions;
+class KernelImage;
+struct TrapKernel;
+
+// End-to-end cost of nanomites including the exception round trip: runs the TrapKernels
+// unpatched and patched under the Tracer and reports traps/s, ns/trap, slowdown and the CPU split.
+class TrapBenchmark
+{
+public:
+  TrapBenchmark();
+  ~TrapBenchmark();
+
+  void Run(BenchmarkReporter& reporter, BenchmarkOptions& options);
+
+private:
+  double MeasureUnpatched(KernelImage& image, DWORD kernelIndex, DWORD iterations);
+  double MeasurePatched(KernelImage& image, DWORD kernelIndex, double& userSeconds, double& kernelSeconds, ULONGLONG& traps);
+  static double Median(double* values, DWORD count);
+
+private:
+  DWORD _repetitions;
+};
@@ -0,0 +1,48 @@
+#include "BenchmarkOptions.h"
+
+BenchmarkOptions::BenchmarkOptions()
+{
+}
+
+BenchmarkOptions::~BenchmarkOptions()
+{
+}
+
+bool BenchmarkOptions::Parse(int argc, char* argv[])
+{
+  for (int i = 1; i < argc; i++)
+  {
+    std::string argument = argv[i];
+    if (argument.rfind("--", 0) == 0)
+    {
+      if (i + 1 >= argc) return false;
+      _values[argument.substr(2)] = argv[++i];
+    }
+    else
+    {
+      _filter = argument;
+    }
+  }
+  return true;
+}
+
+std::string BenchmarkOptions::GetString(const std::string& name, const std::string& defaultValue)
+{
+  auto iter = _values.find(name);
+  if (iter == _values.end()) return defaultValue;
+  return iter->second;
+}
+
+ULONGLONG BenchmarkOptions::GetInteger(const std::string& name, ULONGLONG defaultValue)
+{
+  auto iter = _values.find(name);
+  if (iter == _values.end()) return defaultValue;
+  return std::stoull(iter->second);
+}
+
+double BenchmarkOptions::GetDouble(const std::string& name, double defaultValue)
+{
+  auto iter = _values.find(name);
+  if (iter == _values.end()) return defaultValue;
+  return std::stod(iter->second);
+}
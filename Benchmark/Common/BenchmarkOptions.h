@@ -0,0 +1,24 @@
+#pragma once
+#include "../../Nanomites/Tracer/Platform.h"
+#include <map>
+#include <string>
+
+// Command line options of the form "--name value"; the first argument without "--" is the benchmark filter
+class BenchmarkOptions
+{
+public:
+  BenchmarkOptions();
+  ~BenchmarkOptions();
+
+  bool Parse(int argc, char* argv[]);
+
+  const std::string& GetFilter() { return _filter; }
+  bool Has(const std::string& name) { return _values.find(name) != _values.end(); }
+  std::string GetString(const std::string& name, const std::string& defaultValue);
+  ULONGLONG GetInteger(const std::string& name, ULONGLONG defaultValue);
+  double GetDouble(const std::string& name, double defaultValue);
+
+private:
+  std::string _filter;
+  std::map<std::string, std::string> _values;
+};
@@ -0,0 +1,42 @@
+#include <iostream>
+#include <iomanip>
+#include "BenchmarkReporter.h"
+
+BenchmarkReporter::BenchmarkReporter()
+{
+}
+
+BenchmarkReporter::~BenchmarkReporter()
+{
+  if (_json.is_open()) _json.close();
+}
+
+bool BenchmarkReporter::OpenJson(const char* fileName)
+{
+  _json.open(fileName, std::ios::out | std::ios::trunc);
+  return _json.is_open();
+}
+
+void BenchmarkReporter::Report(const BenchmarkResult& result)
+{
+  const double nsPerOp = result.Operations == 0 ? 0.0 : result.Nanoseconds / (double)result.Operations;
+  std::cout << std::left << std::setw(40) << result.Name << std::right << std::fixed << std::setprecision(2) << std::setw(12) << nsPerOp << " ns/op";
+  for (const auto& metric : result.Metrics)
+  {
+    std::cout << "  " << metric.first << "=" << metric.second;
+  }
+  std::cout << std::endl;
+
+  if (_json.is_open()) WriteJson(result);
+}
+
+void BenchmarkReporter::WriteJson(const BenchmarkResult& result)
+{
+  const double nsPerOp = result.Operations == 0 ? 0.0 : result.Nanoseconds / (double)result.Operations;
+  _json << std::setprecision(6) << "{\"benchmark\":\"" << result.Name << "\",\"operations\":" << result.Operations << ",\"ns_per_op\":" << nsPerOp;
+  for (const auto& metric : result.Metrics)
+  {
+    _json << ",\"" << metric.first << "\":" << metric.second;
+  }
+  _json << "}" << std::endl;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "../../Nanomites/Tracer/Platform.h"
+#include <string>
+#include <vector>
+#include <fstream>
+
+struct BenchmarkResult
+{
+  std::string Name;
+  ULONGLONG Operations;
+  double Nanoseconds;
+  std::vector<std::pair<std::string, double>> Metrics; // Additional values, e.g. "execs_per_s"
+
+  void AddMetric(const std::string& name, double value) { Metrics.push_back({ name, value }); }
+};
+
+// Prints results as a table and, if a file was opened, as one JSON object per line
+class BenchmarkReporter
+{
+public:
+  BenchmarkReporter();
+  ~BenchmarkReporter();
+
+  bool OpenJson(const char* fileName);
+  void SetFilter(const std::string& filter) { _filter = filter; }
+  bool IsSelected(const std::string& name) { return _filter.empty() || name.find(_filter) != std::string::npos; }
+
+  void Report(const BenchmarkResult& result);
+
+private:
+  void WriteJson(const BenchmarkResult& result);
+
+private:
+  std::string _filter;
+  std::ofstream _json;
+};
@@ -0,0 +1,75 @@
+#include "HardwareCounter.h"
+#ifndef _WIN32
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <x86intrin.h>
+#endif
+
+HardwareCounter::HardwareCounter()
+{
+  _descriptor = -1;
+  _metricName = "cycles_per_op";
+}
+
+HardwareCounter::~HardwareCounter()
+{
+  Close();
+}
+
+#ifdef _WIN32
+void HardwareCounter::Open()
+{
+  _metricName = "cycles_per_op";
+}
+
+void HardwareCounter::Close()
+{
+}
+
+ULONGLONG HardwareCounter::Read()
+{
+  ULONGLONG cycles = 0;
+  QueryThreadCycleTime(GetCurrentThread(), &cycles);
+  return cycles;
+}
+#else
+void HardwareCounter::Open()
+{
+  Close();
+  // Cache misses if possible, otherwise the cycles of the thread, otherwise the time stamp counter
+  const ULONGLONG events[] = { PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_CPU_CYCLES };
+  const char* metricNames[] = { "cache_misses_per_op", "cycles_per_op" };
+  for (DWORD i = 0; i < sizeof(events) / sizeof(events[0]) && _descriptor < 0; i++)
+  {
+    perf_event_attr attributes;
+    memset(&attributes, 0, sizeof(attributes));
+    attributes.type = PERF_TYPE_HARDWARE;
+    attributes.size = sizeof(attributes);
+    attributes.config = events[i];
+    attributes.exclude_kernel = 1; // The lookups run in user mode, also allowed with perf_event_paranoid 2
+    attributes.exclude_hv = 1;
+    _descriptor = (int)syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+    _metricName = metricNames[i];
+  }
+  if (_descriptor < 0) _metricName = "cycles_per_op";
+}
+
+void HardwareCounter::Close()
+{
+  if (_descriptor >= 0)
+  {
+    close(_descriptor);
+    _descriptor = -1;
+  }
+}
+
+ULONGLONG HardwareCounter::Read()
+{
+  if (_descriptor < 0) return __rdtsc();
+  ULONGLONG value = 0;
+  if (read(_descriptor, &value, sizeof(value)) != sizeof(value)) return 0;
+  return value;
+}
+#endif
@@ -0,0 +1,23 @@
+#pragma once
+#include "../../Nanomites/Tracer/Platform.h"
+
+// Hardware event counter of the calling thread. On Linux it counts the last level cache misses with perf_event_open
+// and falls back to cycles if the event or perf itself is not available (perf_event_paranoid, virtual machines).
+// On Windows the cache counters are not accessible from user mode, it counts the cycles of the thread.
+class HardwareCounter
+{
+public:
+  HardwareCounter();
+  ~HardwareCounter();
+
+  void Open();
+  void Close();
+  ULONGLONG Read();
+
+  // Name of the result metric, the counted events per operation
+  const char* GetMetricName() { return _metricName; }
+
+private:
+  int _descriptor; // perf event, -1 if the time stamp counter is read instead
+  const char* _metricName;
+};
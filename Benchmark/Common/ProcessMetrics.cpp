@@ -0,0 +1,77 @@
+#include "ProcessMetrics.h"
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/resource.h>
+#endif
+
+#ifdef _WIN32
+
+SIZE_T ProcessMetrics::GetPrivateBytes()
+{
+  PROCESS_MEMORY_COUNTERS_EX counters = {};
+  counters.cb = sizeof(counters);
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters), sizeof(counters))) return 0;
+  return counters.PrivateUsage;
+}
+
+SIZE_T ProcessMetrics::GetPeakWorkingSet()
+{
+  PROCESS_MEMORY_COUNTERS counters = {};
+  counters.cb = sizeof(counters);
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+  return counters.PeakWorkingSetSize;
+}
+
+void ProcessMetrics::GetProcessCpuTimes(double& userSeconds, double& kernelSeconds)
+{
+  FILETIME creationTime, exitTime, kernelTime, userTime;
+  userSeconds = 0.0;
+  kernelSeconds = 0.0;
+  if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime)) return;
+
+  // FILETIME is given in 100 ns units
+  userSeconds = (double)(((ULONGLONG)userTime.dwHighDateTime << 32) | userTime.dwLowDateTime) / 1e7;
+  kernelSeconds = (double)(((ULONGLONG)kernelTime.dwHighDateTime << 32) | kernelTime.dwLowDateTime) / 1e7;
+}
+#else
+SIZE_T ProcessMetrics::GetPrivateBytes()
+{
+  FILE* status = fopen("/proc/self/status", "r");
+  if (status == nullptr) return 0;
+
+  char line[256];
+  SIZE_T kilobytes = 0;
+  while (fgets(line, sizeof(line), status) != nullptr)
+  {
+    if (strncmp(line, "RssAnon:", 8) == 0)
+    {
+      kilobytes = strtoull(line + 8, nullptr, 10);
+      break;
+    }
+  }
+  fclose(status);
+  return kilobytes * 1024;
+}
+
+SIZE_T ProcessMetrics::GetPeakWorkingSet()
+{
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+  return (SIZE_T)usage.ru_maxrss * 1024; // Kilobytes
+}
+
+void ProcessMetrics::GetProcessCpuTimes(double& userSeconds, double& kernelSeconds)
+{
+  userSeconds = 0.0;
+  kernelSeconds = 0.0;
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return;
+
+  userSeconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6;
+  kernelSeconds = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+#endif
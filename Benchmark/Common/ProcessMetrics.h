@@ -0,0 +1,12 @@
+#pragma once
+#include "../../Nanomites/Tracer/Platform.h"
+
+// Memory and CPU counters of the current process; on Linux the private bytes are the resident anonymous memory and the
+// peak working set is the peak resident set size
+class ProcessMetrics
+{
+public:
+  static SIZE_T GetPrivateBytes();
+  static SIZE_T GetPeakWorkingSet();
+  static void GetProcessCpuTimes(double& userSeconds, double& kernelSeconds);
+};
@@ -0,0 +1,21 @@
+#include "Stopwatch.h"
+
+Stopwatch::Stopwatch()
+{
+  Start();
+}
+
+Stopwatch::~Stopwatch()
+{
+}
+
+void Stopwatch::Start()
+{
+  // QueryPerformanceCounter on Windows, CLOCK_MONOTONIC on Linux
+  _start = std::chrono::steady_clock::now();
+}
+
+double Stopwatch::ElapsedNanoseconds()
+{
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - _start).count();
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <chrono>
+
+class Stopwatch
+{
+public:
+  Stopwatch();
+  ~Stopwatch();
+
+  void Start();
+  double ElapsedNanoseconds();
+
+private:
+  std::chrono::steady_clock::time_point _start;
+};
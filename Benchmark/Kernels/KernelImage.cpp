@@ -0,0 +1,191 @@
+#include <cstring>
+#include "KernelImage.h"
+#include "../../Nanomites/Tracer/NanomiteMetadata.h"
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+typedef DWORD(*KernelFunction)();
+
+#define KERNEL_ALIGNMENT 64
+
+KernelImage::KernelImage()
+{
+  _unpatched = nullptr;
+  _patched = nullptr;
+  _size = 0;
+  _metadataBuffer = nullptr;
+  _random = 0x2545F491;
+}
+
+KernelImage::~KernelImage()
+{
+  Free();
+}
+
+bool KernelImage::Create(DWORD iterations)
+{
+  Free();
+
+  DWORD offset = 0;
+  for (DWORD i = 0; i < TrapKernelCount; i++)
+  {
+    _kernelOffsets.push_back(offset);
+    offset += (TrapKernels[i].CodeSize + KERNEL_ALIGNMENT - 1) & ~(KERNEL_ALIGNMENT - 1);
+  }
+  _size = offset;
+
+  _unpatched = Allocate(_size);
+  _patched = Allocate(_size);
+  if (_unpatched == nullptr || _patched == nullptr) return false;
+
+  Layout(_unpatched, iterations);
+  Layout(_patched, iterations);
+  ApplyNanomites();
+  CreateMetadata();
+
+  _section.SetSectionStart((DWORD_PTR)_patched);
+  _section.SetSectionEnd((DWORD_PTR)_patched + _size - 1);
+  _section.SetSectionSize(_size);
+
+  return Protect(_unpatched, _size) && Protect(_patched, _size);
+}
+
+DWORD KernelImage::RunUnpatched(DWORD kernelIndex)
+{
+  KernelFunction kernel = reinterpret_cast<KernelFunction>(_unpatched + _kernelOffsets[kernelIndex]);
+  return kernel();
+}
+
+DWORD KernelImage::RunPatched(DWORD kernelIndex)
+{
+  KernelFunction kernel = reinterpret_cast<KernelFunction>(_patched + _kernelOffsets[kernelIndex]);
+  return kernel();
+}
+
+BYTE* KernelImage::Allocate(DWORD size)
+{
+#ifdef _WIN32
+  BYTE* code = reinterpret_cast<BYTE*>(VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+#else
+  void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  BYTE* code = mapping == MAP_FAILED ? nullptr : reinterpret_cast<BYTE*>(mapping);
+#endif
+  if (code != nullptr) memset(code, 0xC3, size); // ret
+  return code;
+}
+
+bool KernelImage::Protect(BYTE* code, DWORD size)
+{
+#ifdef _WIN32
+  DWORD oldProtect = 0;
+  if (!VirtualProtect(code, size, PAGE_EXECUTE_READ, &oldProtect)) return false;
+  return FlushInstructionCache(GetCurrentProcess(), code, size) != FALSE;
+#else
+  if (mprotect(code, size, PROT_READ | PROT_EXEC) != 0) return false;
+  __builtin___clear_cache(reinterpret_cast<char*>(code), reinterpret_cast<char*>(code + size));
+  return true;
+#endif
+}
+
+void KernelImage::Release(BYTE* code)
+{
+#ifdef _WIN32
+  VirtualFree(code, 0, MEM_RELEASE);
+#else
+  munmap(code, _size);
+#endif
+}
+
+void KernelImage::Layout(BYTE* code, DWORD iterations)
+{
+  for (DWORD i = 0; i < TrapKernelCount; i++)
+  {
+    BYTE* kernel = code + _kernelOffsets[i];
+    memcpy(kernel, TrapKernels[i].Code, TrapKernels[i].CodeSize);
+    memcpy(kernel + TRAP_KERNEL_ITERATIONS_OFFSET, &iterations, sizeof(DWORD));
+  }
+}
+
+void KernelImage::ApplyNanomites()
+{
+  _nanomites.clear();
+  for (DWORD i = 0; i < TrapKernelCount; i++)
+  {
+    for (DWORD j = 0; j < TrapKernels[i].SiteCount; j++)
+    {
+      const DWORD rva = _kernelOffsets[i] + TrapKernels[i].SiteOffsets[j];
+      BYTE* site = _patched + rva;
+
+      Nanomite nanomite;
+      nanomite.Rva = rva;
+      if (site[0] == 0x0F) // 0x0F 0x80 - 0x8F : jcc rel32
+      {
+        nanomite.JumpType = ToJumpType(site[1]);
+        nanomite.OpcodeLength = 6;
+        nanomite.JumpLength = *reinterpret_cast<DWORD*>(site + 2);
+      }
+      else if (site[0] == 0xE9) // jmp rel32
+      {
+        nanomite.JumpType = ToJumpType(site[0]);
+        nanomite.OpcodeLength = 5;
+        nanomite.JumpLength = *reinterpret_cast<DWORD*>(site + 1);
+      }
+      else // jcc, jmp, jcxz rel8
+      {
+        nanomite.JumpType = ToJumpType(site[0]);
+        nanomite.OpcodeLength = 2;
+        nanomite.JumpLength = (DWORD)(int)(signed char)site[1];
+      }
+      _nanomites.push_back(nanomite);
+
+      // Same patching as NanomitesCreator::WriteNanomite
+      site[0] = 0xCC;
+      for (DWORD k = 1; k < nanomite.OpcodeLength; k++)
+      {
+        _random ^= _random << 13; _random ^= _random >> 17; _random ^= _random << 5;
+        site[k] = (BYTE)_random;
+      }
+    }
+  }
+}
+
+JumpType KernelImage::ToJumpType(DWORD opcode)
+{
+  if (opcode >= 0x70 && opcode <= 0x7F) return (JumpType)(JumpType::JO + opcode - 0x70);
+  if (opcode >= 0x80 && opcode <= 0x8F) return (JumpType)(JumpType::JO + opcode - 0x80);
+  if (opcode == 0xE3) return JumpType::JCXZ;
+  if (opcode == 0xEB || opcode == 0xE9) return JumpType::JMP;
+  return JumpType::UNKNOWN;
+}
+
+void KernelImage::CreateMetadata()
+{
+  // Same layout as the resource written by the Builder: header followed by the nanomites sorted by RVA
+  const DWORD metadataSize = sizeof(NanomiteMetadata) + (DWORD)_nanomites.size() * sizeof(Nanomite);
+  _metadataBuffer = new BYTE[metadataSize];
+  memset(_metadataBuffer, 0, metadataSize);
+  reinterpret_cast<NanomiteMetadata*>(_metadataBuffer)->ItemCount = (DWORD)_nanomites.size();
+  memcpy(_metadataBuffer + sizeof(NanomiteMetadata), _nanomites.data(), _nanomites.size() * sizeof(Nanomite));
+}
+
+void KernelImage::Free()
+{
+  if (_unpatched != nullptr)
+  {
+    Release(_unpatched);
+    _unpatched = nullptr;
+  }
+  if (_patched != nullptr)
+  {
+    Release(_patched);
+    _patched = nullptr;
+  }
+  if (_metadataBuffer != nullptr)
+  {
+    delete[] _metadataBuffer;
+    _metadataBuffer = nullptr;
+  }
+  _kernelOffsets.clear();
+  _nanomites.clear();
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "../../Nanomites/Tracer/Platform.h"
+#include <vector>
+#include "TrapKernels.h"
+#include "../../Nanomites/Tracer/SectionInfo.h"
+#include "../../Nanomites/Tracer/Nanomite.h"
+
+struct NanomiteMetadata;
+
+// Executable copies of all TrapKernels: an unpatched one and one with nanomites applied according to the
+// Builder's rules (0xCC followed by random bytes over the whole jump instruction). The patched copy is the
+// protected section for the Tracer, its allocation base serves as image base.
+class KernelImage
+{
+public:
+  KernelImage();
+  ~KernelImage();
+
+  bool Create(DWORD iterations);
+
+  DWORD RunUnpatched(DWORD kernelIndex);
+  DWORD RunPatched(DWORD kernelIndex);
+
+  DWORD_PTR GetImageBase() { return (DWORD_PTR)_patched; }
+  SectionInfo* GetSection() { return &_section; }
+  NanomiteMetadata* GetMetadata() { return reinterpret_cast<NanomiteMetadata*>(_metadataBuffer); }
+
+private:
+  BYTE* Allocate(DWORD size);
+  bool Protect(BYTE* code, DWORD size);
+  void Release(BYTE* code);
+  void Layout(BYTE* code, DWORD iterations);
+  void ApplyNanomites();
+  JumpType ToJumpType(DWORD opcode);
+  void CreateMetadata();
+  void Free();
+
+private:
+  BYTE* _unpatched;
+  BYTE* _patched;
+  DWORD _size;
+  std::vector<DWORD> _kernelOffsets;
+  std::vector<Nanomite> _nanomites;
+  BYTE* _metadataBuffer;
+  SectionInfo _section;
+  DWORD _random;
+};
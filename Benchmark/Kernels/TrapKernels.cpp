@@ -0,0 +1,57 @@
+#include "TrapKernels.h"
+
+// mov ecx, N / L: dec ecx / jnz L (short) / xor eax, eax / ret
+static const BYTE JnzShortLoop[] =
+{
+  0xB9, 0x00, 0x00, 0x00, 0x00, // 0  : mov ecx, iterations
+  0xFF, 0xC9,                   // 5  : dec ecx
+  0x75, 0xFC,                   // 7  : jnz 5
+  0x31, 0xC0,                   // 9  : xor eax, eax
+  0xC3                          // 11 : ret
+};
+
+// mov ecx, N / L: dec ecx / jnz L (near) / xor eax, eax / ret
+static const BYTE JnzNearLoop[] =
+{
+  0xB9, 0x00, 0x00, 0x00, 0x00,       // 0  : mov ecx, iterations
+  0xFF, 0xC9,                         // 5  : dec ecx
+  0x0F, 0x85, 0xF8, 0xFF, 0xFF, 0xFF, // 7  : jnz 5
+  0x31, 0xC0,                         // 13 : xor eax, eax
+  0xC3                                // 15 : ret
+};
+
+// Unconditional short jump inside the loop
+static const BYTE JmpChainLoop[] =
+{
+  0xB9, 0x00, 0x00, 0x00, 0x00, // 0  : mov ecx, iterations
+  0xFF, 0xC9,                   // 5  : dec ecx
+  0xEB, 0x01,                   // 7  : jmp 10
+  0x90,                         // 9  : nop
+  0x75, 0xF9,                   // 10 : jnz 5
+  0x31, 0xC0,                   // 12 : xor eax, eax
+  0xC3                          // 14 : ret
+};
+
+// Conditional jump which is taken every second iteration
+static const BYTE AlternatingLoop[] =
+{
+  0xB9, 0x00, 0x00, 0x00, 0x00, // 0  : mov ecx, iterations
+  0xFF, 0xC9,                   // 5  : dec ecx
+  0xF6, 0xC1, 0x01,             // 7  : test cl, 1
+  0x74, 0x02,                   // 10 : jz 14
+  0x90, 0x90,                   // 12 : nop, nop
+  0x85, 0xC9,                   // 14 : test ecx, ecx
+  0x75, 0xF3,                   // 16 : jnz 5
+  0x31, 0xC0,                   // 18 : xor eax, eax
+  0xC3                          // 20 : ret
+};
+
+const TrapKernel TrapKernels[] =
+{
+  { "jnz_short_loop", JnzShortLoop, sizeof(JnzShortLoop), { 7 }, 1 },
+  { "jnz_near_loop", JnzNearLoop, sizeof(JnzNearLoop), { 7 }, 1 },
+  { "jmp_chain_loop", JmpChainLoop, sizeof(JmpChainLoop), { 7, 10 }, 2 },
+  { "alternating_loop", AlternatingLoop, sizeof(AlternatingLoop), { 10, 16 }, 2 },
+};
+
+const DWORD TrapKernelCount = sizeof(TrapKernels) / sizeof(TrapKernels[0]);
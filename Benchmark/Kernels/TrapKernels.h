@@ -0,0 +1,18 @@
+#pragma once
+#include "../../Nanomites/Tracer/Platform.h"
+
+#define TRAP_KERNEL_MAX_SITES 4
+#define TRAP_KERNEL_ITERATIONS_OFFSET 1 // imm32 of "mov ecx, iterations"
+
+// Hand-assembled loop kernel with known jump sites; the encodings are identical for x86 and x64
+struct TrapKernel
+{
+  const char* Name;
+  const BYTE* Code;
+  DWORD CodeSize;
+  DWORD SiteOffsets[TRAP_KERNEL_MAX_SITES];
+  DWORD SiteCount;  // Every site is executed once per iteration
+};
+
+extern const TrapKernel TrapKernels[];
+extern const DWORD TrapKernelCount;
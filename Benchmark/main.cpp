@@ -0,0 +1,53 @@
+#include <iostream>
+#include <string>
+#include "Common/BenchmarkOptions.h"
+#include "Common/BenchmarkReporter.h"
+#include "Benchmarks/CoverageBenchmark.h"
+#include "Benchmarks/TracerBenchmark.h"
+#include "Benchmarks/TrapBenchmark.h"
+#include "Benchmarks/ScalingBenchmark.h"
+
+void PrintUsage();
+
+// --- main program --- Usage: Benchmark.exe [filter] [--json <file>] [--<option> <value> ...]
+// Runs all benchmarks whose name contains the filter, results are printed and optionally written as JSON lines.
+int main(int argc, char* argv[])
+{
+  BenchmarkOptions options;
+  if (!options.Parse(argc, argv))
+  {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  BenchmarkReporter reporter;
+  reporter.SetFilter(options.GetFilter());
+  if (options.Has("json") && !reporter.OpenJson(options.GetString("json", "").c_str()))
+  {
+    std::cout << "Opening " << options.GetString("json", "") << " failed!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  CoverageBenchmark coverageBenchmark;
+  coverageBenchmark.Run(reporter, options);
+
+  TracerBenchmark tracerBenchmark;
+  tracerBenchmark.Run(reporter, options);
+
+  TrapBenchmark trapBenchmark;
+  trapBenchmark.Run(reporter, options);
+
+  ScalingBenchmark scalingBenchmark;
+  scalingBenchmark.Run(reporter, options);
+
+  return EXIT_SUCCESS;
+}
+
+void PrintUsage()
+{
+  std::cout << "Usage: Benchmark.exe [filter] [--json <file>] [--<option> <value> ...]" << std::endl;
+  std::cout << "  coverage : --execs <fuzzing iterations>" << std::endl;
+  std::cout << "  tracer   : --sites <count> --density <sites per KB> --jmp <fraction of JMP> --near <fraction of near jumps>" << std::endl;
+  std::cout << "  trap     : --iterations <loop iterations> --repetitions <count>" << std::endl;
+  std::cout << "  scaling  : --threads <max threads> --iterations <loop iterations> --runs <per thread> --kernel <index> --pin <0|1>" << std::endl;
+}
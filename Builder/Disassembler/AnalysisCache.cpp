@@ -0,0 +1,274 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include "AnalysisCache.h"
+
+AnalysisCache::AnalysisCache()
+{
+  _shards.reset(new Shard[SHARD_COUNT]);
+  for (DWORD i = 0; i < SHARD_COUNT; i++)
+  {
+    _shards[i].Loaded = false;
+    _shards[i].Modified = false;
+  }
+  _hitCount = 0;
+  _missCount = 0;
+  _addedCount = 0;
+  _rejectedCount = 0;
+}
+
+AnalysisCache::~AnalysisCache()
+{
+}
+
+bool AnalysisCache::Open(const char* directory)
+{
+  _directory = directory;
+  std::error_code error;
+  std::filesystem::create_directories(_directory, error);
+  return std::filesystem::is_directory(_directory, error);
+}
+
+bool AnalysisCache::Save()
+{
+  bool result = true;
+  for (DWORD i = 0; i < SHARD_COUNT; i++)
+  {
+    Shard& shard = _shards[i];
+    std::lock_guard<std::mutex> lock(shard.Mutex);
+    if (!shard.Modified) continue;
+    if (!SaveShard(i, shard)) result = false;
+    shard.Modified = false;
+  }
+  return result;
+}
+
+FunctionKey AnalysisCache::GetKey(const BYTE* code, DWORD length, const std::vector<DWORD>& relocations, DWORD relocationSize, bool is64Bit, ULONGLONG decoderVersion, std::vector<BYTE>& buffer)
+{
+  // Relocated bytes hold absolute addresses that change with the image base and the layout, never instruction bytes
+  buffer.assign(code, code + length);
+  for (DWORD offset : relocations)
+  {
+    if (offset < length) memset(buffer.data() + offset, 0, std::min(relocationSize, length - offset));
+  }
+
+  ULONGLONG low = KEY_SEED_LOW ^ length ^ Mix(decoderVersion);
+  ULONGLONG high = KEY_SEED_HIGH ^ (((ULONGLONG)length << 1) | (is64Bit ? 1 : 0));
+  for (DWORD offset : relocations)
+  {
+    high = (high ^ offset) * KEY_PRIME_1;
+  }
+
+  // Two independent lanes over 8 byte words, the tail is zero padded; the length is part of the seed
+  DWORD i = 0;
+  for (; i < length; i += sizeof(ULONGLONG))
+  {
+    ULONGLONG word = 0;
+    memcpy(&word, buffer.data() + i, std::min<DWORD>(sizeof(ULONGLONG), length - i));
+    low = Rotate(low ^ (word * KEY_PRIME_1), 31) * KEY_PRIME_2;
+    high = Rotate(high + word, 27) * KEY_PRIME_3 + KEY_PRIME_1;
+  }
+
+  FunctionKey key;
+  key.Low = Mix(low ^ Rotate(high, 32));
+  key.High = Mix(high + key.Low);
+  return key;
+}
+
+bool AnalysisCache::Find(const FunctionKey& key, FunctionAnalysis& outAnalysis)
+{
+  const size_t index = GetShardIndex(key);
+  Shard& shard = _shards[index];
+  std::lock_guard<std::mutex> lock(shard.Mutex);
+  LoadShard(index, shard);
+  auto entry = shard.Entries.find(key);
+  if (entry == shard.Entries.end())
+  {
+    _missCount++;
+    return false;
+  }
+  entry->second.Used = true;
+  outAnalysis = entry->second.Analysis;
+  _hitCount++;
+  return true;
+}
+
+void AnalysisCache::Insert(const FunctionKey& key, const FunctionAnalysis& analysis)
+{
+  const size_t index = GetShardIndex(key);
+  Shard& shard = _shards[index];
+  std::lock_guard<std::mutex> lock(shard.Mutex);
+  LoadShard(index, shard);
+  Entry& entry = shard.Entries[key];
+  entry.Analysis = analysis;
+  entry.Used = true;
+  shard.Modified = true;
+  _addedCount++;
+}
+
+void AnalysisCache::Reject(const FunctionKey& key)
+{
+  const size_t index = GetShardIndex(key);
+  Shard& shard = _shards[index];
+  std::lock_guard<std::mutex> lock(shard.Mutex);
+  if (shard.Entries.erase(key) == 0) return;
+  _hitCount--;
+  _missCount++;
+  _rejectedCount++;
+}
+
+size_t AnalysisCache::GetShardIndex(const FunctionKey& key)
+{
+  return (size_t)(key.High >> 56);
+}
+
+void AnalysisCache::LoadShard(size_t index, Shard& shard)
+{
+  // Called with the lock of the shard held
+  if (shard.Loaded) return;
+  ReadShard(GetShardName(index), shard.Entries);
+  shard.Loaded = true;
+}
+
+std::string AnalysisCache::GetShardName(size_t index) const
+{
+  const char* digits = "0123456789abcdef";
+  return (std::filesystem::path(_directory) / (std::string() + digits[index >> 4] + digits[index & 15] + ".nmc")).string();
+}
+
+bool AnalysisCache::SaveShard(size_t index, Shard& shard)
+{
+  // Entries written by other builders since the shard was loaded are kept
+  const std::string fileName = GetShardName(index);
+  EntryMap diskEntries;
+  ReadShard(fileName, diskEntries);
+
+  // Entries used by this build first, then the rest until the shard is full
+  std::vector<BYTE> buffer(sizeof(ShardHeader));
+  DWORD entryCount = 0;
+  for (int pass = 0; pass < 3; pass++)
+  {
+    const EntryMap& entries = pass < 2 ? shard.Entries : diskEntries;
+    for (const auto& entry : entries)
+    {
+      if (entryCount == MAX_SHARD_ENTRIES) break;
+      if (pass == 0 && !entry.second.Used) continue;
+      if (pass == 1 && entry.second.Used) continue;
+      if (pass == 2 && shard.Entries.count(entry.first) != 0) continue;
+      AppendEntry(buffer, entry.first, entry.second.Analysis);
+      entryCount++;
+    }
+  }
+
+  ShardHeader header = { SHARD_MAGIC, CACHE_VERSION, entryCount, 0 };
+  memcpy(buffer.data(), &header, sizeof(header));
+  const DWORD trailer[2] = { SHARD_MAGIC, Hash(FNV_OFFSET_BASIS, buffer.data(), buffer.size()) };
+  buffer.insert(buffer.end(), (const BYTE*)trailer, (const BYTE*)trailer + sizeof(trailer));
+
+  // The temporary name is unique across processes and machines sharing the directory
+  std::random_device random;
+  const std::string tempName = fileName + "." + std::to_string(((ULONGLONG)random() << 32) | random()) + ".tmp";
+  std::ofstream file(tempName, std::ios::binary | std::ios::trunc);
+  file.write((const char*)buffer.data(), buffer.size());
+  file.close();
+
+  std::error_code error;
+  if (!file.good())
+  {
+    std::filesystem::remove(tempName, error);
+    return false;
+  }
+  std::filesystem::rename(tempName, fileName, error);
+  if (error)
+  {
+    // E.g. the shard is open in another process on Windows; the entries are found again next time
+    std::filesystem::remove(tempName, error);
+    return false;
+  }
+  return true;
+}
+
+bool AnalysisCache::ReadShard(const std::string& fileName, EntryMap& outEntries)
+{
+  std::ifstream file(fileName, std::ios::binary);
+  if (!file.is_open()) return false;
+  std::vector<BYTE> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+  DWORD trailer[2];
+  if (data.size() < sizeof(ShardHeader) + sizeof(trailer)) return false;
+  const size_t end = data.size() - sizeof(trailer);
+  memcpy(trailer, data.data() + end, sizeof(trailer));
+  if (trailer[0] != SHARD_MAGIC || trailer[1] != Hash(FNV_OFFSET_BASIS, data.data(), end)) return false;
+
+  ShardHeader header;
+  memcpy(&header, data.data(), sizeof(header));
+  if (header.Magic != SHARD_MAGIC || header.Version != CACHE_VERSION) return false;
+
+  // Entries are only added once the whole shard parsed
+  EntryMap entries;
+  size_t position = sizeof(ShardHeader);
+  for (DWORD i = 0; i < header.EntryCount; i++)
+  {
+    FunctionKey key;
+    DWORD counts[2];
+    if (end - position < sizeof(key) + sizeof(counts)) return false;
+    memcpy(&key, data.data() + position, sizeof(key));
+    memcpy(counts, data.data() + position + sizeof(key), sizeof(counts));
+    position += sizeof(key) + sizeof(counts);
+
+    const size_t jumpBytes = (size_t)counts[0] * sizeof(RelativeJump);
+    const size_t callBytes = (size_t)counts[1] * sizeof(LONGLONG);
+    if (end - position < jumpBytes + callBytes) return false;
+
+    Entry& entry = entries[key];
+    entry.Used = false;
+    entry.Analysis.Jumps.resize(counts[0]);
+    entry.Analysis.Calls.resize(counts[1]);
+    if (jumpBytes != 0) memcpy(entry.Analysis.Jumps.data(), data.data() + position, jumpBytes);
+    if (callBytes != 0) memcpy(entry.Analysis.Calls.data(), data.data() + position + jumpBytes, callBytes);
+    position += jumpBytes + callBytes;
+  }
+  if (position != end) return false;
+
+  // Entries already in memory are newer or the same
+  outEntries.insert(entries.begin(), entries.end());
+  return true;
+}
+
+void AnalysisCache::AppendEntry(std::vector<BYTE>& buffer, const FunctionKey& key, const FunctionAnalysis& analysis)
+{
+  const DWORD counts[2] = { (DWORD)analysis.Jumps.size(), (DWORD)analysis.Calls.size() };
+  buffer.insert(buffer.end(), (const BYTE*)&key, (const BYTE*)&key + sizeof(key));
+  buffer.insert(buffer.end(), (const BYTE*)counts, (const BYTE*)counts + sizeof(counts));
+  buffer.insert(buffer.end(), (const BYTE*)analysis.Jumps.data(), (const BYTE*)(analysis.Jumps.data() + analysis.Jumps.size()));
+  buffer.insert(buffer.end(), (const BYTE*)analysis.Calls.data(), (const BYTE*)(analysis.Calls.data() + analysis.Calls.size()));
+}
+
+ULONGLONG AnalysisCache::Rotate(ULONGLONG value, int bits)
+{
+  return (value << bits) | (value >> (64 - bits));
+}
+
+ULONGLONG AnalysisCache::Mix(ULONGLONG value)
+{
+  // Finalizer of MurmurHash3
+  value ^= value >> 33;
+  value *= 0xFF51AFD7ED558CCDULL;
+  value ^= value >> 33;
+  value *= 0xC4CEB9FE1A85EC53ULL;
+  value ^= value >> 33;
+  return value;
+}
+
+DWORD AnalysisCache::Hash(DWORD hash, const BYTE* data, size_t size)
+{
+  // FNV-1a
+  for (size_t i = 0; i < size; i++)
+  {
+    hash ^= data[i];
+    hash *= 0x01000193;
+  }
+  return hash;
+}
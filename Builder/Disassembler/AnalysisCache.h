@@ -0,0 +1,121 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "RelativeJump.h"
+#include "../PEFile/PEFormat.h"
+
+// Content address of a function: 128 bit hash of its bytes with the relocated bytes zeroed, the positions of these
+// relocations, its length, the machine mode and the decoder version. Rebasing or moving the function keeps the key.
+struct FunctionKey
+{
+  ULONGLONG Low;
+  ULONGLONG High;
+
+  bool operator==(const FunctionKey& other) const { return Low == other.Low && High == other.High; }
+};
+
+// Analysis of one function, relative to its start
+struct FunctionAnalysis
+{
+  std::vector<RelativeJump> Jumps;  // Rva is the offset in the function
+  std::vector<LONGLONG> Calls;      // Targets of relative calls, relative to the function start
+};
+
+// Content-addressed on-disk cache of function analyses, shared by every build that uses the same directory. The
+// entries are split into 256 shard files by key. A shard is only ever replaced as a whole: Save writes a temporary
+// file and renames it over the old one, so readers on other processes or machines see either version, never a torn
+// file. Concurrent writers merge with the shard on disk right before the rename; if one rename wins over another, the
+// lost entries are analyzed again next time. Shards with a bad checksum or version are ignored.
+class AnalysisCache
+{
+public:
+  AnalysisCache();
+  ~AnalysisCache();
+
+  // Creates the directory if needed; the shards are loaded on first use
+  bool Open(const char* directory);
+  // Writes the shards that received new entries; false if one of them could not be written
+  bool Save();
+
+  // relocations: sorted offsets in the function of the relocated bytes, relocationSize bytes each. decoderVersion
+  // separates the analyses of different decoders, e.g. ZydisGetVersion(). buffer receives the normalized copy of the code.
+  static FunctionKey GetKey(const BYTE* code, DWORD length, const std::vector<DWORD>& relocations, DWORD relocationSize, bool is64Bit, ULONGLONG decoderVersion, std::vector<BYTE>& buffer);
+
+  // All are thread-safe
+  bool Find(const FunctionKey& key, FunctionAnalysis& outAnalysis);
+  void Insert(const FunctionKey& key, const FunctionAnalysis& analysis);
+  // Drops an entry that Find returned but that does not match the code; it counts as a miss instead of a hit. The
+  // entry on disk is only replaced once the analysis is inserted again.
+  void Reject(const FunctionKey& key);
+
+  const std::string& GetDirectory() const { return _directory; }
+  DWORD GetHitCount() const { return _hitCount; }
+  DWORD GetMissCount() const { return _missCount; }
+  DWORD GetAddedCount() const { return _addedCount; }
+  DWORD GetRejectedCount() const { return _rejectedCount; }
+
+private:
+  struct FunctionKeyHash
+  {
+    size_t operator()(const FunctionKey& key) const { return (size_t)(key.Low ^ key.High); }
+  };
+
+  struct Entry
+  {
+    FunctionAnalysis Analysis;
+    bool Used;                    // Found or inserted by this process, kept first when a shard is full
+  };
+
+  typedef std::unordered_map<FunctionKey, Entry, FunctionKeyHash> EntryMap;
+
+  struct Shard
+  {
+    std::mutex Mutex;
+    bool Loaded;
+    bool Modified;
+    EntryMap Entries;
+  };
+
+  // Shard layout: ShardHeader, per entry its key, jump count, call count, jumps and calls, then SHARD_MAGIC and the
+  // FNV-1a hash of all bytes in front of it
+  struct ShardHeader
+  {
+    DWORD Magic;
+    DWORD Version;
+    DWORD EntryCount;
+    DWORD Reserved;
+  };
+
+  static size_t GetShardIndex(const FunctionKey& key);
+  std::string GetShardName(size_t index) const;
+  void LoadShard(size_t index, Shard& shard);
+  bool SaveShard(size_t index, Shard& shard);
+  static bool ReadShard(const std::string& fileName, EntryMap& outEntries);
+  static void AppendEntry(std::vector<BYTE>& buffer, const FunctionKey& key, const FunctionAnalysis& analysis);
+  static ULONGLONG Rotate(ULONGLONG value, int bits);
+  static ULONGLONG Mix(ULONGLONG value);
+  static DWORD Hash(DWORD hash, const BYTE* data, size_t size);
+
+private:
+  static const DWORD SHARD_COUNT = 256;
+  static const DWORD SHARD_MAGIC = 0x434D4E4E;          // "NNMC"
+  static const DWORD CACHE_VERSION = 2;                 // Bump when the analysis or the key changes
+  static const DWORD MAX_SHARD_ENTRIES = 1 << 16;
+  static const DWORD FNV_OFFSET_BASIS = 0x811C9DC5;
+  static const ULONGLONG KEY_SEED_LOW = 0x9E3779B97F4A7C15ULL;
+  static const ULONGLONG KEY_SEED_HIGH = 0x6A09E667F3BCC909ULL;
+  static const ULONGLONG KEY_PRIME_1 = 0x9E3779B185EBCA87ULL;
+  static const ULONGLONG KEY_PRIME_2 = 0xC2B2AE3D27D4EB4FULL;
+  static const ULONGLONG KEY_PRIME_3 = 0x165667B19E3779F9ULL;
+
+  std::string _directory;
+  std::unique_ptr<Shard[]> _shards;
+  std::atomic<DWORD> _hitCount;
+  std::atomic<DWORD> _missCount;
+  std::atomic<DWORD> _addedCount;
+  std::atomic<DWORD> _rejectedCount;
+};
@@ -0,0 +1,155 @@
+// The SSE2 and AVX2 variants exist on x86 and x64 only, other architectures always use the scalar loop
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define BYTE_SCANNER_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#include <cpuid.h>
+#include <immintrin.h>
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+#include "ByteScanner.h"
+
+ByteScanner::ByteScanner()
+{
+  _supportedLevel = DetectLevel();
+  _level = _supportedLevel;
+}
+
+ByteScanner::~ByteScanner()
+{
+}
+
+void ByteScanner::Find(const BYTE* data, DWORD length, BYTE value, std::vector<DWORD>& offsets) const
+{
+  // The vector loops collect the matches of a window on the stack and stop before the last partial window, the
+  // scalar loop does the tail
+  DWORD scanned = 0;
+#ifdef BYTE_SCANNER_X86
+  if (_level == ScanLevel::Avx2)
+  {
+    scanned = FindAvx2(data, length, value, offsets);
+  }
+  else if (_level == ScanLevel::Sse2)
+  {
+    scanned = FindSse2(data, length, value, offsets);
+  }
+#endif
+  FindScalar(data, scanned, length, value, offsets);
+}
+
+ScanLevel ByteScanner::DetectLevel()
+{
+#ifndef BYTE_SCANNER_X86
+  return ScanLevel::Scalar;
+#else
+  unsigned int info[4];
+  Cpuid(0, info);
+  const unsigned int maxLeaf = info[0];
+  Cpuid(1, info);
+  const bool hasSse2 = (info[3] & (1 << 26)) != 0;
+  const bool hasOsxsave = (info[2] & (1 << 27)) != 0;
+  const bool hasAvx = (info[2] & (1 << 28)) != 0;
+
+  // AVX2 also needs the OS to save the upper halves of the YMM registers (XCR0 bits 1 and 2)
+  bool hasAvx2 = false;
+  if (maxLeaf >= 7 && hasOsxsave && hasAvx && (GetEnabledStates() & 6) == 6)
+  {
+    Cpuid(7, info);
+    hasAvx2 = (info[1] & (1 << 5)) != 0;
+  }
+
+  if (hasAvx2) return ScanLevel::Avx2;
+  if (hasSse2) return ScanLevel::Sse2;
+  return ScanLevel::Scalar;
+#endif
+}
+
+#ifdef BYTE_SCANNER_X86
+void ByteScanner::Cpuid(unsigned int leaf, unsigned int info[4])
+{
+#ifdef _MSC_VER
+  __cpuidex((int*)info, (int)leaf, 0);
+#else
+  __cpuid_count(leaf, 0, info[0], info[1], info[2], info[3]);
+#endif
+}
+
+ULONGLONG ByteScanner::GetEnabledStates()
+{
+#ifdef _MSC_VER
+  return _xgetbv(0);
+#else
+  // xgetbv with ECX = 0 reads XCR0; the instruction itself does not need the xsave target
+  unsigned int low, high;
+  __asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+  return ((ULONGLONG)high << 32) | low;
+#endif
+}
+
+DWORD ByteScanner::FindSse2(const BYTE* data, DWORD length, BYTE value, std::vector<DWORD>& offsets)
+{
+  const __m128i needle = _mm_set1_epi8((char)value);
+  DWORD matches[WINDOW_SIZE];
+  DWORD offset = 0;
+  while (length - offset >= WINDOW_SIZE)
+  {
+    DWORD count = 0;
+    for (DWORD end = offset + WINDOW_SIZE; offset < end; offset += 16)
+    {
+      const __m128i block = _mm_loadu_si128((const __m128i*)(data + offset));
+      const DWORD mask = (DWORD)_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+      count = AddMatches(offset, mask, matches, count);
+    }
+    offsets.insert(offsets.end(), matches, matches + count);
+  }
+  return offset;
+}
+
+TARGET_AVX2 DWORD ByteScanner::FindAvx2(const BYTE* data, DWORD length, BYTE value, std::vector<DWORD>& offsets)
+{
+  const __m256i needle = _mm256_set1_epi8((char)value);
+  DWORD matches[WINDOW_SIZE];
+  DWORD offset = 0;
+  while (length - offset >= WINDOW_SIZE)
+  {
+    DWORD count = 0;
+    for (DWORD end = offset + WINDOW_SIZE; offset < end; offset += 32)
+    {
+      const __m256i block = _mm256_loadu_si256((const __m256i*)(data + offset));
+      const DWORD mask = (DWORD)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle));
+      count = AddMatches(offset, mask, matches, count);
+    }
+    offsets.insert(offsets.end(), matches, matches + count);
+  }
+  _mm256_zeroupper();
+  return offset;
+}
+
+DWORD ByteScanner::AddMatches(DWORD offset, DWORD mask, DWORD* matches, DWORD count)
+{
+  // One bit per byte of the block, lowest bit first keeps the offsets sorted
+  while (mask != 0)
+  {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+#else
+    const DWORD index = (DWORD)__builtin_ctz(mask);
+#endif
+    matches[count++] = offset + index;
+    mask &= mask - 1;
+  }
+  return count;
+}
+#endif
+
+void ByteScanner::FindScalar(const BYTE* data, DWORD begin, DWORD length, BYTE value, std::vector<DWORD>& offsets)
+{
+  for (DWORD i = begin; i < length; i++)
+  {
+    if (data[i] == value) offsets.push_back(i);
+  }
+}
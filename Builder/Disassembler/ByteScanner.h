@@ -0,0 +1,42 @@
+#pragma once
+#include <vector>
+#include "../PEFile/PEFormat.h"
+
+enum class ScanLevel
+{
+  Scalar,
+  Sse2,  // 16 bytes per compare
+  Avx2   // 32 bytes per compare
+};
+
+// Finds all occurrences of a byte value with SIMD compares; the best level supported by the processor and the OS is
+// selected at runtime. Builds for other architectures than x86 and x64 only have the scalar loop.
+class ByteScanner
+{
+public:
+  ByteScanner();
+  ~ByteScanner();
+
+  // Appends the offsets of all bytes equal to value, in ascending order
+  void Find(const BYTE* data, DWORD length, BYTE value, std::vector<DWORD>& offsets) const;
+
+  // Lower levels can be forced for comparison, higher levels than supported are ignored
+  void SetLevel(ScanLevel level) { _level = level <= _supportedLevel ? level : _supportedLevel; }
+  ScanLevel GetLevel() const { return _level; }
+  ScanLevel GetSupportedLevel() const { return _supportedLevel; }
+
+private:
+  static ScanLevel DetectLevel();
+  static void Cpuid(unsigned int leaf, unsigned int info[4]);
+  static ULONGLONG GetEnabledStates(); // XCR0
+  static void FindScalar(const BYTE* data, DWORD begin, DWORD length, BYTE value, std::vector<DWORD>& offsets);
+  static DWORD FindSse2(const BYTE* data, DWORD length, BYTE value, std::vector<DWORD>& offsets);
+  static DWORD FindAvx2(const BYTE* data, DWORD length, BYTE value, std::vector<DWORD>& offsets);
+  static DWORD AddMatches(DWORD offset, DWORD mask, DWORD* matches, DWORD count);
+
+private:
+  static const DWORD WINDOW_SIZE = 1024;
+
+  ScanLevel _supportedLevel;
+  ScanLevel _level;
+};
@@ -1,78 +1,545 @@
+#ifndef ZYDIS_STATIC_BUILD
 #define ZYDIS_STATIC_BUILD
-#include <windows.h>
+#endif
+#include <algorithm>
+#include <atomic>
 #include <map>
+#include <thread>
 #include "Disassembler.h"
 
 Disassembler::Disassembler()
 {
+  InitializeDecoder(true);
+  _analysisMode = AnalysisMode::ControlFlow;
+  _threadCount = std::thread::hardware_concurrency();
+  if (_threadCount == 0) _threadCount = 1;
+  _functionCount = 0;
+  _cache = nullptr;
+  _cachedFunctionCount = 0;
+  _relocationSize = 0;
+  _is64Bit = true;
 }
 
 Disassembler::~Disassembler()
 {
 }
 
-bool Disassembler::GetRelativeJumps(PEFile& peFile, PIMAGE_SECTION_HEADER sectionHeader, std::vector<RelativeJump>& result)
+bool Disassembler::AnalyzeSection(PEFile& peFile, const PeSectionHeader* sectionHeader, std::vector<RelativeJump>& jumps, std::vector<DWORD>& ccRvas)
+{
+  const BYTE* section = peFile.GetPointer(sectionHeader->PointerToRawData, sectionHeader->SizeOfRawData);
+  const DWORD sectionLength = sectionHeader->SizeOfRawData;
+  if (section == nullptr) return false;
+
+  jumps.clear();
+  ccRvas.clear();
+  InitializeDecoder(peFile.Is64Bit());
+  _is64Bit = peFile.Is64Bit();
+  _cachedFunctionCount = 0;
+  _functionStarts.clear();
+
+  if (_analysisMode == AnalysisMode::ControlFlow)
+  {
+    AnalyzeControlFlow(peFile, sectionHeader, jumps);
+  }
+  else
+  {
+    // Several chunks per thread balance the load, but every chunk should be large compared to the resynchronization
+    DWORD chunkCount = _threadCount * 4;
+    if (chunkCount > sectionLength / MIN_CHUNK_SIZE) chunkCount = sectionLength / MIN_CHUNK_SIZE;
+    if (_threadCount == 1 || chunkCount < 2)
+    {
+      AnalyzeSerial(section, sectionLength, jumps);
+    }
+    else
+    {
+      AnalyzeParallel(section, sectionLength, chunkCount, jumps);
+    }
+  }
+
+  // 0xCC bytes inside of instructions count as well, they do not depend on the instruction boundaries
+  ccRvas.reserve(sectionLength / 64);
+  _byteScanner.Find(section, sectionLength, 0xCC, ccRvas);
+  return true;
+}
+
+void Disassembler::InitializeDecoder(bool is64Bit)
+{
+  // The machine mode follows the image, not the platform of the Builder
+  if (is64Bit)
+  {
+    ZydisDecoderInit(&_decoder, ZYDIS_MACHINE_MODE_LONG_64, ZYDIS_STACK_WIDTH_64);
+  }
+  else
+  {
+    ZydisDecoderInit(&_decoder, ZYDIS_MACHINE_MODE_LONG_COMPAT_32, ZYDIS_STACK_WIDTH_32);
+  }
+  ZydisDecoderEnableMode(&_decoder, ZYDIS_DECODER_MODE_MINIMAL, ZYAN_TRUE);
+}
+
+void Disassembler::AnalyzeSerial(const BYTE* section, DWORD sectionLength, std::vector<RelativeJump>& jumps) const
+{
+  // Compiled code has roughly one jump per 16 bytes
+  jumps.reserve(sectionLength / 16);
+
+  DWORD rva = 0;
+  while (rva < sectionLength)
+  {
+    rva += DecodeInstruction(section, sectionLength, rva, jumps);
+  }
+}
+
+void Disassembler::AnalyzeParallel(const BYTE* section, DWORD sectionLength, DWORD chunkCount, std::vector<RelativeJump>& jumps) const
+{
+  std::vector<Chunk> chunks(chunkCount);
+  const DWORD chunkSize = sectionLength / chunkCount;
+  for (DWORD i = 0; i < chunkCount; i++)
+  {
+    chunks[i].Begin = i * chunkSize;
+    chunks[i].End = (i == chunkCount - 1) ? sectionLength : (i + 1) * chunkSize;
+  }
+
+  // Every chunk except the first starts decoding at a guessed instruction boundary
+  std::atomic<DWORD> nextChunk(0);
+  std::vector<std::thread> threads;
+  const DWORD threadCount = _threadCount < chunkCount ? _threadCount : chunkCount;
+  for (DWORD t = 0; t < threadCount; t++)
+  {
+    threads.emplace_back([&]()
+    {
+      for (DWORD i = nextChunk++; i < chunkCount; i = nextChunk++)
+      {
+        AnalyzeChunk(section, sectionLength, chunks[i]);
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  // Merge in RVA order. The true instruction stream of the previous chunk ends at position; it is followed serially
+  // until it meets an instruction start of the chunk, from there on both streams are identical. x86 code usually
+  // converges after a few instructions, without convergence the whole chunk is decoded serially.
+  jumps.reserve(sectionLength / 16);
+  jumps.insert(jumps.end(), chunks[0].Jumps.begin(), chunks[0].Jumps.end());
+  DWORD position = chunks[0].StreamEnd;
+  for (DWORD i = 1; i < chunkCount; i++)
+  {
+    const Chunk& chunk = chunks[i];
+    bool converged = false;
+    while (position < chunk.End)
+    {
+      if (position < chunk.Begin + SYNC_WINDOW && std::binary_search(chunk.Starts.begin(), chunk.Starts.end(), position))
+      {
+        converged = true;
+        break;
+      }
+      position += DecodeInstruction(section, sectionLength, position, jumps);
+    }
+
+    if (converged)
+    {
+      auto first = std::lower_bound(chunk.Jumps.begin(), chunk.Jumps.end(), position, [](const RelativeJump& jump, DWORD rva) -> bool
+      {
+        return jump.Rva < rva;
+      });
+      jumps.insert(jumps.end(), first, chunk.Jumps.end());
+      position = chunk.StreamEnd;
+    }
+  }
+}
+
+void Disassembler::AnalyzeChunk(const BYTE* section, DWORD sectionLength, Chunk& chunk) const
+{
+  chunk.Jumps.reserve((chunk.End - chunk.Begin) / 16);
+
+  DWORD rva = chunk.Begin;
+  while (rva < chunk.End)
+  {
+    if (rva < chunk.Begin + SYNC_WINDOW) chunk.Starts.push_back(rva);
+    rva += DecodeInstruction(section, sectionLength, rva, chunk.Jumps);
+  }
+  chunk.StreamEnd = rva;
+}
+
+DWORD Disassembler::DecodeInstruction(const BYTE* section, DWORD sectionLength, DWORD rva, std::vector<RelativeJump>& jumps) const
+{
+  ZydisDecodedInstruction instruction;
+  if (!ZYAN_SUCCESS(ZydisDecoderDecodeInstruction(&_decoder, nullptr, section + rva, sectionLength - rva, &instruction)))
+  {
+    return 1; // Undecodable bytes are skipped one by one
+  }
+
+  if (IsRelativeJump(instruction))
+  {
+    jumps.push_back(ToRelativeJump(instruction, rva));
+  }
+  return instruction.length;
+}
+
+void Disassembler::AnalyzeControlFlow(PEFile& peFile, const PeSectionHeader* sectionHeader, std::vector<RelativeJump>& jumps)
 {
-  DWORD sectionOffset = sectionHeader->PointerToRawData;
-  DWORD sectionLength = sectionHeader->SizeOfRawData;
-  DWORD fileOffset = sectionOffset;
-  do
+  Exploration exploration;
+  exploration.Section = peFile.GetPointer(sectionHeader->PointerToRawData, sectionHeader->SizeOfRawData);
+  exploration.SectionLength = sectionHeader->SizeOfRawData;
+  exploration.SectionVa = peFile.GetImageBase() + sectionHeader->VirtualAddress;
+  exploration.SectionRva = sectionHeader->VirtualAddress;
+  exploration.Map.assign(exploration.SectionLength, UNEXPLORED);
+
+  FunctionTable functionTable;
+  const bool hasFunctionTable = functionTable.Load(peFile, sectionHeader) && !functionTable.GetFunctions().empty();
+  const std::vector<FunctionRange>& functions = functionTable.GetFunctions();
+  _functionCount = hasFunctionTable ? (DWORD)functions.size() : 0;
+
+  std::vector<DWORD> calls;
+  if (hasFunctionTable && _cache != nullptr)
   {
-    ZydisDisassembledInstruction instructionInfo;
-    GetInstruction(peFile, fileOffset, instructionInfo);
-    if (IsRelativeJump(instructionInfo))
+    // The keys ignore the relocated bytes, their values change with the image base and the layout
+    std::vector<DWORD> rvas;
+    peFile.GetRelocations(rvas);
+    _relocations.clear();
+    for (DWORD rva : rvas)
     {
-      RelativeJump relativeJump;
-      relativeJump.Rva = fileOffset - sectionOffset;
-      relativeJump.Opcode = instructionInfo.info.opcode;
-      relativeJump.OpcodeLength = instructionInfo.info.length;
-      relativeJump.JmpLength = (DWORD)instructionInfo.info.raw.imm->value.u;
+      if (rva >= sectionHeader->VirtualAddress && rva - sectionHeader->VirtualAddress < exploration.SectionLength) _relocations.push_back(rva - sectionHeader->VirtualAddress);
+    }
+    _relocationSize = peFile.Is64Bit() ? sizeof(ULONGLONG) : sizeof(DWORD);
+  }
+  if (hasFunctionTable)
+  {
+    // Exact instruction boundaries: every function is decoded from its start to its end, independent of the others
+    AnalyzeFunctions(exploration.Section, exploration.SectionLength, functions, jumps, calls);
+    for (const FunctionRange& function : functions)
+    {
+      std::fill(exploration.Map.begin() + function.Begin, exploration.Map.begin() + function.End, FUNCTION);
+    }
+  }
+
+  // Recursive descent from the entry point and the calls of the .pdata functions; leaf functions have no .pdata entry
+  // and are reached this way or, if only called from outside of the section or through pointers, by the starts behind
+  // int3 padding in the gaps between the functions. Without .pdata the section start is added as well.
+  AddFunctionStart(exploration, (LONGLONG)peFile.GetEntryPoint() - sectionHeader->VirtualAddress);
+  for (DWORD call : calls) AddFunctionStart(exploration, call);
+  if (!hasFunctionTable) AddFunctionStart(exploration, 0);
+  Explore(exploration, jumps);
+  ExploreGaps(exploration, jumps);
+
+  for (const FunctionRange& function : functions) exploration.FunctionStarts.push_back(function.Begin);
+  std::sort(exploration.FunctionStarts.begin(), exploration.FunctionStarts.end());
+  exploration.FunctionStarts.erase(std::unique(exploration.FunctionStarts.begin(), exploration.FunctionStarts.end()), exploration.FunctionStarts.end());
+  _functionStarts.swap(exploration.FunctionStarts);
+
+  std::sort(jumps.begin(), jumps.end(), [](const RelativeJump& a, const RelativeJump& b) -> bool
+  {
+    return a.Rva < b.Rva;
+  });
+}
+
+void Disassembler::AnalyzeFunctions(const BYTE* section, DWORD sectionLength, const std::vector<FunctionRange>& functions, std::vector<RelativeJump>& jumps, std::vector<DWORD>& calls)
+{
+  // Blocks of consecutive functions keep the results in RVA order without a vector per function
+  DWORD codeSize = 0;
+  for (const FunctionRange& function : functions) codeSize += function.End - function.Begin;
+  DWORD blockSize = codeSize / (_threadCount * 8);
+  if (blockSize < MIN_BLOCK_SIZE) blockSize = MIN_BLOCK_SIZE;
 
-      result.push_back(relativeJump);
+  std::vector<FunctionBlock> blocks;
+  DWORD size = 0;
+  for (size_t i = 0; i < functions.size(); i++)
+  {
+    if (blocks.empty() || size >= blockSize)
+    {
+      blocks.emplace_back();
+      blocks.back().First = i;
+      size = 0;
+    }
+    blocks.back().Last = i + 1;
+    size += functions[i].End - functions[i].Begin;
+  }
+
+  auto analyzeBlock = [&](FunctionBlock& block)
+  {
+    FunctionAnalysis analysis;
+    FunctionKey key;
+    std::vector<BYTE> buffer;
+    block.CachedCount = 0;
+    for (size_t i = block.First; i < block.Last; i++)
+    {
+      if (_cache != nullptr && FindCachedFunction(section, functions[i], key, analysis, buffer))
+      {
+        block.CachedCount++;
+      }
+      else
+      {
+        AnalyzeFunction(section, functions[i], analysis);
+        if (_cache != nullptr) _cache->Insert(key, analysis);
+      }
+      AddFunction(sectionLength, functions[i], analysis, block);
     }
-    fileOffset += instructionInfo.info.length;
-  } while (fileOffset < sectionOffset + sectionLength);
+  };
 
+  const DWORD threadCount = _threadCount < blocks.size() ? _threadCount : (DWORD)blocks.size();
+  if (threadCount <= 1)
+  {
+    for (FunctionBlock& block : blocks) analyzeBlock(block);
+  }
+  else
+  {
+    std::atomic<size_t> nextBlock(0);
+    std::vector<std::thread> threads;
+    for (DWORD t = 0; t < threadCount; t++)
+    {
+      threads.emplace_back([&]()
+      {
+        for (size_t i = nextBlock++; i < blocks.size(); i = nextBlock++) analyzeBlock(blocks[i]);
+      });
+    }
+    for (auto& thread : threads) thread.join();
+  }
+
+  jumps.reserve(codeSize / 16);
+  for (const FunctionBlock& block : blocks)
+  {
+    _cachedFunctionCount += block.CachedCount;
+    jumps.insert(jumps.end(), block.Jumps.begin(), block.Jumps.end());
+    calls.insert(calls.end(), block.Calls.begin(), block.Calls.end());
+  }
+}
+
+void Disassembler::AnalyzeFunction(const BYTE* section, const FunctionRange& function, FunctionAnalysis& analysis) const
+{
+  // Relative to the function start, so that the result only depends on the bytes of the function
+  analysis.Jumps.clear();
+  analysis.Calls.clear();
+  const BYTE* code = section + function.Begin;
+  const DWORD length = function.End - function.Begin;
+  DWORD offset = 0;
+  while (offset < length)
+  {
+    // Instructions never cross the end of the function
+    ZydisDecodedInstruction instruction;
+    if (!ZYAN_SUCCESS(ZydisDecoderDecodeInstruction(&_decoder, nullptr, code + offset, length - offset, &instruction)))
+    {
+      offset++;
+      continue;
+    }
+
+    if (IsRelativeJump(instruction))
+    {
+      analysis.Jumps.push_back(ToRelativeJump(instruction, offset));
+    }
+    else if (IsRelativeCall(instruction))
+    {
+      analysis.Calls.push_back(GetBranchTarget(instruction, offset));
+    }
+    offset += instruction.length;
+  }
+}
+
+bool Disassembler::FindCachedFunction(const BYTE* section, const FunctionRange& function, FunctionKey& key, FunctionAnalysis& analysis, std::vector<BYTE>& buffer) const
+{
+  // Relocations that start inside of the function; one reaching in from the front only costs a cache miss
+  std::vector<DWORD> relocations;
+  for (auto rva = std::lower_bound(_relocations.begin(), _relocations.end(), function.Begin); rva != _relocations.end() && *rva < function.End; ++rva)
+  {
+    relocations.push_back(*rva - function.Begin);
+  }
+  key = AnalysisCache::GetKey(section + function.Begin, function.End - function.Begin, relocations, _relocationSize, _is64Bit, ZydisGetVersion(), buffer);
+  if (!_cache->Find(key, analysis)) return false;
+  if (IsValidAnalysis(section, function, analysis)) return true;
+  _cache->Reject(key);
+  return false;
+}
+
+bool Disassembler::IsValidAnalysis(const BYTE* section, const FunctionRange& function, const FunctionAnalysis& analysis) const
+{
+  // The patches are applied to the cached sites without decoding the function, so a key collision or a shard that
+  // was damaged behind a valid checksum must not reach them: every site has to decode to the cached jump again
+  const BYTE* code = section + function.Begin;
+  const DWORD length = function.End - function.Begin;
+  DWORD end = 0;
+  for (const RelativeJump& jump : analysis.Jumps)
+  {
+    // Sorted, not overlapping and inside of the function
+    if (jump.Rva < end || jump.Rva >= length || jump.OpcodeLength == 0 || jump.OpcodeLength > length - jump.Rva) return false;
+
+    ZydisDecodedInstruction instruction;
+    if (!ZYAN_SUCCESS(ZydisDecoderDecodeInstruction(&_decoder, nullptr, code + jump.Rva, length - jump.Rva, &instruction))) return false;
+    if (!IsRelativeJump(instruction)) return false;
+    const RelativeJump decoded = ToRelativeJump(instruction, jump.Rva);
+    if (decoded.Opcode != jump.Opcode || decoded.OpcodeLength != jump.OpcodeLength || decoded.JmpLength != jump.JmpLength) return false;
+    end = jump.Rva + jump.OpcodeLength;
+  }
   return true;
 }
 
-bool Disassembler::GetCCs(PEFile& peFile, PIMAGE_SECTION_HEADER sectionHeader, std::set<DWORD>& rvas)
+void Disassembler::AddFunction(DWORD sectionLength, const FunctionRange& function, const FunctionAnalysis& analysis, FunctionBlock& block)
 {
-  DWORD sectionOffset = sectionHeader->PointerToRawData;
-  DWORD sectionLength = sectionHeader->SizeOfRawData;
-  DWORD fileOffset = sectionOffset;
-  do
+  for (RelativeJump jump : analysis.Jumps)
+  {
+    jump.Rva += function.Begin;
+    block.Jumps.push_back(jump);
+  }
+  for (LONGLONG call : analysis.Calls)
   {
-    BYTE* offset = (BYTE*)(fileOffset + (DWORD_PTR)peFile.DOS_HEADER());
-    if (*offset == 0xCC)
+    const LONGLONG target = function.Begin + call;
+    if (target >= 0 && target < sectionLength) block.Calls.push_back((DWORD)target);
+  }
+}
+
+void Disassembler::Explore(Exploration& exploration, std::vector<RelativeJump>& jumps) const
+{
+  std::vector<BYTE>& map = exploration.Map;
+  while (!exploration.Pending.empty())
+  {
+    DWORD rva = exploration.Pending.back();
+    exploration.Pending.pop_back();
+
+    // Follow the instruction stream until it ends or reaches code that is already known
+    while (rva < exploration.SectionLength && map[rva] == UNEXPLORED)
     {
-      DWORD rva = fileOffset - sectionOffset;
-      rvas.insert(rva);
+      ZydisDecodedInstruction instruction;
+      if (!ZYAN_SUCCESS(ZydisDecoderDecodeInstruction(&_decoder, nullptr, exploration.Section + rva, exploration.SectionLength - rva, &instruction))) break;
+
+      // An instruction overlapping other instructions or data is not on a real path
+      const DWORD end = rva + instruction.length;
+      if (std::any_of(map.begin() + rva + 1, map.begin() + end, [](BYTE state) -> bool { return state != UNEXPLORED; })) break;
+      map[rva] = INSTRUCTION;
+      std::fill(map.begin() + rva + 1, map.begin() + end, OPERAND);
+
+      if (IsRelativeJump(instruction))
+      {
+        jumps.push_back(ToRelativeJump(instruction, rva));
+        AddPending(exploration, GetBranchTarget(instruction, rva));
+      }
+      else if (IsRelativeCall(instruction))
+      {
+        AddFunctionStart(exploration, GetBranchTarget(instruction, rva));
+      }
+      else if (IsJumpTable(instruction))
+      {
+        FollowJumpTable(exploration, instruction);
+      }
+
+      if (IsTerminator(instruction)) break;
+      rva = end;
     }
-    fileOffset += 1;
-  } while (fileOffset < sectionOffset + sectionLength);
+  }
+}
 
+void Disassembler::ExploreGaps(Exploration& exploration, std::vector<RelativeJump>& jumps) const
+{
+  // Functions that are not referenced from the section (e.g. only called from .text) start behind int3 padding, which
+  // follows known code or aligns the function to 16 bytes. Other unexplored bytes are data, or code that cannot be
+  // told apart from data; both are left untouched, so a single 0xCC operand inside of them is not taken for padding.
+  // Jump tables that the compiler placed behind a function look like padded code and are skipped as well.
+  const BYTE* section = exploration.Section;
+  const std::vector<BYTE>& map = exploration.Map;
+  auto isPadding = [&](DWORD rva) -> bool
+  {
+    return section[rva] == 0xCC && (map[rva] == UNEXPLORED || map[rva] == INSTRUCTION || map[rva] == FUNCTION);
+  };
+
+  for (DWORD rva = 1; rva < exploration.SectionLength; rva++)
+  {
+    if (map[rva] != UNEXPLORED || section[rva] == 0xCC || !isPadding(rva - 1)) continue;
+
+    DWORD paddingStart = rva - 1;
+    while (paddingStart > 0 && isPadding(paddingStart - 1)) paddingStart--;
+    const bool isAligned = (rva & (FUNCTION_ALIGNMENT - 1)) == 0 && rva - paddingStart >= 2;
+    if ((paddingStart == 0 || map[paddingStart - 1] != UNEXPLORED || isAligned) && !IsAddressTable(exploration, rva))
+    {
+      AddFunctionStart(exploration, rva);
+      Explore(exploration, jumps);
+    }
+  }
+}
+
+bool Disassembler::IsAddressTable(const Exploration& exploration, DWORD rva) const
+{
+  // Two entries that both point into the section, as RVAs (x64) or absolute addresses (x86)
+  if (rva + 2 * sizeof(DWORD) > exploration.SectionLength) return false;
+  for (DWORD i = 0; i < 2; i++)
+  {
+    const DWORD entry = *(const DWORD*)(exploration.Section + rva + i * sizeof(DWORD));
+    const bool isRva = entry >= exploration.SectionRva && entry - exploration.SectionRva < exploration.SectionLength;
+    const bool isVa = (ULONGLONG)entry >= exploration.SectionVa && (ULONGLONG)entry - exploration.SectionVa < exploration.SectionLength;
+    if (!isRva && !isVa) return false;
+  }
   return true;
 }
 
-void Disassembler::GetInstruction(PEFile& peFile, DWORD_PTR offset, ZydisDisassembledInstruction& instructionInfo)
+void Disassembler::FollowJumpTable(Exploration& exploration, const ZydisDecodedInstruction& instruction) const
 {
-  offset = offset + (DWORD_PTR)peFile.DOS_HEADER();
-#ifdef _WIN64
-  ZydisDisassembleIntel(ZYDIS_MACHINE_MODE_LONG_64, 0, (void*)offset, peFile.GetBufferSize() - offset, &instructionInfo);
-#else
-  ZydisDisassembleIntel(ZYDIS_MACHINE_MODE_LONG_COMPAT_32, 0, (void*)offset, peFile.GetBufferSize() - offset, &instructionInfo);
-#endif
+  // jmp [index * 4 + table]: the table holds absolute addresses, it ends at the first entry outside of the section
+  std::vector<BYTE>& map = exploration.Map;
+  const LONGLONG entrySize = sizeof(DWORD);
+  const LONGLONG table = (LONGLONG)(DWORD)instruction.raw.disp.value - (LONGLONG)exploration.SectionVa;
+  for (LONGLONG offset = table; offset >= 0 && offset + entrySize <= exploration.SectionLength; offset += entrySize)
+  {
+    if (std::any_of(map.begin() + offset, map.begin() + offset + entrySize, [](BYTE state) -> bool { return state != UNEXPLORED && state != DATA; })) break;
+    const LONGLONG target = (LONGLONG)*(const DWORD*)(exploration.Section + offset) - (LONGLONG)exploration.SectionVa;
+    if (target < 0 || target >= exploration.SectionLength) break;
+
+    std::fill(map.begin() + offset, map.begin() + offset + entrySize, DATA);
+    AddPending(exploration, target);
+  }
 }
 
-bool Disassembler::IsRelativeJump(ZydisDisassembledInstruction& instructionInfo)
+void Disassembler::AddFunctionStart(Exploration& exploration, LONGLONG rva) const
 {
-  // Check if the instruction is a jump (either conditional or unconditional).
-  const auto category = instructionInfo.info.meta.category;
-  bool isJump = (category == ZYDIS_CATEGORY_COND_BR) || (category == ZYDIS_CATEGORY_UNCOND_BR);
+  // Also recorded if the function was already reached through a jump
+  if (rva >= 0 && rva < exploration.SectionLength) exploration.FunctionStarts.push_back((DWORD)rva);
+  AddPending(exploration, rva);
+}
+
+void Disassembler::AddPending(Exploration& exploration, LONGLONG rva) const
+{
+  if (rva >= 0 && rva < exploration.SectionLength && exploration.Map[rva] == UNEXPLORED)
+  {
+    exploration.Pending.push_back((DWORD)rva);
+  }
+}
 
-  // Check if the instruction uses relative addressing.
-  bool isRelative = (instructionInfo.info.attributes & ZYDIS_ATTRIB_IS_RELATIVE);
+bool Disassembler::IsRelativeJump(const ZydisDecodedInstruction& instruction) const
+{
+  // The minimal mode does not provide the category, so jumps are identified by their mnemonic:
+  // JB ... JZ (including JMP and JCXZ/JECXZ/JRCXZ) and LOOP/LOOPE/LOOPNE, as in the COND_BR and UNCOND_BR categories
+  const ZydisMnemonic mnemonic = instruction.mnemonic;
+  const bool isJump = (mnemonic >= ZYDIS_MNEMONIC_JB && mnemonic <= ZYDIS_MNEMONIC_JZ) ||
+    mnemonic == ZYDIS_MNEMONIC_LOOP || mnemonic == ZYDIS_MNEMONIC_LOOPE || mnemonic == ZYDIS_MNEMONIC_LOOPNE;
+  const bool isRelative = (instruction.attributes & ZYDIS_ATTRIB_IS_RELATIVE) != 0;
 
   return isJump && isRelative;
 }
+
+bool Disassembler::IsRelativeCall(const ZydisDecodedInstruction& instruction) const
+{
+  return instruction.mnemonic == ZYDIS_MNEMONIC_CALL && (instruction.attributes & ZYDIS_ATTRIB_IS_RELATIVE) != 0;
+}
+
+bool Disassembler::IsJumpTable(const ZydisDecodedInstruction& instruction) const
+{
+  // jmp dword ptr [reg * 4 + disp32] as emitted by MSVC for x86 switch statements
+  return instruction.mnemonic == ZYDIS_MNEMONIC_JMP && (instruction.attributes & ZYDIS_ATTRIB_IS_RELATIVE) == 0 &&
+    instruction.raw.modrm.mod == 0 && instruction.raw.modrm.rm == 4 && instruction.raw.sib.base == 5 && instruction.raw.sib.scale == 2;
+}
+
+bool Disassembler::IsTerminator(const ZydisDecodedInstruction& instruction) const
+{
+  // The next instruction is not reached from this one
+  const ZydisMnemonic mnemonic = instruction.mnemonic;
+  return mnemonic == ZYDIS_MNEMONIC_RET || mnemonic == ZYDIS_MNEMONIC_JMP || mnemonic == ZYDIS_MNEMONIC_INT3 ||
+    mnemonic == ZYDIS_MNEMONIC_INT || mnemonic == ZYDIS_MNEMONIC_UD2 || mnemonic == ZYDIS_MNEMONIC_HLT;
+}
+
+RelativeJump Disassembler::ToRelativeJump(const ZydisDecodedInstruction& instruction, DWORD rva)
+{
+  RelativeJump relativeJump;
+  relativeJump.Rva = rva;
+  relativeJump.Opcode = instruction.opcode;
+  relativeJump.OpcodeLength = instruction.length;
+  relativeJump.JmpLength = (DWORD)instruction.raw.imm[0].value.u;
+  return relativeJump;
+}
+
+LONGLONG Disassembler::GetBranchTarget(const ZydisDecodedInstruction& instruction, DWORD rva)
+{
+  return (LONGLONG)rva + instruction.length + instruction.raw.imm[0].value.s;
+}
@@ -1,9 +1,17 @@
 #pragma once
-#include <set>
 #include <vector>
+#include "AnalysisCache.h"
+#include "ByteScanner.h"
+#include "FunctionTable.h"
 #include "RelativeJump.h"
-#include "..\PEFile\PEFile.h"
-#include "..\Zydis\include\Zydis.h"
+#include "../PEFile/PEFile.h"
+#include "../Zydis/include/Zydis.h"
+
+enum class AnalysisMode
+{
+  ControlFlow,  // Function ranges from .pdata on x64, recursive descent otherwise; data inside of code is skipped
+  LinearSweep   // Decodes the whole section from its start, in parallel chunks
+};
 
 class Disassembler
 {
@@ -11,10 +19,110 @@ public:
   Disassembler();
   ~Disassembler();
 
-  bool GetRelativeJumps(PEFile& peFile, PIMAGE_SECTION_HEADER sectionHeader, std::vector<RelativeJump>& result);
-  bool GetCCs(PEFile& peFile, PIMAGE_SECTION_HEADER sectionHeader, std::set<DWORD>& rvas);
+  // Collects the relative jumps (sorted by RVA) and the section relative RVAs of all 0xCC bytes.
+  // Functions from .pdata and large sections in linear sweep mode are decoded in parallel.
+  bool AnalyzeSection(PEFile& peFile, const PeSectionHeader* sectionHeader, std::vector<RelativeJump>& jumps, std::vector<DWORD>& ccRvas);
+
+  void SetAnalysisMode(AnalysisMode analysisMode) { _analysisMode = analysisMode; }
+  AnalysisMode GetAnalysisMode() const { return _analysisMode; }
+
+  // Number of threads used by AnalyzeSection, defaults to the number of logical processors; 1 decodes serially
+  void SetThreadCount(DWORD threadCount) { _threadCount = threadCount == 0 ? 1 : threadCount; }
+  DWORD GetThreadCount() const { return _threadCount; }
+
+  // SIMD level of the 0xCC scan, selected at runtime; can be lowered for comparison
+  ByteScanner& GetByteScanner() { return _byteScanner; }
+
+  // Functions found in the .pdata of the last call of AnalyzeSection, 0 if the recursive descent was used
+  DWORD GetFunctionCount() const { return _functionCount; }
+  // Sorted section relative starts of all functions the control flow analysis knows: .pdata entries, the entry point,
+  // call targets, the starts behind int3 padding and, without .pdata, the section start. Empty in linear sweep mode.
+  const std::vector<DWORD>& GetFunctionStarts() const { return _functionStarts; }
+
+  // Reuses the analysis of .pdata functions whose relocation-normalized bytes are in the cache and adds the others;
+  // nullptr (default) analyzes every function. Code without .pdata is always analyzed.
+  void SetAnalysisCache(AnalysisCache* cache) { _cache = cache; }
+  // Functions of the last call of AnalyzeSection taken from the cache
+  DWORD GetCachedFunctionCount() const { return _cachedFunctionCount; }
+
+private:
+  struct Chunk
+  {
+    DWORD Begin;
+    DWORD End;
+    DWORD StreamEnd;              // End of the last decoded instruction, >= End
+    std::vector<DWORD> Starts;    // Instruction starts within the first SYNC_WINDOW bytes
+    std::vector<RelativeJump> Jumps;
+  };
+
+  struct FunctionBlock
+  {
+    size_t First;                 // Consecutive functions [First, Last) of the function table
+    size_t Last;
+    std::vector<RelativeJump> Jumps;
+    std::vector<DWORD> Calls;     // Targets of relative calls inside of the section
+    DWORD CachedCount;            // Functions taken from the cache
+  };
+
+  struct Exploration
+  {
+    const BYTE* Section;
+    DWORD SectionLength;
+    ULONGLONG SectionVa;          // ImageBase + VirtualAddress, jump tables contain absolute addresses
+    DWORD SectionRva;             // x64 jump tables contain RVAs
+    std::vector<BYTE> Map;        // State of every byte, see UNEXPLORED ... FUNCTION
+    std::vector<DWORD> Pending;   // Branch targets still to explore
+    std::vector<DWORD> FunctionStarts;
+  };
+
+  void InitializeDecoder(bool is64Bit);
+  void AnalyzeSerial(const BYTE* section, DWORD sectionLength, std::vector<RelativeJump>& jumps) const;
+  void AnalyzeParallel(const BYTE* section, DWORD sectionLength, DWORD chunkCount, std::vector<RelativeJump>& jumps) const;
+  void AnalyzeChunk(const BYTE* section, DWORD sectionLength, Chunk& chunk) const;
+  DWORD DecodeInstruction(const BYTE* section, DWORD sectionLength, DWORD rva, std::vector<RelativeJump>& jumps) const;
+
+  void AnalyzeControlFlow(PEFile& peFile, const PeSectionHeader* sectionHeader, std::vector<RelativeJump>& jumps);
+  void AnalyzeFunctions(const BYTE* section, DWORD sectionLength, const std::vector<FunctionRange>& functions, std::vector<RelativeJump>& jumps, std::vector<DWORD>& calls);
+  void AnalyzeFunction(const BYTE* section, const FunctionRange& function, FunctionAnalysis& analysis) const;
+  // A cached analysis whose jumps do not decode at their sites is rejected, the caller analyzes the function again
+  bool FindCachedFunction(const BYTE* section, const FunctionRange& function, FunctionKey& key, FunctionAnalysis& analysis, std::vector<BYTE>& buffer) const;
+  bool IsValidAnalysis(const BYTE* section, const FunctionRange& function, const FunctionAnalysis& analysis) const;
+  static void AddFunction(DWORD sectionLength, const FunctionRange& function, const FunctionAnalysis& analysis, FunctionBlock& block);
+  void Explore(Exploration& exploration, std::vector<RelativeJump>& jumps) const;
+  void ExploreGaps(Exploration& exploration, std::vector<RelativeJump>& jumps) const;
+  bool IsAddressTable(const Exploration& exploration, DWORD rva) const;
+  void FollowJumpTable(Exploration& exploration, const ZydisDecodedInstruction& instruction) const;
+  void AddFunctionStart(Exploration& exploration, LONGLONG rva) const;
+  void AddPending(Exploration& exploration, LONGLONG rva) const;
+
+  bool IsRelativeJump(const ZydisDecodedInstruction& instruction) const;
+  bool IsRelativeCall(const ZydisDecodedInstruction& instruction) const;
+  bool IsJumpTable(const ZydisDecodedInstruction& instruction) const;
+  bool IsTerminator(const ZydisDecodedInstruction& instruction) const;
+  static RelativeJump ToRelativeJump(const ZydisDecodedInstruction& instruction, DWORD rva);
+  static LONGLONG GetBranchTarget(const ZydisDecodedInstruction& instruction, DWORD rva);
 
 private:
-  void GetInstruction(PEFile& peFile, DWORD_PTR offset, ZydisDisassembledInstruction& instructionInfo);
-  bool IsRelativeJump(ZydisDisassembledInstruction& instructionInfo);
+  static const DWORD MIN_CHUNK_SIZE = 1 << 20;
+  static const DWORD SYNC_WINDOW = 4096;
+  static const DWORD MIN_BLOCK_SIZE = 64 * 1024;
+  static const DWORD FUNCTION_ALIGNMENT = 16;
+
+  static constexpr BYTE UNEXPLORED = 0;
+  static constexpr BYTE INSTRUCTION = 1; // First byte of a decoded instruction
+  static constexpr BYTE OPERAND = 2;     // Remaining bytes of a decoded instruction
+  static constexpr BYTE DATA = 3;        // Jump table
+  static constexpr BYTE FUNCTION = 4;    // Function from .pdata, decoded separately
+
+  ZydisDecoder _decoder; // Minimal mode: length, mnemonic, relative attribute and raw fields only; read-only while decoding
+  ByteScanner _byteScanner;
+  AnalysisMode _analysisMode;
+  DWORD _threadCount;
+  DWORD _functionCount;
+  std::vector<DWORD> _functionStarts;
+  AnalysisCache* _cache;
+  DWORD _cachedFunctionCount;
+  std::vector<DWORD> _relocations; // Section relative, sorted; for the cache keys
+  DWORD _relocationSize;
+  bool _is64Bit;
 };
\ No newline at end of file
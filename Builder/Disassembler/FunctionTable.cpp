@@ -0,0 +1,52 @@
+#include <algorithm>
+#include "FunctionTable.h"
+
+FunctionTable::FunctionTable()
+{
+}
+
+FunctionTable::~FunctionTable()
+{
+}
+
+bool FunctionTable::Load(PEFile& peFile, const PeSectionHeader* sectionHeader)
+{
+  _functions.clear();
+  if (peFile.GetMachine() != PE_MACHINE_AMD64) return false;
+
+  const PeDataDirectory directory = peFile.GetDataDirectory(PE_DIRECTORY_ENTRY_EXCEPTION);
+  if (directory.VirtualAddress == 0 || directory.Size < sizeof(PeRuntimeFunction)) return false;
+  const PeRuntimeFunction* entries = (const PeRuntimeFunction*)peFile.GetRvaPointer(directory.VirtualAddress, directory.Size);
+  if (entries == nullptr) return false;
+
+  // Only functions that lie completely inside of the section
+  const DWORD sectionBegin = sectionHeader->VirtualAddress;
+  const DWORD sectionEnd = sectionBegin + sectionHeader->SizeOfRawData;
+  const DWORD entryCount = directory.Size / sizeof(PeRuntimeFunction);
+  for (DWORD i = 0; i < entryCount; i++)
+  {
+    const PeRuntimeFunction& entry = entries[i];
+    if (entry.BeginAddress >= sectionBegin && entry.BeginAddress < entry.EndAddress && entry.EndAddress <= sectionEnd)
+    {
+      FunctionRange function;
+      function.Begin = entry.BeginAddress - sectionBegin;
+      function.End = entry.EndAddress - sectionBegin;
+      _functions.push_back(function);
+    }
+  }
+
+  // The linker emits the entries sorted; a malformed table must still not produce overlapping ranges
+  std::sort(_functions.begin(), _functions.end(), [](const FunctionRange& a, const FunctionRange& b) -> bool
+  {
+    return a.Begin < b.Begin;
+  });
+  size_t count = 0;
+  for (size_t i = 0; i < _functions.size(); i++)
+  {
+    if (count != 0 && _functions[i].Begin < _functions[count - 1].End) continue;
+    _functions[count++] = _functions[i];
+  }
+  _functions.resize(count);
+
+  return true;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <vector>
+#include "../PEFile/PEFile.h"
+
+struct FunctionRange
+{
+  DWORD Begin; // Section relative
+  DWORD End;
+};
+
+// Function ranges of a section from the exception directory (.pdata) of an x64 image. Every function with a stack
+// frame has a RUNTIME_FUNCTION entry; leaf functions do not and have to be found by the caller.
+class FunctionTable
+{
+public:
+  FunctionTable();
+  ~FunctionTable();
+
+  // False if the image is not x64 or has no exception directory
+  bool Load(PEFile& peFile, const PeSectionHeader* sectionHeader);
+
+  // Sorted by Begin, without overlaps
+  const std::vector<FunctionRange>& GetFunctions() const { return _functions; }
+
+private:
+  std::vector<FunctionRange> _functions;
+};
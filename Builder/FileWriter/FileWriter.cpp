@@ -1,24 +1,100 @@
+#include <filesystem>
 #include "FileWriter.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 FileWriter::FileWriter()
 {
+  _writtenSize = 0;
+  _writeCount = 0;
 }
 
 FileWriter::~FileWriter()
 {
+  Abort();
 }
 
-void FileWriter::OpenForWriteBin(const char* fileName, std::ofstream& fileStream)
+bool FileWriter::Open(const char* fileName)
 {
-  fileStream.open(fileName, std::ios::out | std::ios::binary);
+  Abort();
+  _fileName = fileName;
+  _temporaryFileName = _fileName + ".tmp";
+  _writtenSize = 0;
+  _writeCount = 0;
+  _file.open(_temporaryFileName, std::ios::out | std::ios::binary | std::ios::trunc);
+  return _file.is_open();
 }
 
-void FileWriter::Write(std::ofstream& fileStream, BYTE* buffer, DWORD bufferSize)
+bool FileWriter::Write(const BYTE* buffer, DWORD bufferSize)
 {
-  fileStream.write((char*)buffer, bufferSize);
+  if (!_file.is_open()) return false;
+  _file.write((const char*)buffer, bufferSize);
+  _writtenSize += bufferSize;
+  _writeCount++;
+  return _file.good();
 }
 
-void FileWriter::Close(std::ofstream& fileStream)
+bool FileWriter::Commit()
 {
-  fileStream.close();
+  if (!_file.is_open()) return false;
+  _file.close();
+  // The rename may reach the disk before the data otherwise
+  if (_file.fail() || !FlushFile(_temporaryFileName))
+  {
+    Abort();
+    return false;
+  }
+
+  std::error_code error;
+  std::filesystem::rename(_temporaryFileName, _fileName, error);
+  if (error)
+  {
+    Abort();
+    return false;
+  }
+  _temporaryFileName.clear();
+#ifndef _WIN32
+  FlushDirectory(_fileName);
+#endif
+  return true;
+}
+
+void FileWriter::Abort()
+{
+  if (_file.is_open()) _file.close();
+  if (_temporaryFileName.empty()) return;
+  std::error_code error;
+  std::filesystem::remove(_temporaryFileName, error);
+  _temporaryFileName.clear();
+}
+
+bool FileWriter::FlushFile(const std::string& fileName)
+{
+#ifdef _WIN32
+  HANDLE file = CreateFileA(fileName.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) return false;
+  const bool result = FlushFileBuffers(file) != FALSE;
+  CloseHandle(file);
+  return result;
+#else
+  const int file = open(fileName.c_str(), O_WRONLY);
+  if (file == -1) return false;
+  const bool result = fsync(file) == 0;
+  close(file);
+  return result;
+#endif
+}
+
+#ifndef _WIN32
+bool FileWriter::FlushDirectory(const std::string& fileName)
+{
+  const std::filesystem::path directory = std::filesystem::path(fileName).parent_path();
+  const int file = open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY);
+  if (file == -1) return false;
+  const bool result = fsync(file) == 0;
+  close(file);
+  return result;
 }
+#endif
@@ -1,14 +1,39 @@
 #pragma once
-#include <windows.h>
 #include <fstream>
+#include <string>
+#include "../PEFile/PEFormat.h"
 
+// Writes a file sequentially under a temporary name next to the target; Commit flushes it to disk and replaces the
+// target with it, so neither a failed build nor a power loss leaves a half written executable behind. The target may still be open (e.g. mapped) while the
+// data is written, it has to be released before Commit.
 class FileWriter
 {
 public:
   FileWriter();
   ~FileWriter();
 
-  void OpenForWriteBin(const char* fileName, std::ofstream& fileStream);
-  void Write(std::ofstream& fileStream, BYTE* buffer, DWORD bufferSize);
-  void Close(std::ofstream& fileStream);  
+  bool Open(const char* fileName);
+  bool Write(const BYTE* buffer, DWORD bufferSize);
+  bool Commit();
+  // Removes the temporary file; called by the destructor unless Commit succeeded
+  void Abort();
+
+  // Bytes and calls of Write since Open
+  ULONGLONG GetWrittenSize() const { return _writtenSize; }
+  DWORD GetWriteCount() const { return _writeCount; }
+
+private:
+  // Forces the written data of the file to disk
+  static bool FlushFile(const std::string& fileName);
+#ifndef _WIN32
+  // Makes the rename inside the directory of the file durable
+  static bool FlushDirectory(const std::string& fileName);
+#endif
+
+private:
+  std::ofstream _file;
+  std::string _fileName;
+  std::string _temporaryFileName;
+  ULONGLONG _writtenSize;
+  DWORD _writeCount;
 };
@@ -0,0 +1,376 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include "PatchWriter.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+const PatchWriter::NativeFile PatchWriter::INVALID_FILE = INVALID_HANDLE_VALUE;
+#else
+const PatchWriter::NativeFile PatchWriter::INVALID_FILE = -1;
+#endif
+
+PatchWriter::PatchWriter()
+{
+  _file = INVALID_FILE;
+  _journal = INVALID_FILE;
+  _fileSize = 0;
+  _originalSize = 0;
+  _lastWriteTime = 0;
+  _journalWritten = false;
+  _writtenBytes = 0;
+  _writeCount = 0;
+}
+
+PatchWriter::~PatchWriter()
+{
+  Close();
+  if (!_journalName.empty() && !_journalWritten)
+  {
+    std::error_code error;
+    std::filesystem::remove(_journalName, error);
+  }
+}
+
+bool PatchWriter::Open(const char* fileName)
+{
+  _fileName = fileName;
+  _journalName = _fileName + ".journal";
+  _runs.clear();
+  _fileSize = 0;
+  _journalWritten = false;
+  _writtenBytes = 0;
+  _writeCount = 0;
+  if (!GetFileIdentity(fileName, _originalSize, _lastWriteTime)) return false;
+  if (!OpenNative(fileName, false, _file)) return false;
+  return OpenNative(_journalName.c_str(), true, _journal);
+}
+
+void PatchWriter::AddRun(DWORD offset, const BYTE* data, DWORD size)
+{
+  if (size == 0) return;
+  Run run;
+  run.Offset = offset;
+  run.Size = size;
+  run.Data = data;
+  _runs.push_back(run);
+}
+
+bool PatchWriter::Apply()
+{
+  if (_file == INVALID_FILE || !WriteJournal()) return false;
+
+  for (const Run& run : _runs)
+  {
+    if (!WriteAt(_file, run.Offset, run.Data, run.Size)) return false;
+  }
+  return FlushNative(_file);
+}
+
+bool PatchWriter::Commit()
+{
+  if (!_journalWritten) return false;
+  const bool result = ResizeNative(_file, _fileSize) && FlushNative(_file);
+  Close();
+  if (!result) return false;
+
+  std::error_code error;
+  std::filesystem::remove(_journalName, error);
+  _journalName.clear();
+  return true;
+}
+
+bool PatchWriter::Recover(const char* fileName)
+{
+  const std::string journalName = std::string(fileName) + ".journal";
+  std::error_code error;
+  if (!std::filesystem::exists(journalName, error)) return true;
+
+  // The file was not touched before the journal was complete, an incomplete journal is just removed
+  std::vector<BYTE> journal;
+  if (ReadJournal(journalName, journal) && MatchesJournal(fileName, journal))
+  {
+    NativeFile file;
+    if (!OpenNative(fileName, false, file)) return false;
+    const JournalHeader* header = (const JournalHeader*)journal.data();
+    size_t position = sizeof(JournalHeader);
+    bool result = true;
+    for (DWORD i = 0; i < header->RunCount && result; i++)
+    {
+      DWORD run[2];
+      memcpy(run, journal.data() + position, sizeof(run));
+      position += sizeof(run) + GetBlockCount(run[0], run[1]) * sizeof(DWORD);
+      result = WriteNative(file, run[0], journal.data() + position, run[1]);
+      position += run[1];
+    }
+    result = result && ResizeNative(file, header->FileSize) && FlushNative(file);
+    CloseNative(file);
+    if (!result) return false;
+  }
+  std::filesystem::remove(journalName, error);
+  return true;
+}
+
+bool PatchWriter::WriteJournal()
+{
+  std::vector<BYTE> buffer;
+  buffer.reserve(JOURNAL_BUFFER_SIZE);
+  ULONGLONG offset = 0;
+  DWORD hash = FNV_OFFSET_BASIS;
+
+  // The file is still unchanged on disk, a mapping of it is copy on write
+  std::ifstream file(_fileName, std::ios::in | std::ios::binary);
+  if (!file.is_open()) return false;
+  std::vector<DWORD> blockHashes;
+
+  JournalHeader header = {};
+  header.Magic = JOURNAL_MAGIC;
+  header.RunCount = (DWORD)_runs.size();
+  header.FileSize = _fileSize;
+  header.OriginalSize = _originalSize;
+  header.LastWriteTime = _lastWriteTime;
+  if (!AppendJournal(buffer, offset, hash, &header, sizeof(header))) return false;
+  for (const Run& run : _runs)
+  {
+    const DWORD position[2] = { run.Offset, run.Size };
+    if (!HashBlocks(file, run.Offset, run.Size, _originalSize, blockHashes)) return false;
+    if (!AppendJournal(buffer, offset, hash, position, sizeof(position))) return false;
+    if (!AppendJournal(buffer, offset, hash, blockHashes.data(), (DWORD)(blockHashes.size() * sizeof(DWORD)))) return false;
+    if (!AppendJournal(buffer, offset, hash, run.Data, run.Size)) return false;
+  }
+  const DWORD trailer[2] = { JOURNAL_MAGIC, hash };
+  buffer.insert(buffer.end(), (const BYTE*)trailer, (const BYTE*)trailer + sizeof(trailer));
+  if (!WriteAt(_journal, offset, buffer.data(), (DWORD)buffer.size()) || !FlushNative(_journal)) return false;
+
+  CloseNative(_journal);
+  _journalWritten = true;
+  return true;
+}
+
+bool PatchWriter::AppendJournal(std::vector<BYTE>& buffer, ULONGLONG& offset, DWORD& hash, const void* data, DWORD size)
+{
+  hash = Hash(hash, (const BYTE*)data, size);
+  if (buffer.size() + size > JOURNAL_BUFFER_SIZE)
+  {
+    if (!WriteAt(_journal, offset, buffer.data(), (DWORD)buffer.size())) return false;
+    offset += buffer.size();
+    buffer.clear();
+  }
+  // Large runs bypass the buffer
+  if (size > JOURNAL_BUFFER_SIZE)
+  {
+    if (!WriteAt(_journal, offset, (const BYTE*)data, size)) return false;
+    offset += size;
+    return true;
+  }
+  buffer.insert(buffer.end(), (const BYTE*)data, (const BYTE*)data + size);
+  return true;
+}
+
+bool PatchWriter::ReadJournal(const std::string& journalName, std::vector<BYTE>& outJournal)
+{
+  std::ifstream file(journalName, std::ios::in | std::ios::binary | std::ios::ate);
+  if (!file.is_open()) return false;
+  const std::streamoff size = file.tellg();
+  if (size < (std::streamoff)(sizeof(JournalHeader) + 2 * sizeof(DWORD))) return false;
+  outJournal.resize((size_t)size);
+  file.seekg(0);
+  if (!file.read((char*)outJournal.data(), size)) return false;
+
+  // Every run has to lie inside the journal and the end has to match the hash of the content
+  const JournalHeader* header = (const JournalHeader*)outJournal.data();
+  if (header->Magic != JOURNAL_MAGIC) return false;
+  const size_t end = outJournal.size() - 2 * sizeof(DWORD);
+  size_t position = sizeof(JournalHeader);
+  for (DWORD i = 0; i < header->RunCount; i++)
+  {
+    DWORD run[2];
+    if (end - position < sizeof(run)) return false;
+    memcpy(run, outJournal.data() + position, sizeof(run));
+    if ((ULONGLONG)run[0] + run[1] > UINT32_MAX) return false;
+    const size_t recordSize = (size_t)GetBlockCount(run[0], run[1]) * sizeof(DWORD) + run[1];
+    if (end - position - sizeof(run) < recordSize) return false;
+    position += sizeof(run) + recordSize;
+  }
+  DWORD trailer[2];
+  memcpy(trailer, outJournal.data() + end, sizeof(trailer));
+  return position == end && trailer[0] == JOURNAL_MAGIC && trailer[1] == Hash(FNV_OFFSET_BASIS, outJournal.data(), (DWORD)end);
+}
+
+bool PatchWriter::MatchesJournal(const char* fileName, const std::vector<BYTE>& journal)
+{
+  const JournalHeader* header = (const JournalHeader*)journal.data();
+  DWORD fileSize = 0;
+  ULONGLONG lastWriteTime = 0;
+  if (!GetFileIdentity(fileName, fileSize, lastWriteTime)) return false;
+  // Commit sets the final size before it removes the journal
+  if (fileSize != header->OriginalSize && fileSize != header->FileSize) return false;
+  const bool isUnchanged = lastWriteTime == header->LastWriteTime && fileSize == header->OriginalSize;
+
+  std::ifstream file(fileName, std::ios::in | std::ios::binary);
+  if (!file.is_open()) return false;
+  std::vector<DWORD> blockHashes;
+  std::vector<BYTE> block(IDENTITY_BLOCK_SIZE);
+  size_t position = sizeof(JournalHeader);
+  for (DWORD i = 0; i < header->RunCount; i++)
+  {
+    DWORD run[2];
+    memcpy(run, journal.data() + position, sizeof(run));
+    const DWORD blockCount = GetBlockCount(run[0], run[1]);
+    const BYTE* originalHashes = journal.data() + position + sizeof(run);
+    const BYTE* data = originalHashes + blockCount * sizeof(DWORD);
+    position += sizeof(run) + blockCount * sizeof(DWORD) + run[1];
+    if (!HashBlocks(file, run[0], run[1], header->OriginalSize, blockHashes)) return false;
+
+    DWORD blockStart = run[0];
+    for (DWORD j = 0; j < blockCount; j++)
+    {
+      const DWORD blockEnd = std::min((blockStart / IDENTITY_BLOCK_SIZE + 1) * IDENTITY_BLOCK_SIZE, run[0] + run[1]);
+      DWORD originalHash;
+      memcpy(&originalHash, originalHashes + j * sizeof(DWORD), sizeof(DWORD));
+      if (blockHashes[j] != originalHash)
+      {
+        // Already patched, which requires a write since the journal
+        const DWORD size = blockEnd - blockStart;
+        if (isUnchanged || blockEnd > fileSize) return false;
+        file.clear();
+        file.seekg(blockStart);
+        if (!file.read((char*)block.data(), size) || memcmp(block.data(), data + (blockStart - run[0]), size) != 0) return false;
+      }
+      blockStart = blockEnd;
+    }
+  }
+  return true;
+}
+
+bool PatchWriter::HashBlocks(std::ifstream& file, DWORD offset, DWORD size, DWORD originalSize, std::vector<DWORD>& outHashes)
+{
+  // Bytes behind the original end are not part of the identity
+  outHashes.clear();
+  std::vector<BYTE> block(IDENTITY_BLOCK_SIZE);
+  const DWORD end = offset + size;
+  DWORD blockStart = offset;
+  for (DWORD i = GetBlockCount(offset, size); i > 0; i--)
+  {
+    const DWORD blockEnd = std::min((blockStart / IDENTITY_BLOCK_SIZE + 1) * IDENTITY_BLOCK_SIZE, end);
+    const DWORD hashedEnd = std::min(blockEnd, std::max(blockStart, originalSize));
+    if (hashedEnd > blockStart)
+    {
+      file.clear();
+      file.seekg(blockStart);
+      if (!file.read((char*)block.data(), hashedEnd - blockStart)) return false;
+    }
+    outHashes.push_back(Hash(FNV_OFFSET_BASIS, block.data(), hashedEnd - blockStart));
+    blockStart = blockEnd;
+  }
+  return true;
+}
+
+DWORD PatchWriter::GetBlockCount(DWORD offset, DWORD size)
+{
+  if (size == 0) return 0;
+  return (offset + size - 1) / IDENTITY_BLOCK_SIZE - offset / IDENTITY_BLOCK_SIZE + 1;
+}
+
+bool PatchWriter::GetFileIdentity(const char* fileName, DWORD& outSize, ULONGLONG& outLastWriteTime)
+{
+  std::error_code error;
+  const uintmax_t size = std::filesystem::file_size(fileName, error);
+  if (error || size > UINT32_MAX) return false;
+  const std::filesystem::file_time_type lastWriteTime = std::filesystem::last_write_time(fileName, error);
+  if (error) return false;
+  outSize = (DWORD)size;
+  outLastWriteTime = (ULONGLONG)lastWriteTime.time_since_epoch().count();
+  return true;
+}
+
+bool PatchWriter::WriteAt(NativeFile file, ULONGLONG offset, const BYTE* data, DWORD size)
+{
+  _writtenBytes += size;
+  _writeCount++;
+  return WriteNative(file, offset, data, size);
+}
+
+void PatchWriter::Close()
+{
+  CloseNative(_file);
+  CloseNative(_journal);
+}
+
+DWORD PatchWriter::Hash(DWORD hash, const BYTE* data, DWORD size)
+{
+  // FNV-1a
+  for (DWORD i = 0; i < size; i++)
+  {
+    hash = (hash ^ data[i]) * 0x01000193;
+  }
+  return hash;
+}
+
+bool PatchWriter::OpenNative(const char* fileName, bool create, NativeFile& outFile)
+{
+#ifdef _WIN32
+  // FILE_SHARE_WRITE: the file may still be mapped by PEFile, which opened it with FILE_SHARE_WRITE as well
+  outFile = CreateFileA(fileName, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, create ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+#else
+  outFile = open(fileName, create ? (O_WRONLY | O_CREAT | O_TRUNC) : O_WRONLY, 0644);
+#endif
+  return outFile != INVALID_FILE;
+}
+
+bool PatchWriter::WriteNative(NativeFile file, ULONGLONG offset, const BYTE* data, DWORD size)
+{
+#ifdef _WIN32
+  OVERLAPPED overlapped = {};
+  overlapped.Offset = (DWORD)offset;
+  overlapped.OffsetHigh = (DWORD)(offset >> 32);
+  DWORD written = 0;
+  return WriteFile(file, data, size, &written, &overlapped) && written == size;
+#else
+  // pwrite may write less than requested
+  while (size != 0)
+  {
+    const ssize_t written = pwrite(file, data, size, (off_t)offset);
+    if (written <= 0) return false;
+    data += written;
+    offset += written;
+    size -= (DWORD)written;
+  }
+  return true;
+#endif
+}
+
+bool PatchWriter::ResizeNative(NativeFile file, ULONGLONG size)
+{
+#ifdef _WIN32
+  LARGE_INTEGER position;
+  position.QuadPart = (LONGLONG)size;
+  return SetFilePointerEx(file, position, NULL, FILE_BEGIN) && SetEndOfFile(file);
+#else
+  return ftruncate(file, (off_t)size) == 0;
+#endif
+}
+
+bool PatchWriter::FlushNative(NativeFile file)
+{
+#ifdef _WIN32
+  return FlushFileBuffers(file) != FALSE;
+#else
+  return fsync(file) == 0;
+#endif
+}
+
+void PatchWriter::CloseNative(NativeFile& file)
+{
+  if (file == INVALID_FILE) return;
+#ifdef _WIN32
+  CloseHandle(file);
+#else
+  close(file);
+#endif
+  file = INVALID_FILE;
+}
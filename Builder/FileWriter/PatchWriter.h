@@ -0,0 +1,98 @@
+#pragma once
+#include <fstream>
+#include <string>
+#include <vector>
+#include "../PEFile/PEFormat.h"
+
+// Patches an existing file in place with positioned writes instead of rewriting it. All runs are first written to a
+// redo journal (<file>.journal) which is flushed to disk before the file is touched. Recover replays a journal left
+// behind by a crash, so the file ends up either unchanged or completely patched. The journal identifies the file it
+// belongs to; a journal that does not match the file, e.g. after a relink, is removed without touching it.
+class PatchWriter
+{
+public:
+  PatchWriter();
+  ~PatchWriter();
+
+  // Opens the file for positioned writes and creates the journal
+  bool Open(const char* fileName);
+  // The data is not copied and has to stay valid until Apply returns
+  void AddRun(DWORD offset, const BYTE* data, DWORD size);
+  void SetFileSize(DWORD fileSize) { _fileSize = fileSize; }
+  // Writes the journal and the runs; the file is not shrunk yet
+  bool Apply();
+  // Sets the final size and removes the journal. Shrinking fails on Windows while the file is mapped, so the mapping
+  // has to be released first.
+  bool Commit();
+
+  // Replays <fileName>.journal if it belongs to the file and removes it; true if there was none or it did not match
+  static bool Recover(const char* fileName);
+
+  // Journal and file, since Open
+  ULONGLONG GetWrittenBytes() const { return _writtenBytes; }
+  DWORD GetWriteCount() const { return _writeCount; }
+  DWORD GetRunCount() const { return (DWORD)_runs.size(); }
+
+private:
+#ifdef _WIN32
+  typedef HANDLE NativeFile;
+#else
+  typedef int NativeFile;
+#endif
+
+  struct Run
+  {
+    DWORD Offset;
+    DWORD Size;
+    const BYTE* Data;
+  };
+
+  // Journal layout: JournalHeader, per run its offset, size, the hashes of its blocks before the patch and the data,
+  // then JOURNAL_MAGIC and the FNV-1a hash of all bytes in front of it. A journal without a valid end is discarded.
+  // Blocks are the IDENTITY_BLOCK_SIZE aligned parts of a run; only bytes below OriginalSize are hashed.
+  struct JournalHeader
+  {
+    DWORD Magic;
+    DWORD RunCount;
+    DWORD FileSize;
+    DWORD OriginalSize;         // Size and last write time of the file before the patch
+    ULONGLONG LastWriteTime;
+  };
+
+  bool WriteJournal();
+  bool AppendJournal(std::vector<BYTE>& buffer, ULONGLONG& offset, DWORD& hash, const void* data, DWORD size);
+  bool WriteAt(NativeFile file, ULONGLONG offset, const BYTE* data, DWORD size);
+  static bool ReadJournal(const std::string& journalName, std::vector<BYTE>& outJournal);
+  // True if every block of every run still holds either its original bytes or the patched ones; while the file has not
+  // been written since the journal, only the original bytes
+  static bool MatchesJournal(const char* fileName, const std::vector<BYTE>& journal);
+  static bool HashBlocks(std::ifstream& file, DWORD offset, DWORD size, DWORD originalSize, std::vector<DWORD>& outHashes);
+  static DWORD GetBlockCount(DWORD offset, DWORD size);
+  static bool GetFileIdentity(const char* fileName, DWORD& outSize, ULONGLONG& outLastWriteTime);
+  void Close();
+  static DWORD Hash(DWORD hash, const BYTE* data, DWORD size);
+  static bool OpenNative(const char* fileName, bool create, NativeFile& outFile);
+  static bool WriteNative(NativeFile file, ULONGLONG offset, const BYTE* data, DWORD size);
+  static bool ResizeNative(NativeFile file, ULONGLONG size);
+  static bool FlushNative(NativeFile file);
+  static void CloseNative(NativeFile& file);
+
+private:
+  static const DWORD JOURNAL_MAGIC = 0x324A4D4E;        // "NMJ2"
+  static const DWORD IDENTITY_BLOCK_SIZE = 4096;        // A torn write leaves every block in one of both states
+  static const DWORD JOURNAL_BUFFER_SIZE = 1 << 20;
+  static const DWORD FNV_OFFSET_BASIS = 0x811C9DC5;
+  static const NativeFile INVALID_FILE;
+
+  std::string _fileName;
+  std::string _journalName;
+  NativeFile _file;
+  NativeFile _journal;
+  std::vector<Run> _runs;
+  DWORD _fileSize;
+  DWORD _originalSize;
+  ULONGLONG _lastWriteTime;
+  bool _journalWritten;           // From then on the journal is kept until Commit, a later Recover completes the patch
+  ULONGLONG _writtenBytes;
+  DWORD _writeCount;
+};
@@ -0,0 +1,120 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include "PhaseProfiler.h"
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+PhaseProfiler::PhaseProfiler()
+{
+}
+
+PhaseProfiler::~PhaseProfiler()
+{
+}
+
+void PhaseProfiler::Begin(const char* phaseName)
+{
+  _currentPhase = phaseName;
+  _start = std::chrono::steady_clock::now();
+}
+
+void PhaseProfiler::End()
+{
+  const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start).count();
+
+  size_t privateBytes, peakWorkingSet;
+  GetMemoryCounters(privateBytes, peakWorkingSet);
+
+  for (auto& phase : _phases)
+  {
+    if (phase.Name != _currentPhase) continue;
+    phase.Milliseconds += milliseconds;
+    phase.PrivateBytes = privateBytes;
+    phase.PeakWorkingSet = peakWorkingSet;
+    return;
+  }
+  _phases.push_back({ _currentPhase, milliseconds, privateBytes, peakWorkingSet });
+}
+
+void PhaseProfiler::Add(const PhaseProfiler& other)
+{
+  for (const auto& otherPhase : other._phases)
+  {
+    bool found = false;
+    for (auto& phase : _phases)
+    {
+      if (phase.Name != otherPhase.Name) continue;
+      phase.Milliseconds += otherPhase.Milliseconds;
+      if (otherPhase.PrivateBytes > phase.PrivateBytes) phase.PrivateBytes = otherPhase.PrivateBytes;
+      if (otherPhase.PeakWorkingSet > phase.PeakWorkingSet) phase.PeakWorkingSet = otherPhase.PeakWorkingSet;
+      found = true;
+      break;
+    }
+    if (!found) _phases.push_back(otherPhase);
+  }
+}
+
+void PhaseProfiler::Print() const
+{
+  double total = 0.0;
+  std::cout << std::left << std::setw(12) << "phase" << std::right << std::setw(12) << "ms" << std::setw(16) << "private KiB" << std::setw(16) << "peak ws KiB" << std::endl;
+  for (const auto& phase : _phases)
+  {
+    std::cout << std::left << std::setw(12) << phase.Name << std::right << std::fixed << std::setprecision(3) << std::setw(12) << phase.Milliseconds;
+    std::cout << std::setw(16) << phase.PrivateBytes / 1024 << std::setw(16) << phase.PeakWorkingSet / 1024 << std::endl;
+    total += phase.Milliseconds;
+  }
+  std::cout << std::left << std::setw(12) << "total" << std::right << std::setw(12) << total << std::endl;
+}
+
+bool PhaseProfiler::WriteJson(const char* fileName) const
+{
+  std::ofstream file(fileName);
+  if (!file.is_open()) return false;
+
+  file << "{\"phases\":[";
+  for (size_t i = 0; i < _phases.size(); i++)
+  {
+    const PhaseResult& phase = _phases[i];
+    file << (i == 0 ? "" : ",") << "{\"name\":\"" << phase.Name << "\",\"ms\":" << std::fixed << std::setprecision(3) << phase.Milliseconds;
+    file << ",\"private_bytes\":" << phase.PrivateBytes << ",\"peak_working_set\":" << phase.PeakWorkingSet << "}";
+  }
+  file << "]}" << std::endl;
+  return file.good();
+}
+
+void PhaseProfiler::GetMemoryCounters(size_t& privateBytes, size_t& peakWorkingSet)
+{
+  privateBytes = 0;
+  peakWorkingSet = 0;
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS_EX counters = {};
+  counters.cb = sizeof(counters);
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters), sizeof(counters))) return;
+  privateBytes = counters.PrivateUsage;
+  peakWorkingSet = counters.PeakWorkingSetSize;
+#else
+  // Lines like "VmHWM:     1234 kB"
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line))
+  {
+    if (line.compare(0, 8, "RssAnon:") == 0) privateBytes = std::stoull(line.substr(8)) * 1024;
+    else if (line.compare(0, 6, "VmHWM:") == 0) peakWorkingSet = std::stoull(line.substr(6)) * 1024;
+  }
+#endif
+}
+
+PhaseProfiler::Scope::Scope(PhaseProfiler* profiler, const char* phaseName)
+{
+  _profiler = profiler;
+  if (_profiler != nullptr) _profiler->Begin(phaseName);
+}
+
+PhaseProfiler::Scope::~Scope()
+{
+  if (_profiler != nullptr) _profiler->End();
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+
+struct PhaseResult
+{
+  std::string Name;
+  double Milliseconds;
+  size_t PrivateBytes;    // Private bytes (Linux: resident anonymous memory) at the end of the phase
+  size_t PeakWorkingSet;  // Peak working set (Linux: peak resident set) of the process at the end of the phase
+};
+
+// Wall clock time and memory of the build phases. Repeated phases (e.g. one per section) are accumulated.
+class PhaseProfiler
+{
+public:
+  PhaseProfiler();
+  ~PhaseProfiler();
+
+  void Begin(const char* phaseName);
+  void End();
+  // Accumulates the phases of another profiler, e.g. of one file of a batch; memory counters keep the maximum
+  void Add(const PhaseProfiler& other);
+
+  const std::vector<PhaseResult>& GetPhases() const { return _phases; }
+
+  void Print() const;
+  bool WriteJson(const char* fileName) const;
+
+  // Measures the enclosing block; does nothing if profiler is nullptr
+  class Scope
+  {
+  public:
+    Scope(PhaseProfiler* profiler, const char* phaseName);
+    ~Scope();
+
+  private:
+    PhaseProfiler* _profiler;
+  };
+
+private:
+  static void GetMemoryCounters(size_t& privateBytes, size_t& peakWorkingSet);
+
+private:
+  std::vector<PhaseResult> _phases;
+  std::string _currentPhase;
+  std::chrono::steady_clock::time_point _start;
+};
@@ -0,0 +1,239 @@
+#include <stdlib.h>
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include "DensityPolicy.h"
+#include "RandomGenerator.h"
+
+DensityPolicy::DensityPolicy()
+{
+  _fraction = 1.0;
+  _maxPerFunction = 0;
+  _maxPerBlock = 0;
+  _jumpTypes = ALL_JUMP_TYPES;
+  _direction = JumpDirection::Any;
+  _seed = 0;
+  _hasSeed = false;
+  _errorLine = 0;
+}
+
+DensityPolicy::~DensityPolicy()
+{
+}
+
+bool DensityPolicy::Load(const char* fileName)
+{
+  _errorLine = 0;
+  std::ifstream file(fileName);
+  if (!file.is_open()) return false;
+
+  std::string line;
+  DWORD lineNumber = 0;
+  while (std::getline(file, line))
+  {
+    lineNumber++;
+    const size_t comment = line.find('#');
+    if (comment != std::string::npos) line.erase(comment);
+    const size_t start = line.find_first_not_of(" \t\r");
+    if (start == std::string::npos) continue;
+
+    const size_t separator = line.find('=');
+    if (separator == std::string::npos || separator < start)
+    {
+      _errorLine = lineNumber;
+      return false;
+    }
+    std::string key = line.substr(start, separator - start);
+    std::string value = line.substr(separator + 1);
+    key.erase(key.find_last_not_of(" \t") + 1);
+    value.erase(0, value.find_first_not_of(" \t"));
+    value.erase(value.find_last_not_of(" \t\r") + 1);
+    std::transform(value.begin(), value.end(), value.begin(), [](char c) -> char { return (char)tolower((unsigned char)c); });
+    if (!ParseLine(key, value))
+    {
+      _errorLine = lineNumber;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool DensityPolicy::ParseLine(const std::string& key, const std::string& value)
+{
+  char* end = nullptr;
+  if (key == "fraction")
+  {
+    const double fraction = strtod(value.c_str(), &end);
+    if (end == value.c_str() || *end != '\0' || fraction < 0.0 || fraction > 1.0) return false;
+    _fraction = fraction;
+    return true;
+  }
+  if (key == "max-per-function" || key == "max-per-block" || key == "seed")
+  {
+    const ULONGLONG number = strtoull(value.c_str(), &end, 10);
+    if (end == value.c_str() || *end != '\0') return false;
+    if (key == "max-per-function") _maxPerFunction = (DWORD)number;
+    else if (key == "max-per-block") _maxPerBlock = (DWORD)number;
+    else SetSeed(number);
+    return true;
+  }
+  if (key == "direction")
+  {
+    if (value == "any") _direction = JumpDirection::Any;
+    else if (value == "forward") _direction = JumpDirection::Forward;
+    else if (value == "backward") _direction = JumpDirection::Backward;
+    else return false;
+    return true;
+  }
+  if (key == "jump-types") return ParseJumpTypes(value);
+  return false;
+}
+
+bool DensityPolicy::ParseJumpTypes(const std::string& value)
+{
+  // Comma or space separated names
+  DWORD jumpTypes = 0;
+  std::istringstream stream(value);
+  std::string name;
+  while (stream >> name)
+  {
+    size_t start = 0;
+    while (start <= name.size())
+    {
+      const size_t end = std::min(name.find(',', start), name.size());
+      const std::string item = name.substr(start, end - start);
+      start = end + 1;
+      if (item.empty()) continue;
+      if (item == "all") jumpTypes |= ALL_JUMP_TYPES;
+      else if (item == "jcc") jumpTypes |= CONDITIONAL_JUMP_TYPES;
+      else
+      {
+        auto type = std::find_if(std::begin(JUMP_TYPE_NAMES) + JO, std::end(JUMP_TYPE_NAMES), [&](const char* typeName) -> bool
+        {
+          return item == typeName;
+        });
+        if (type == std::end(JUMP_TYPE_NAMES)) return false;
+        jumpTypes |= 1 << (type - std::begin(JUMP_TYPE_NAMES));
+      }
+    }
+  }
+  if (jumpTypes == 0) return false;
+  _jumpTypes = jumpTypes;
+  return true;
+}
+
+bool DensityPolicy::IsDefault() const
+{
+  return _fraction >= 1.0 && _maxPerFunction == 0 && _maxPerBlock == 0 && _jumpTypes == ALL_JUMP_TYPES && _direction == JumpDirection::Any;
+}
+
+std::string DensityPolicy::GetDescription() const
+{
+  if (IsDefault()) return "every jump";
+
+  std::ostringstream description;
+  description << _fraction * 100.0 << "% of the";
+  if (_direction == JumpDirection::Forward) description << " forward";
+  else if (_direction == JumpDirection::Backward) description << " backward";
+  if (_jumpTypes == CONDITIONAL_JUMP_TYPES) description << " conditional";
+  else if (_jumpTypes != ALL_JUMP_TYPES)
+  {
+    const char* separator = " ";
+    for (DWORD type = JO; type <= JMP; type++)
+    {
+      if ((_jumpTypes & (1 << type)) == 0) continue;
+      description << separator << JUMP_TYPE_NAMES[type];
+      separator = ", ";
+    }
+  }
+  description << " jumps";
+  if (_maxPerFunction != 0) description << ", at most " << _maxPerFunction << " per function";
+  if (_maxPerBlock != 0) description << ", at most " << _maxPerBlock << " per block";
+  if (_hasSeed) description << ", sampling seed " << _seed;
+  return description.str();
+}
+
+bool DensityPolicy::Accepts(JumpType jumpType, const RelativeJump& jump) const
+{
+  if ((_jumpTypes & (1 << jumpType)) == 0) return false;
+  if (_direction == JumpDirection::Any) return true;
+  const bool isBackward = GetTarget(jump) <= (LONGLONG)jump.Rva;
+  return isBackward == (_direction == JumpDirection::Backward);
+}
+
+void DensityPolicy::Sample(const std::vector<RelativeJump>& jumps, const std::vector<DWORD>& functionStarts, DWORD sectionRva, ULONGLONG buildSeed, std::vector<bool>& selected) const
+{
+  if (_fraction >= 1.0 && _maxPerFunction == 0 && _maxPerBlock == 0) return;
+
+  // One draw per candidate from the stream of its RVA; the fraction keeps the lowest 53 bit priorities
+  const ULONGLONG seed = (_hasSeed ? _seed : buildSeed) ^ SAMPLING_SEED;
+  std::vector<ULONGLONG> priorities(jumps.size(), 0);
+  for (size_t i = 0; i < jumps.size(); i++)
+  {
+    if (!selected[i]) continue;
+    RandomGenerator random(seed, (ULONGLONG)sectionRva + jumps[i].Rva);
+    priorities[i] = random.Next() >> 11;
+    if ((double)priorities[i] * (1.0 / (1ULL << 53)) >= _fraction) selected[i] = false;
+  }
+
+  std::vector<size_t> buffer;
+  if (_maxPerBlock != 0)
+  {
+    // Blocks start at every branch target and function start; the jumps between two starts share a block. Targets
+    // behind the last jump cannot split a block.
+    std::vector<DWORD> blockStarts(functionStarts);
+    for (const RelativeJump& jump : jumps)
+    {
+      const LONGLONG target = GetTarget(jump);
+      if (target >= 0 && target <= jumps.back().Rva) blockStarts.push_back((DWORD)target);
+    }
+    std::sort(blockStarts.begin(), blockStarts.end());
+    blockStarts.erase(std::unique(blockStarts.begin(), blockStarts.end()), blockStarts.end());
+
+    size_t blockIndex = 0;
+    size_t first = 0;
+    for (size_t i = 0; i <= jumps.size(); i++)
+    {
+      const bool isLast = i == jumps.size();
+      size_t index = blockIndex;
+      while (!isLast && index < blockStarts.size() && blockStarts[index] <= jumps[i].Rva) index++;
+      if (!isLast && index == blockIndex) continue;
+      Limit(priorities, first, i, _maxPerBlock, selected, buffer);
+      blockIndex = index;
+      first = i;
+    }
+  }
+
+  if (_maxPerFunction != 0)
+  {
+    size_t functionIndex = 0;
+    size_t first = 0;
+    for (size_t i = 0; i <= jumps.size(); i++)
+    {
+      const bool isLast = i == jumps.size();
+      size_t index = functionIndex;
+      while (!isLast && index < functionStarts.size() && functionStarts[index] <= jumps[i].Rva) index++;
+      if (!isLast && index == functionIndex) continue;
+      Limit(priorities, first, i, _maxPerFunction, selected, buffer);
+      functionIndex = index;
+      first = i;
+    }
+  }
+}
+
+void DensityPolicy::Limit(const std::vector<ULONGLONG>& priorities, size_t first, size_t last, DWORD maxCount, std::vector<bool>& selected, std::vector<size_t>& buffer)
+{
+  buffer.clear();
+  for (size_t i = first; i < last; i++)
+  {
+    if (selected[i]) buffer.push_back(i);
+  }
+  if (buffer.size() <= maxCount) return;
+
+  std::nth_element(buffer.begin(), buffer.begin() + maxCount, buffer.end(), [&](size_t a, size_t b) -> bool
+  {
+    return priorities[a] < priorities[b] || (priorities[a] == priorities[b] && a < b);
+  });
+  for (size_t i = maxCount; i < buffer.size(); i++) selected[buffer[i]] = false;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Nanomite.h"
+#include "../Disassembler/RelativeJump.h"
+
+enum class JumpDirection
+{
+  Any,
+  Forward,    // Target behind the jump
+  Backward    // Back edges: the target is at or in front of the jump, usually a loop
+};
+
+// Limits how many of the jumps of a section become nanomites, to bound the runtime overhead while keeping the sites
+// spread over the code. Jumps are first filtered by type and direction. Every remaining jump then gets a priority from
+// its own RandomGenerator stream (seed and RVA), so the choice does not depend on the thread count or the order of the
+// sections. A jump is kept if its priority falls below the fraction, and only the jumps with the lowest priorities
+// within a block and within a function survive the limits. The same seed and input always select the same jumps.
+class DensityPolicy
+{
+public:
+  DensityPolicy();
+  ~DensityPolicy();
+
+  // "key = value" lines, '#' starts a comment:
+  //   fraction = 0.25                converted share of the jumps, 0 to 1
+  //   max-per-function = 8           0 for no limit
+  //   max-per-block = 1              0 for no limit; a block runs from one branch target or function start to the next
+  //   jump-types = jcc, jmp          jo ... jg, jcxz, jmp; jcc for all conditional jumps, all for every type
+  //   direction = forward            any, forward or backward
+  //   seed = 1234                    sampling seed, default: the seed of the build
+  // False for an unreadable file or an invalid line, see GetErrorLine
+  bool Load(const char* fileName);
+  // Line of the last failed Load, 0 if the file could not be read
+  DWORD GetErrorLine() const { return _errorLine; }
+
+  void SetFraction(double fraction) { _fraction = fraction; }
+  void SetMaxPerFunction(DWORD maxPerFunction) { _maxPerFunction = maxPerFunction; }
+  void SetMaxPerBlock(DWORD maxPerBlock) { _maxPerBlock = maxPerBlock; }
+  // One bit per JumpType
+  void SetJumpTypes(DWORD jumpTypes) { _jumpTypes = jumpTypes; }
+  void SetDirection(JumpDirection direction) { _direction = direction; }
+  void SetSeed(ULONGLONG seed) { _seed = seed; _hasSeed = true; }
+
+  // True if every jump is converted
+  bool IsDefault() const;
+  // For the build output, e.g. "25% of the forward je, jne jumps, at most 4 per function"
+  std::string GetDescription() const;
+
+  // Type and direction of a section relative jump
+  bool Accepts(JumpType jumpType, const RelativeJump& jump) const;
+  // jumps: section relative and sorted; selected: one flag per jump, set for the candidates on entry and cleared for
+  // the jumps the policy leaves untouched. functionStarts as returned by the Disassembler, empty for one function.
+  void Sample(const std::vector<RelativeJump>& jumps, const std::vector<DWORD>& functionStarts, DWORD sectionRva, ULONGLONG buildSeed, std::vector<bool>& selected) const;
+
+private:
+  bool ParseLine(const std::string& key, const std::string& value);
+  bool ParseJumpTypes(const std::string& value);
+  // Keeps the maxCount candidates with the lowest priorities in [first, last)
+  static void Limit(const std::vector<ULONGLONG>& priorities, size_t first, size_t last, DWORD maxCount, std::vector<bool>& selected, std::vector<size_t>& buffer);
+  static LONGLONG GetTarget(const RelativeJump& jump) { return (LONGLONG)jump.Rva + jump.OpcodeLength + (LONG)jump.JmpLength; }
+
+private:
+  static const DWORD ALL_JUMP_TYPES = ((1 << (JMP + 1)) - 1) & ~(1 << UNKNOWN);
+  static const DWORD CONDITIONAL_JUMP_TYPES = ALL_JUMP_TYPES & ~(1 << JMP);
+  static const ULONGLONG SAMPLING_SEED = 0x6A09E667F3BCC909ULL; // Separates the sampling from the filler streams
+
+  double _fraction;
+  DWORD _maxPerFunction;
+  DWORD _maxPerBlock;
+  DWORD _jumpTypes;
+  JumpDirection _direction;
+  ULONGLONG _seed;
+  bool _hasSeed;
+  DWORD _errorLine;
+};
@@ -1,5 +1,5 @@
 #pragma once
-#include <Windows.h>
+#include "../PEFile/PEFormat.h"
 
 enum JumpType
 {
@@ -24,6 +24,9 @@ enum JumpType
   JMP   // 0xE9 / 0xEB
 };
 
+// Lower case mnemonics by JumpType, as written by the build report and read from density policies
+inline const char* const JUMP_TYPE_NAMES[] = { "unknown", "jo", "jno", "jb", "jnb", "je", "jne", "jbe", "ja", "js", "jns", "jp", "jnp", "jl", "jge", "jle", "jg", "jcxz", "jmp" };
+
 struct Nanomite
 {
   DWORD Rva;  // Relative to ImageBase
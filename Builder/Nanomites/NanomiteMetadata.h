@@ -1,10 +1,23 @@
 #pragma once
-#include <Windows.h>
+#include "../PEFile/PEFormat.h"
 
 struct Nanomite;
 
+// Protected section in the section table resource: a DWORD count followed by one entry per section. The nanomites of
+// a section are the range [FirstNanomite, FirstNanomite + NanomiteCount) of the table sorted by RVA.
+struct NanomiteSection
+{
+  BYTE Name[PE_SIZEOF_SHORT_NAME];  // Null terminated if shorter than 8 characters
+  DWORD VirtualAddress;
+  DWORD VirtualSize;
+  DWORD FirstNanomite;
+  DWORD NanomiteCount;
+};
+
 struct NanomiteMetadata
 {
   DWORD ItemCount;
   Nanomite* Nanomites;
+  DWORD SectionCount;     // Builder only, the runtime reads the sections from their own resource
+  NanomiteSection* Sections;
 };
\ No newline at end of file
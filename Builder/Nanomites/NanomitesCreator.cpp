@@ -1,51 +1,156 @@
-#include <time.h>
 #include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
 #include "NanomitesCreator.h"
-#include "..\Disassembler\Disassembler.h"
+#include "DensityPolicy.h"
+#include "RandomGenerator.h"
+#include "../Disassembler/Disassembler.h"
+#include "../Instrumentation/PhaseProfiler.h"
 
 NanomitesCreator::NanomitesCreator()
 {
-  srand((int)time(NULL));
+  _seed = RandomGenerator::CreateSeed();
+  _profiler = nullptr;
+  _threadCount = 0;
+  _cache = nullptr;
+  _policy = nullptr;
+  _costModel = nullptr;
+  _functionCount = 0;
+  _cachedFunctionCount = 0;
+  _relocationSize = 0;
+  _jumpCount = 0;
+  _decoyCount = 0;
+  _excludedCount = 0;
+  _skippedCount = 0;
 }
 
 NanomitesCreator::~NanomitesCreator()
 {
 }
 
-NanomiteMetadata* NanomitesCreator::Create(PEFile& peFile, PIMAGE_SECTION_HEADER sectionHeader)
+NanomiteMetadata* NanomitesCreator::Create(PEFile& peFile, const PeSectionHeader* sectionHeader)
 {
-  Disassembler disasm;
+  return Create(peFile, std::vector<const PeSectionHeader*>(1, sectionHeader));
+}
 
-  // Get all 0xCC bytes of section to use them as fake nanomites
-  std::set<DWORD> fakeNanomiteRVAs;
-  disasm.GetCCs(peFile, sectionHeader, fakeNanomiteRVAs);
+NanomiteMetadata* NanomitesCreator::Create(PEFile& peFile, const std::vector<const PeSectionHeader*>& sectionHeaders)
+{
+  // Find all real relative jumps of the sections and all 0xCC bytes to use them as fake nanomites
+  std::vector<SectionAnalysis> analyses(sectionHeaders.size());
+  {
+    PhaseProfiler::Scope phase(_profiler, "analyze");
+    AnalyzeSections(peFile, sectionHeaders, analyses);
+  }
+  _functionCount = 0;
+  _cachedFunctionCount = 0;
+  for (const SectionAnalysis& analysis : analyses)
+  {
+    _functionCount += analysis.FunctionCount;
+    _cachedFunctionCount += analysis.CachedFunctionCount;
+  }
 
-  // Find all real relative jumps of section
-  std::vector<RelativeJump> relativeJumps;
-  disasm.GetRelativeJumps(peFile, sectionHeader, relativeJumps);
+  // Bytes the loader rebases are never code, a "jump" overlapping them was decoded from data
+  _relocationRvas.clear();
+  peFile.GetRelocations(_relocationRvas);
+  _relocationSize = peFile.Is64Bit() ? sizeof(ULONGLONG) : sizeof(DWORD);
 
-  // Process jumps into a single list
+  // Process jumps of all sections into a single list; patching records the changed ranges in the PEFile, one
+  // section at a time
   std::vector<Nanomite> nanomites;
-  ProcessRealJumps(peFile, sectionHeader, relativeJumps, nanomites);
-  ProcessFakeJumps(sectionHeader, fakeNanomiteRVAs, nanomites);
+  _jumpCount = 0;
+  _decoyCount = 0;
+  _excludedCount = 0;
+  _skippedCount = 0;
+  {
+    PhaseProfiler::Scope phase(_profiler, "patch");
+    for (size_t i = 0; i < sectionHeaders.size(); i++)
+    {
+      const size_t first = nanomites.size();
+      ProcessRealJumps(peFile, sectionHeaders[i], analyses[i].RelativeJumps, analyses[i].FunctionStarts, nanomites);
+      analyses[i].FirstJump = first;
+      analyses[i].JumpCount = (DWORD)(nanomites.size() - first);
+      _jumpCount += analyses[i].JumpCount;
+      ProcessFakeJumps(sectionHeaders[i], analyses[i].FakeNanomiteRvas, nanomites);
+      analyses[i].NanomiteCount = (DWORD)(nanomites.size() - first);
+    }
+    _decoyCount = (DWORD)nanomites.size() - _jumpCount;
+  }
+
+  _sectionReports.clear();
+  if (_costModel != nullptr)
+  {
+    PhaseProfiler::Scope phase(_profiler, "report");
+    CreateSectionReports(sectionHeaders, analyses, nanomites);
+  }
 
-  // Sort by rva
+  // Sort by rva and create the final metadata output structure, which will be written into the resource section of the target executable
+  PhaseProfiler::Scope phase(_profiler, "sort");
   SortNanomitesByRva(nanomites);
+  return CreateMetadata(sectionHeaders, analyses, nanomites);
+}
+
+void NanomitesCreator::AnalyzeSections(PEFile& peFile, const std::vector<const PeSectionHeader*>& sectionHeaders, std::vector<SectionAnalysis>& analyses) const
+{
+  // Every worker analyzes one section at a time with its share of the threads
+  DWORD threadCount = _threadCount != 0 ? _threadCount : std::thread::hardware_concurrency();
+  if (threadCount == 0) threadCount = 1;
+  const DWORD workerCount = (DWORD)std::min<size_t>(threadCount, sectionHeaders.size());
+  std::atomic<size_t> nextSection(0);
+  auto work = [&]()
+  {
+    for (size_t i = nextSection++; i < sectionHeaders.size(); i = nextSection++)
+    {
+      Disassembler disasm;
+      disasm.SetThreadCount(std::max<DWORD>(1, threadCount / workerCount));
+      disasm.SetAnalysisCache(_cache);
+      disasm.AnalyzeSection(peFile, sectionHeaders[i], analyses[i].RelativeJumps, analyses[i].FakeNanomiteRvas);
+      analyses[i].FunctionStarts = disasm.GetFunctionStarts();
+      analyses[i].FunctionCount = disasm.GetFunctionCount();
+      analyses[i].CachedFunctionCount = disasm.GetCachedFunctionCount();
+    }
+  };
 
-  // Create the final metadata output structure, which will be written into the resource section of the target executable
-  return CreateMetadata(sectionHeader, nanomites);
+  if (workerCount <= 1)
+  {
+    work();
+    return;
+  }
+  std::vector<std::thread> workers;
+  for (DWORD t = 0; t < workerCount; t++) workers.emplace_back(work);
+  for (auto& worker : workers) worker.join();
 }
 
-void NanomitesCreator::ProcessRealJumps(PEFile& peFile, PIMAGE_SECTION_HEADER sectionHeader, const std::vector<RelativeJump>& relativeJumps, std::vector<Nanomite>& outNanomites)
+void NanomitesCreator::ProcessRealJumps(PEFile& peFile, const PeSectionHeader* sectionHeader, const std::vector<RelativeJump>& relativeJumps, const std::vector<DWORD>& functionStarts, std::vector<Nanomite>& outNanomites)
 {
-  for (const auto& jump : relativeJumps)
+  // Candidates are the known jumps outside of the exclusions and relocations, the density policy thins them out
+  std::vector<bool> selected(relativeJumps.size(), false);
+  DWORD candidateCount = 0;
+  for (size_t i = 0; i < relativeJumps.size(); i++)
   {
+    const RelativeJump& jump = relativeJumps[i];
     JumpType jumpType = ToJumpType(jump.Opcode);
     if (jumpType == JumpType::UNKNOWN) continue;
+    if (_excludedRvas.count(jump.Rva + sectionHeader->VirtualAddress) != 0)
+    {
+      _excludedCount++;
+      continue;
+    }
+    if (OverlapsRelocation(jump.Rva + sectionHeader->VirtualAddress, jump.OpcodeLength)) continue;
+    candidateCount++;
+    selected[i] = _policy == nullptr || _policy->Accepts(jumpType, jump);
+  }
+  if (_policy != nullptr) _policy->Sample(relativeJumps, functionStarts, sectionHeader->VirtualAddress, _seed, selected);
+
+  const size_t first = outNanomites.size();
+  for (size_t i = 0; i < relativeJumps.size(); i++)
+  {
+    if (!selected[i]) continue;
+    const RelativeJump& jump = relativeJumps[i];
 
     Nanomite nanomite;
     nanomite.Rva = jump.Rva;
-    nanomite.JumpType = static_cast<DWORD>(jumpType);
+    nanomite.JumpType = static_cast<DWORD>(ToJumpType(jump.Opcode));
     nanomite.JumpLength = jump.JmpLength;
     nanomite.OpcodeLength = jump.OpcodeLength;
 
@@ -55,19 +160,62 @@ void NanomitesCreator::ProcessRealJumps(PEFile& peFile, PIMAGE_SECTION_HEADER se
     nanomite.Rva += sectionHeader->VirtualAddress; // Make RVA relative to ImageBase
     outNanomites.push_back(nanomite);
   }
+  _skippedCount += candidateCount - (DWORD)(outNanomites.size() - first);
+}
+
+void NanomitesCreator::ProcessFakeJumps(const PeSectionHeader* sectionHeader, const std::vector<DWORD>& fakeNanomiteRVAs, std::vector<Nanomite>& outNanomites) const
+{
+  // Decoys only depend on their RVA and the seed, so the threads can split them in any way
+  const size_t first = outNanomites.size();
+  const size_t count = fakeNanomiteRVAs.size();
+  outNanomites.resize(first + count);
+  DWORD threadCount = _threadCount != 0 ? _threadCount : std::thread::hardware_concurrency();
+  threadCount = (DWORD)std::min<size_t>(std::max<DWORD>(threadCount, 1), count / MIN_DECOYS_PER_THREAD);
+  if (threadCount <= 1)
+  {
+    CreateFakeJumps(sectionHeader, fakeNanomiteRVAs.data(), count, outNanomites.data() + first);
+    return;
+  }
+
+  std::vector<std::thread> threads;
+  for (DWORD t = 0; t < threadCount; t++)
+  {
+    const size_t begin = count * t / threadCount;
+    const size_t end = count * (t + 1) / threadCount;
+    threads.emplace_back([&, begin, end]()
+    {
+      CreateFakeJumps(sectionHeader, fakeNanomiteRVAs.data() + begin, end - begin, outNanomites.data() + first + begin);
+    });
+  }
+  for (auto& thread : threads) thread.join();
 }
 
-void NanomitesCreator::ProcessFakeJumps(PIMAGE_SECTION_HEADER sectionHeader, const std::set<DWORD>& fakeNanomiteRVAs, std::vector<Nanomite>& outNanomites) const
+void NanomitesCreator::CreateFakeJumps(const PeSectionHeader* sectionHeader, const DWORD* fakeNanomiteRVAs, size_t count, Nanomite* outNanomites) const
 {
-  for (DWORD rva : fakeNanomiteRVAs)
+  for (size_t i = 0; i < count; i++)
   {
-    Nanomite fake;
-    fake.Rva = rva + sectionHeader->VirtualAddress; // Make RVA relative to ImageBase
-    fake.JumpType = static_cast<DWORD>(ToJumpType(GetRandomShortJump()));
-    fake.JumpLength = GetRandomByte(0x02, 0xA0);
+    Nanomite& fake = outNanomites[i];
+    fake.Rva = fakeNanomiteRVAs[i] + sectionHeader->VirtualAddress; // Make RVA relative to ImageBase
+    RandomGenerator random(_seed, fake.Rva);
+    fake.JumpType = static_cast<DWORD>(ToJumpType(GetRandomShortJump(random)));
+    fake.JumpLength = random.NextByte(0x02, 0xA0);
     fake.OpcodeLength = 2;
+  }
+}
 
-    outNanomites.push_back(fake);
+void NanomitesCreator::CreateSectionReports(const std::vector<const PeSectionHeader*>& sectionHeaders, const std::vector<SectionAnalysis>& analyses, const std::vector<Nanomite>& nanomites)
+{
+  _sectionReports.resize(sectionHeaders.size());
+  for (size_t i = 0; i < sectionHeaders.size(); i++)
+  {
+    const PeSectionHeader* sectionHeader = sectionHeaders[i];
+    const SectionAnalysis& analysis = analyses[i];
+    SectionReport& report = _sectionReports[i];
+    report.Name = PEFile::GetSectionName(sectionHeader);
+    report.VirtualAddress = sectionHeader->VirtualAddress;
+    report.Size = sectionHeader->SizeOfRawData;
+    report.DecoyCount = analysis.NanomiteCount - analysis.JumpCount;
+    _costModel->Analyze(sectionHeader, analysis.RelativeJumps, analysis.FunctionStarts, nanomites.data() + analysis.FirstJump, analysis.JumpCount, report);
   }
 }
 
@@ -79,7 +227,7 @@ void NanomitesCreator::SortNanomitesByRva(std::vector<Nanomite>& nanomites) cons
   });
 }
 
-NanomiteMetadata* NanomitesCreator::CreateMetadata(PIMAGE_SECTION_HEADER sectionHeader, const std::vector<Nanomite>& nanomites) const
+NanomiteMetadata* NanomitesCreator::CreateMetadata(const std::vector<const PeSectionHeader*>& sectionHeaders, const std::vector<SectionAnalysis>& analyses, const std::vector<Nanomite>& nanomites) const
 {
   NanomiteMetadata* result = new NanomiteMetadata();
   result->ItemCount = (DWORD)nanomites.size();
@@ -89,43 +237,52 @@ NanomiteMetadata* NanomitesCreator::CreateMetadata(PIMAGE_SECTION_HEADER section
 
   std::copy(nanomites.begin(), nanomites.end(), result->Nanomites);
 
+  // Sections do not overlap, so the nanomites of each one are a contiguous range of the sorted table
+  result->SectionCount = (DWORD)sectionHeaders.size();
+  result->Sections = new NanomiteSection[result->SectionCount];
+  for (DWORD i = 0; i < result->SectionCount; i++)
+  {
+    const PeSectionHeader* sectionHeader = sectionHeaders[i];
+    NanomiteSection& section = result->Sections[i];
+    memcpy(section.Name, sectionHeader->Name, sizeof(section.Name));
+    section.VirtualAddress = sectionHeader->VirtualAddress;
+    section.VirtualSize = sectionHeader->VirtualSize;
+    auto first = std::lower_bound(nanomites.begin(), nanomites.end(), sectionHeader->VirtualAddress, [](const Nanomite& nanomite, DWORD rva) -> bool
+    {
+      return nanomite.Rva < rva;
+    });
+    section.FirstNanomite = (DWORD)(first - nanomites.begin());
+    section.NanomiteCount = analyses[i].NanomiteCount;
+  }
+
   return result;
 }
 
-void NanomitesCreator::WriteNanomite(PEFile& peFile, PIMAGE_SECTION_HEADER sectionHeader, Nanomite& nanomite)
+void NanomitesCreator::WriteNanomite(PEFile& peFile, const PeSectionHeader* sectionHeader, Nanomite& nanomite)
 {
-  BYTE* peFileBuffer = peFile.GetBuffer();
-
   const DWORD sectionOffset = sectionHeader->PointerToRawData;
   DWORD offset = nanomite.Rva + sectionOffset;
-  BYTE* fileOffset = peFileBuffer + offset;
+  BYTE* fileOffset = peFile.GetWritablePointer(offset, nanomite.OpcodeLength);
+  if (fileOffset == nullptr || nanomite.OpcodeLength == 0) return;
 
   *fileOffset = 0xCC;
 
-  // Fill the remaining bytes with random data
-  for (unsigned int i = 1; i < nanomite.OpcodeLength; ++i)
-  {
-    fileOffset[i] = GetRandomByte();
-  }
+  // Fill the remaining bytes with random data from the stream of this site
+  RandomGenerator random(_seed, nanomite.Rva + sectionHeader->VirtualAddress);
+  random.Fill(fileOffset + 1, nanomite.OpcodeLength - 1);
 }
 
-BYTE NanomitesCreator::GetRandomShortJump() const
+bool NanomitesCreator::OverlapsRelocation(DWORD rva, DWORD length) const
 {
-  // 0x70 (JO_S) to 0x7F (JG_S)
-  return GetRandomByte(0x70, 0x7F);
+  const DWORD first = rva >= _relocationSize ? rva - _relocationSize + 1 : 0;
+  auto relocation = std::lower_bound(_relocationRvas.begin(), _relocationRvas.end(), first);
+  return relocation != _relocationRvas.end() && *relocation < rva + length;
 }
 
-BYTE NanomitesCreator::GetRandomByte() const
+BYTE NanomitesCreator::GetRandomShortJump(RandomGenerator& random) const
 {
-  const int min = 0;
-  const int max = 255;
-  return GetRandomByte(0, 255);
-}
-
-BYTE NanomitesCreator::GetRandomByte(const int min, const int max) const
-{
-  BYTE result = (BYTE)(((double)rand() / RAND_MAX) * (max - min) + min);
-  return result;
+  // 0x70 (JO_S) to 0x7F (JG_S)
+  return random.NextByte(0x70, 0x7F);
 }
 
 JumpType NanomitesCreator::ToJumpType(DWORD opcode) const
@@ -1,11 +1,16 @@
 #pragma once
-#include <Windows.h>
 #include <set>
 #include <vector>
 #include "Nanomite.h"
 #include "NanomiteMetadata.h"
-#include "..\PEFile\PEFile.h"
-#include "..\Disassembler\RelativeJump.h"
+#include "../PEFile/PEFile.h"
+#include "../Disassembler/RelativeJump.h"
+#include "../Report/CostModel.h"
+
+class PhaseProfiler;
+class RandomGenerator;
+class AnalysisCache;
+class DensityPolicy;
 
 class NanomitesCreator
 {
@@ -13,17 +18,82 @@ public:
   NanomitesCreator();
   ~NanomitesCreator();
 
-  NanomiteMetadata* Create(PEFile& peFile, PIMAGE_SECTION_HEADER sectionHeader);
+  NanomiteMetadata* Create(PEFile& peFile, const PeSectionHeader* sectionHeader);
+  // Analyzes the sections at the same time and merges their nanomites into one table sorted by RVA
+  NanomiteMetadata* Create(PEFile& peFile, const std::vector<const PeSectionHeader*>& sectionHeaders);
+
+  // Jumps at these RVAs (relative to ImageBase) are left untouched, e.g. hot sites reported by Nanoprof
+  void SetExcludedRvas(const std::set<DWORD>& excludedRvas) { _excludedRvas = excludedRvas; }
+  // Measures the scan, decode, patch and sort phases, nullptr disables it
+  void SetPhaseProfiler(PhaseProfiler* profiler) { _profiler = profiler; }
+  // Threads of the analysis, 0 uses one per logical processor
+  void SetThreadCount(DWORD threadCount) { _threadCount = threadCount; }
+  // Reuses the analysis of unchanged functions, nullptr analyzes everything
+  void SetAnalysisCache(AnalysisCache* cache) { _cache = cache; }
+  // Filler bytes and decoys are drawn from a stream per site, the same seed and input give the same output
+  void SetSeed(ULONGLONG seed) { _seed = seed; }
+  ULONGLONG GetSeed() const { return _seed; }
+  // Limits which jumps become nanomites, nullptr (default) converts every jump
+  void SetDensityPolicy(const DensityPolicy* policy) { _policy = policy; }
+  // Fills the section reports after patching with this model, nullptr (default) skips them
+  void SetCostModel(const CostModel* costModel) { _costModel = costModel; }
+
+  // Real and decoy nanomites of the last call of Create, summed over the sections
+  DWORD GetJumpCount() const { return _jumpCount; }
+  DWORD GetDecoyCount() const { return _decoyCount; }
+  // Jumps left untouched because their RVA is excluded
+  DWORD GetExcludedCount() const { return _excludedCount; }
+  // Jumps that could have been converted but were left untouched by the density policy
+  DWORD GetSkippedCount() const { return _skippedCount; }
+  // Functions from .pdata and how many of them came from the cache
+  DWORD GetFunctionCount() const { return _functionCount; }
+  DWORD GetCachedFunctionCount() const { return _cachedFunctionCount; }
+  // One per section in the order of the headers, empty without a cost model
+  const std::vector<SectionReport>& GetSectionReports() const { return _sectionReports; }
 
 private:
-  void ProcessRealJumps(PEFile& peFile, PIMAGE_SECTION_HEADER sectionHeader, const std::vector<RelativeJump>& relativeJumps, std::vector<Nanomite>& outNanomites);
-  void ProcessFakeJumps(PIMAGE_SECTION_HEADER sectionHeader, const std::set<DWORD>& fakeNanomiteRVAs, std::vector<Nanomite>& outNanomites) const;
+  struct SectionAnalysis
+  {
+    std::vector<RelativeJump> RelativeJumps;
+    std::vector<DWORD> FakeNanomiteRvas;
+    std::vector<DWORD> FunctionStarts;
+    DWORD FunctionCount;
+    DWORD CachedFunctionCount;
+    DWORD NanomiteCount;
+    size_t FirstJump;     // Real nanomites of the section in the unsorted list, by RVA
+    DWORD JumpCount;
+  };
+
+  void AnalyzeSections(PEFile& peFile, const std::vector<const PeSectionHeader*>& sectionHeaders, std::vector<SectionAnalysis>& analyses) const;
+  void ProcessRealJumps(PEFile& peFile, const PeSectionHeader* sectionHeader, const std::vector<RelativeJump>& relativeJumps, const std::vector<DWORD>& functionStarts, std::vector<Nanomite>& outNanomites);
+  void ProcessFakeJumps(const PeSectionHeader* sectionHeader, const std::vector<DWORD>& fakeNanomiteRVAs, std::vector<Nanomite>& outNanomites) const;
+  void CreateFakeJumps(const PeSectionHeader* sectionHeader, const DWORD* fakeNanomiteRVAs, size_t count, Nanomite* outNanomites) const;
+  void CreateSectionReports(const std::vector<const PeSectionHeader*>& sectionHeaders, const std::vector<SectionAnalysis>& analyses, const std::vector<Nanomite>& nanomites);
   void SortNanomitesByRva(std::vector<Nanomite>& nanomites) const;
-  NanomiteMetadata* CreateMetadata(PIMAGE_SECTION_HEADER sectionHeader, const std::vector<Nanomite>& nanomites) const;
-  void WriteNanomite(PEFile& peFile, PIMAGE_SECTION_HEADER sectionHeader, Nanomite& nanomite);
-  BYTE GetRandomShortJump() const;
-  BYTE GetRandomByte() const;
-  BYTE GetRandomByte(int min, int max) const;
+  NanomiteMetadata* CreateMetadata(const std::vector<const PeSectionHeader*>& sectionHeaders, const std::vector<SectionAnalysis>& analyses, const std::vector<Nanomite>& nanomites) const;
+  bool OverlapsRelocation(DWORD rva, DWORD length) const;
+  void WriteNanomite(PEFile& peFile, const PeSectionHeader* sectionHeader, Nanomite& nanomite);
+  BYTE GetRandomShortJump(RandomGenerator& random) const;
   JumpType ToJumpType(DWORD opcode) const;
+
+private:
+  static const size_t MIN_DECOYS_PER_THREAD = 1 << 16;
+
+  std::set<DWORD> _excludedRvas;
+  std::vector<DWORD> _relocationRvas; // Sorted base relocations of the image
+  DWORD _relocationSize;
+  PhaseProfiler* _profiler;
+  DWORD _threadCount;
+  AnalysisCache* _cache;
+  ULONGLONG _seed;
+  const DensityPolicy* _policy;
+  const CostModel* _costModel;
+  std::vector<SectionReport> _sectionReports;
+  DWORD _functionCount;
+  DWORD _cachedFunctionCount;
+  DWORD _jumpCount;
+  DWORD _decoyCount;
+  DWORD _excludedCount;
+  DWORD _skippedCount;
 };
 
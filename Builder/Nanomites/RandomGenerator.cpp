@@ -0,0 +1,61 @@
+#include <cstring>
+#include <random>
+#include "RandomGenerator.h"
+
+RandomGenerator::RandomGenerator(ULONGLONG seed, ULONGLONG stream)
+{
+  // The stream is scrambled before it meets the seed, so neighbouring streams (RVAs) do not share state bits
+  ULONGLONG streamState = stream * STREAM_GAMMA;
+  ULONGLONG state = seed ^ SplitMix(streamState);
+  for (int i = 0; i < 4; i++)
+  {
+    _state[i] = SplitMix(state);
+  }
+}
+
+RandomGenerator::~RandomGenerator()
+{
+}
+
+ULONGLONG RandomGenerator::Next()
+{
+  const ULONGLONG result = Rotate(_state[1] * 5, 7) * 9;
+  const ULONGLONG shifted = _state[1] << 17;
+  _state[2] ^= _state[0];
+  _state[3] ^= _state[1];
+  _state[1] ^= _state[2];
+  _state[0] ^= _state[3];
+  _state[2] ^= shifted;
+  _state[3] = Rotate(_state[3], 45);
+  return result;
+}
+
+BYTE RandomGenerator::NextByte(BYTE min, BYTE max)
+{
+  // Multiply and shift instead of a modulo; the bias of 2^-24 at most does not matter for filler bytes
+  const ULONGLONG range = (ULONGLONG)(max - min) + 1;
+  return (BYTE)(min + (((Next() >> 32) * range) >> 32));
+}
+
+void RandomGenerator::Fill(BYTE* data, DWORD size)
+{
+  for (DWORD i = 0; i < size; i += sizeof(ULONGLONG))
+  {
+    const ULONGLONG value = Next();
+    memcpy(data + i, &value, size - i < sizeof(ULONGLONG) ? size - i : sizeof(ULONGLONG));
+  }
+}
+
+ULONGLONG RandomGenerator::CreateSeed()
+{
+  std::random_device random;
+  return ((ULONGLONG)random() << 32) | random();
+}
+
+ULONGLONG RandomGenerator::SplitMix(ULONGLONG& state)
+{
+  ULONGLONG value = (state += 0x9E3779B97F4A7C15ULL);
+  value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+  return value ^ (value >> 31);
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "../PEFile/PEFormat.h"
+
+// xoshiro256** seeded through SplitMix64. Every (seed, stream) pair starts an independent sequence, so each patch
+// site can draw from its own stream: the output only depends on the seed and the site, not on the thread or the order
+// in which the sites are processed.
+class RandomGenerator
+{
+public:
+  RandomGenerator(ULONGLONG seed, ULONGLONG stream = 0);
+  ~RandomGenerator();
+
+  ULONGLONG Next();
+  // Uniform in [min, max]
+  BYTE NextByte(BYTE min, BYTE max);
+  // One draw per 8 bytes
+  void Fill(BYTE* data, DWORD size);
+
+  // From the entropy source of the system, for builds without a fixed seed
+  static ULONGLONG CreateSeed();
+
+private:
+  static ULONGLONG SplitMix(ULONGLONG& state);
+  static ULONGLONG Rotate(ULONGLONG value, int bits) { return (value << bits) | (value >> (64 - bits)); }
+
+private:
+  static const ULONGLONG STREAM_GAMMA = 0x9E3779B97F4A7C15ULL;
+
+  ULONGLONG _state[4];
+};
@@ -0,0 +1,74 @@
+#include "FileMapping.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+FileMapping::FileMapping()
+{
+  _data = nullptr;
+  _size = 0;
+}
+
+FileMapping::~FileMapping()
+{
+  Close();
+}
+
+bool FileMapping::Open(const char* fileName)
+{
+  Close();
+#ifdef _WIN32
+  // FILE_SHARE_WRITE allows PEFile::SaveFile to write the patched pages back while the view exists
+  HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) return false;
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0 || fileSize.QuadPart > 0xFFFFFFFF)
+  {
+    CloseHandle(file);
+    return false;
+  }
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+  CloseHandle(file);
+  if (mapping == NULL) return false;
+
+  // The view keeps the mapping and the file open
+  _data = (BYTE*)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+  CloseHandle(mapping);
+  if (_data == nullptr) return false;
+  _size = (DWORD)fileSize.QuadPart;
+#else
+  const int file = open(fileName, O_RDONLY);
+  if (file < 0) return false;
+  struct stat status;
+  if (fstat(file, &status) != 0 || status.st_size == 0 || status.st_size > 0xFFFFFFFF)
+  {
+    close(file);
+    return false;
+  }
+
+  // The mapping keeps the file open
+  void* data = mmap(nullptr, (size_t)status.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+  close(file);
+  if (data == MAP_FAILED) return false;
+  _data = (BYTE*)data;
+  _size = (DWORD)status.st_size;
+#endif
+  return true;
+}
+
+void FileMapping::Close()
+{
+  if (_data == nullptr) return;
+#ifdef _WIN32
+  UnmapViewOfFile(_data);
+#else
+  munmap(_data, _size);
+#endif
+  _data = nullptr;
+  _size = 0;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "PEFormat.h"
+
+// Private copy-on-write view of a file: the file is opened read-only, written pages are copied by the OS and never
+// reach the file. The view can be read by several threads at the same time.
+class FileMapping
+{
+public:
+  FileMapping();
+  ~FileMapping();
+
+  // False for empty files and files of 4 GB or more
+  bool Open(const char* fileName);
+  void Close();
+
+  BYTE* GetData() const { return _data; }
+  DWORD GetSize() const { return _size; }
+
+private:
+  BYTE* _data;
+  DWORD _size;
+};
@@ -1,75 +1,565 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include "PEFile.h"
+#include "../FileWriter/FileWriter.h"
+#include "../FileWriter/PatchWriter.h"
 
 PEFile::PEFile()
 {
-  _buffer = nullptr;
-  _bufferSize = 0;
-  _PIMAGE_DOS_HEADER = nullptr;
-  _PIMAGE_NT_HEADERS = nullptr;
-  _PIMAGE_SECTION_HEADER = nullptr;
+  _data = nullptr;
+  _dataSize = 0;
+  _size = 0;
+  _originalSize = 0;
+  _ntHeadersOffset = 0;
+  _sectionTableOffset = 0;
+  _is64Bit = false;
 }
 
 PEFile::~PEFile()
 {
-  DeleteBuffer();
 }
 
-bool PEFile::OpenFile(const char* fileName)
+bool PEFile::OpenFile(const char* fileName, LoadMode loadMode)
 {
-  DeleteBuffer();
-  HANDLE hFile = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_WRITE | FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-  if (hFile == INVALID_HANDLE_VALUE)
+  Close();
+  if (loadMode == LoadMode::Mapping)
   {
-    return false;
+    if (!_mapping.Open(fileName)) return false;
+    _data = _mapping.GetData();
+    _size = _mapping.GetSize();
+    _dataSize = _size;
+    _fileName = fileName;
   }
-  _bufferSize = GetFileSize(hFile, 0);
-  if (_bufferSize == 0)
+  else
   {
-    CloseHandle(hFile);
-    return false;
+    std::ifstream file(fileName, std::ios::in | std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+    {
+      return false;
+    }
+    const std::streamoff fileSize = file.tellg();
+    if (fileSize <= 0 || fileSize > 0xFFFFFFFF)
+    {
+      return false;
+    }
+    _buffer.resize((size_t)fileSize);
+    file.seekg(0);
+    if (!file.read((char*)_buffer.data(), fileSize))
+    {
+      Close();
+      return false;
+    }
+    _data = _buffer.data();
+    _size = (DWORD)fileSize;
+    _dataSize = _size;
   }
-  _buffer = new BYTE[_bufferSize];
-  if (_buffer == NULL)
+
+  _originalSize = _size;
+  if (!Validate())
   {
-    CloseHandle(hFile);
+    Close();
     return false;
   }
-  DWORD	bytesRead = 0;
-  if (!ReadFile(hFile, _buffer, _bufferSize, &bytesRead, NULL)) return false;
-  CloseHandle(hFile);
+  return true;
+}
+
+bool PEFile::SaveFile(const char* fileName) const
+{
+  // The file behind the mapping cannot be replaced or shrunk while it is mapped, only patched in place
+  std::error_code error;
+  if (IsMapped() && std::filesystem::equivalent(fileName, _fileName, error))
+  {
+    if (_size < _mapping.GetSize()) return false;
+    PatchWriter writer;
+    return writer.Open(fileName) && WritePatches(writer) && writer.Apply() && writer.Commit();
+  }
+
+  FileWriter writer;
+  return writer.Open(fileName) && Write(writer) && writer.Commit();
+}
+
+bool PEFile::Write(FileWriter& writer) const
+{
+  if (!writer.Write(_data, _dataSize)) return false;
+  return _tail.empty() || writer.Write(_tail.data(), (DWORD)_tail.size());
+}
+
+bool PEFile::WritePatches(PatchWriter& writer) const
+{
+  // Patch runs inside the part that still matches the file, followed by everything behind it as one run
+  CoalescePatches();
+  for (const PatchRun& patch : _patches)
+  {
+    writer.AddRun(patch.Offset, _data + patch.Offset, patch.Size);
+  }
+  if (_size > _originalSize)
+  {
+    const BYTE* appended = GetImagePointer(_originalSize, _size - _originalSize);
+    if (appended == nullptr) return false;
+    writer.AddRun(_originalSize, appended, _size - _originalSize);
+  }
+  writer.SetFileSize(_size);
+  return true;
+}
+
+DWORD PEFile::GetPatchSize() const
+{
+  CoalescePatches();
+  DWORD size = _size - _originalSize;
+  for (const PatchRun& patch : _patches) size += patch.Size;
+  return size;
+}
+
+void PEFile::Close()
+{
+  _mapping.Close();
+  _buffer.clear();
+  _buffer.shrink_to_fit();
+  _tail.clear();
+  _tail.shrink_to_fit();
+  _fileName.clear();
+  _patches.clear();
+  _patches.shrink_to_fit();
+  _data = nullptr;
+  _dataSize = 0;
+  _size = 0;
+  _originalSize = 0;
+  _ntHeadersOffset = 0;
+  _sectionTableOffset = 0;
+  _is64Bit = false;
+}
+
+ULONGLONG PEFile::GetImageBase() const
+{
+  return _is64Bit ? GetOptionalHeader64()->ImageBase : GetOptionalHeader()->ImageBase;
+}
+
+DWORD PEFile::GetEntryPoint() const
+{
+  return GetOptionalHeader()->AddressOfEntryPoint;
+}
+
+const PeSectionHeader* PEFile::GetSectionHeader(WORD index) const
+{
+  if (index >= GetSectionCount()) return nullptr;
+  return GetSectionTable() + index;
+}
+
+const PeSectionHeader* PEFile::FindSectionByName(const std::string& sectionName) const
+{
+  for (WORD i = 0; i < GetSectionCount(); i++)
+  {
+    const PeSectionHeader* sectionHeader = GetSectionHeader(i);
+    if (sectionName == GetSectionName(sectionHeader))
+    {
+      return sectionHeader;
+    }
+  }
+  return nullptr;
+}
+
+std::string PEFile::GetSectionName(const PeSectionHeader* sectionHeader)
+{
+  // The name is only null terminated if it is shorter than 8 characters
+  const BYTE* nameEnd = std::find(sectionHeader->Name, sectionHeader->Name + PE_SIZEOF_SHORT_NAME, 0);
+  return std::string((const char*)sectionHeader->Name, (const char*)nameEnd);
+}
+
+const PeSectionHeader* PEFile::FindSectionByRva(DWORD rva) const
+{
+  for (WORD i = 0; i < GetSectionCount(); i++)
+  {
+    const PeSectionHeader* sectionHeader = GetSectionHeader(i);
+    const DWORD size = std::max(sectionHeader->VirtualSize, sectionHeader->SizeOfRawData);
+    if (rva >= sectionHeader->VirtualAddress && rva - sectionHeader->VirtualAddress < size)
+    {
+      return sectionHeader;
+    }
+  }
+  return nullptr;
+}
 
-  Initialize();
+PeDataDirectory PEFile::GetDataDirectory(DWORD index) const
+{
+  PeDataDirectory directory = {};
+  if (index < GetDataDirectoryCount()) directory = GetDataDirectories()[index];
+  return directory;
+}
 
+bool PEFile::SetDataDirectory(DWORD index, DWORD rva, DWORD size)
+{
+  if (index >= GetDataDirectoryCount()) return false;
+  PeDataDirectory* directory = GetDataDirectories() + index;
+  directory->VirtualAddress = rva;
+  directory->Size = size;
+  MarkDirty((DWORD)((BYTE*)directory - _data), sizeof(PeDataDirectory));
   return true;
 }
 
-PIMAGE_SECTION_HEADER PEFile::FindSectionByName(const std::string& sectionName)
+DWORD PEFile::RvaToOffset(DWORD rva) const
+{
+  const PeSectionHeader* sectionHeader = GetSectionTable();
+  for (WORD i = 0; i < GetSectionCount(); i++, sectionHeader++)
+  {
+    if (rva >= sectionHeader->VirtualAddress && rva - sectionHeader->VirtualAddress < sectionHeader->SizeOfRawData)
+    {
+      return sectionHeader->PointerToRawData + (rva - sectionHeader->VirtualAddress);
+    }
+  }
+  return 0;
+}
+
+const BYTE* PEFile::GetRvaPointer(DWORD rva, DWORD size) const
 {
-  WORD sectionCount = NT_HEADERS()->FileHeader.NumberOfSections;
-  PIMAGE_SECTION_HEADER pSectionHeader = SECTION_HEADER();
-  for (int i = 0; i < sectionCount; i++, pSectionHeader++)
+  for (WORD i = 0; i < GetSectionCount(); i++)
   {
-    const char* section = (char*)pSectionHeader->Name;
-    if (sectionName.compare(section) == 0)
+    const PeSectionHeader* sectionHeader = GetSectionHeader(i);
+    if (rva < sectionHeader->VirtualAddress || rva - sectionHeader->VirtualAddress >= sectionHeader->SizeOfRawData) continue;
+
+    const DWORD sectionOffset = rva - sectionHeader->VirtualAddress;
+    if (size > sectionHeader->SizeOfRawData - sectionOffset) return nullptr;
+    return GetPointer(sectionHeader->PointerToRawData + sectionOffset, size);
+  }
+  return nullptr;
+}
+
+bool PEFile::GetRelocations(std::vector<DWORD>& rvas) const
+{
+  rvas.clear();
+  const PeDataDirectory directory = GetDataDirectory(PE_DIRECTORY_ENTRY_BASERELOC);
+  if (directory.VirtualAddress == 0 || directory.Size == 0) return true;
+  const BYTE* data = GetRvaPointer(directory.VirtualAddress, directory.Size);
+  if (data == nullptr) return false;
+
+  // Blocks of one 4 KiB page each: header followed by WORD entries, the upper 4 bits are the type
+  DWORD offset = 0;
+  while (directory.Size - offset >= sizeof(PeBaseRelocation))
+  {
+    const PeBaseRelocation* block = (const PeBaseRelocation*)(data + offset);
+    if (block->SizeOfBlock < sizeof(PeBaseRelocation) || block->SizeOfBlock > directory.Size - offset) return false;
+
+    const WORD* entries = (const WORD*)(block + 1);
+    const DWORD entryCount = (block->SizeOfBlock - sizeof(PeBaseRelocation)) / sizeof(WORD);
+    for (DWORD i = 0; i < entryCount; i++)
     {
-      return pSectionHeader;
+      const WORD type = entries[i] >> 12;
+      if (type == PE_REL_BASED_HIGHLOW || type == PE_REL_BASED_DIR64)
+      {
+        rvas.push_back(block->VirtualAddress + (entries[i] & 0x0FFF));
+      }
     }
+    offset += block->SizeOfBlock;
+  }
+
+  std::sort(rvas.begin(), rvas.end());
+  return true;
+}
+
+const PeSectionHeader* PEFile::AddSection(const char* name, DWORD size, DWORD characteristics)
+{
+  // The new header has to fit in front of the raw data of the first section
+  const WORD sectionCount = GetSectionCount();
+  const DWORD headersEnd = _sectionTableOffset + (sectionCount + 1) * sizeof(PeSectionHeader);
+  if (headersEnd > GetOptionalHeader()->SizeOfHeaders) return nullptr;
+  DWORD virtualEnd = 0;
+  for (WORD i = 0; i < sectionCount; i++)
+  {
+    const PeSectionHeader* sectionHeader = GetSectionHeader(i);
+    if (sectionHeader->SizeOfRawData != 0 && sectionHeader->PointerToRawData < headersEnd) return nullptr;
+    virtualEnd = std::max(virtualEnd, sectionHeader->VirtualAddress + std::max(sectionHeader->VirtualSize, sectionHeader->SizeOfRawData));
+  }
+
+  const DWORD fileAlignment = GetOptionalHeader()->FileAlignment;
+  const DWORD rawOffset = Align(GetRawDataEnd(), fileAlignment);
+  const DWORD rawSize = Align(size, fileAlignment);
+  Truncate(rawOffset);
+  Resize(rawOffset + rawSize);
+
+  PeSectionHeader* sectionHeader = GetSectionTable() + sectionCount;
+  memset(sectionHeader, 0, sizeof(PeSectionHeader));
+  for (DWORD i = 0; i < PE_SIZEOF_SHORT_NAME && name[i] != 0; i++) sectionHeader->Name[i] = name[i];
+  sectionHeader->VirtualSize = size;
+  sectionHeader->VirtualAddress = Align(std::max(virtualEnd, GetOptionalHeader()->SizeOfHeaders), GetOptionalHeader()->SectionAlignment);
+  sectionHeader->SizeOfRawData = rawSize;
+  sectionHeader->PointerToRawData = rawOffset;
+  sectionHeader->Characteristics = characteristics;
+  GetFileHeader()->NumberOfSections++;
+  MarkDirty(_ntHeadersOffset, headersEnd - _ntHeadersOffset);
+
+  if (characteristics & PE_SCN_CNT_INITIALIZED_DATA) GetOptionalHeader()->SizeOfInitializedData += rawSize;
+  UpdateSizeOfImage();
+  return sectionHeader;
+}
+
+bool PEFile::RemoveLastSection()
+{
+  const WORD sectionCount = GetSectionCount();
+  if (sectionCount == 0) return false;
+
+  PeSectionHeader* sectionHeader = GetSectionTable() + sectionCount - 1;
+  PeOptionalHeader32* optionalHeader = GetOptionalHeader();
+  if ((sectionHeader->Characteristics & PE_SCN_CNT_INITIALIZED_DATA) && optionalHeader->SizeOfInitializedData >= sectionHeader->SizeOfRawData)
+  {
+    optionalHeader->SizeOfInitializedData -= sectionHeader->SizeOfRawData;
+  }
+  memset(sectionHeader, 0, sizeof(PeSectionHeader));
+  GetFileHeader()->NumberOfSections--;
+  MarkDirty(_ntHeadersOffset, _sectionTableOffset + sectionCount * sizeof(PeSectionHeader) - _ntHeadersOffset);
+
+  Truncate(GetRawDataEnd());
+  UpdateSizeOfImage();
+  return true;
+}
+
+void PEFile::UpdateChecksum()
+{
+  // 16 bit one's complement sum of the file with the CheckSum field as zero, plus the file size
+  GetOptionalHeader()->CheckSum = 0;
+  ULONGLONG sum = AddToChecksum(0, _data, _dataSize, 0);
+  sum = AddToChecksum(sum, _tail.data(), (DWORD)_tail.size(), _dataSize);
+  GetOptionalHeader()->CheckSum = (DWORD)sum + _size;
+  MarkDirty((DWORD)((BYTE*)&GetOptionalHeader()->CheckSum - _data), sizeof(DWORD));
+}
+
+const BYTE* PEFile::GetPointer(DWORD offset, DWORD size) const
+{
+  return GetImagePointer(offset, size);
+}
+
+BYTE* PEFile::GetWritablePointer(DWORD offset, DWORD size)
+{
+  BYTE* pointer = GetImagePointer(offset, size);
+  if (pointer != nullptr) MarkDirty(offset, size);
+  return pointer;
+}
+
+DWORD PEFile::GetDirtyPageCount() const
+{
+  CoalescePatches();
+  DWORD count = 0;
+  DWORD nextPage = 0;
+  for (const PatchRun& patch : _patches)
+  {
+    // Neighbouring runs can share a page
+    const DWORD firstPage = std::max(patch.Offset / DIRTY_PAGE_SIZE, nextPage);
+    const DWORD endPage = (patch.Offset + patch.Size - 1) / DIRTY_PAGE_SIZE + 1;
+    if (endPage > firstPage) count += endPage - firstPage;
+    nextPage = std::max(nextPage, endPage);
+  }
+  return count;
+}
+
+bool PEFile::Validate()
+{
+  const ULONGLONG fileSize = _size;
+  if (fileSize < sizeof(PeDosHeader)) return false;
+  const PeDosHeader* dosHeader = (const PeDosHeader*)_data;
+  if (dosHeader->e_magic != PE_DOS_SIGNATURE || dosHeader->e_lfanew < (LONG)sizeof(PeDosHeader)) return false;
+
+  _ntHeadersOffset = (DWORD)dosHeader->e_lfanew;
+  const DWORD optionalHeaderOffset = _ntHeadersOffset + sizeof(DWORD) + sizeof(PeFileHeader);
+  if ((ULONGLONG)optionalHeaderOffset + sizeof(WORD) > fileSize) return false;
+  if (*(const DWORD*)(_data + _ntHeadersOffset) != PE_NT_SIGNATURE) return false;
+
+  const WORD magic = *(const WORD*)(_data + optionalHeaderOffset);
+  if (magic != PE_OPTIONAL_HEADER32_MAGIC && magic != PE_OPTIONAL_HEADER64_MAGIC) return false;
+  _is64Bit = magic == PE_OPTIONAL_HEADER64_MAGIC;
+
+  // The data directories are optional, everything in front of them is not
+  const PeFileHeader* fileHeader = GetFileHeader();
+  const DWORD minimumSize = _is64Bit ? offsetof(PeOptionalHeader64, DataDirectory) : offsetof(PeOptionalHeader32, DataDirectory);
+  if (fileHeader->SizeOfOptionalHeader < minimumSize) return false;
+  _sectionTableOffset = optionalHeaderOffset + fileHeader->SizeOfOptionalHeader;
+  if ((ULONGLONG)_sectionTableOffset + (ULONGLONG)fileHeader->NumberOfSections * sizeof(PeSectionHeader) > fileSize) return false;
+
+  const PeOptionalHeader32* optionalHeader = GetOptionalHeader();
+  const DWORD fileAlignment = optionalHeader->FileAlignment;
+  const DWORD sectionAlignment = optionalHeader->SectionAlignment;
+  if (fileAlignment == 0 || (fileAlignment & (fileAlignment - 1)) != 0) return false;
+  if (sectionAlignment == 0 || (sectionAlignment & (sectionAlignment - 1)) != 0) return false;
+
+  for (WORD i = 0; i < fileHeader->NumberOfSections; i++)
+  {
+    const PeSectionHeader* sectionHeader = GetSectionHeader(i);
+    if ((ULONGLONG)sectionHeader->PointerToRawData + sectionHeader->SizeOfRawData > fileSize) return false;
   }
+  return true;
+}
+
+PeSectionHeader* PEFile::GetSectionTable() const
+{
+  return (PeSectionHeader*)(_data + _sectionTableOffset);
+}
+
+BYTE* PEFile::GetImagePointer(DWORD offset, DWORD size) const
+{
+  if (offset > _size || size > _size - offset) return nullptr;
+  if (offset + size <= _dataSize) return _data + offset;
+  if (offset >= _dataSize) return _tail.data() + (offset - _dataSize);
   return nullptr;
 }
 
-void PEFile::DeleteBuffer()
+void PEFile::MarkDirty(DWORD offset, DWORD size)
+{
+  // Everything behind _originalSize is written as a whole anyway
+  if (size == 0 || offset >= _originalSize) return;
+  const DWORD end = std::min(offset + size, _originalSize);
+
+  // Patches mostly arrive in ascending order, merging them right away keeps the list short
+  if (!_patches.empty())
+  {
+    PatchRun& last = _patches.back();
+    if (offset <= last.Offset + last.Size + PATCH_GAP && end + PATCH_GAP >= last.Offset)
+    {
+      const DWORD lastEnd = std::max(last.Offset + last.Size, end);
+      last.Offset = std::min(last.Offset, offset);
+      last.Size = lastEnd - last.Offset;
+      return;
+    }
+  }
+  PatchRun patch;
+  patch.Offset = offset;
+  patch.Size = end - offset;
+  _patches.push_back(patch);
+}
+
+void PEFile::CoalescePatches() const
+{
+  std::sort(_patches.begin(), _patches.end(), [](const PatchRun& left, const PatchRun& right) { return left.Offset < right.Offset; });
+  size_t count = 0;
+  for (size_t i = 0; i < _patches.size(); i++)
+  {
+    // Clipped by a later truncation
+    PatchRun patch = _patches[i];
+    if (patch.Offset >= _originalSize) continue;
+    patch.Size = std::min(patch.Size, _originalSize - patch.Offset);
+
+    // Rewriting a few unchanged bytes is cheaper than another write call
+    if (count != 0 && patch.Offset <= _patches[count - 1].Offset + _patches[count - 1].Size + PATCH_GAP)
+    {
+      PatchRun& last = _patches[count - 1];
+      last.Size = std::max(last.Offset + last.Size, patch.Offset + patch.Size) - last.Offset;
+    }
+    else
+    {
+      _patches[count++] = patch;
+    }
+  }
+  _patches.resize(count);
+}
+
+void PEFile::Resize(DWORD size)
+{
+  // A mapping cannot grow: the image only uses a prefix of it and new bytes go to the tail
+  if (IsMapped())
+  {
+    if (size <= _dataSize)
+    {
+      _dataSize = size;
+      _tail.clear();
+    }
+    else
+    {
+      _tail.resize(size - _dataSize, 0);
+    }
+  }
+  else
+  {
+    _buffer.resize(size, 0);
+    _data = _buffer.data();
+    _dataSize = size;
+  }
+  _size = size;
+  _originalSize = std::min(_originalSize, size);
+}
+
+PeFileHeader* PEFile::GetFileHeader() const
+{
+  return (PeFileHeader*)(_data + _ntHeadersOffset + sizeof(DWORD));
+}
+
+PeOptionalHeader32* PEFile::GetOptionalHeader() const
+{
+  // Only ImageBase, the stack and heap sizes and the data directories differ between PE32 and PE32+; all other fields
+  // can be accessed through the PE32 layout
+  return (PeOptionalHeader32*)(GetFileHeader() + 1);
+}
+
+PeOptionalHeader64* PEFile::GetOptionalHeader64() const
+{
+  return (PeOptionalHeader64*)(GetFileHeader() + 1);
+}
+
+PeDataDirectory* PEFile::GetDataDirectories() const
 {
-  if (_buffer != nullptr)
+  return _is64Bit ? GetOptionalHeader64()->DataDirectory : GetOptionalHeader()->DataDirectory;
+}
+
+DWORD PEFile::GetDataDirectoryCount() const
+{
+  const DWORD headerSize = _is64Bit ? offsetof(PeOptionalHeader64, DataDirectory) : offsetof(PeOptionalHeader32, DataDirectory);
+  DWORD count = (GetFileHeader()->SizeOfOptionalHeader - headerSize) / sizeof(PeDataDirectory);
+  count = std::min(count, _is64Bit ? GetOptionalHeader64()->NumberOfRvaAndSizes : GetOptionalHeader()->NumberOfRvaAndSizes);
+  return std::min(count, (DWORD)PE_NUMBEROF_DIRECTORY_ENTRIES);
+}
+
+DWORD PEFile::GetRawDataEnd() const
+{
+  DWORD end = GetOptionalHeader()->SizeOfHeaders;
+  const PeSectionHeader* sectionHeader = GetSectionTable();
+  for (WORD i = 0; i < GetSectionCount(); i++, sectionHeader++)
+  {
+    if (sectionHeader->SizeOfRawData != 0) end = std::max(end, sectionHeader->PointerToRawData + sectionHeader->SizeOfRawData);
+  }
+  return end;
+}
+
+void PEFile::Truncate(DWORD size)
+{
+  // The certificate table is referenced by file offset and is always stored behind the sections
+  const PeDataDirectory security = GetDataDirectory(PE_DIRECTORY_ENTRY_SECURITY);
+  if (security.VirtualAddress != 0 && (ULONGLONG)security.VirtualAddress + security.Size > size)
+  {
+    SetDataDirectory(PE_DIRECTORY_ENTRY_SECURITY, 0, 0);
+  }
+  if (size != _size) Resize(size);
+}
+
+void PEFile::UpdateSizeOfImage()
+{
+  PeOptionalHeader32* optionalHeader = GetOptionalHeader();
+  DWORD end = optionalHeader->SizeOfHeaders;
+  for (WORD i = 0; i < GetSectionCount(); i++)
+  {
+    const PeSectionHeader* sectionHeader = GetSectionHeader(i);
+    const DWORD size = sectionHeader->VirtualSize != 0 ? sectionHeader->VirtualSize : sectionHeader->SizeOfRawData;
+    end = std::max(end, sectionHeader->VirtualAddress + size);
+  }
+  optionalHeader->SizeOfImage = Align(end, optionalHeader->SectionAlignment);
+}
+
+ULONGLONG PEFile::AddToChecksum(ULONGLONG sum, const BYTE* data, DWORD size, DWORD offset)
+{
+  // Bytes at even file offsets are the low halves of the words
+  DWORD i = 0;
+  if ((offset & 1) && size != 0)
   {
-    delete[] _buffer;
-    _buffer = nullptr;
+    sum += data[0] << 8;
+    i = 1;
   }
+  for (; i + 1 < size; i += 2)
+  {
+    sum += (WORD)(data[i] | (data[i + 1] << 8));
+    sum = (sum & 0xFFFF) + (sum >> 16);
+  }
+  if (i < size) sum += data[i];
+  sum = (sum & 0xFFFF) + (sum >> 16);
+  return (sum & 0xFFFF) + (sum >> 16);
 }
 
-void PEFile::Initialize()
+DWORD PEFile::Align(DWORD value, DWORD alignment)
 {
-  _PIMAGE_DOS_HEADER = (PIMAGE_DOS_HEADER)_buffer;
-  _PIMAGE_NT_HEADERS = (PIMAGE_NT_HEADERS)(_buffer + _PIMAGE_DOS_HEADER->e_lfanew);
-  _PIMAGE_SECTION_HEADER = IMAGE_FIRST_SECTION(_PIMAGE_NT_HEADERS);
-}
\ No newline at end of file
+  return (value + alignment - 1) & ~(alignment - 1);
+}
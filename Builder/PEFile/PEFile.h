@@ -1,33 +1,123 @@
 #pragma once
-#include <windows.h>
 #include <string>
+#include <vector>
+#include "FileMapping.h"
+#include "PEFormat.h"
 
+class FileWriter;
+class PatchWriter;
+
+enum class LoadMode
+{
+  Mapping,  // Copy-on-write view of the file, only the pages that are written to take memory
+  Buffer    // The whole file is read into memory
+};
+
+// PE32/PE32+ image loaded into memory. Every header, section and data directory is validated against the file size
+// when the file is opened, so the raw data of all sections can be accessed without further checks.
+// Changes go through GetWritablePointer, which records the written ranges as patch runs: saving a mapped image to its
+// own file only writes these runs back. Sections added to a mapped image are kept in memory behind the part of the mapping that is
+// still used, so the image is never copied as a whole.
 class PEFile
 {
 public:
   PEFile();
   ~PEFile();
 
-  bool OpenFile(const char* fileName);
+  // False if the file cannot be read or is not a well-formed PE32/PE32+ image
+  bool OpenFile(const char* fileName, LoadMode loadMode = LoadMode::Mapping);
+  // Saving a mapped image to its own file fails once its size changed; use Write and replace the file after Close
+  bool SaveFile(const char* fileName) const;
+  // Writes the whole image sequentially
+  bool Write(FileWriter& writer) const;
+  // Adds the patch runs and the data behind the end of the file to an in-place writer
+  bool WritePatches(PatchWriter& writer) const;
+  // Bytes WritePatches would write
+  DWORD GetPatchSize() const;
+  // Releases the image and the mapping; required before the file is rewritten by someone else
+  void Close();
+
+  bool Is64Bit() const { return _is64Bit; }
+  WORD GetMachine() const { return GetFileHeader()->Machine; }
+  ULONGLONG GetImageBase() const;
+  DWORD GetEntryPoint() const;
+
+  WORD GetSectionCount() const { return GetFileHeader()->NumberOfSections; }
+  const PeSectionHeader* GetSectionHeader(WORD index) const;
+  const PeSectionHeader* FindSectionByName(const std::string& sectionName) const;
+  const PeSectionHeader* FindSectionByRva(DWORD rva) const;
+  static std::string GetSectionName(const PeSectionHeader* sectionHeader);
+
+  // Zero if the directory is not present
+  PeDataDirectory GetDataDirectory(DWORD index) const;
+  bool SetDataDirectory(DWORD index, DWORD rva, DWORD size);
 
-  const PIMAGE_DOS_HEADER DOS_HEADER() { return _PIMAGE_DOS_HEADER; }
-  const PIMAGE_NT_HEADERS NT_HEADERS() { return _PIMAGE_NT_HEADERS; }
-  const PIMAGE_SECTION_HEADER SECTION_HEADER() { return _PIMAGE_SECTION_HEADER; }
+  // File offset of an RVA inside the raw data of a section, 0 if it is not backed by the file
+  DWORD RvaToOffset(DWORD rva) const;
+  // Pointer to size bytes at an RVA, nullptr unless all of them are backed by the raw data of one section
+  const BYTE* GetRvaPointer(DWORD rva, DWORD size) const;
 
-  PIMAGE_SECTION_HEADER FindSectionByName(const std::string& sectionName);
+  // Sorted RVAs of all HIGHLOW and DIR64 base relocations, false if the relocation directory is malformed
+  bool GetRelocations(std::vector<DWORD>& rvas) const;
 
-  DWORD GetBufferSize() { return _bufferSize; }
-  BYTE* GetBuffer() { return _buffer; }
+  // Appends a zero filled section behind the last one and updates SizeOfImage; data behind the raw data of the last
+  // section (overlay, certificates) is dropped. nullptr if the section table has no room for another header.
+  // Pointers into the image behind the new section are invalid afterwards.
+  const PeSectionHeader* AddSection(const char* name, DWORD size, DWORD characteristics);
+  // Removes the last section header together with its raw data
+  bool RemoveLastSection();
+  void UpdateChecksum();
+
+  DWORD GetBufferSize() const { return _size; }
+  // Pointer to size bytes at a file offset, nullptr if the range is outside of the image or spans the mapping and the
+  // added sections (the raw data of a section never does)
+  const BYTE* GetPointer(DWORD offset, DWORD size) const;
+  BYTE* GetWritablePointer(DWORD offset, DWORD size);
+
+  bool IsMapped() const { return _mapping.GetData() != nullptr; }
+  // Pages of DIRTY_PAGE_SIZE bytes touched by patch runs since the file was opened
+  DWORD GetDirtyPageCount() const;
 
 private:
-  void DeleteBuffer();
-  void Initialize();
+  bool Validate();
+  PeSectionHeader* GetSectionTable() const;
+  BYTE* GetImagePointer(DWORD offset, DWORD size) const;
+  void MarkDirty(DWORD offset, DWORD size);
+  void CoalescePatches() const;
+  void Resize(DWORD size);
+  PeFileHeader* GetFileHeader() const;
+  PeOptionalHeader32* GetOptionalHeader() const;
+  PeOptionalHeader64* GetOptionalHeader64() const;
+  PeDataDirectory* GetDataDirectories() const;
+  DWORD GetDataDirectoryCount() const;
+  DWORD GetRawDataEnd() const;
+  void Truncate(DWORD size);
+  void UpdateSizeOfImage();
+  static ULONGLONG AddToChecksum(ULONGLONG sum, const BYTE* data, DWORD size, DWORD offset);
+  static DWORD Align(DWORD value, DWORD alignment);
+
+public:
+  static const DWORD DIRTY_PAGE_SIZE = 4096;
 
 private:
-  BYTE* _buffer;
-  DWORD _bufferSize;
+  struct PatchRun
+  {
+    DWORD Offset;
+    DWORD Size;
+  };
+
+  static const DWORD PATCH_GAP = 64;      // Runs closer than this are merged
 
-  PIMAGE_DOS_HEADER _PIMAGE_DOS_HEADER;
-  PIMAGE_NT_HEADERS _PIMAGE_NT_HEADERS;
-  PIMAGE_SECTION_HEADER _PIMAGE_SECTION_HEADER;
-};
\ No newline at end of file
+  BYTE* _data;                    // Mapping or buffer
+  DWORD _dataSize;                // Bytes of _data that belong to the image, _tail follows them
+  mutable std::vector<BYTE> _tail;
+  DWORD _size;
+  FileMapping _mapping;
+  std::vector<BYTE> _buffer;
+  std::string _fileName;          // Of the mapped file
+  DWORD _originalSize;            // Bytes at the start of the image that match the file apart from the patch runs
+  mutable std::vector<PatchRun> _patches;
+  DWORD _ntHeadersOffset;
+  DWORD _sectionTableOffset;
+  bool _is64Bit;
+};
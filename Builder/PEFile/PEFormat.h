@@ -0,0 +1,226 @@
+#pragma once
+// Fixed-layout PE32/PE32+ structures and constants of the Builder, independent of <windows.h> so that the Builder
+// also builds on Linux. The names follow the IMAGE_* definitions of winnt.h with a Pe/PE_ prefix.
+#include <cstddef>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef int32_t LONG;
+typedef uint64_t ULONGLONG;
+typedef int64_t LONGLONG;
+typedef uintptr_t DWORD_PTR;
+#endif
+
+#define PE_DOS_SIGNATURE 0x5A4D             // MZ
+#define PE_NT_SIGNATURE 0x00004550          // PE00
+#define PE_OPTIONAL_HEADER32_MAGIC 0x10B
+#define PE_OPTIONAL_HEADER64_MAGIC 0x20B
+#define PE_MACHINE_I386 0x014C
+#define PE_MACHINE_AMD64 0x8664
+#define PE_NUMBEROF_DIRECTORY_ENTRIES 16
+#define PE_SIZEOF_SHORT_NAME 8
+
+#define PE_FILE_RELOCS_STRIPPED 0x0001
+#define PE_FILE_EXECUTABLE_IMAGE 0x0002
+#define PE_FILE_LARGE_ADDRESS_AWARE 0x0020
+#define PE_FILE_32BIT_MACHINE 0x0100
+#define PE_SUBSYSTEM_WINDOWS_CUI 3
+
+#define PE_DIRECTORY_ENTRY_RESOURCE 2
+#define PE_DIRECTORY_ENTRY_EXCEPTION 3
+#define PE_DIRECTORY_ENTRY_SECURITY 4
+#define PE_DIRECTORY_ENTRY_BASERELOC 5
+
+#define PE_SCN_CNT_CODE 0x00000020
+#define PE_SCN_CNT_INITIALIZED_DATA 0x00000040
+#define PE_SCN_MEM_DISCARDABLE 0x02000000
+#define PE_SCN_MEM_EXECUTE 0x20000000
+#define PE_SCN_MEM_READ 0x40000000
+#define PE_SCN_MEM_WRITE 0x80000000
+
+#define PE_REL_BASED_ABSOLUTE 0
+#define PE_REL_BASED_HIGHLOW 3
+#define PE_REL_BASED_DIR64 10
+
+#define PE_RESOURCE_NAME_IS_STRING 0x80000000
+#define PE_RESOURCE_DATA_IS_DIRECTORY 0x80000000
+#define PE_RT_RCDATA 10
+#define PE_LANG_NEUTRAL 0
+
+#pragma pack(push, 4)
+
+struct PeDosHeader
+{
+  WORD e_magic;
+  WORD e_cblp;
+  WORD e_cp;
+  WORD e_crlc;
+  WORD e_cparhdr;
+  WORD e_minalloc;
+  WORD e_maxalloc;
+  WORD e_ss;
+  WORD e_sp;
+  WORD e_csum;
+  WORD e_ip;
+  WORD e_cs;
+  WORD e_lfarlc;
+  WORD e_ovno;
+  WORD e_res[4];
+  WORD e_oemid;
+  WORD e_oeminfo;
+  WORD e_res2[10];
+  LONG e_lfanew;        // File offset of the NT headers
+};
+
+struct PeFileHeader
+{
+  WORD Machine;
+  WORD NumberOfSections;
+  DWORD TimeDateStamp;
+  DWORD PointerToSymbolTable;
+  DWORD NumberOfSymbols;
+  WORD SizeOfOptionalHeader;
+  WORD Characteristics;
+};
+
+struct PeDataDirectory
+{
+  DWORD VirtualAddress;
+  DWORD Size;
+};
+
+struct PeOptionalHeader32
+{
+  WORD Magic;
+  BYTE MajorLinkerVersion;
+  BYTE MinorLinkerVersion;
+  DWORD SizeOfCode;
+  DWORD SizeOfInitializedData;
+  DWORD SizeOfUninitializedData;
+  DWORD AddressOfEntryPoint;
+  DWORD BaseOfCode;
+  DWORD BaseOfData;
+  DWORD ImageBase;
+  DWORD SectionAlignment;
+  DWORD FileAlignment;
+  WORD MajorOperatingSystemVersion;
+  WORD MinorOperatingSystemVersion;
+  WORD MajorImageVersion;
+  WORD MinorImageVersion;
+  WORD MajorSubsystemVersion;
+  WORD MinorSubsystemVersion;
+  DWORD Win32VersionValue;
+  DWORD SizeOfImage;
+  DWORD SizeOfHeaders;
+  DWORD CheckSum;
+  WORD Subsystem;
+  WORD DllCharacteristics;
+  DWORD SizeOfStackReserve;
+  DWORD SizeOfStackCommit;
+  DWORD SizeOfHeapReserve;
+  DWORD SizeOfHeapCommit;
+  DWORD LoaderFlags;
+  DWORD NumberOfRvaAndSizes;
+  PeDataDirectory DataDirectory[PE_NUMBEROF_DIRECTORY_ENTRIES];
+};
+
+struct PeOptionalHeader64
+{
+  WORD Magic;
+  BYTE MajorLinkerVersion;
+  BYTE MinorLinkerVersion;
+  DWORD SizeOfCode;
+  DWORD SizeOfInitializedData;
+  DWORD SizeOfUninitializedData;
+  DWORD AddressOfEntryPoint;
+  DWORD BaseOfCode;
+  ULONGLONG ImageBase;
+  DWORD SectionAlignment;
+  DWORD FileAlignment;
+  WORD MajorOperatingSystemVersion;
+  WORD MinorOperatingSystemVersion;
+  WORD MajorImageVersion;
+  WORD MinorImageVersion;
+  WORD MajorSubsystemVersion;
+  WORD MinorSubsystemVersion;
+  DWORD Win32VersionValue;
+  DWORD SizeOfImage;
+  DWORD SizeOfHeaders;
+  DWORD CheckSum;
+  WORD Subsystem;
+  WORD DllCharacteristics;
+  ULONGLONG SizeOfStackReserve;
+  ULONGLONG SizeOfStackCommit;
+  ULONGLONG SizeOfHeapReserve;
+  ULONGLONG SizeOfHeapCommit;
+  DWORD LoaderFlags;
+  DWORD NumberOfRvaAndSizes;
+  PeDataDirectory DataDirectory[PE_NUMBEROF_DIRECTORY_ENTRIES];
+};
+
+struct PeSectionHeader
+{
+  BYTE Name[PE_SIZEOF_SHORT_NAME];  // Not null terminated if all 8 bytes are used
+  DWORD VirtualSize;
+  DWORD VirtualAddress;
+  DWORD SizeOfRawData;
+  DWORD PointerToRawData;
+  DWORD PointerToRelocations;
+  DWORD PointerToLinenumbers;
+  WORD NumberOfRelocations;
+  WORD NumberOfLinenumbers;
+  DWORD Characteristics;
+};
+
+struct PeRuntimeFunction   // x64 exception directory (.pdata)
+{
+  DWORD BeginAddress;
+  DWORD EndAddress;
+  DWORD UnwindInfoAddress;
+};
+
+struct PeBaseRelocation    // Followed by (SizeOfBlock - 8) / 2 WORD entries: type << 12 | page offset
+{
+  DWORD VirtualAddress;
+  DWORD SizeOfBlock;
+};
+
+struct PeResourceDirectory // Followed by the named entries, then the ID entries
+{
+  DWORD Characteristics;
+  DWORD TimeDateStamp;
+  WORD MajorVersion;
+  WORD MinorVersion;
+  WORD NumberOfNamedEntries;
+  WORD NumberOfIdEntries;
+};
+
+struct PeResourceDirectoryEntry
+{
+  DWORD Name;          // ID, or PE_RESOURCE_NAME_IS_STRING | offset of a length prefixed UTF-16 string
+  DWORD OffsetToData;  // PE_RESOURCE_DATA_IS_DIRECTORY | offset of a directory, or offset of a PeResourceDataEntry
+};
+
+struct PeResourceDataEntry
+{
+  DWORD OffsetToData;  // RVA of the data
+  DWORD Size;
+  DWORD CodePage;
+  DWORD Reserved;
+};
+
+#pragma pack(pop)
+
+static_assert(sizeof(PeDosHeader) == 64, "PeDosHeader");
+static_assert(sizeof(PeFileHeader) == 20, "PeFileHeader");
+static_assert(sizeof(PeOptionalHeader32) == 224, "PeOptionalHeader32");
+static_assert(sizeof(PeOptionalHeader64) == 240, "PeOptionalHeader64");
+static_assert(sizeof(PeSectionHeader) == 40, "PeSectionHeader");
+static_assert(sizeof(PeRuntimeFunction) == 12, "PeRuntimeFunction");
+static_assert(sizeof(PeResourceDirectory) == 16, "PeResourceDirectory");
+static_assert(sizeof(PeResourceDataEntry) == 16, "PeResourceDataEntry");
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cstring>
 #include "ResourceAdder.h"
 
 ResourceAdder::ResourceAdder()
@@ -10,17 +12,227 @@ ResourceAdder::~ResourceAdder()
 
 bool ResourceAdder::AddResource(const char* fileName, WORD resourceId, BYTE* buffer, DWORD bufferSize)
 {
-  HANDLE updateHandle = BeginUpdateResourceA(fileName, FALSE);
-  BOOL result = UpdateResourceW(updateHandle, RT_RCDATA, MAKEINTRESOURCE(resourceId), MAKELANGID(LANG_NEUTRAL, SUBLANG_NEUTRAL), buffer, bufferSize);
-  EndUpdateResource(updateHandle, FALSE);
-  if (!result)
+  // The file is replaced after the image has been read into memory
+  PEFile peFile;
+  if (!peFile.OpenFile(fileName, LoadMode::Buffer)) return false;
+  if (!AddResource(peFile, resourceId, buffer, bufferSize)) return false;
+  return peFile.SaveFile(fileName);
+}
+
+bool ResourceAdder::AddResource(PEFile& peFile, WORD resourceId, const BYTE* buffer, DWORD bufferSize)
+{
+  return AddResources(peFile, { { resourceId, buffer, bufferSize } });
+}
+
+bool ResourceAdder::AddResources(PEFile& peFile, const std::vector<Resource>& resources)
+{
+  ResourceNode root = {};
+  const PeDataDirectory directory = peFile.GetDataDirectory(PE_DIRECTORY_ENTRY_RESOURCE);
+  if (directory.VirtualAddress != 0 && directory.Size != 0)
+  {
+    const BYTE* resources = peFile.GetRvaPointer(directory.VirtualAddress, directory.Size);
+    if (resources == nullptr || !ReadDirectory(peFile, resources, directory.Size, 0, 0, root)) return false;
+  }
+
+  for (const Resource& resource : resources)
+  {
+    // Children are vectors, the references are taken again for every resource
+    ResourceNode& type = FindOrAddChild(root, PE_RT_RCDATA);
+    ResourceNode& name = FindOrAddChild(type, resource.Id);
+    ResourceNode& language = FindOrAddChild(name, PE_LANG_NEUTRAL);
+    language.IsData = true;
+    language.Data.assign(resource.Buffer, resource.Buffer + resource.Size);
+    language.CodePage = 0;
+  }
+
+  return WriteSection(peFile, root);
+}
+
+bool ResourceAdder::ReadDirectory(PEFile& peFile, const BYTE* resources, DWORD resourcesSize, DWORD offset, DWORD depth, ResourceNode& outNode) const
+{
+  if (resourcesSize < sizeof(PeResourceDirectory) || offset > resourcesSize - sizeof(PeResourceDirectory)) return false;
+  const PeResourceDirectory* directory = (const PeResourceDirectory*)(resources + offset);
+  const DWORD entryCount = directory->NumberOfNamedEntries + directory->NumberOfIdEntries;
+  if (entryCount * sizeof(PeResourceDirectoryEntry) > resourcesSize - offset - sizeof(PeResourceDirectory)) return false;
+  outNode.Directory = *directory;
+  outNode.IsData = false;
+
+  const PeResourceDirectoryEntry* entries = (const PeResourceDirectoryEntry*)(directory + 1);
+  for (DWORD i = 0; i < entryCount; i++)
+  {
+    const PeResourceDirectoryEntry& entry = entries[i];
+    ResourceNode child = {};
+    if (entry.Name & PE_RESOURCE_NAME_IS_STRING)
+    {
+      const DWORD nameOffset = entry.Name & ~PE_RESOURCE_NAME_IS_STRING;
+      if (nameOffset > resourcesSize - sizeof(WORD)) return false;
+      const WORD length = *(const WORD*)(resources + nameOffset);
+      if (length * sizeof(WORD) > resourcesSize - nameOffset - sizeof(WORD)) return false;
+      const WORD* name = (const WORD*)(resources + nameOffset + sizeof(WORD));
+      child.Name.assign(name, name + length);
+    }
+    else
+    {
+      child.Id = entry.Name;
+    }
+
+    // Type and name entries point to directories, language entries to data; this also stops cycles
+    const bool isDirectory = (entry.OffsetToData & PE_RESOURCE_DATA_IS_DIRECTORY) != 0;
+    if (isDirectory != (depth + 1 < MAX_DEPTH)) return false;
+    if (isDirectory)
+    {
+      if (!ReadDirectory(peFile, resources, resourcesSize, entry.OffsetToData & ~PE_RESOURCE_DATA_IS_DIRECTORY, depth + 1, child)) return false;
+    }
+    else
+    {
+      if (resourcesSize < sizeof(PeResourceDataEntry) || entry.OffsetToData > resourcesSize - sizeof(PeResourceDataEntry)) return false;
+      const PeResourceDataEntry* dataEntry = (const PeResourceDataEntry*)(resources + entry.OffsetToData);
+      const BYTE* data = peFile.GetRvaPointer(dataEntry->OffsetToData, dataEntry->Size);
+      if (data == nullptr && dataEntry->Size != 0) return false;
+      child.IsData = true;
+      child.Data.assign(data, data + dataEntry->Size);
+      child.CodePage = dataEntry->CodePage;
+    }
+    outNode.Children.push_back(child);
+  }
+  return true;
+}
+
+ResourceAdder::ResourceNode& ResourceAdder::FindOrAddChild(ResourceNode& node, DWORD id) const
+{
+  // Named entries come first, then the ID entries in ascending order
+  auto position = node.Children.begin();
+  while (position != node.Children.end() && (!position->Name.empty() || position->Id < id)) ++position;
+  if (position != node.Children.end() && position->Id == id) return *position;
+
+  ResourceNode child = {};
+  child.Id = id;
+  return *node.Children.insert(position, child);
+}
+
+void ResourceAdder::Measure(const ResourceNode& node, Layout& layout) const
+{
+  layout.Directories += sizeof(PeResourceDirectory) + (DWORD)node.Children.size() * sizeof(PeResourceDirectoryEntry);
+  for (const ResourceNode& child : node.Children)
   {
-    EndUpdateResourceA(updateHandle, TRUE);
-    return false;
+    if (!child.Name.empty()) layout.Names += (DWORD)(child.Name.size() + 1) * sizeof(WORD);
+    if (child.IsData)
+    {
+      layout.DataEntries += sizeof(PeResourceDataEntry);
+      layout.Data += Align((DWORD)child.Data.size(), DATA_ALIGNMENT);
+    }
+    else
+    {
+      Measure(child, layout);
+    }
   }
-  if (!EndUpdateResourceA(updateHandle, FALSE))
+}
+
+void ResourceAdder::WriteDirectory(const ResourceNode& node, BYTE* output, DWORD sectionRva, DWORD offset, Layout& next) const
+{
+  PeResourceDirectory* directory = (PeResourceDirectory*)(output + offset);
+  *directory = node.Directory;
+  directory->NumberOfNamedEntries = 0;
+  directory->NumberOfIdEntries = 0;
+
+  PeResourceDirectoryEntry* entry = (PeResourceDirectoryEntry*)(directory + 1);
+  for (const ResourceNode& child : node.Children)
+  {
+    if (child.Name.empty())
+    {
+      entry->Name = child.Id;
+      directory->NumberOfIdEntries++;
+    }
+    else
+    {
+      // Length prefixed, not null terminated
+      entry->Name = PE_RESOURCE_NAME_IS_STRING | next.Names;
+      *(WORD*)(output + next.Names) = (WORD)child.Name.size();
+      memcpy(output + next.Names + sizeof(WORD), child.Name.data(), child.Name.size() * sizeof(WORD));
+      next.Names += (DWORD)(child.Name.size() + 1) * sizeof(WORD);
+      directory->NumberOfNamedEntries++;
+    }
+
+    if (child.IsData)
+    {
+      PeResourceDataEntry* dataEntry = (PeResourceDataEntry*)(output + next.DataEntries);
+      dataEntry->OffsetToData = sectionRva + next.Data;
+      dataEntry->Size = (DWORD)child.Data.size();
+      dataEntry->CodePage = child.CodePage;
+      dataEntry->Reserved = 0;
+      if (!child.Data.empty()) memcpy(output + next.Data, child.Data.data(), child.Data.size());
+      entry->OffsetToData = next.DataEntries;
+      next.DataEntries += sizeof(PeResourceDataEntry);
+      next.Data += Align((DWORD)child.Data.size(), DATA_ALIGNMENT);
+    }
+    else
+    {
+      const DWORD childOffset = next.Directories;
+      next.Directories += sizeof(PeResourceDirectory) + (DWORD)child.Children.size() * sizeof(PeResourceDirectoryEntry);
+      entry->OffsetToData = PE_RESOURCE_DATA_IS_DIRECTORY | childOffset;
+      WriteDirectory(child, output, sectionRva, childOffset, next);
+    }
+    entry++;
+  }
+}
+
+bool ResourceAdder::WriteSection(PEFile& peFile, const ResourceNode& root)
+{
+  Layout size = {};
+  Measure(root, size);
+  Layout next;
+  next.Directories = sizeof(PeResourceDirectory) + (DWORD)root.Children.size() * sizeof(PeResourceDirectoryEntry);
+  next.Names = size.Directories;
+  next.DataEntries = Align(next.Names + size.Names, sizeof(DWORD));
+  next.Data = Align(next.DataEntries + size.DataEntries, DATA_ALIGNMENT);
+  const DWORD sectionSize = next.Data + size.Data;
+
+  // A trailing .reloc section is moved behind the new section; its blocks only contain the RVAs of other sections
+  const PeDataDirectory relocations = peFile.GetDataDirectory(PE_DIRECTORY_ENTRY_BASERELOC);
+  const PeSectionHeader* lastSection = peFile.GetSectionHeader(peFile.GetSectionCount() - 1);
+  PeSectionHeader relocationSection = {};
+  std::vector<BYTE> relocationData;
+  const bool moveRelocations = lastSection != nullptr && relocations.VirtualAddress != 0 && peFile.FindSectionByRva(relocations.VirtualAddress) == lastSection;
+  if (moveRelocations)
   {
-    return false;
+    relocationSection = *lastSection;
+    const BYTE* data = peFile.GetPointer(lastSection->PointerToRawData, lastSection->SizeOfRawData);
+    relocationData.assign(data, data + lastSection->SizeOfRawData);
+    peFile.RemoveLastSection();
   }
+
+  // The old resource section is replaced if it is the last one now, otherwise it stays unused
+  const PeDataDirectory resources = peFile.GetDataDirectory(PE_DIRECTORY_ENTRY_RESOURCE);
+  lastSection = peFile.GetSectionHeader(peFile.GetSectionCount() - 1);
+  if (lastSection != nullptr && resources.VirtualAddress != 0 && peFile.FindSectionByRva(resources.VirtualAddress) == lastSection)
+  {
+    peFile.RemoveLastSection();
+  }
+  const char* sectionName = peFile.FindSectionByName(".rsrc") == nullptr ? ".rsrc" : ".rsrc2";
+
+  const PeSectionHeader* sectionHeader = peFile.AddSection(sectionName, sectionSize, PE_SCN_CNT_INITIALIZED_DATA | PE_SCN_MEM_READ);
+  if (sectionHeader == nullptr) return false;
+  const DWORD sectionRva = sectionHeader->VirtualAddress;
+  WriteDirectory(root, peFile.GetWritablePointer(sectionHeader->PointerToRawData, sectionSize), sectionRva, 0, next);
+  peFile.SetDataDirectory(PE_DIRECTORY_ENTRY_RESOURCE, sectionRva, sectionSize);
+
+  if (moveRelocations)
+  {
+    char name[PE_SIZEOF_SHORT_NAME + 1] = {};
+    memcpy(name, relocationSection.Name, PE_SIZEOF_SHORT_NAME);
+    const DWORD virtualSize = relocationSection.VirtualSize != 0 ? relocationSection.VirtualSize : relocationSection.SizeOfRawData;
+    sectionHeader = peFile.AddSection(name, virtualSize, relocationSection.Characteristics);
+    if (sectionHeader == nullptr) return false;
+    const DWORD copySize = std::min((DWORD)relocationData.size(), virtualSize);
+    memcpy(peFile.GetWritablePointer(sectionHeader->PointerToRawData, copySize), relocationData.data(), copySize);
+    peFile.SetDataDirectory(PE_DIRECTORY_ENTRY_BASERELOC, sectionHeader->VirtualAddress + (relocations.VirtualAddress - relocationSection.VirtualAddress), relocations.Size);
+  }
+
+  peFile.UpdateChecksum();
   return true;
-}
\ No newline at end of file
+}
+
+DWORD ResourceAdder::Align(DWORD value, DWORD alignment)
+{
+  return (value + alignment - 1) & ~(alignment - 1);
+}
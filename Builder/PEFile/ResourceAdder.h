@@ -1,12 +1,57 @@
 #pragma once
-#include <Windows.h>
+#include <vector>
+#include "PEFile.h"
 
+// Adds or replaces an RT_RCDATA resource (language neutral) without the Win32 resource update API: the resource tree
+// is read, changed in memory and written into a new resource section.
 class ResourceAdder
 {
 public:
+  struct Resource
+  {
+    WORD Id;
+    const BYTE* Buffer;
+    DWORD Size;
+  };
+
   ResourceAdder();
   ~ResourceAdder();
 
   bool AddResource(const char* fileName, WORD resourceId, BYTE* buffer, DWORD bufferSize);
+  bool AddResource(PEFile& peFile, WORD resourceId, const BYTE* buffer, DWORD bufferSize);
+  // All resources end up in one new resource section
+  bool AddResources(PEFile& peFile, const std::vector<Resource>& resources);
+
+private:
+  // Directory or, on the language level, data entry of the resource tree
+  struct ResourceNode
+  {
+    DWORD Id;
+    std::vector<WORD> Name;       // UTF-16 name without length prefix, empty for ID entries
+    PeResourceDirectory Directory;
+    std::vector<ResourceNode> Children;
+    bool IsData;
+    std::vector<BYTE> Data;
+    DWORD CodePage;
+  };
+
+  // Sizes of the four areas of the section when measuring, next write positions when writing
+  struct Layout
+  {
+    DWORD Directories;
+    DWORD Names;
+    DWORD DataEntries;
+    DWORD Data;
+  };
+
+  bool ReadDirectory(PEFile& peFile, const BYTE* resources, DWORD resourcesSize, DWORD offset, DWORD depth, ResourceNode& outNode) const;
+  ResourceNode& FindOrAddChild(ResourceNode& node, DWORD id) const;
+  void Measure(const ResourceNode& node, Layout& layout) const;
+  void WriteDirectory(const ResourceNode& node, BYTE* output, DWORD sectionRva, DWORD offset, Layout& next) const;
+  bool WriteSection(PEFile& peFile, const ResourceNode& root);
+  static DWORD Align(DWORD value, DWORD alignment);
 
-};
\ No newline at end of file
+private:
+  static const DWORD MAX_DEPTH = 3;       // Type, name, language
+  static const DWORD DATA_ALIGNMENT = 8;
+};
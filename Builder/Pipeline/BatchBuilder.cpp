@@ -0,0 +1,213 @@
+#include <stdlib.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include "BatchBuilder.h"
+#include "../Nanomites/RandomGenerator.h"
+
+BatchBuilder::BatchBuilder()
+{
+  _sectionNames.push_back(".nano");
+  _loadMode = LoadMode::Mapping;
+  _writeMode = WriteMode::Replace;
+  _threadCount = 0;
+  _ioThreadCount = 2;
+  _analysisThreadCount = 1;
+  _memoryBudget = 1024ULL * 1024 * 1024;
+  _cache = nullptr;
+  _seed = RandomGenerator::CreateSeed();
+  _policy = nullptr;
+  _costModel = nullptr;
+  _nextRead = 0;
+  _activeIo = 0;
+  _jobsInFlight = 0;
+  _bytesInFlight = 0;
+  _peakBytesInFlight = 0;
+}
+
+BatchBuilder::~BatchBuilder()
+{
+}
+
+bool BatchBuilder::Run(const std::vector<std::string>& fileNames)
+{
+  _fileNames = fileNames;
+  _jobs.clear();
+  _jobs.resize(fileNames.size());
+  _results.assign(fileNames.size(), BatchResult());
+  _profiler = PhaseProfiler();
+  _nextRead = 0;
+  _protectQueue.clear();
+  _writeQueue.clear();
+  _activeIo = 0;
+  _jobsInFlight = 0;
+  _bytesInFlight = 0;
+  _peakBytesInFlight = 0;
+  if (fileNames.empty()) return true;
+
+  DWORD threadCount = _threadCount != 0 ? _threadCount : std::thread::hardware_concurrency();
+  if (threadCount == 0) threadCount = 1;
+  if (threadCount > fileNames.size()) threadCount = (DWORD)fileNames.size();
+  // A single file gets all cores for its analysis, many files get one core each
+  _analysisThreadCount = std::max<DWORD>(1, (_threadCount != 0 ? _threadCount : std::thread::hardware_concurrency()) / threadCount);
+
+  std::vector<std::thread> threads;
+  for (DWORD t = 1; t < threadCount; t++)
+  {
+    threads.emplace_back(&BatchBuilder::Work, this);
+  }
+  Work();
+  for (auto& thread : threads) thread.join();
+
+  for (const auto& result : _results)
+  {
+    if (result.Status != BatchStatus::Succeeded) return false;
+  }
+  return true;
+}
+
+void BatchBuilder::Work()
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (true)
+  {
+    Stage stage;
+    size_t index;
+    if (TakeTask(stage, index))
+    {
+      lock.unlock();
+      const bool result = Execute(stage, index);
+      lock.lock();
+
+      if (stage != Stage::Protect) _activeIo--;
+      if (result && stage == Stage::Read) _protectQueue.push_back(index);
+      else if (result && stage == Stage::Protect) _writeQueue.push_back(index);
+      else
+      {
+        // Failed or written: the image is gone, its memory and the slot are free for the next file
+        _jobsInFlight--;
+        _bytesInFlight -= _jobs[index].Size;
+        BatchStatus status = BatchStatus::Succeeded;
+        if (!result && stage == Stage::Read) status = BatchStatus::ReadFailed;
+        else if (!result && stage == Stage::Protect) status = BatchStatus::ProtectFailed;
+        else if (!result) status = BatchStatus::WriteFailed;
+        Finish(index, status);
+      }
+      _condition.notify_all();
+      continue;
+    }
+
+    if (_nextRead == _fileNames.size() && _jobsInFlight == 0) break;
+    _condition.wait(lock);
+  }
+}
+
+bool BatchBuilder::TakeTask(Stage& stage, size_t& index)
+{
+  // Later stages first: writing releases memory, protecting makes a file ready for writing
+  if (!_writeQueue.empty() && _activeIo < _ioThreadCount)
+  {
+    stage = Stage::Write;
+    index = _writeQueue.front();
+    _writeQueue.pop_front();
+    _activeIo++;
+    return true;
+  }
+  if (!_protectQueue.empty())
+  {
+    stage = Stage::Protect;
+    index = _protectQueue.front();
+    _protectQueue.pop_front();
+    return true;
+  }
+  if (_nextRead < _fileNames.size() && _activeIo < _ioThreadCount)
+  {
+    // Missing files cost nothing, their read fails right away
+    std::error_code error;
+    const ULONGLONG size = std::filesystem::file_size(_fileNames[_nextRead], error);
+    const ULONGLONG charge = error ? 0 : size;
+    if (_jobsInFlight != 0 && _bytesInFlight + charge > _memoryBudget) return false;
+
+    stage = Stage::Read;
+    index = _nextRead++;
+    _jobs[index].Size = charge;
+    _bytesInFlight += charge;
+    _peakBytesInFlight = std::max(_peakBytesInFlight, _bytesInFlight);
+    _jobsInFlight++;
+    _activeIo++;
+    return true;
+  }
+  return false;
+}
+
+bool BatchBuilder::Execute(Stage stage, size_t index)
+{
+  Job& job = _jobs[index];
+  BatchResult& result = _results[index];
+  if (stage == Stage::Read)
+  {
+    job.Start = std::chrono::steady_clock::now();
+    result.FileName = _fileNames[index];
+
+    // Optional exclusion list written by Nanoprof
+    std::set<DWORD> excludedRvas;
+    ReadExcludedRvas(_fileNames[index] + ".exclude", excludedRvas);
+
+    job.Pipeline.reset(new BuildPipeline());
+    job.Pipeline->SetExcludedRvas(excludedRvas);
+    job.Pipeline->SetPhaseProfiler(&job.Profiler);
+    job.Pipeline->SetLoadMode(_loadMode);
+    job.Pipeline->SetWriteMode(_writeMode);
+    job.Pipeline->SetThreadCount(_analysisThreadCount);
+    job.Pipeline->SetAnalysisCache(_cache);
+    job.Pipeline->SetSeed(_seed);
+    job.Pipeline->SetDensityPolicy(_policy);
+    job.Pipeline->SetCostModel(_costModel);
+    return job.Pipeline->Load(_fileNames[index].c_str());
+  }
+  if (stage == Stage::Protect)
+  {
+    return job.Pipeline->Protect(_sectionNames);
+  }
+  return job.Pipeline->Save();
+}
+
+void BatchBuilder::Finish(size_t index, BatchStatus status)
+{
+  Job& job = _jobs[index];
+  BatchResult& result = _results[index];
+  result.Status = status;
+  result.SectionCount = job.Pipeline->GetSectionCount();
+  result.JumpCount = job.Pipeline->GetJumpCount();
+  result.DecoyCount = job.Pipeline->GetDecoyCount();
+  result.ExcludedCount = job.Pipeline->GetExcludedCount();
+  result.SkippedCount = job.Pipeline->GetSkippedCount();
+  result.FunctionCount = job.Pipeline->GetFunctionCount();
+  result.CachedFunctionCount = job.Pipeline->GetCachedFunctionCount();
+  result.UsedWriteMode = job.Pipeline->GetUsedWriteMode();
+  result.WrittenBytes = job.Pipeline->GetWrittenBytes();
+  result.WriteCount = job.Pipeline->GetWriteCount();
+  result.MetadataSize = job.Pipeline->GetMetadataSize();
+  result.Sections = job.Pipeline->GetSectionReports();
+  result.Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - job.Start).count();
+  _profiler.Add(job.Profiler);
+  job.Pipeline.reset();
+
+  if (_callback) _callback(result);
+}
+
+void BatchBuilder::ReadExcludedRvas(const std::string& exclusionFile, std::set<DWORD>& outRvas)
+{
+  std::ifstream file(exclusionFile);
+  if (!file.is_open()) return;
+
+  // One hexadecimal RVA per line, '#' starts a comment
+  std::string line;
+  while (std::getline(file, line))
+  {
+    const size_t start = line.find_first_not_of(" \t\r");
+    if (start == std::string::npos || line[start] == '#') continue;
+    outRvas.insert((DWORD)strtoul(line.c_str() + start, nullptr, 16));
+  }
+}
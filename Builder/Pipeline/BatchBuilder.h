@@ -0,0 +1,135 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "BuildPipeline.h"
+#include "../Instrumentation/PhaseProfiler.h"
+
+enum class BatchStatus
+{
+  Succeeded,
+  ReadFailed,     // Missing, locked or not a PE32/PE32+ image
+  ProtectFailed,  // No section matches or the metadata resources could not be added
+  WriteFailed
+};
+
+struct BatchResult
+{
+  std::string FileName;
+  BatchStatus Status;
+  DWORD SectionCount;       // Protected sections
+  DWORD ExcludedCount;      // Jumps left untouched because <file>.exclude lists them
+  DWORD JumpCount;
+  DWORD DecoyCount;
+  DWORD SkippedCount;       // Left untouched by the density policy
+  DWORD FunctionCount;      // From .pdata
+  DWORD CachedFunctionCount;
+  WriteMode UsedWriteMode;
+  ULONGLONG WrittenBytes;
+  DWORD WriteCount;
+  DWORD MetadataSize;       // Bytes of the metadata resources
+  std::vector<SectionReport> Sections;  // Only with a cost model
+  double Milliseconds;      // From the start of the read to the end of the write
+};
+
+// Protects many executables in one process. Every file passes three stages: read (BuildPipeline::Load),
+// protect (analyze, patch and add the resource) and write. A pool of worker threads always takes the latest stage of
+// any file that is ready, so finished images leave memory before new ones are read. Reads and writes are limited to
+// a few at a time to keep the disk streaming, and a file is only read while the input bytes in flight stay within
+// the memory budget.
+class BatchBuilder
+{
+public:
+  BatchBuilder();
+  ~BatchBuilder();
+
+  // Names or patterns of the sections to protect (default: .nano)
+  void SetSectionNames(const std::vector<std::string>& sectionNames) { _sectionNames = sectionNames; }
+  void SetLoadMode(LoadMode loadMode) { _loadMode = loadMode; }
+  void SetWriteMode(WriteMode writeMode) { _writeMode = writeMode; }
+  // Worker threads, 0 uses one per logical processor
+  void SetThreadCount(DWORD threadCount) { _threadCount = threadCount; }
+  // Reads and writes at the same time
+  void SetIoThreadCount(DWORD ioThreadCount) { _ioThreadCount = ioThreadCount == 0 ? 1 : ioThreadCount; }
+  // Input bytes of the files between read and write; a file larger than the budget is built alone
+  void SetMemoryBudget(ULONGLONG memoryBudget) { _memoryBudget = memoryBudget; }
+  // Shared by all files, nullptr analyzes every function
+  void SetAnalysisCache(AnalysisCache* cache) { _cache = cache; }
+  // Used for every file, random by default; the same seed and inputs give byte-identical outputs for any thread count
+  void SetSeed(ULONGLONG seed) { _seed = seed; }
+  ULONGLONG GetSeed() const { return _seed; }
+  // Used for every file, nullptr (default) converts every jump
+  void SetDensityPolicy(const DensityPolicy* policy) { _policy = policy; }
+  // Fills BatchResult::Sections for the build report, nullptr (default) skips it
+  void SetCostModel(const CostModel* costModel) { _costModel = costModel; }
+  // Called for every finished file, in the order they finish; calls are serialized
+  void SetResultCallback(const std::function<void(const BatchResult&)>& callback) { _callback = callback; }
+
+  // True if all files were protected
+  bool Run(const std::vector<std::string>& fileNames);
+
+  // Results in the order of the file names
+  const std::vector<BatchResult>& GetResults() const { return _results; }
+  // Phases of all files, accumulated
+  const PhaseProfiler& GetProfiler() const { return _profiler; }
+  // Most input bytes in flight at a time, within the memory budget unless a single file exceeds it
+  ULONGLONG GetPeakBytesInFlight() const { return _peakBytesInFlight; }
+
+private:
+  enum class Stage
+  {
+    Read,
+    Protect,
+    Write
+  };
+
+  struct Job
+  {
+    std::unique_ptr<BuildPipeline> Pipeline;
+    PhaseProfiler Profiler;
+    ULONGLONG Size;         // Charged against the memory budget while in flight
+    std::chrono::steady_clock::time_point Start;
+  };
+
+  void Work();
+  bool TakeTask(Stage& stage, size_t& index);
+  bool Execute(Stage stage, size_t index);
+  void Finish(size_t index, BatchStatus status);
+  static void ReadExcludedRvas(const std::string& exclusionFile, std::set<DWORD>& outRvas);
+
+private:
+  std::vector<std::string> _sectionNames;
+  LoadMode _loadMode;
+  WriteMode _writeMode;
+  DWORD _threadCount;
+  DWORD _ioThreadCount;
+  DWORD _analysisThreadCount;  // Threads of one analysis, the cores are shared by the files in flight
+  ULONGLONG _memoryBudget;
+  AnalysisCache* _cache;
+  ULONGLONG _seed;
+  const DensityPolicy* _policy;
+  const CostModel* _costModel;
+  std::function<void(const BatchResult&)> _callback;
+
+  std::vector<std::string> _fileNames;
+  std::vector<Job> _jobs;
+  std::vector<BatchResult> _results;
+  PhaseProfiler _profiler;
+
+  // Scheduler state, guarded by _mutex
+  std::mutex _mutex;
+  std::condition_variable _condition;
+  size_t _nextRead;
+  std::deque<size_t> _protectQueue;
+  std::deque<size_t> _writeQueue;
+  DWORD _activeIo;
+  DWORD _jobsInFlight;
+  ULONGLONG _bytesInFlight;
+  ULONGLONG _peakBytesInFlight;
+};
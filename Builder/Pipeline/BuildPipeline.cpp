@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <cstring>
+#include "BuildPipeline.h"
+#include "InputList.h"
+#include "../PEFile/ResourceAdder.h"
+#include "../FileWriter/FileWriter.h"
+#include "../FileWriter/PatchWriter.h"
+#include "../Nanomites/NanomitesCreator.h"
+#include "../Nanomites/NanomiteMetadata.h"
+#include "../Nanomites/RandomGenerator.h"
+#include "../Instrumentation/PhaseProfiler.h"
+
+BuildPipeline::BuildPipeline()
+{
+  _profiler = nullptr;
+  _threadCount = 0;
+  _cache = nullptr;
+  _seed = RandomGenerator::CreateSeed();
+  _policy = nullptr;
+  _costModel = nullptr;
+  _loadMode = LoadMode::Mapping;
+  _writeMode = WriteMode::Replace;
+  _usedWriteMode = WriteMode::Replace;
+  _writtenBytes = 0;
+  _writeCount = 0;
+  _sectionCount = 0;
+  _sectionSize = 0;
+  _jumpCount = 0;
+  _decoyCount = 0;
+  _excludedCount = 0;
+  _skippedCount = 0;
+  _functionCount = 0;
+  _cachedFunctionCount = 0;
+  _metadataSize = 0;
+  _dirtyPageCount = 0;
+}
+
+BuildPipeline::~BuildPipeline()
+{
+}
+
+bool BuildPipeline::Run(const char* exeFile, const char* sectionName)
+{
+  return Load(exeFile) && Protect(std::vector<std::string>(1, sectionName)) && Save();
+}
+
+bool BuildPipeline::Load(const char* exeFile)
+{
+  _exeFile = exeFile;
+
+  // Completes an in-place write that was interrupted
+  PhaseProfiler::Scope phase(_profiler, "read");
+  if (!PatchWriter::Recover(exeFile)) return false;
+  return _peFile.OpenFile(exeFile, _loadMode);
+}
+
+bool BuildPipeline::Protect(const std::vector<std::string>& sectionNames)
+{
+  std::vector<const PeSectionHeader*> sectionHeaders;
+  FindSections(sectionNames, sectionHeaders);
+  if (sectionHeaders.empty()) return false;
+  _sectionCount = (DWORD)sectionHeaders.size();
+  _sectionSize = 0;
+  for (const PeSectionHeader* sectionHeader : sectionHeaders) _sectionSize += sectionHeader->SizeOfRawData;
+
+  NanomitesCreator nanomitesCreator;
+  nanomitesCreator.SetExcludedRvas(_excludedRvas);
+  nanomitesCreator.SetPhaseProfiler(_profiler);
+  nanomitesCreator.SetThreadCount(_threadCount);
+  nanomitesCreator.SetAnalysisCache(_cache);
+  nanomitesCreator.SetSeed(_seed);
+  nanomitesCreator.SetDensityPolicy(_policy);
+  nanomitesCreator.SetCostModel(_costModel);
+  NanomiteMetadata* metadata = nanomitesCreator.Create(_peFile, sectionHeaders);
+  _jumpCount = nanomitesCreator.GetJumpCount();
+  _decoyCount = nanomitesCreator.GetDecoyCount();
+  _excludedCount = nanomitesCreator.GetExcludedCount();
+  _skippedCount = nanomitesCreator.GetSkippedCount();
+  _functionCount = nanomitesCreator.GetFunctionCount();
+  _cachedFunctionCount = nanomitesCreator.GetCachedFunctionCount();
+  _sectionReports = nanomitesCreator.GetSectionReports();
+
+  bool result;
+  {
+    PhaseProfiler::Scope phase(_profiler, "resource");
+    result = AddMetadataAsResource(metadata);
+  }
+  delete[] metadata->Nanomites;
+  delete[] metadata->Sections;
+  delete metadata;
+  return result;
+}
+
+bool BuildPipeline::Save()
+{
+  PhaseProfiler::Scope phase(_profiler, "write");
+  _dirtyPageCount = _peFile.GetDirtyPageCount();
+  return WriteFile();
+}
+
+bool BuildPipeline::WriteFile()
+{
+  // In place pays off while the patches are small compared to the file, the journal doubles them
+  if (_writeMode == WriteMode::InPlace && _peFile.GetPatchSize() <= _peFile.GetBufferSize() / 2)
+  {
+    PatchWriter patchWriter;
+    if (patchWriter.Open(_exeFile.c_str()) && _peFile.WritePatches(patchWriter))
+    {
+      _usedWriteMode = WriteMode::InPlace;
+      bool result = patchWriter.Apply();
+      // Shrinking the file has to wait for the mapping to be released
+      _peFile.Close();
+      result = result && patchWriter.Commit();
+      _writtenBytes = patchWriter.GetWrittenBytes();
+      _writeCount = patchWriter.GetWriteCount();
+      return result;
+    }
+  }
+
+  // Patched image and new sections in one sequential write; the file replaces the input once it is unmapped
+  _usedWriteMode = WriteMode::Replace;
+  FileWriter writer;
+  bool result = writer.Open(_exeFile.c_str()) && _peFile.Write(writer);
+  _peFile.Close();
+  result = result && writer.Commit();
+  _writtenBytes = writer.GetWrittenSize();
+  _writeCount = writer.GetWriteCount();
+  return result;
+}
+
+void BuildPipeline::FindSections(const std::vector<std::string>& sectionNames, std::vector<const PeSectionHeader*>& outSections) const
+{
+  // In the order of the section table
+  for (WORD i = 0; i < _peFile.GetSectionCount(); i++)
+  {
+    const PeSectionHeader* sectionHeader = _peFile.GetSectionHeader(i);
+    const std::string name = PEFile::GetSectionName(sectionHeader);
+    const bool matches = std::any_of(sectionNames.begin(), sectionNames.end(), [&](const std::string& sectionName) -> bool
+    {
+      return InputList::MatchesExactCase(sectionName.c_str(), name.c_str());
+    });
+    if (matches && sectionHeader->SizeOfRawData != 0) outSections.push_back(sectionHeader);
+  }
+}
+
+bool BuildPipeline::AddMetadataAsResource(NanomiteMetadata* metadata)
+{
+  // Append nanomite meta data as resource. The runtime reads the items behind its own NanomiteMetadata, whose size
+  // depends on the pointer size of the protected executable and not on the one of the Builder.
+  const DWORD headerSize = _peFile.Is64Bit() ? METADATA_HEADER_SIZE_64 : METADATA_HEADER_SIZE_32;
+  DWORD metadataSize = headerSize + (metadata->ItemCount) * sizeof(Nanomite);
+  BYTE* metadataBuffer = new BYTE[metadataSize];
+  memset(metadataBuffer, 0, metadataSize);
+  memcpy(metadataBuffer, &metadata->ItemCount, sizeof(DWORD));
+  memcpy(metadataBuffer + headerSize, metadata->Nanomites, metadata->ItemCount * sizeof(Nanomite));
+
+  // Section table: count, then the entries; older runtimes only read the metadata resource
+  std::vector<BYTE> sectionTable(sizeof(DWORD) + metadata->SectionCount * sizeof(NanomiteSection));
+  memcpy(sectionTable.data(), &metadata->SectionCount, sizeof(DWORD));
+  memcpy(sectionTable.data() + sizeof(DWORD), metadata->Sections, metadata->SectionCount * sizeof(NanomiteSection));
+
+  _metadataSize = metadataSize + (DWORD)sectionTable.size();
+
+  ResourceAdder resourceAdder;
+  const bool result = resourceAdder.AddResources(_peFile, {
+    { METADATA_RESOURCE_ID, metadataBuffer, metadataSize },
+    { SECTION_TABLE_RESOURCE_ID, sectionTable.data(), (DWORD)sectionTable.size() } });
+  delete[] metadataBuffer;
+  return result;
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <set>
+#include <string>
+#include <vector>
+#include "../PEFile/PEFile.h"
+#include "../Report/CostModel.h"
+
+struct NanomiteMetadata;
+class AnalysisCache;
+class DensityPolicy;
+class PhaseProfiler;
+
+enum class WriteMode
+{
+  Replace,  // The whole image is written to a temporary file which replaces the executable
+  InPlace   // Only the patch runs and the new sections are written into the executable, protected by a journal
+};
+
+// Applies nanomites to sections of an executable: read, scan, decode, patch, sort, add the metadata resources and write.
+// Run executes the three stages Load, Protect and Save in a row; BatchBuilder runs them on different threads.
+class BuildPipeline
+{
+public:
+  BuildPipeline();
+  ~BuildPipeline();
+
+  // Jumps at these RVAs (relative to ImageBase) are left untouched
+  void SetExcludedRvas(const std::set<DWORD>& excludedRvas) { _excludedRvas = excludedRvas; }
+  // Measures every phase, nullptr disables it
+  void SetPhaseProfiler(PhaseProfiler* profiler) { _profiler = profiler; }
+  // Mapping (default) only copies the patched pages, Buffer reads the whole file into memory
+  void SetLoadMode(LoadMode loadMode) { _loadMode = loadMode; }
+  // InPlace falls back to Replace if the journal cannot be created or most of the file changes
+  void SetWriteMode(WriteMode writeMode) { _writeMode = writeMode; }
+  // Threads of the analysis, 0 uses one per logical processor
+  void SetThreadCount(DWORD threadCount) { _threadCount = threadCount; }
+  // Reuses the analysis of unchanged functions, nullptr analyzes everything
+  void SetAnalysisCache(AnalysisCache* cache) { _cache = cache; }
+  // Seed of the filler bytes and decoys, random by default
+  void SetSeed(ULONGLONG seed) { _seed = seed; }
+  // Limits which jumps become nanomites, nullptr (default) converts every jump
+  void SetDensityPolicy(const DensityPolicy* policy) { _policy = policy; }
+  // Estimates the cost of the protected functions for the build report, nullptr (default) skips it
+  void SetCostModel(const CostModel* costModel) { _costModel = costModel; }
+
+  bool Run(const char* exeFile, const char* sectionName);
+
+  // Completes an interrupted in-place write and opens the executable
+  bool Load(const char* exeFile);
+  // Patches every section matching one of the names (* and ? allowed) and adds the metadata resources; a section
+  // matched by several names is protected once. False if no section matches.
+  bool Protect(const std::vector<std::string>& sectionNames);
+  // Writes the executable and releases the image
+  bool Save();
+
+  // Results of the last run
+  DWORD GetSectionCount() const { return _sectionCount; }
+  // Raw size of all protected sections
+  DWORD GetSectionSize() const { return _sectionSize; }
+  DWORD GetJumpCount() const { return _jumpCount; }
+  DWORD GetDecoyCount() const { return _decoyCount; }
+  // Jumps left untouched by the exclusions
+  DWORD GetExcludedCount() const { return _excludedCount; }
+  // Jumps the density policy left untouched
+  DWORD GetSkippedCount() const { return _skippedCount; }
+  DWORD GetFunctionCount() const { return _functionCount; }
+  DWORD GetCachedFunctionCount() const { return _cachedFunctionCount; }
+  // Bytes of the metadata and section table resources
+  DWORD GetMetadataSize() const { return _metadataSize; }
+  // One per protected section, empty without a cost model
+  const std::vector<SectionReport>& GetSectionReports() const { return _sectionReports; }
+  // Pages touched by patches, in Mapping mode these are the pages the OS copied
+  DWORD GetDirtyPageCount() const { return _dirtyPageCount; }
+  WriteMode GetUsedWriteMode() const { return _usedWriteMode; }
+  // Bytes and write calls of the output, including the journal
+  ULONGLONG GetWrittenBytes() const { return _writtenBytes; }
+  DWORD GetWriteCount() const { return _writeCount; }
+
+private:
+  void FindSections(const std::vector<std::string>& sectionNames, std::vector<const PeSectionHeader*>& outSections) const;
+  bool AddMetadataAsResource(NanomiteMetadata* metadata);
+  bool WriteFile();
+
+private:
+  // sizeof(NanomiteMetadata) in the protected executable: DWORD count and a pointer, padded to the pointer size
+  static const DWORD METADATA_HEADER_SIZE_32 = 8;
+  static const DWORD METADATA_HEADER_SIZE_64 = 16;
+  static const WORD METADATA_RESOURCE_ID = 1234;
+  static const WORD SECTION_TABLE_RESOURCE_ID = 1235;
+
+  PEFile _peFile;
+  std::string _exeFile;
+  std::set<DWORD> _excludedRvas;
+  PhaseProfiler* _profiler;
+  DWORD _threadCount;
+  AnalysisCache* _cache;
+  ULONGLONG _seed;
+  const DensityPolicy* _policy;
+  const CostModel* _costModel;
+  std::vector<SectionReport> _sectionReports;
+  LoadMode _loadMode;
+  WriteMode _writeMode;
+  WriteMode _usedWriteMode;
+  ULONGLONG _writtenBytes;
+  DWORD _writeCount;
+  DWORD _sectionCount;
+  DWORD _sectionSize;
+  DWORD _jumpCount;
+  DWORD _decoyCount;
+  DWORD _excludedCount;
+  DWORD _skippedCount;
+  DWORD _functionCount;
+  DWORD _cachedFunctionCount;
+  DWORD _metadataSize;
+  DWORD _dirtyPageCount;
+};
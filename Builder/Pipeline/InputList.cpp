@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include "InputList.h"
+
+InputList::InputList()
+{
+}
+
+InputList::~InputList()
+{
+}
+
+bool InputList::Add(const std::string& input)
+{
+  return Add(input, 0);
+}
+
+bool InputList::Add(const std::string& input, DWORD depth)
+{
+  if (input.empty()) return true;
+  if (input[0] == '@') return AddResponseFile(input.substr(1), depth);
+  if (input.find_first_of("*?") != std::string::npos) return AddPattern(input);
+  // Missing files are reported by the build of the file, like every other error of a single input
+  AddFile(input);
+  return true;
+}
+
+bool InputList::AddResponseFile(const std::string& fileName, DWORD depth)
+{
+  if (depth >= MAX_RESPONSE_FILE_DEPTH) return false;
+  std::ifstream file(fileName);
+  if (!file.is_open()) return false;
+
+  std::string line;
+  while (std::getline(file, line))
+  {
+    const size_t start = line.find_first_not_of(" \t\r");
+    if (start == std::string::npos || line[start] == '#') continue;
+    const size_t end = line.find_last_not_of(" \t\r");
+    std::string input = line.substr(start, end - start + 1);
+    // Paths with spaces may be quoted
+    if (input.size() >= 2 && input.front() == '"' && input.back() == '"') input = input.substr(1, input.size() - 2);
+    if (!Add(input, depth + 1)) return false;
+  }
+  return true;
+}
+
+bool InputList::AddPattern(const std::string& pattern)
+{
+  // Wildcards are only supported in the file name, the directory is taken as it is
+  const size_t separator = pattern.find_last_of("/\\");
+  const std::string directory = separator == std::string::npos ? "" : pattern.substr(0, separator + 1);
+  const std::string namePattern = pattern.substr(directory.size());
+  if (directory.find_first_of("*?") != std::string::npos) return false;
+
+  std::vector<std::string> matches;
+  std::error_code error;
+  for (const auto& entry : std::filesystem::directory_iterator(directory.empty() ? "." : directory, error))
+  {
+    if (!entry.is_regular_file(error)) continue;
+    const std::string name = entry.path().filename().string();
+    if (Matches(namePattern.c_str(), name.c_str())) matches.push_back(directory + name);
+  }
+  if (matches.empty()) return false;
+
+  // Directory order depends on the file system
+  std::sort(matches.begin(), matches.end());
+  for (const auto& match : matches) AddFile(match);
+  return true;
+}
+
+void InputList::AddFile(const std::string& fileName)
+{
+  std::error_code error;
+  std::string key = std::filesystem::weakly_canonical(fileName, error).string();
+  if (error) key = fileName;
+#ifdef _WIN32
+  std::transform(key.begin(), key.end(), key.begin(), [](char c) { return (char)std::tolower((unsigned char)c); });
+#endif
+  if (!_knownFiles.insert(key).second) return;
+  _files.push_back(fileName);
+}
+
+bool InputList::Matches(const char* pattern, const char* name)
+{
+#ifdef _WIN32
+  return MatchWildcards(pattern, name, true);
+#else
+  return MatchWildcards(pattern, name, false);
+#endif
+}
+
+bool InputList::MatchesExactCase(const char* pattern, const char* name)
+{
+  return MatchWildcards(pattern, name, false);
+}
+
+bool InputList::MatchWildcards(const char* pattern, const char* name, bool ignoreCase)
+{
+  // Greedy match with backtracking to the last '*'
+  const char* star = nullptr;
+  const char* starName = nullptr;
+  while (*name != '\0')
+  {
+    const bool same = ignoreCase ? std::tolower((unsigned char)*pattern) == std::tolower((unsigned char)*name) : *pattern == *name;
+    if (*pattern == '*')
+    {
+      star = pattern++;
+      starName = name;
+    }
+    else if (*pattern == '?' || (*pattern != '\0' && same))
+    {
+      pattern++;
+      name++;
+    }
+    else if (star != nullptr)
+    {
+      pattern = star + 1;
+      name = ++starName;
+    }
+    else
+    {
+      return false;
+    }
+  }
+  while (*pattern == '*') pattern++;
+  return *pattern == '\0';
+}
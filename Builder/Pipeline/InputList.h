@@ -0,0 +1,37 @@
+#pragma once
+#include <set>
+#include <string>
+#include <vector>
+#include "../PEFile/PEFormat.h"
+
+// Executables given on the command line: paths, wildcard patterns (* and ? in the file name, e.g. bin\*.exe) and
+// response files (@list.txt, one input per line, '#' starts a comment). Every file is kept once, in the order given.
+class InputList
+{
+public:
+  InputList();
+  ~InputList();
+
+  // False if a response file cannot be read or a pattern matches no file
+  bool Add(const std::string& input);
+
+  const std::vector<std::string>& GetFiles() const { return _files; }
+
+  // * matches any number of characters, ? one; case-insensitive on Windows, like its file names
+  static bool Matches(const char* pattern, const char* name);
+  // The same, but case-sensitive on every platform: section names are bytes, .nano and .NANO are different sections
+  static bool MatchesExactCase(const char* pattern, const char* name);
+
+private:
+  bool Add(const std::string& input, DWORD depth);
+  bool AddResponseFile(const std::string& fileName, DWORD depth);
+  bool AddPattern(const std::string& pattern);
+  void AddFile(const std::string& fileName);
+  static bool MatchWildcards(const char* pattern, const char* name, bool ignoreCase);
+
+private:
+  static const DWORD MAX_RESPONSE_FILE_DEPTH = 8;  // Response files may list further response files
+
+  std::vector<std::string> _files;
+  std::set<std::string> _knownFiles;               // Canonical paths, the same file must not be built twice at once
+};
@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include "BuildReport.h"
+
+BuildReport::BuildReport(const CostModel& costModel) : _costModel(costModel)
+{
+}
+
+BuildReport::~BuildReport()
+{
+}
+
+bool BuildReport::Write(const char* fileName) const
+{
+  std::ofstream file(fileName);
+  if (!file.is_open()) return false;
+
+  const std::string name = fileName;
+  const bool isCsv = name.size() >= 4 && name.compare(name.size() - 4, 4, ".csv") == 0;
+  if (isCsv) WriteCsv(file);
+  else WriteJson(file);
+  return file.good();
+}
+
+void BuildReport::WriteJson(std::ostream& stream) const
+{
+  stream << std::fixed << std::setprecision(0);
+  stream << "{\"cycles_per_trap\":" << _costModel.GetCyclesPerTrap() << ",\"loop_iterations\":" << _costModel.GetLoopIterations() << ",\"files\":[";
+  for (size_t f = 0; f < _files.size(); f++)
+  {
+    const FileReport& file = _files[f];
+    stream << (f == 0 ? "" : ",") << "{\"file\":";
+    WriteString(stream, file.FileName);
+    stream << ",\"seed\":" << file.Seed << ",\"metadata_bytes\":" << file.MetadataSize << ",\"sections\":[";
+    for (size_t s = 0; s < file.Sections.size(); s++)
+    {
+      const SectionReport& section = file.Sections[s];
+      DWORD maxSites = 0;
+      for (const FunctionCost& function : section.Functions) maxSites = std::max(maxSites, function.SiteCount);
+      const DWORD siteCount = section.ShortSiteCount + section.NearSiteCount;
+
+      stream << (s == 0 ? "" : ",") << "{\"name\":";
+      WriteString(stream, section.Name);
+      stream << ",\"rva\":" << section.VirtualAddress << ",\"size\":" << section.Size << ",\"nanomites\":" << siteCount;
+      stream << ",\"short\":" << section.ShortSiteCount << ",\"near\":" << section.NearSiteCount << ",\"decoys\":" << section.DecoyCount << ",\"jump_types\":{";
+      bool first = true;
+      for (DWORD type = 0; type < SectionReport::JUMP_TYPE_COUNT; type++)
+      {
+        if (section.JumpTypeCounts[type] == 0) continue;
+        stream << (first ? "" : ",") << "\"" << JUMP_TYPE_NAMES[type] << "\":" << section.JumpTypeCounts[type];
+        first = false;
+      }
+      stream << "},\"functions\":" << section.FunctionCount << ",\"functions_with_sites\":" << section.Functions.size();
+      stream << ",\"sites_per_function\":" << std::setprecision(2) << (section.Functions.empty() ? 0.0 : (double)siteCount / section.Functions.size()) << std::setprecision(0);
+      stream << ",\"max_sites_per_function\":" << maxSites << ",\"estimated_cycles\":" << section.Cycles << ",\"function_costs\":[";
+      for (size_t i = 0; i < section.Functions.size(); i++)
+      {
+        const FunctionCost& function = section.Functions[i];
+        stream << (i == 0 ? "" : ",") << "{\"rva\":" << function.Rva << ",\"size\":" << function.Size << ",\"sites\":" << function.SiteCount;
+        stream << ",\"max_loop_depth\":" << function.MaxLoopDepth << ",\"estimated_cycles\":" << function.Cycles << "}";
+      }
+      stream << "]}";
+    }
+    stream << "]}";
+  }
+  stream << "]}" << std::endl;
+}
+
+void BuildReport::WriteCsv(std::ostream& stream) const
+{
+  stream << std::fixed << std::setprecision(0);
+  stream << "file,section,function_rva,size,sites,max_loop_depth,estimated_cycles" << std::endl;
+  for (const FileReport& file : _files)
+  {
+    for (const SectionReport& section : file.Sections)
+    {
+      for (const FunctionCost& function : section.Functions)
+      {
+        WriteString(stream, file.FileName);
+        stream << ",";
+        WriteString(stream, section.Name);
+        stream << ",0x" << std::hex << function.Rva << std::dec << "," << function.Size << "," << function.SiteCount << "," << function.MaxLoopDepth << "," << function.Cycles << std::endl;
+      }
+    }
+  }
+}
+
+void BuildReport::WriteString(std::ostream& stream, const std::string& value)
+{
+  // Quoted, with the quotes and backslashes escaped; valid in JSON and, without backslashes in the value, in CSV
+  stream << "\"";
+  for (char c : value)
+  {
+    if (c == '"' || c == '\\') stream << '\\';
+    stream << c;
+  }
+  stream << "\"";
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <vector>
+#include "CostModel.h"
+
+// Protection of one executable as written to the report
+struct FileReport
+{
+  std::string FileName;
+  ULONGLONG Seed;
+  DWORD MetadataSize;     // Bytes of the metadata and section table resources
+  std::vector<SectionReport> Sections;
+};
+
+// Report of a Builder run for reviewers: per file and section the nanomites by jump type, short and near sites,
+// decoys, sites per function and the metadata size, plus the static cost estimate of every function with sites.
+// JSON holds everything; CSV has one row per function for spreadsheets and scripts.
+class BuildReport
+{
+public:
+  BuildReport(const CostModel& costModel);
+  ~BuildReport();
+
+  void AddFile(const FileReport& file) { _files.push_back(file); }
+
+  // CSV if the name ends with .csv, JSON otherwise
+  bool Write(const char* fileName) const;
+
+private:
+  void WriteJson(std::ostream& stream) const;
+  void WriteCsv(std::ostream& stream) const;
+  static void WriteString(std::ostream& stream, const std::string& value);
+
+private:
+  const CostModel& _costModel;
+  std::vector<FileReport> _files;
+};
@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <cmath>
+#include "CostModel.h"
+
+CostModel::CostModel()
+{
+  _cyclesPerTrap = 6000.0;
+  _loopIterations = 10.0;
+}
+
+CostModel::~CostModel()
+{
+}
+
+void CostModel::Analyze(const PeSectionHeader* sectionHeader, const std::vector<RelativeJump>& jumps, const std::vector<DWORD>& functionStarts, const Nanomite* sites, size_t siteCount, SectionReport& report) const
+{
+  const DWORD sectionRva = sectionHeader->VirtualAddress;
+  const DWORD sectionLength = sectionHeader->SizeOfRawData;
+  report.FunctionCount = (DWORD)functionStarts.size();
+  report.Functions.clear();
+  report.Cycles = 0.0;
+  std::fill(report.JumpTypeCounts, report.JumpTypeCounts + SectionReport::JUMP_TYPE_COUNT, 0);
+  report.ShortSiteCount = 0;
+  report.NearSiteCount = 0;
+
+  // Loops of a function end at a backward jump and start at its target; the depth of every jump is the sum of the
+  // loops opened and not yet closed in front of it
+  std::vector<int> depthChanges(jumps.size() + 1, 0);
+  size_t functionIndex = 0;
+  size_t functionFirst = 0;
+  for (size_t i = 0; i < jumps.size(); i++)
+  {
+    const RelativeJump& jump = jumps[i];
+    while (functionIndex < functionStarts.size() && functionStarts[functionIndex] <= jump.Rva)
+    {
+      functionIndex++;
+      functionFirst = i;
+    }
+    const DWORD functionStart = functionIndex == 0 ? 0 : functionStarts[functionIndex - 1];
+    const LONGLONG target = (LONGLONG)jump.Rva + jump.OpcodeLength + (LONG)jump.JmpLength;
+    if (target > jump.Rva || target < functionStart) continue;
+
+    auto first = std::lower_bound(jumps.begin() + functionFirst, jumps.begin() + i, (DWORD)target, [](const RelativeJump& other, DWORD rva) -> bool
+    {
+      return other.Rva < rva;
+    });
+    depthChanges[first - jumps.begin()]++;
+    depthChanges[i + 1]--;
+  }
+
+  // Sites are a subset of the jumps, both sorted
+  int depth = 0;
+  size_t jumpIndex = 0;
+  functionIndex = 0;
+  for (size_t s = 0; s < siteCount; s++)
+  {
+    const Nanomite& site = sites[s];
+    const DWORD rva = site.Rva - sectionRva;
+    while (jumpIndex < jumps.size() && jumps[jumpIndex].Rva <= rva) depth += depthChanges[jumpIndex++];
+    while (functionIndex < functionStarts.size() && functionStarts[functionIndex] <= rva) functionIndex++;
+
+    const DWORD functionStart = functionIndex == 0 ? 0 : functionStarts[functionIndex - 1];
+    if (report.Functions.empty() || report.Functions.back().Rva != functionStart + sectionRva)
+    {
+      const DWORD functionEnd = functionIndex < functionStarts.size() ? functionStarts[functionIndex] : sectionLength;
+      FunctionCost function = { functionStart + sectionRva, functionEnd - functionStart, 0, 0, 0.0 };
+      report.Functions.push_back(function);
+    }
+
+    FunctionCost& function = report.Functions.back();
+    const DWORD loopDepth = (DWORD)std::max(depth, 0);
+    const double cycles = _cyclesPerTrap * std::pow(_loopIterations, (double)std::min(loopDepth, MAX_LOOP_DEPTH));
+    function.SiteCount++;
+    function.MaxLoopDepth = std::max(function.MaxLoopDepth, loopDepth);
+    function.Cycles += cycles;
+    report.Cycles += cycles;
+
+    if (site.JumpType < SectionReport::JUMP_TYPE_COUNT) report.JumpTypeCounts[site.JumpType]++;
+    if (site.OpcodeLength == 2) report.ShortSiteCount++;
+    else report.NearSiteCount++;
+  }
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "../Disassembler/RelativeJump.h"
+#include "../Nanomites/Nanomite.h"
+#include "../PEFile/PEFormat.h"
+
+// Static estimate of one function with nanomites
+struct FunctionCost
+{
+  DWORD Rva;              // Relative to ImageBase
+  DWORD Size;             // Up to the next known function start
+  DWORD SiteCount;
+  DWORD MaxLoopDepth;
+  double Cycles;          // Expected trap cycles per call
+};
+
+// Sites and costs of one protected section
+struct SectionReport
+{
+  static const DWORD JUMP_TYPE_COUNT = JMP + 1;
+
+  std::string Name;
+  DWORD VirtualAddress;
+  DWORD Size;
+  DWORD JumpTypeCounts[JUMP_TYPE_COUNT];  // Real nanomites, indexed by JumpType
+  DWORD ShortSiteCount;   // 2 byte jumps with an 8 bit displacement
+  DWORD NearSiteCount;    // 5 and 6 byte jumps with a 32 bit displacement
+  DWORD DecoyCount;
+  DWORD FunctionCount;    // Functions known to the analysis, with or without sites
+  std::vector<FunctionCost> Functions;  // Functions with sites, by RVA
+  double Cycles;
+};
+
+// Estimates the trap cycles of a function call without running it: every site is assumed to execute once per call,
+// times LoopIterations for every loop around it. Loops come from the control flow graph of the function, each backward
+// jump closes a loop [target, jump] and the depth of a site is the number of loops containing it (the same depth
+// Nanoprof reports). Backward jumps left unpatched still count as loops.
+class CostModel
+{
+public:
+  CostModel();
+  ~CostModel();
+
+  void SetCyclesPerTrap(double cyclesPerTrap) { _cyclesPerTrap = cyclesPerTrap; }
+  double GetCyclesPerTrap() const { return _cyclesPerTrap; }
+  void SetLoopIterations(double loopIterations) { _loopIterations = loopIterations; }
+  double GetLoopIterations() const { return _loopIterations; }
+
+  // jumps: all relative jumps of the section, section relative and sorted. functionStarts: section relative and
+  // sorted, empty treats the section as one function. sites: the real nanomites of the section, sorted by RVA.
+  // Linear in the number of jumps apart from one binary search per backward jump within its function.
+  void Analyze(const PeSectionHeader* sectionHeader, const std::vector<RelativeJump>& jumps, const std::vector<DWORD>& functionStarts, const Nanomite* sites, size_t siteCount, SectionReport& report) const;
+
+private:
+  static constexpr DWORD MAX_LOOP_DEPTH = 8;  // Deeper nests are weighted like this one
+
+  double _cyclesPerTrap;
+  double _loopIterations;
+};
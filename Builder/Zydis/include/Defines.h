@@ -32,7 +32,7 @@
 #ifndef ZYDIS_DEFINES_H
 #define ZYDIS_DEFINES_H
 
-#include ".\Zycore\Defines.h"
+#include "./Zycore/Defines.h"
 
 // This is a cut-down version of what CMake's `GenerateExportHeader` would usually generate. To
 // simplify builds without CMake, we define these things manually instead of relying on CMake
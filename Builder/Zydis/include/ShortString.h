@@ -33,7 +33,7 @@
 #ifndef ZYDIS_SHORTSTRING_H
 #define ZYDIS_SHORTSTRING_H
 
-#include ".\Zycore\Defines.h"
+#include "./Zycore/Defines.h"
 #include "Zycore/Types.h"
 
 #ifdef __cplusplus
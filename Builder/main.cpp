@@ -1,71 +1,216 @@
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
 #include <iostream>
-#include "PEFile\PEFile.h"
-#include "PEFile\ResourceAdder.h"
-#include "FileWriter\FileWriter.h"
-#include "Nanomites\NanomitesCreator.h"
-#include "Nanomites\NanomiteMetadata.h"
+#include <string>
+#include "Pipeline/BatchBuilder.h"
+#include "Pipeline/InputList.h"
+#include "Disassembler/AnalysisCache.h"
+#include "Nanomites/DensityPolicy.h"
+#include "Instrumentation/PhaseProfiler.h"
+#include "Report/BuildReport.h"
 
-bool CreateNanomites(const char* exeFile, const char* sectionName);
-void WriteFile(const char* exeFile, PEFile& peFile);
-void AddMetadataAsResource(const char* exeFile, NanomiteMetadata* metadata);
+void PrintUsage();
+void PrintResult(const BatchResult& result);
+void AddSectionNames(const std::string& argument, std::vector<std::string>& sectionNames);
+
+bool ReadNumber(int argc, char* argv[], int& i, ULONGLONG& outValue);
+
+// Exit codes: all files protected, at least one file failed, invalid command line
+const int EXIT_BUILD_FAILED = 1;
+const int EXIT_USAGE = 2;
 
 // --- main program --- Will be executed as post build event in the Builder project; make sure to rebuild the solution after making changes!
-int main()
+// Usage: Builder.exe [options] <exe|pattern|@response file>...
+//   --section names    : sections to protect, comma separated, * and ? allowed, case-sensitive; repeatable (default: .nano)
+//   --threads n        : worker threads (default: number of logical processors)
+//   --io-threads n     : concurrent reads and writes (default: 2)
+//   --max-memory-mb n  : input megabytes between read and write (default: 1024)
+//   --no-map           : read the whole executable into memory instead of mapping it
+//   --in-place         : only write the changed bytes into the executable (journaled) instead of replacing it
+//   --cache dir        : reuse the analysis of unchanged functions; the directory can be shared between builders
+//   --seed n           : seed of the filler bytes and decoys (default: random); the same seed gives the same output
+//   --policy file      : limit the converted jumps by fraction, type, direction, function and block (see DensityPolicy)
+//   --json file        : write the accumulated phase timings and memory counters as JSON
+//   --report file      : write the sites, decoys, metadata size and estimated cost per function (.csv or JSON)
+//   --cycles-per-trap n: cost of one trap for the report (default: 6000)
+//   --loop-iterations n: iterations assumed per loop around a site for the report (default: 10)
+int main(int argc, char* argv[])
 {
-  const std::string fileName = "Nanomites.exe";
-  const std::string sectionName = ".nano";
+  BatchBuilder batchBuilder;
+  InputList inputList;
+  AnalysisCache cache;
+  CostModel costModel;
+  DensityPolicy policy;
+  std::vector<std::string> sectionNames;
+  const char* cacheDirectory = nullptr;
+  const char* jsonFile = nullptr;
+  const char* reportFile = nullptr;
+  const char* policyFile = nullptr;
+  for (int i = 1; i < argc; i++)
+  {
+    const std::string argument = argv[i];
+    const bool hasValue = i + 1 < argc;
+    ULONGLONG value = 0;
+    if (argument == "--no-wait") continue; // The Builder no longer waits for ENTER, kept for existing build scripts
+    else if (argument == "--no-map") batchBuilder.SetLoadMode(LoadMode::Buffer);
+    else if (argument == "--in-place") batchBuilder.SetWriteMode(WriteMode::InPlace);
+    else if (argument == "--section" && hasValue) AddSectionNames(argv[++i], sectionNames);
+    else if (argument == "--threads" && ReadNumber(argc, argv, i, value)) batchBuilder.SetThreadCount((DWORD)value);
+    else if (argument == "--io-threads" && ReadNumber(argc, argv, i, value)) batchBuilder.SetIoThreadCount((DWORD)value);
+    else if (argument == "--max-memory-mb" && ReadNumber(argc, argv, i, value)) batchBuilder.SetMemoryBudget(value * 1024 * 1024);
+    else if (argument == "--seed" && ReadNumber(argc, argv, i, value)) batchBuilder.SetSeed(value);
+    else if (argument == "--json" && hasValue) jsonFile = argv[++i];
+    else if (argument == "--cache" && hasValue) cacheDirectory = argv[++i];
+    else if (argument == "--policy" && hasValue) policyFile = argv[++i];
+    else if (argument == "--report" && hasValue) reportFile = argv[++i];
+    else if (argument == "--cycles-per-trap" && ReadNumber(argc, argv, i, value)) costModel.SetCyclesPerTrap((double)value);
+    else if (argument == "--loop-iterations" && ReadNumber(argc, argv, i, value)) costModel.SetLoopIterations((double)value);
+    else if (argument.compare(0, 2, "--") == 0)
+    {
+      std::cout << "Invalid option " << argument << "." << std::endl;
+      PrintUsage();
+      return EXIT_USAGE;
+    }
+    else if (!inputList.Add(argument))
+    {
+      std::cout << "No executables found for " << argument << "." << std::endl;
+      return EXIT_USAGE;
+    }
+  }
+
+  if (!sectionNames.empty()) batchBuilder.SetSectionNames(sectionNames);
+  const std::vector<std::string>& files = inputList.GetFiles();
+  if (files.empty())
+  {
+    PrintUsage();
+    return EXIT_USAGE;
+  }
+
+  if (cacheDirectory != nullptr)
+  {
+    if (!cache.Open(cacheDirectory))
+    {
+      std::cout << "Opening the analysis cache " << cacheDirectory << " failed!" << std::endl;
+      return EXIT_USAGE;
+    }
+    batchBuilder.SetAnalysisCache(&cache);
+  }
+  if (reportFile != nullptr) batchBuilder.SetCostModel(&costModel);
+  if (policyFile != nullptr)
+  {
+    if (!policy.Load(policyFile))
+    {
+      std::cout << "Reading the density policy " << policyFile;
+      if (policy.GetErrorLine() != 0) std::cout << " failed in line " << policy.GetErrorLine() << "!" << std::endl;
+      else std::cout << " failed!" << std::endl;
+      return EXIT_USAGE;
+    }
+    batchBuilder.SetDensityPolicy(&policy);
+  }
 
-  std::cout << "Creating nanomites in section " << sectionName << " of " << fileName << "..." << std::endl;
+  std::cout << "Creating nanomites in " << files.size() << " executable(s) with seed " << batchBuilder.GetSeed() << "..." << std::endl;
+  if (policyFile != nullptr) std::cout << "Density policy " << policyFile << ": " << policy.GetDescription() << std::endl;
+  batchBuilder.SetResultCallback(PrintResult);
+  const auto start = std::chrono::steady_clock::now();
+  const bool success = batchBuilder.Run(files);
+  const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+  if (cacheDirectory != nullptr)
+  {
+    // A cache that cannot be written only costs time in the next build
+    const DWORD functionCount = cache.GetHitCount() + cache.GetMissCount();
+    std::cout << "Analysis cache " << cacheDirectory << ": " << cache.GetHitCount() << " of " << functionCount << " functions reused, "
+      << cache.GetAddedCount() << " added";
+    if (cache.GetRejectedCount() != 0) std::cout << ", " << cache.GetRejectedCount() << " rejected";
+    std::cout << "." << std::endl;
+    if (!cache.Save()) std::cout << "Writing the analysis cache failed!" << std::endl;
+  }
+
+  const PhaseProfiler& profiler = batchBuilder.GetProfiler();
+  profiler.Print();
+  if (jsonFile != nullptr && !profiler.WriteJson(jsonFile))
+  {
+    std::cout << "Writing " << jsonFile << " failed!" << std::endl;
+  }
 
-  if (!CreateNanomites(fileName.c_str(), sectionName.c_str()))
+  size_t failed = 0;
+  BuildReport report(costModel);
+  for (const auto& result : batchBuilder.GetResults())
+  {
+    if (result.Status != BatchStatus::Succeeded) failed++;
+    else report.AddFile({ result.FileName, batchBuilder.GetSeed(), result.MetadataSize, result.Sections });
+  }
+  if (reportFile != nullptr && !report.Write(reportFile))
+  {
+    std::cout << "Writing " << reportFile << " failed!" << std::endl;
+  }
+  std::cout << "Protected " << files.size() - failed << " of " << files.size() << " executable(s) in " << (ULONGLONG)milliseconds << " ms, at most "
+    << batchBuilder.GetPeakBytesInFlight() / (1024 * 1024) << " MB of input in flight." << std::endl;
+  if (!success)
   {
     std::cout << "Creating nanomites failed!" << std::endl;
-    return EXIT_FAILURE;
+    return EXIT_BUILD_FAILED;
   }
 
   std::cout << "Creating nanomites finished successfully." << std::endl;
-  std::cout << "Press ENTER to exit..." << std::endl;
-  std::cin.get();
-
   return EXIT_SUCCESS;
 }
 
-bool CreateNanomites(const char* exeFile, const char* sectionName)
+void PrintUsage()
 {
-  PEFile peFile;
-  if (!peFile.OpenFile(exeFile)) return false;
-
-  PIMAGE_SECTION_HEADER sectionHeader = peFile.FindSectionByName(sectionName);
-  if (sectionHeader == nullptr) return false;
-
-  NanomitesCreator nanomitesCreator;
-  NanomiteMetadata* metadata = nanomitesCreator.Create(peFile, sectionHeader);
-
-  WriteFile(exeFile, peFile);
-  AddMetadataAsResource(exeFile, metadata);
-
-  return true;
+  std::cout << "Usage: Builder.exe [options] <exe|pattern|@response file>..." << std::endl;
+  std::cout << "  Patterns use * and ? in the file name (bin\\*.exe); response files list one input per line." << std::endl;
+  std::cout << "  --section <names> --threads <count> --io-threads <count> --max-memory-mb <MB>" << std::endl;
+  std::cout << "  --no-map --in-place --cache <directory> --seed <number> --policy <file> --json <file>" << std::endl;
+  std::cout << "  --report <file.json|file.csv> --cycles-per-trap <cycles> --loop-iterations <count>" << std::endl;
 }
 
-void WriteFile(const char* exeFile, PEFile& peFile)
+void PrintResult(const BatchResult& result)
 {
-  // Write exe file with nanomites
-  FileWriter fileWriter;
-  std::ofstream outfile;
-  fileWriter.OpenForWriteBin(exeFile, outfile);
-  fileWriter.Write(outfile, (BYTE*)(peFile.DOS_HEADER()), peFile.GetBufferSize());
-  fileWriter.Close(outfile);
+  // Called by the worker threads one at a time
+  switch (result.Status)
+  {
+  case BatchStatus::Succeeded:
+    std::cout << "[ok]     " << result.FileName << ": " << result.JumpCount << " nanomites, " << result.DecoyCount << " decoys";
+    if (result.SectionCount > 1) std::cout << " in " << result.SectionCount << " sections";
+    if (result.ExcludedCount != 0) std::cout << ", " << result.ExcludedCount << " excluded";
+    if (result.SkippedCount != 0) std::cout << ", " << result.SkippedCount << " left by the policy";
+    if (result.FunctionCount != 0) std::cout << ", " << result.FunctionCount - result.CachedFunctionCount << " of " << result.FunctionCount << " functions analyzed";
+    std::cout << "; " << (result.UsedWriteMode == WriteMode::InPlace ? "patched " : "rewrote ") << result.WrittenBytes << " bytes in "
+      << result.WriteCount << " writes, " << (ULONGLONG)result.Milliseconds << " ms" << std::endl;
+    break;
+  case BatchStatus::ReadFailed:
+    std::cout << "[failed] " << result.FileName << ": cannot be read or is not a PE32/PE32+ image" << std::endl;
+    break;
+  case BatchStatus::ProtectFailed:
+    std::cout << "[failed] " << result.FileName << ": no section matches or the metadata resources cannot be added" << std::endl;
+    break;
+  case BatchStatus::WriteFailed:
+    std::cout << "[failed] " << result.FileName << ": writing failed" << std::endl;
+    break;
+  }
 }
 
-void AddMetadataAsResource(const char* exeFile, NanomiteMetadata* metadata)
+bool ReadNumber(int argc, char* argv[], int& i, ULONGLONG& outValue)
 {
-  // Append nanomite meta data as resource
-  DWORD metadataSize = sizeof(NanomiteMetadata) + (metadata->ItemCount) * sizeof(Nanomite);
-  BYTE* metadataBuffer = new BYTE[metadataSize];
-  memset(metadataBuffer, 0, metadataSize);
-  memcpy(metadataBuffer, metadata, sizeof(NanomiteMetadata));
-  memcpy(metadataBuffer + sizeof(NanomiteMetadata), metadata->Nanomites, metadata->ItemCount * sizeof(Nanomite));
+  // Consumes the value of the option at argv[i] if it is a number
+  if (i + 1 >= argc) return false;
+  char* end = nullptr;
+  outValue = strtoull(argv[i + 1], &end, 10);
+  if (end == argv[i + 1] || *end != '\0') return false;
+  i++;
+  return true;
+}
 
-  ResourceAdder resourceAdder;
-  resourceAdder.AddResource(exeFile, 1234, metadataBuffer, metadataSize);
+void AddSectionNames(const std::string& argument, std::vector<std::string>& sectionNames)
+{
+  // ".nano,.nanohot" or ".nano*"
+  size_t start = 0;
+  while (start <= argument.size())
+  {
+    const size_t end = std::min(argument.find(',', start), argument.size());
+    if (end > start) sectionNames.push_back(argument.substr(start, end - start));
+    start = end + 1;
+  }
 }
@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <filesystem>
+#include <thread>
+#include "BatchBenchmark.h"
+#include "../Generator/SyntheticPEGenerator.h"
+#include "../../Benchmark/Common/BenchmarkOptions.h"
+#include "../../Benchmark/Common/BenchmarkReporter.h"
+#include "../../Benchmark/Common/Stopwatch.h"
+#include "../../Builder/Pipeline/BatchBuilder.h"
+
+BatchBenchmark::BatchBenchmark()
+{
+}
+
+BatchBenchmark::~BatchBenchmark()
+{
+}
+
+void BatchBenchmark::Run(BenchmarkReporter& reporter, BenchmarkOptions& options)
+{
+  if (!reporter.IsSelected("batch")) return;
+
+  const DWORD fileCount = (DWORD)options.GetInteger("files", 32);
+  const DWORD sizeMb = (DWORD)options.GetInteger("size-mb", 4);
+  const DWORD repetitions = (DWORD)options.GetInteger("repetitions", 3);
+  const DWORD ioThreads = (DWORD)options.GetInteger("io-threads", 2);
+  DWORD maxThreads = (DWORD)options.GetInteger("threads", std::thread::hardware_concurrency());
+  if (maxThreads == 0) maxThreads = 1;
+  if (fileCount == 0 || sizeMb == 0 || repetitions == 0) return;
+
+  // Different seeds, so the files are not identical; the pipeline modifies them, every run starts from fresh copies
+  std::vector<std::string> inputFiles;
+  std::vector<std::string> workFiles;
+  std::error_code error;
+  SyntheticPEGenerator generator;
+  for (DWORD i = 0; i < fileCount; i++)
+  {
+    SyntheticPESettings settings;
+    settings.Is64Bit = (i % 2) == 0;
+    settings.SectionSize = sizeMb * 1024 * 1024;
+    settings.JumpsPerKb = (DWORD)options.GetInteger("density", 40);
+    settings.PaddingBytes = (DWORD)options.GetInteger("padding", 8);
+    settings.FunctionTable = true;
+    settings.DataSize = 0;
+    settings.Seed = 0x2545F491 + i;
+
+    inputFiles.push_back(SyntheticPEGenerator::GetTempFileName(("nanomites-batch-" + std::to_string(i) + ".exe").c_str()));
+    workFiles.push_back(SyntheticPEGenerator::GetTempFileName(("nanomites-batch-work-" + std::to_string(i) + ".exe").c_str()));
+    if (!generator.Generate(inputFiles.back().c_str(), settings)) break;
+  }
+
+  const double megabytes = (double)fileCount * sizeMb;
+  double serialNs = 0.0;
+  // 1, 2, 4, ... threads, always ending with the requested maximum
+  for (DWORD threads = 1; inputFiles.size() == fileCount && threads != 0; threads = (threads == maxThreads) ? 0 : std::min(threads * 2, maxThreads))
+  {
+    std::vector<double> times;
+    bool succeeded = true;
+    for (DWORD r = 0; r < repetitions && succeeded; r++)
+    {
+      for (DWORD i = 0; i < fileCount; i++)
+      {
+        if (!std::filesystem::copy_file(inputFiles[i], workFiles[i], std::filesystem::copy_options::overwrite_existing, error)) succeeded = false;
+      }
+      if (!succeeded) break;
+
+      BatchBuilder batchBuilder;
+      batchBuilder.SetThreadCount(threads);
+      batchBuilder.SetIoThreadCount(ioThreads);
+      Stopwatch stopwatch;
+      succeeded = batchBuilder.Run(workFiles);
+      times.push_back(stopwatch.ElapsedNanoseconds());
+    }
+    if (!succeeded) break;
+
+    const double nanoseconds = Median(times);
+    if (threads == 1) serialNs = nanoseconds;
+
+    BenchmarkResult result;
+    result.Name = "batch/" + std::to_string(threads) + "t/" + std::to_string(fileCount) + "x" + std::to_string(sizeMb) + "MB";
+    result.Operations = fileCount;
+    result.Nanoseconds = nanoseconds;
+    result.AddMetric("files_per_s", fileCount * 1e9 / nanoseconds);
+    result.AddMetric("mb_per_s", megabytes * 1e9 / nanoseconds);
+    result.AddMetric("speedup", serialNs / nanoseconds);
+    reporter.Report(result);
+  }
+
+  for (const auto& file : inputFiles) std::filesystem::remove(file, error);
+  for (const auto& file : workFiles) std::filesystem::remove(file, error);
+}
+
+double BatchBenchmark::Median(std::vector<double>& values)
+{
+  std::sort(values.begin(), values.end());
+  const size_t count = values.size();
+  return (count % 2 == 1) ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2.0;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "../../Builder/PEFile/PEFormat.h"
+
+class BenchmarkReporter;
+class BenchmarkOptions;
+
+// Batch throughput: protects a set of synthetic executables with the BatchBuilder on 1, 2, 4, ... worker threads and
+// reports files/s, MB/s and the speedup over one thread. The speedup flattens once the disk is saturated.
+class BatchBenchmark
+{
+public:
+  BatchBenchmark();
+  ~BatchBenchmark();
+
+  void Run(BenchmarkReporter& reporter, BenchmarkOptions& options);
+
+private:
+  static double Median(std::vector<double>& values);
+};
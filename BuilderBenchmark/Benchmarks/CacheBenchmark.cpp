@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <filesystem>
+#include "CacheBenchmark.h"
+#include "../Generator/SyntheticPEGenerator.h"
+#include "../../Benchmark/Common/BenchmarkOptions.h"
+#include "../../Benchmark/Common/BenchmarkReporter.h"
+#include "../../Benchmark/Common/Stopwatch.h"
+#include "../../Builder/Disassembler/AnalysisCache.h"
+#include "../../Builder/Disassembler/Disassembler.h"
+#include "../../Builder/Disassembler/FunctionTable.h"
+#include "../../Builder/PEFile/PEFile.h"
+
+CacheBenchmark::CacheBenchmark()
+{
+}
+
+CacheBenchmark::~CacheBenchmark()
+{
+}
+
+void CacheBenchmark::Run(BenchmarkReporter& reporter, BenchmarkOptions& options)
+{
+  if (!reporter.IsSelected("cache")) return;
+
+  const DWORD sizeMb = (DWORD)options.GetInteger("size-mb", 128);
+  const DWORD repetitions = (DWORD)options.GetInteger("repetitions", 3);
+  const DWORD changedPercent = (DWORD)options.GetInteger("changed-pct", 1);
+  if (sizeMb == 0 || repetitions == 0) return;
+
+  const std::string fileName = SyntheticPEGenerator::GetTempFileName("nanomites-cache.exe");
+  const std::string cacheDirectory = SyntheticPEGenerator::GetTempFileName("nanomites-cache");
+
+  SyntheticPESettings settings;
+  settings.Is64Bit = true;
+  settings.SectionSize = sizeMb * 1024 * 1024;
+  settings.JumpsPerKb = (DWORD)options.GetInteger("density", 40);
+  settings.PaddingBytes = (DWORD)options.GetInteger("padding", 8);
+  settings.FunctionTable = true;
+  settings.DataSize = 0;
+  settings.Seed = 0x2545F491;
+
+  // The same image twice: as built before and after the change
+  SyntheticPEGenerator generator;
+  PEFile original, changed;
+  const bool loaded = generator.Generate(fileName.c_str(), settings) && original.OpenFile(fileName.c_str(), LoadMode::Buffer) &&
+    changed.OpenFile(fileName.c_str(), LoadMode::Buffer);
+  std::error_code error;
+  std::filesystem::remove(fileName, error);
+  if (!loaded) return;
+  const PeSectionHeader* originalSection = original.FindSectionByName(".nano");
+  const PeSectionHeader* changedSection = changed.FindSectionByName(".nano");
+  FunctionTable functionTable;
+  if (originalSection == nullptr || changedSection == nullptr || !functionTable.Load(changed, changedSection)) return;
+
+  // An int3 at the start of every n-th function changes its key
+  const std::vector<FunctionRange>& functions = functionTable.GetFunctions();
+  const DWORD changedCount = (DWORD)(functions.size() * std::min<DWORD>(changedPercent, 100) / 100);
+  for (DWORD i = 0; i < changedCount; i++)
+  {
+    const FunctionRange& function = functions[(size_t)i * functions.size() / changedCount];
+    BYTE* code = changed.GetWritablePointer(changedSection->PointerToRawData + function.Begin, 1);
+    if (code != nullptr) *code = 0xCC;
+  }
+
+  std::vector<double> noneNs, cleanNs, incrementalNs;
+  std::vector<RelativeJump> jumps;
+  std::vector<DWORD> ccRvas;
+  DWORD cachedCount = 0;
+  ULONGLONG cacheBytes = 0;
+  for (DWORD r = 0; r < repetitions; r++)
+  {
+    Disassembler disassembler;
+    Stopwatch stopwatch;
+    disassembler.AnalyzeSection(original, originalSection, jumps, ccRvas);
+    noneNs.push_back(stopwatch.ElapsedNanoseconds());
+
+    std::filesystem::remove_all(cacheDirectory, error);
+    {
+      stopwatch.Start();
+      AnalysisCache cache;
+      Disassembler cachedDisassembler;
+      cachedDisassembler.SetAnalysisCache(&cache);
+      const bool saved = cache.Open(cacheDirectory.c_str()) && cachedDisassembler.AnalyzeSection(original, originalSection, jumps, ccRvas) && cache.Save();
+      cleanNs.push_back(stopwatch.ElapsedNanoseconds());
+      if (!saved) return;
+    }
+    cacheBytes = GetDirectorySize(cacheDirectory);
+    {
+      stopwatch.Start();
+      AnalysisCache cache;
+      Disassembler cachedDisassembler;
+      cachedDisassembler.SetAnalysisCache(&cache);
+      const bool saved = cache.Open(cacheDirectory.c_str()) && cachedDisassembler.AnalyzeSection(changed, changedSection, jumps, ccRvas) && cache.Save();
+      incrementalNs.push_back(stopwatch.ElapsedNanoseconds());
+      cachedCount = cachedDisassembler.GetCachedFunctionCount();
+      if (!saved) return;
+    }
+  }
+  std::filesystem::remove_all(cacheDirectory, error);
+
+  const double megabytes = (double)settings.SectionSize / (1024 * 1024);
+  const double none = Median(noneNs);
+  const char* names[] = { "none", "clean", "incremental" };
+  std::vector<double>* times[] = { &noneNs, &cleanNs, &incrementalNs };
+  for (int i = 0; i < 3; i++)
+  {
+    const double nanoseconds = Median(*times[i]);
+
+    BenchmarkResult result;
+    result.Name = std::string("cache/") + names[i] + "/" + std::to_string(sizeMb) + "MB";
+    result.Operations = functions.size();
+    result.Nanoseconds = nanoseconds;
+    result.AddMetric("mb_per_s", megabytes * 1e9 / nanoseconds);
+    result.AddMetric("speedup", none / nanoseconds);
+    if (i == 2)
+    {
+      result.AddMetric("changed_functions", changedCount);
+      result.AddMetric("cached_functions", cachedCount);
+      result.AddMetric("cache_bytes", (double)cacheBytes);
+    }
+    reporter.Report(result);
+  }
+}
+
+ULONGLONG CacheBenchmark::GetDirectorySize(const std::string& directory)
+{
+  ULONGLONG size = 0;
+  std::error_code error;
+  for (const auto& entry : std::filesystem::directory_iterator(directory, error))
+  {
+    if (entry.is_regular_file(error)) size += entry.file_size(error);
+  }
+  return size;
+}
+
+double CacheBenchmark::Median(std::vector<double>& values)
+{
+  std::sort(values.begin(), values.end());
+  const size_t count = values.size();
+  return (count % 2 == 1) ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2.0;
+}
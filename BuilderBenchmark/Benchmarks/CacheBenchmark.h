@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "../../Builder/PEFile/PEFormat.h"
+
+class BenchmarkReporter;
+class BenchmarkOptions;
+
+// Incremental analysis: the section analysis of a PE32+ file with .pdata without a cache, with an empty cache (clean
+// build, includes writing the cache) and with the cache of the clean build after a share of the functions changed
+// (incremental build, includes loading and updating the cache). Reports the time, MB/s and the speedup over no cache.
+class CacheBenchmark
+{
+public:
+  CacheBenchmark();
+  ~CacheBenchmark();
+
+  void Run(BenchmarkReporter& reporter, BenchmarkOptions& options);
+
+private:
+  static ULONGLONG GetDirectorySize(const std::string& directory);
+  static double Median(std::vector<double>& values);
+};
@@ -0,0 +1,287 @@
+#include <stdlib.h>
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include "DensityBenchmark.h"
+#include "../Generator/SyntheticPEGenerator.h"
+#include "../../Benchmark/Common/BenchmarkOptions.h"
+#include "../../Benchmark/Common/BenchmarkReporter.h"
+#include "../../Benchmark/Common/Stopwatch.h"
+#include "../../Builder/Nanomites/DensityPolicy.h"
+#include "../../Builder/Nanomites/NanomitesCreator.h"
+#include "../../Builder/Nanomites/NanomiteMetadata.h"
+#include "../../Builder/PEFile/PEFile.h"
+#include "../../Builder/Pipeline/BuildPipeline.h"
+#include "../../Builder/Report/CostModel.h"
+
+DensityBenchmark::DensityBenchmark()
+{
+}
+
+DensityBenchmark::~DensityBenchmark()
+{
+}
+
+void DensityBenchmark::Run(BenchmarkReporter& reporter, BenchmarkOptions& options)
+{
+  if (!reporter.IsSelected("density")) return;
+
+  const DWORD sizeMb = (DWORD)options.GetInteger("size-mb", 16);
+  const DWORD repetitions = (DWORD)options.GetInteger("repetitions", 3);
+  const std::string sectionName = options.GetString("section", ".nano");
+  if (sizeMb == 0 || repetitions == 0) return;
+
+  // The reference converts every jump. Without --fraction a sweep from 50% down to 1% follows, 100% as well if one of
+  // the limits is given; the limits apply to every fraction.
+  const DWORD maxPerFunction = (DWORD)options.GetInteger("max-per-function", 0);
+  const DWORD maxPerBlock = (DWORD)options.GetInteger("max-per-block", 0);
+  std::vector<double> fractions = { 0.5, 0.25, 0.1, 0.05, 0.01 };
+  if (maxPerFunction != 0 || maxPerBlock != 0) fractions.insert(fractions.begin(), 1.0);
+  if (options.Has("fraction")) fractions = { std::min(std::max(options.GetDouble("fraction", 1.0), 0.0), 1.0) };
+  fractions.insert(fractions.begin(), -1.0);
+  if (options.Has("corpus"))
+  {
+    RunCorpus(reporter, options, fractions, maxPerFunction, maxPerBlock);
+    return;
+  }
+
+  // A given executable is used as it is, otherwise a synthetic one is generated and deleted at the end
+  std::string fileName = options.GetString("exe", "");
+  const bool isGenerated = fileName.empty();
+  const std::string label = isGenerated ? std::to_string(sizeMb) + "MB" : fileName.substr(fileName.find_last_of("/\\") + 1);
+  if (isGenerated)
+  {
+    fileName = SyntheticPEGenerator::GetTempFileName("nanomites-density.exe");
+
+    SyntheticPESettings settings;
+    settings.Is64Bit = true;
+    settings.SectionSize = sizeMb * 1024 * 1024;
+    settings.JumpsPerKb = (DWORD)options.GetInteger("density", 40);
+    settings.PaddingBytes = (DWORD)options.GetInteger("padding", 8);
+    settings.FunctionTable = true;
+    settings.DataSize = 0;
+    settings.Seed = 0x2545F491;
+    SyntheticPEGenerator generator;
+    if (!generator.Generate(fileName.c_str(), settings)) return;
+  }
+
+  Measurement full = {};
+  for (double fraction : fractions)
+  {
+    const bool isReference = fraction < 0.0;
+    DensityPolicy policy;
+    if (!isReference)
+    {
+      policy.SetFraction(fraction);
+      policy.SetMaxPerFunction(maxPerFunction);
+      policy.SetMaxPerBlock(maxPerBlock);
+    }
+
+    std::vector<double> elapsed;
+    Measurement measurement = {};
+    for (DWORD r = 0; r < repetitions && Protect(fileName, sectionName, policy, measurement); r++)
+    {
+      elapsed.push_back(measurement.Nanoseconds);
+    }
+    if (elapsed.size() != repetitions) break;
+    if (isReference) full = measurement;
+    const double nanoseconds = Median(elapsed);
+
+    BenchmarkResult result;
+    result.Name = "density/" + (isReference ? std::string("all") : std::to_string((DWORD)(fraction * 100.0 + 0.5)) + "pct") + "/" + label;
+    result.Operations = full.SiteCount; // Time per jump of the section, comparable between the fractions
+    result.Nanoseconds = nanoseconds;
+    result.AddMetric("sites", measurement.SiteCount);
+    result.AddMetric("sites_pct", full.SiteCount == 0 ? 0.0 : 100.0 * measurement.SiteCount / full.SiteCount);
+    result.AddMetric("functions_covered_pct", measurement.FunctionCount == 0 ? 0.0 : 100.0 * measurement.CoveredFunctionCount / measurement.FunctionCount);
+    result.AddMetric("metadata_bytes", measurement.MetadataSize);
+    result.AddMetric("estimated_cycles", measurement.Cycles);
+    result.AddMetric("overhead_vs_all", full.Cycles == 0.0 ? 0.0 : measurement.Cycles / full.Cycles);
+    reporter.Report(result);
+  }
+
+  std::error_code error;
+  if (isGenerated) std::filesystem::remove(fileName, error);
+}
+
+void DensityBenchmark::RunCorpus(BenchmarkReporter& reporter, BenchmarkOptions& options, const std::vector<double>& fractions, DWORD maxPerFunction, DWORD maxPerBlock)
+{
+  // The copy stays next to the demo, so it finds the same DLLs
+  const std::string exeFile = options.GetString("corpus", "");
+  const DWORD scale = (DWORD)options.GetInteger("corpus-scale", 1);
+  const std::string label = exeFile.substr(exeFile.find_last_of("/\\") + 1);
+  const std::string copyFile = (std::filesystem::path(exeFile).parent_path() / "nanomites-density-corpus.exe").string();
+
+  CorpusMeasurement full = {};
+  for (double fraction : fractions)
+  {
+    const bool isReference = fraction < 0.0;
+    DensityPolicy policy;
+    policy.SetFraction(isReference ? 1.0 : fraction);
+    policy.SetMaxPerFunction(isReference ? 0 : maxPerFunction);
+    policy.SetMaxPerBlock(isReference ? 0 : maxPerBlock);
+
+    DWORD siteCount = 0;
+    std::string output;
+    CorpusMeasurement measurement = {};
+    if (!ProtectCopy(exeFile, copyFile, isReference ? nullptr : &policy, siteCount))
+    {
+      std::cout << "Protecting a copy of " << exeFile << " failed!" << std::endl;
+      break;
+    }
+    if (!RunHarness(copyFile, scale, output))
+    {
+      std::cout << "Running " << copyFile << " --corpus failed, the corpus needs the Windows runtime." << std::endl;
+      break;
+    }
+    if (!ParseHarness(output, measurement)) break;
+    if (isReference) full = measurement;
+
+    BenchmarkResult result;
+    result.Name = "density/corpus/" + (isReference ? std::string("all") : std::to_string((DWORD)(fraction * 100.0 + 0.5)) + "pct") + "/" + label;
+    result.Operations = measurement.KernelCount;
+    result.Nanoseconds = measurement.ProtectedMicroseconds * 1000.0;
+    result.AddMetric("sites", siteCount);
+    result.AddMetric("unprotected_us", measurement.UnprotectedMicroseconds);
+    result.AddMetric("protected_us", measurement.ProtectedMicroseconds);
+    result.AddMetric("slowdown", measurement.Slowdown);
+    result.AddMetric("slowdown_vs_all", full.Slowdown == 0.0 ? 0.0 : measurement.Slowdown / full.Slowdown);
+    result.AddMetric("traps", (double)measurement.TrapCount);
+    result.AddMetric("mismatches", measurement.MismatchCount);
+    reporter.Report(result);
+  }
+
+  std::error_code error;
+  std::filesystem::remove(copyFile, error);
+}
+
+bool DensityBenchmark::ProtectCopy(const std::string& exeFile, const std::string& copyFile, const DensityPolicy* policy, DWORD& outSiteCount)
+{
+  // The whole build as the post-build step runs it, with a fixed seed
+  std::error_code error;
+  if (!std::filesystem::copy_file(exeFile, copyFile, std::filesystem::copy_options::overwrite_existing, error)) return false;
+  BuildPipeline pipeline;
+  pipeline.SetSeed(0x2545F4914F6CDD1DULL);
+  pipeline.SetDensityPolicy(policy);
+  if (!pipeline.Run(copyFile.c_str(), ".nano")) return false;
+  outSiteCount = pipeline.GetJumpCount();
+  return true;
+}
+
+bool DensityBenchmark::RunHarness(const std::string& exeFile, DWORD scale, std::string& outOutput)
+{
+#ifdef _WIN32
+  // Standard input from NUL ends the final "Press ENTER" prompt of the demo
+  const std::string outputFile = exeFile + ".txt";
+  SECURITY_ATTRIBUTES attributes = { sizeof(attributes), nullptr, TRUE };
+  HANDLE input = CreateFileA("NUL", GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, &attributes, OPEN_EXISTING, 0, nullptr);
+  HANDLE output = CreateFileA(outputFile.c_str(), GENERIC_WRITE, FILE_SHARE_READ, &attributes, CREATE_ALWAYS, 0, nullptr);
+  BOOL created = FALSE;
+  PROCESS_INFORMATION processInfo = {};
+  if (input != INVALID_HANDLE_VALUE && output != INVALID_HANDLE_VALUE)
+  {
+    STARTUPINFOA startupInfo = {};
+    startupInfo.cb = sizeof(startupInfo);
+    startupInfo.dwFlags = STARTF_USESTDHANDLES;
+    startupInfo.hStdInput = input;
+    startupInfo.hStdOutput = output;
+    startupInfo.hStdError = output;
+    std::string commandLine = "\"" + exeFile + "\" --corpus " + std::to_string(scale);
+    created = CreateProcessA(nullptr, commandLine.data(), nullptr, nullptr, TRUE, 0, nullptr, nullptr, &startupInfo, &processInfo);
+  }
+  if (input != INVALID_HANDLE_VALUE) CloseHandle(input);
+  if (output != INVALID_HANDLE_VALUE) CloseHandle(output);
+  if (created)
+  {
+    WaitForSingleObject(processInfo.hProcess, INFINITE);
+    CloseHandle(processInfo.hThread);
+    CloseHandle(processInfo.hProcess);
+
+    std::ifstream file(outputFile);
+    outOutput.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  }
+  std::error_code error;
+  std::filesystem::remove(outputFile, error);
+  return created != FALSE;
+#else
+  // The runtime with its Tracer is Windows-only
+  return false;
+#endif
+}
+
+bool DensityBenchmark::ParseHarness(const std::string& output, CorpusMeasurement& outMeasurement)
+{
+  // One row per kernel behind the header line: name, input bytes, unprotected "us", protected "us", slowdown "x",
+  // traps, traps per byte and an optional "RESULT MISMATCH"
+  outMeasurement = {};
+  double logSlowdown = 0.0;
+  std::istringstream stream(output);
+  std::string line;
+  bool isTable = false;
+  while (std::getline(stream, line))
+  {
+    std::istringstream row(line);
+    std::string name, unit, slowdown, mismatch;
+    DWORD inputBytes;
+    double unprotectedUs, protectedUs, trapsPerByte;
+    ULONGLONG traps;
+    if (!isTable)
+    {
+      isTable = (row >> name) && name == "kernel";
+      continue;
+    }
+    // Other output, e.g. of the storm detector, may come in between
+    if (!(row >> name >> inputBytes >> unprotectedUs >> unit >> protectedUs >> unit >> slowdown >> traps >> trapsPerByte)) continue;
+    outMeasurement.KernelCount++;
+    outMeasurement.UnprotectedMicroseconds += unprotectedUs;
+    outMeasurement.ProtectedMicroseconds += protectedUs;
+    outMeasurement.TrapCount += traps;
+    if (row >> mismatch) outMeasurement.MismatchCount++;
+    logSlowdown += std::log(std::max(atof(slowdown.c_str()), 1e-9));
+  }
+  if (outMeasurement.KernelCount == 0) return false;
+  outMeasurement.Slowdown = std::exp(logSlowdown / outMeasurement.KernelCount);
+  return true;
+}
+
+bool DensityBenchmark::Protect(const std::string& fileName, const std::string& sectionName, const DensityPolicy& policy, Measurement& outMeasurement)
+{
+  // A fresh image per run, the creator patches it
+  PEFile peFile;
+  if (!peFile.OpenFile(fileName.c_str(), LoadMode::Buffer)) return false;
+  const PeSectionHeader* sectionHeader = peFile.FindSectionByName(sectionName.c_str());
+  if (sectionHeader == nullptr) return false;
+
+  CostModel costModel;
+  NanomitesCreator creator;
+  creator.SetSeed(0x2545F4914F6CDD1DULL);
+  creator.SetDensityPolicy(&policy);
+  creator.SetCostModel(&costModel);
+
+  Stopwatch stopwatch;
+  NanomiteMetadata* metadata = creator.Create(peFile, sectionHeader);
+  outMeasurement.Nanoseconds = stopwatch.ElapsedNanoseconds();
+  // Header, nanomites and decoys of resource 1234
+  outMeasurement.MetadataSize = (peFile.Is64Bit() ? 16 : 8) + metadata->ItemCount * (DWORD)sizeof(Nanomite);
+  delete[] metadata->Nanomites;
+  delete[] metadata->Sections;
+  delete metadata;
+
+  const SectionReport& report = creator.GetSectionReports().front();
+  outMeasurement.SiteCount = creator.GetJumpCount();
+  outMeasurement.FunctionCount = report.FunctionCount;
+  outMeasurement.CoveredFunctionCount = (DWORD)report.Functions.size();
+  outMeasurement.Cycles = report.Cycles;
+  return true;
+}
+
+double DensityBenchmark::Median(std::vector<double>& values)
+{
+  std::sort(values.begin(), values.end());
+  const size_t count = values.size();
+  return (count % 2 == 1) ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2.0;
+}
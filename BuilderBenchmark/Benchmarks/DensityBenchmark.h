@@ -0,0 +1,55 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "../../Builder/PEFile/PEFormat.h"
+
+class BenchmarkReporter;
+class BenchmarkOptions;
+class DensityPolicy;
+
+// Overhead versus density: protects the .nano section of a PE32+ file with .pdata (or of --exe, e.g. the demo before
+// its post-build step) once with every jump and then with a DensityPolicy at fractions from 50% down to 1%. For every
+// run it reports the sites, the share of the functions that keep at least one site, the metadata size, the build time
+// and the static trap cycles of CostModel relative to converting every jump.
+// With --corpus (the demo before its post-build step) it measures the runtime overhead instead: every policy protects
+// a copy of the demo, which then runs its workload corpus ("Nanomites.exe --corpus") under the Tracer. This needs the
+// Windows runtime.
+class DensityBenchmark
+{
+public:
+  DensityBenchmark();
+  ~DensityBenchmark();
+
+  void Run(BenchmarkReporter& reporter, BenchmarkOptions& options);
+
+private:
+  struct Measurement
+  {
+    double Nanoseconds;
+    DWORD SiteCount;
+    DWORD MetadataSize;
+    DWORD FunctionCount;
+    DWORD CoveredFunctionCount;   // With at least one site
+    double Cycles;
+  };
+
+  // Sums of the kernels of one corpus run
+  struct CorpusMeasurement
+  {
+    DWORD KernelCount;
+    double UnprotectedMicroseconds;
+    double ProtectedMicroseconds;
+    double Slowdown;              // Geometric mean of the kernels
+    ULONGLONG TrapCount;
+    DWORD MismatchCount;          // Kernels whose protected result differs
+  };
+
+  void RunCorpus(BenchmarkReporter& reporter, BenchmarkOptions& options, const std::vector<double>& fractions, DWORD maxPerFunction, DWORD maxPerBlock);
+  static bool ProtectCopy(const std::string& exeFile, const std::string& copyFile, const DensityPolicy* policy, DWORD& outSiteCount);
+  // Runs "<exe> --corpus <scale>" with its output redirected, false where the runtime cannot run
+  static bool RunHarness(const std::string& exeFile, DWORD scale, std::string& outOutput);
+  static bool ParseHarness(const std::string& output, CorpusMeasurement& outMeasurement);
+
+  static bool Protect(const std::string& fileName, const std::string& sectionName, const DensityPolicy& policy, Measurement& outMeasurement);
+  static double Median(std::vector<double>& values);
+};
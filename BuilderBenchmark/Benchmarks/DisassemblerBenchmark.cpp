@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <filesystem>
+#include <set>
+#include <string>
+#include <thread>
+#include "DisassemblerBenchmark.h"
+#include "../Generator/SyntheticPEGenerator.h"
+#include "../../Benchmark/Common/BenchmarkOptions.h"
+#include "../../Benchmark/Common/BenchmarkReporter.h"
+#include "../../Benchmark/Common/Stopwatch.h"
+#include "../../Builder/Disassembler/Disassembler.h"
+#include "../../Builder/PEFile/PEFile.h"
+#include "../../Tests/Builder/ReferenceDisassembler.h"
+
+DisassemblerBenchmark::DisassemblerBenchmark()
+{
+}
+
+DisassemblerBenchmark::~DisassemblerBenchmark()
+{
+}
+
+void DisassemblerBenchmark::Run(BenchmarkReporter& reporter, BenchmarkOptions& options)
+{
+  if (!reporter.IsSelected("disassembler")) return;
+
+  const DWORD sizeMb = (DWORD)options.GetInteger("size-mb", 128);
+  const DWORD repetitions = (DWORD)options.GetInteger("repetitions", 3);
+  if (sizeMb == 0 || repetitions == 0) return;
+
+  const std::string fileName = SyntheticPEGenerator::GetTempFileName("nanomites-disassembler.exe");
+
+  SyntheticPESettings settings;
+  settings.Is64Bit = sizeof(void*) == 8;
+  settings.SectionSize = sizeMb * 1024 * 1024;
+  settings.JumpsPerKb = (DWORD)options.GetInteger("density", 40);
+  settings.PaddingBytes = (DWORD)options.GetInteger("padding", 8);
+  settings.FunctionTable = options.GetInteger("pdata", 1) != 0;
+  settings.DataSize = 0;
+  settings.Seed = 0x2545F491;
+
+  SyntheticPEGenerator generator;
+  PEFile peFile;
+  const bool loaded = generator.Generate(fileName.c_str(), settings) && peFile.OpenFile(fileName.c_str(), LoadMode::Buffer);
+  std::error_code error;
+  std::filesystem::remove(fileName, error);
+  if (!loaded) return;
+  const PeSectionHeader* sectionHeader = peFile.FindSectionByName(".nano");
+  if (sectionHeader == nullptr) return;
+
+  Disassembler disassembler;
+  disassembler.SetAnalysisMode(AnalysisMode::LinearSweep);
+  disassembler.SetThreadCount(1);
+  std::vector<double> twoPassNs, fusedNs;
+  std::vector<RelativeJump> twoPassJumps, fusedJumps;
+  std::set<DWORD> twoPassCCs;
+  std::vector<DWORD> fusedCCs;
+  for (DWORD r = 0; r < repetitions; r++)
+  {
+    twoPassJumps.clear();
+    twoPassCCs.clear();
+    Stopwatch stopwatch;
+    ReferenceDisassembler::GetCCs(peFile, sectionHeader, twoPassCCs);
+    ReferenceDisassembler::GetRelativeJumps(peFile, sectionHeader, twoPassJumps);
+    twoPassNs.push_back(stopwatch.ElapsedNanoseconds());
+
+    stopwatch.Start();
+    disassembler.AnalyzeSection(peFile, sectionHeader, fusedJumps, fusedCCs);
+    fusedNs.push_back(stopwatch.ElapsedNanoseconds());
+  }
+
+  // Both variants have to find the same sites
+  bool match = twoPassJumps.size() == fusedJumps.size() && twoPassCCs.size() == fusedCCs.size() && std::equal(fusedCCs.begin(), fusedCCs.end(), twoPassCCs.begin());
+  for (size_t i = 0; match && i < fusedJumps.size(); i++)
+  {
+    match = twoPassJumps[i].Rva == fusedJumps[i].Rva && twoPassJumps[i].Opcode == fusedJumps[i].Opcode && twoPassJumps[i].JmpLength == fusedJumps[i].JmpLength;
+  }
+
+  const double megabytes = (double)settings.SectionSize / (1024 * 1024);
+  const double twoPass = Median(twoPassNs);
+  const double fused = Median(fusedNs);
+
+  BenchmarkResult twoPassResult;
+  twoPassResult.Name = "disassembler/two-pass/" + std::to_string(sizeMb) + "MB";
+  twoPassResult.Operations = twoPassJumps.size();
+  twoPassResult.Nanoseconds = twoPass;
+  twoPassResult.AddMetric("mb_per_s", megabytes * 1e9 / twoPass);
+  reporter.Report(twoPassResult);
+
+  BenchmarkResult fusedResult;
+  fusedResult.Name = "disassembler/fused/" + std::to_string(sizeMb) + "MB";
+  fusedResult.Operations = fusedJumps.size();
+  fusedResult.Nanoseconds = fused;
+  fusedResult.AddMetric("mb_per_s", megabytes * 1e9 / fused);
+  fusedResult.AddMetric("speedup", twoPass / fused);
+  fusedResult.AddMetric("results_match", match ? 1.0 : 0.0);
+  reporter.Report(fusedResult);
+
+  RunParallel(reporter, options, peFile, sectionHeader, sizeMb, AnalysisMode::LinearSweep, generator.GetJumpCount());
+  RunParallel(reporter, options, peFile, sectionHeader, sizeMb, AnalysisMode::ControlFlow, generator.GetJumpCount());
+}
+
+void DisassemblerBenchmark::RunParallel(BenchmarkReporter& reporter, BenchmarkOptions& options, PEFile& peFile, const PeSectionHeader* sectionHeader, DWORD sizeMb, AnalysisMode mode, DWORD generatedJumps)
+{
+  DWORD maxThreads = (DWORD)options.GetInteger("threads", std::thread::hardware_concurrency());
+  if (maxThreads == 0) maxThreads = 1;
+  const DWORD repetitions = (DWORD)options.GetInteger("repetitions", 3);
+  const double megabytes = (double)sectionHeader->SizeOfRawData / (1024 * 1024);
+
+  Disassembler disassembler;
+  disassembler.SetAnalysisMode(mode);
+  const std::string modeName = mode == AnalysisMode::LinearSweep ? "linear" : "control-flow";
+  std::vector<RelativeJump> serialJumps, jumps;
+  std::vector<DWORD> serialCCs, ccs;
+  double serialNs = 0.0;
+  // 1, 2, 4, ... threads, always ending with the requested maximum
+  for (DWORD threads = 1; threads != 0; threads = (threads == maxThreads) ? 0 : std::min(threads * 2, maxThreads))
+  {
+    disassembler.SetThreadCount(threads);
+    std::vector<double> elapsed;
+    for (DWORD r = 0; r < repetitions; r++)
+    {
+      Stopwatch stopwatch;
+      disassembler.AnalyzeSection(peFile, sectionHeader, jumps, ccs);
+      elapsed.push_back(stopwatch.ElapsedNanoseconds());
+    }
+    const double nanoseconds = Median(elapsed);
+    if (threads == 1)
+    {
+      serialNs = nanoseconds;
+      serialJumps = jumps;
+      serialCCs = ccs;
+    }
+
+    BenchmarkResult result;
+    result.Name = "disassembler/" + modeName + "/" + std::to_string(threads) + "t/" + std::to_string(sizeMb) + "MB";
+    result.Operations = jumps.size();
+    result.Nanoseconds = nanoseconds;
+    result.AddMetric("mb_per_s", megabytes * 1e9 / nanoseconds);
+    result.AddMetric("speedup", serialNs / nanoseconds);
+    result.AddMetric("results_match", IsEqual(serialJumps, serialCCs, jumps, ccs) ? 1.0 : 0.0);
+    // Share of the generated jumps that were found; the recursive descent skips code behind unconditional jumps
+    result.AddMetric("coverage", generatedJumps != 0 ? (double)jumps.size() / generatedJumps : 0.0);
+    result.AddMetric("functions", disassembler.GetFunctionCount());
+    reporter.Report(result);
+  }
+}
+
+bool DisassemblerBenchmark::IsEqual(const std::vector<RelativeJump>& jumps1, const std::vector<DWORD>& ccs1, const std::vector<RelativeJump>& jumps2, const std::vector<DWORD>& ccs2)
+{
+  if (jumps1.size() != jumps2.size() || ccs1 != ccs2) return false;
+  for (size_t i = 0; i < jumps1.size(); i++)
+  {
+    if (jumps1[i].Rva != jumps2[i].Rva || jumps1[i].Opcode != jumps2[i].Opcode || jumps1[i].OpcodeLength != jumps2[i].OpcodeLength || jumps1[i].JmpLength != jumps2[i].JmpLength) return false;
+  }
+  return true;
+}
+
+double DisassemblerBenchmark::Median(std::vector<double>& values)
+{
+  std::sort(values.begin(), values.end());
+  const size_t count = values.size();
+  return (count % 2 == 1) ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2.0;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <vector>
+#include "../../Builder/Disassembler/Disassembler.h"
+#include "../../Builder/PEFile/PEFile.h"
+
+class BenchmarkReporter;
+class BenchmarkOptions;
+
+// Section analysis of the Builder: the fused single pass (Disassembler::AnalyzeSection) against the
+// previous full disassembly plus separate 0xCC scan, then the linear sweep and the control flow analysis for 1..N threads.
+class DisassemblerBenchmark
+{
+public:
+  DisassemblerBenchmark();
+  ~DisassemblerBenchmark();
+
+  void Run(BenchmarkReporter& reporter, BenchmarkOptions& options);
+
+private:
+  void RunParallel(BenchmarkReporter& reporter, BenchmarkOptions& options, PEFile& peFile, const PeSectionHeader* sectionHeader, DWORD sizeMb, AnalysisMode mode, DWORD generatedJumps);
+  static bool IsEqual(const std::vector<RelativeJump>& jumps1, const std::vector<DWORD>& ccs1, const std::vector<RelativeJump>& jumps2, const std::vector<DWORD>& ccs2);
+  static double Median(std::vector<double>& values);
+};
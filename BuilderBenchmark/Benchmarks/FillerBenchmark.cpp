@@ -0,0 +1,119 @@
+#include <stdlib.h>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include "FillerBenchmark.h"
+#include "../../Benchmark/Common/BenchmarkOptions.h"
+#include "../../Benchmark/Common/BenchmarkReporter.h"
+#include "../../Benchmark/Common/Stopwatch.h"
+#include "../../Builder/Nanomites/RandomGenerator.h"
+
+FillerBenchmark::FillerBenchmark()
+{
+}
+
+FillerBenchmark::~FillerBenchmark()
+{
+}
+
+void FillerBenchmark::Run(BenchmarkReporter& reporter, BenchmarkOptions& options)
+{
+  if (!reporter.IsSelected("filler")) return;
+
+  const DWORD siteCount = (DWORD)options.GetInteger("sites", 4 * 1024 * 1024);
+  const DWORD repetitions = (DWORD)options.GetInteger("repetitions", 5);
+  DWORD maxThreads = (DWORD)options.GetInteger("threads", std::thread::hardware_concurrency());
+  if (maxThreads == 0) maxThreads = 1;
+  if (siteCount == 0 || repetitions == 0) return;
+
+  const ULONGLONG seed = 0x2545F4914F6CDD1DULL;
+  const double megabytes = (double)siteCount * SITE_SIZE / (1024 * 1024);
+  std::vector<BYTE> output((size_t)siteCount * SITE_SIZE);
+
+  // Reference: the global rand() of the CRT, which neither runs in parallel nor repeats between builds
+  srand(1);
+  std::vector<double> legacyNs;
+  for (DWORD r = 0; r < repetitions; r++)
+  {
+    Stopwatch stopwatch;
+    FillLegacy(output.data(), siteCount);
+    legacyNs.push_back(stopwatch.ElapsedNanoseconds());
+  }
+  const double legacy = Median(legacyNs);
+
+  BenchmarkResult legacyResult;
+  legacyResult.Name = "filler/rand/" + std::to_string(siteCount) + "sites";
+  legacyResult.Operations = siteCount;
+  legacyResult.Nanoseconds = legacy;
+  legacyResult.AddMetric("msites_per_s", siteCount * 1e3 / legacy);
+  legacyResult.AddMetric("mb_per_s", megabytes * 1e9 / legacy);
+  reporter.Report(legacyResult);
+
+  // 1, 2, 4, ... threads, always ending with the requested maximum
+  std::vector<BYTE> serial;
+  for (DWORD threads = 1; threads != 0; threads = (threads == maxThreads) ? 0 : std::min(threads * 2, maxThreads))
+  {
+    std::vector<double> elapsed;
+    for (DWORD r = 0; r < repetitions; r++)
+    {
+      std::fill(output.begin(), output.end(), 0);
+      Stopwatch stopwatch;
+      std::vector<std::thread> workers;
+      for (DWORD t = 0; t < threads; t++)
+      {
+        const DWORD begin = (DWORD)((ULONGLONG)siteCount * t / threads);
+        const DWORD end = (DWORD)((ULONGLONG)siteCount * (t + 1) / threads);
+        workers.emplace_back(FillStreams, output.data() + (size_t)begin * SITE_SIZE, begin, end - begin, seed);
+      }
+      for (auto& worker : workers) worker.join();
+      elapsed.push_back(stopwatch.ElapsedNanoseconds());
+    }
+    if (threads == 1) serial = output;
+    const double nanoseconds = Median(elapsed);
+
+    BenchmarkResult result;
+    result.Name = "filler/streams/" + std::to_string(threads) + "t/" + std::to_string(siteCount) + "sites";
+    result.Operations = siteCount;
+    result.Nanoseconds = nanoseconds;
+    result.AddMetric("msites_per_s", siteCount * 1e3 / nanoseconds);
+    result.AddMetric("mb_per_s", megabytes * 1e9 / nanoseconds);
+    result.AddMetric("speedup", legacy / nanoseconds);
+    result.AddMetric("results_match", output == serial ? 1.0 : 0.0);
+    reporter.Report(result);
+  }
+}
+
+void FillerBenchmark::FillLegacy(BYTE* output, DWORD siteCount)
+{
+  // NanomitesCreator::GetRandomByte before the per-site streams
+  for (DWORD i = 0; i < siteCount; i++)
+  {
+    BYTE* site = output + (size_t)i * SITE_SIZE;
+    for (DWORD j = 0; j < FILLER_SIZE; j++)
+    {
+      site[j] = (BYTE)(((double)rand() / RAND_MAX) * 255);
+    }
+    site[FILLER_SIZE] = (BYTE)(((double)rand() / RAND_MAX) * (0x7F - 0x70) + 0x70);
+    site[FILLER_SIZE + 1] = (BYTE)(((double)rand() / RAND_MAX) * (0xA0 - 0x02) + 0x02);
+  }
+}
+
+void FillerBenchmark::FillStreams(BYTE* output, DWORD firstSite, DWORD siteCount, ULONGLONG seed)
+{
+  // As NanomitesCreator: a stream per site, keyed by its RVA
+  for (DWORD i = 0; i < siteCount; i++)
+  {
+    BYTE* site = output + (size_t)i * SITE_SIZE;
+    RandomGenerator random(seed, firstSite + i);
+    random.Fill(site, FILLER_SIZE);
+    site[FILLER_SIZE] = random.NextByte(0x70, 0x7F);
+    site[FILLER_SIZE + 1] = random.NextByte(0x02, 0xA0);
+  }
+}
+
+double FillerBenchmark::Median(std::vector<double>& values)
+{
+  std::sort(values.begin(), values.end());
+  const size_t count = values.size();
+  return (count % 2 == 1) ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2.0;
+}
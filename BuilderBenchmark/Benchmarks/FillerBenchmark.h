@@ -0,0 +1,27 @@
+#pragma once
+#include <vector>
+#include "../../Builder/PEFile/PEFormat.h"
+
+class BenchmarkReporter;
+class BenchmarkOptions;
+
+// Random bytes of the patch phase: per site the filler behind the 0xCC of a 6 byte jump plus the type and length of a
+// decoy. Compares the previous rand() with a double division per byte against the per-site RandomGenerator streams
+// of the Builder on 1, 2, 4, ... threads, and checks that every thread count produces the same bytes.
+class FillerBenchmark
+{
+public:
+  FillerBenchmark();
+  ~FillerBenchmark();
+
+  void Run(BenchmarkReporter& reporter, BenchmarkOptions& options);
+
+private:
+  static void FillLegacy(BYTE* output, DWORD siteCount);
+  static void FillStreams(BYTE* output, DWORD firstSite, DWORD siteCount, ULONGLONG seed);
+  static double Median(std::vector<double>& values);
+
+private:
+  static const DWORD FILLER_SIZE = 5;              // Behind the 0xCC of a near conditional jump
+  static const DWORD SITE_SIZE = FILLER_SIZE + 2;  // Plus the decoy jump type and length
+};
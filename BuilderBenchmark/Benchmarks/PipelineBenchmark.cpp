@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include "PipelineBenchmark.h"
+#include "../Generator/SyntheticPEGenerator.h"
+#include "../../Benchmark/Common/BenchmarkOptions.h"
+#include "../../Benchmark/Common/BenchmarkReporter.h"
+#include "../../Benchmark/Common/ProcessMetrics.h"
+#include "../../Builder/Instrumentation/PhaseProfiler.h"
+
+PipelineBenchmark::PipelineBenchmark()
+{
+  _repetitions = 3;
+}
+
+PipelineBenchmark::~PipelineBenchmark()
+{
+}
+
+void PipelineBenchmark::Run(BenchmarkReporter& reporter, BenchmarkOptions& options)
+{
+  if (!reporter.IsSelected("builder")) return;
+
+  _repetitions = (DWORD)options.GetInteger("repetitions", 3);
+  const DWORD jumpsPerKb = (DWORD)options.GetInteger("density", 40);
+  const DWORD paddingBytes = (DWORD)options.GetInteger("padding", 8);
+  // The Builder decodes in the mode of the input, independent of its own platform
+  const bool is64Bit = options.GetInteger("pe64", 1) != 0;
+  // Data the Builder never touches: read in Buffer mode, only mapped in Mapping mode
+  const DWORD dataMb = (DWORD)options.GetInteger("data-mb", 0);
+  const std::string load = options.GetString("load", "both");
+  const std::string write = options.GetString("write", "replace");
+  if (_repetitions == 0) return;
+
+  // The peak working set only grows, so the mapped runs go first
+  std::vector<LoadMode> loadModes;
+  if (load != "buffer") loadModes.push_back(LoadMode::Mapping);
+  if (load != "map") loadModes.push_back(LoadMode::Buffer);
+  std::vector<WriteMode> writeModes;
+  if (write != "in-place") writeModes.push_back(WriteMode::Replace);
+  if (write != "replace") writeModes.push_back(WriteMode::InPlace);
+
+  std::vector<DWORD> sizesMb = { 1, 16, 128 };
+  if (options.Has("size-mb")) sizesMb = { (DWORD)options.GetInteger("size-mb", 1) };
+  for (LoadMode loadMode : loadModes)
+  {
+    for (WriteMode writeMode : writeModes)
+    {
+      for (DWORD sizeMb : sizesMb)
+      {
+        RunSize(reporter, sizeMb, dataMb, jumpsPerKb, paddingBytes, is64Bit, loadMode, writeMode);
+      }
+    }
+  }
+}
+
+void PipelineBenchmark::RunSize(BenchmarkReporter& reporter, DWORD sizeMb, DWORD dataMb, DWORD jumpsPerKb, DWORD paddingBytes, bool is64Bit, LoadMode loadMode, WriteMode writeMode)
+{
+  const std::string inputFile = SyntheticPEGenerator::GetTempFileName("nanomites-synthetic.exe");
+  const std::string workFile = SyntheticPEGenerator::GetTempFileName("nanomites-synthetic-work.exe");
+  std::error_code error;
+
+  SyntheticPESettings settings;
+  settings.Is64Bit = is64Bit;
+  settings.SectionSize = sizeMb * 1024 * 1024;
+  settings.JumpsPerKb = jumpsPerKb;
+  settings.PaddingBytes = paddingBytes;
+  settings.FunctionTable = true;
+  settings.DataSize = dataMb * 1024 * 1024;
+  settings.Seed = 0x2545F491;
+
+  SyntheticPEGenerator generator;
+  if (!generator.Generate(inputFile.c_str(), settings)) return;
+
+  // The pipeline modifies its input, every repetition starts from a fresh copy
+  std::vector<std::string> phaseNames;
+  std::map<std::string, std::vector<double>> phaseMs;
+  std::vector<double> totalMs;
+  DWORD jumps = 0;
+  DWORD dirtyPages = 0;
+  SIZE_T privateBytes = 0;
+  ULONGLONG writtenBytes = 0;
+  DWORD writeCount = 0;
+  bool inPlace = false;
+  for (DWORD r = 0; r < _repetitions; r++)
+  {
+    if (!std::filesystem::copy_file(inputFile, workFile, std::filesystem::copy_options::overwrite_existing, error)) break;
+
+    const SIZE_T baselineBytes = ProcessMetrics::GetPrivateBytes();
+    PhaseProfiler profiler;
+    BuildPipeline pipeline;
+    pipeline.SetPhaseProfiler(&profiler);
+    pipeline.SetLoadMode(loadMode);
+    pipeline.SetWriteMode(writeMode);
+    if (!pipeline.Run(workFile.c_str(), ".nano")) break;
+    jumps = pipeline.GetJumpCount();
+    dirtyPages = pipeline.GetDirtyPageCount();
+    writtenBytes = pipeline.GetWrittenBytes();
+    writeCount = pipeline.GetWriteCount();
+    inPlace = pipeline.GetUsedWriteMode() == WriteMode::InPlace;
+
+    double total = 0.0;
+    for (const auto& phase : profiler.GetPhases())
+    {
+      if (r == 0) phaseNames.push_back(phase.Name);
+      phaseMs[phase.Name].push_back(phase.Milliseconds);
+      total += phase.Milliseconds;
+      if (phase.PrivateBytes > baselineBytes) privateBytes = std::max(privateBytes, (SIZE_T)(phase.PrivateBytes - baselineBytes));
+    }
+    totalMs.push_back(total);
+  }
+  std::filesystem::remove(workFile, error);
+  std::filesystem::remove(inputFile, error);
+  if (totalMs.size() != _repetitions) return;
+
+  const double megabytes = (double)settings.SectionSize / (1024 * 1024);
+  phaseNames.push_back("total");
+  phaseMs["total"] = totalMs;
+  for (const auto& name : phaseNames)
+  {
+    const double milliseconds = Median(phaseMs[name]);
+
+    BenchmarkResult result;
+    result.Name = "builder/" + name + "/" + std::to_string(sizeMb) + "MB" + (loadMode == LoadMode::Buffer ? "/buffer" : "") +
+      (writeMode == WriteMode::InPlace ? "/in-place" : "");
+    result.Operations = jumps;
+    result.Nanoseconds = milliseconds * 1e6;
+    result.AddMetric("mb_per_s", megabytes * 1000.0 / milliseconds);
+    result.AddMetric("jumps_per_s", jumps * 1000.0 / milliseconds);
+    if (name == "total")
+    {
+      result.AddMetric("jumps_generated", generator.GetJumpCount());
+      result.AddMetric("peak_working_set", (double)ProcessMetrics::GetPeakWorkingSet());
+      result.AddMetric("private_bytes", (double)privateBytes);
+      result.AddMetric("dirty_pages", dirtyPages);
+      result.AddMetric("written_bytes", (double)writtenBytes);
+      result.AddMetric("write_calls", writeCount);
+      // Zero if the patches were too large and the file was replaced
+      result.AddMetric("in_place", inPlace ? 1 : 0);
+    }
+    reporter.Report(result);
+  }
+}
+
+double PipelineBenchmark::Median(std::vector<double>& values)
+{
+  std::sort(values.begin(), values.end());
+  const size_t count = values.size();
+  return (count % 2 == 1) ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2.0;
+}
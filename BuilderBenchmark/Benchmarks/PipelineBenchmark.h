@@ -0,0 +1,27 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "../../Builder/Pipeline/BuildPipeline.h"
+
+class BenchmarkReporter;
+class BenchmarkOptions;
+
+// Builder throughput: runs the complete pipeline (BuildPipeline) on synthetic executables of growing size
+// and reports MB/s and jumps/s for every phase. The input is mapped (LoadMode::Mapping) or read into memory
+// (LoadMode::Buffer, results end with /buffer); the memory metrics show what the mapping saves. The output either
+// replaces the file or patches it in place (WriteMode::InPlace, results end with /in-place).
+class PipelineBenchmark
+{
+public:
+  PipelineBenchmark();
+  ~PipelineBenchmark();
+
+  void Run(BenchmarkReporter& reporter, BenchmarkOptions& options);
+
+private:
+  void RunSize(BenchmarkReporter& reporter, DWORD sizeMb, DWORD dataMb, DWORD jumpsPerKb, DWORD paddingBytes, bool is64Bit, LoadMode loadMode, WriteMode writeMode);
+  static double Median(std::vector<double>& values);
+
+private:
+  DWORD _repetitions;
+};
@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <filesystem>
+#include <set>
+#include <string>
+#include "ScanBenchmark.h"
+#include "../Generator/SyntheticPEGenerator.h"
+#include "../../Benchmark/Common/BenchmarkOptions.h"
+#include "../../Benchmark/Common/BenchmarkReporter.h"
+#include "../../Benchmark/Common/Stopwatch.h"
+#include "../../Builder/Disassembler/ByteScanner.h"
+#include "../../Builder/Disassembler/Disassembler.h"
+#include "../../Builder/PEFile/PEFile.h"
+#include "../../Tests/Builder/ReferenceDisassembler.h"
+
+ScanBenchmark::ScanBenchmark()
+{
+}
+
+ScanBenchmark::~ScanBenchmark()
+{
+}
+
+void ScanBenchmark::Run(BenchmarkReporter& reporter, BenchmarkOptions& options)
+{
+  if (!reporter.IsSelected("scan")) return;
+
+  const DWORD sizeMb = (DWORD)options.GetInteger("size-mb", 128);
+  const DWORD repetitions = (DWORD)options.GetInteger("repetitions", 5);
+  if (sizeMb == 0 || repetitions == 0) return;
+
+  const std::string fileName = SyntheticPEGenerator::GetTempFileName("nanomites-scan.exe");
+
+  SyntheticPESettings settings;
+  settings.Is64Bit = sizeof(void*) == 8;
+  settings.SectionSize = sizeMb * 1024 * 1024;
+  settings.JumpsPerKb = (DWORD)options.GetInteger("density", 40);
+  settings.PaddingBytes = (DWORD)options.GetInteger("padding", 64);
+  settings.FunctionTable = false;
+  settings.DataSize = 0;
+  settings.Seed = 0x2545F491;
+
+  SyntheticPEGenerator generator;
+  PEFile peFile;
+  const bool loaded = generator.Generate(fileName.c_str(), settings) && peFile.OpenFile(fileName.c_str(), LoadMode::Buffer);
+  std::error_code error;
+  std::filesystem::remove(fileName, error);
+  if (!loaded) return;
+  const PeSectionHeader* sectionHeader = peFile.FindSectionByName(".nano");
+  if (sectionHeader == nullptr) return;
+
+  const BYTE* section = peFile.GetPointer(sectionHeader->PointerToRawData, sectionHeader->SizeOfRawData);
+  const DWORD sectionLength = sectionHeader->SizeOfRawData;
+  const double gigabytes = (double)sectionLength / (1024 * 1024 * 1024);
+
+  // Reference: one byte at a time into a std::set
+  Disassembler disassembler;
+  std::set<DWORD> reference;
+  std::vector<double> referenceNs;
+  for (DWORD r = 0; r < repetitions; r++)
+  {
+    reference.clear();
+    Stopwatch stopwatch;
+    ReferenceDisassembler::GetCCs(peFile, sectionHeader, reference);
+    referenceNs.push_back(stopwatch.ElapsedNanoseconds());
+  }
+  const double referenceTime = Median(referenceNs);
+
+  BenchmarkResult referenceResult;
+  referenceResult.Name = "scan/set/" + std::to_string(sizeMb) + "MB";
+  referenceResult.Operations = reference.size();
+  referenceResult.Nanoseconds = referenceTime;
+  referenceResult.AddMetric("gb_per_s", gigabytes * 1e9 / referenceTime);
+  referenceResult.AddMetric("padding_share", (double)reference.size() / sectionLength);
+  reporter.Report(referenceResult);
+
+  const char* levelNames[] = { "scalar", "sse2", "avx2" };
+  ByteScanner scanner;
+  for (int level = (int)ScanLevel::Scalar; level <= (int)scanner.GetSupportedLevel(); level++)
+  {
+    scanner.SetLevel((ScanLevel)level);
+    std::vector<DWORD> offsets;
+    std::vector<double> elapsed;
+    for (DWORD r = 0; r < repetitions; r++)
+    {
+      offsets.clear();
+      Stopwatch stopwatch;
+      scanner.Find(section, sectionLength, 0xCC, offsets);
+      elapsed.push_back(stopwatch.ElapsedNanoseconds());
+    }
+    const double nanoseconds = Median(elapsed);
+
+    BenchmarkResult result;
+    result.Name = std::string("scan/") + levelNames[level] + "/" + std::to_string(sizeMb) + "MB";
+    result.Operations = offsets.size();
+    result.Nanoseconds = nanoseconds;
+    result.AddMetric("gb_per_s", gigabytes * 1e9 / nanoseconds);
+    result.AddMetric("speedup", referenceTime / nanoseconds);
+    result.AddMetric("results_match", offsets.size() == reference.size() && std::equal(offsets.begin(), offsets.end(), reference.begin()) ? 1.0 : 0.0);
+    reporter.Report(result);
+  }
+}
+
+double ScanBenchmark::Median(std::vector<double>& values)
+{
+  std::sort(values.begin(), values.end());
+  const size_t count = values.size();
+  return (count % 2 == 1) ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2.0;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <vector>
+#include "../../Builder/PEFile/PEFormat.h"
+
+class BenchmarkReporter;
+class BenchmarkOptions;
+
+// 0xCC scan of the Builder that finds the decoy sites: the previous byte loop into a std::set (ReferenceDisassembler::GetCCs)
+// against the ByteScanner on every SIMD level the processor supports, on a section with heavy int3 padding.
+class ScanBenchmark
+{
+public:
+  ScanBenchmark();
+  ~ScanBenchmark();
+
+  void Run(BenchmarkReporter& reporter, BenchmarkOptions& options);
+
+private:
+  static double Median(std::vector<double>& values);
+};
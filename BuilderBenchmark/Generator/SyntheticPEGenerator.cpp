@@ -0,0 +1,407 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include "SyntheticPEGenerator.h"
+
+#define FILE_ALIGNMENT 0x200
+#define SECTION_ALIGNMENT 0x1000
+#define HEADERS_SIZE 0x400
+#define TEXT_RVA 0x1000
+#define NANO_RVA 0x2000
+#define FLUSH_SIZE (1 << 20)
+#define RECENT_FUNCTIONS 64
+
+SyntheticPEGenerator::SyntheticPEGenerator()
+{
+  _settings = {};
+  _random = 1;
+  _bytesUntilJump = 0;
+  _jumpCount = 0;
+  _paddingCount = 0;
+  _written = 0;
+  _functionStart = 0;
+}
+
+SyntheticPEGenerator::~SyntheticPEGenerator()
+{
+}
+
+bool SyntheticPEGenerator::Generate(const char* fileName, const SyntheticPESettings& settings)
+{
+  _settings = settings;
+  _random = settings.Seed != 0 ? settings.Seed : 1;
+  _jumpCount = 0;
+  _paddingCount = 0;
+  _written = 0;
+  _functions.clear();
+  _bytesUntilJump = settings.JumpsPerKb != 0 ? NextRandom(2 * 1024 / settings.JumpsPerKb + 1) : 0xFFFFFFFF;
+
+  std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) return false;
+
+  // The headers depend on the number of functions and are written last
+  const DWORD nanoRawSize = (settings.SectionSize + FILE_ALIGNMENT - 1) & ~(FILE_ALIGNMENT - 1);
+  std::vector<BYTE> headers(HEADERS_SIZE, 0);
+  file.write((const char*)headers.data(), headers.size());
+
+  // .text : a single ret as entry point
+  std::vector<BYTE> text(FILE_ALIGNMENT, 0xCC);
+  text[0] = 0xC3;
+  file.write((const char*)text.data(), text.size());
+
+  // .nano : functions are generated into a buffer which is flushed every MB
+  std::vector<BYTE> code;
+  code.reserve(FLUSH_SIZE + 4096);
+  while (_written + code.size() + 16 <= settings.SectionSize)
+  {
+    DWORD remaining = settings.SectionSize - _written - (DWORD)code.size();
+    DWORD size = 64 + NextRandom(960);
+    if (size > remaining - 16) size = remaining - 16;
+    if (size >= 16) EmitFunction(code, size);
+
+    // int3 padding between functions, as emitted by the linker which also aligns them to 16 bytes
+    DWORD padding = 0;
+    if (settings.PaddingBytes != 0)
+    {
+      padding = NextRandom(2 * settings.PaddingBytes + 1);
+      padding += (16 - (_written + (DWORD)code.size() + padding) % 16) % 16;
+    }
+    remaining = settings.SectionSize - _written - (DWORD)code.size();
+    if (padding > remaining) padding = remaining;
+    code.insert(code.end(), padding, 0xCC);
+    _paddingCount += padding;
+    if (size < 16) break;
+
+    if (code.size() >= FLUSH_SIZE)
+    {
+      file.write((const char*)code.data(), code.size());
+      _written += (DWORD)code.size();
+      code.clear();
+    }
+  }
+  code.resize(nanoRawSize - _written, 0xCC);
+  file.write((const char*)code.data(), code.size());
+
+  // .pdata : RUNTIME_FUNCTION entries followed by one shared UNWIND_INFO
+  DWORD pdataRawSize = 0;
+  if (settings.Is64Bit && settings.FunctionTable && !_functions.empty())
+  {
+    const DWORD pdataSize = (DWORD)(_functions.size() * sizeof(PeRuntimeFunction)) + sizeof(DWORD);
+    pdataRawSize = (pdataSize + FILE_ALIGNMENT - 1) & ~(FILE_ALIGNMENT - 1);
+    WriteFunctionTable(file, pdataRawSize);
+  }
+
+  // .rdata : random bytes, never read by the Builder
+  const DWORD dataRawSize = (settings.DataSize + FILE_ALIGNMENT - 1) & ~(FILE_ALIGNMENT - 1);
+  if (dataRawSize != 0)
+  {
+    WriteData(file, dataRawSize);
+  }
+
+  file.seekp(0);
+  WriteHeaders(file, nanoRawSize, pdataRawSize, dataRawSize);
+
+  return file.good();
+}
+
+std::string SyntheticPEGenerator::GetTempFileName(const char* name)
+{
+  std::error_code error;
+  const std::filesystem::path directory = std::filesystem::temp_directory_path(error);
+  if (error) return name;
+  return (directory / name).string();
+}
+
+void SyntheticPEGenerator::WriteHeaders(std::ofstream& file, DWORD nanoRawSize, DWORD pdataRawSize, DWORD dataRawSize)
+{
+  std::vector<BYTE> headers(HEADERS_SIZE, 0);
+
+  PeDosHeader* dosHeader = (PeDosHeader*)headers.data();
+  dosHeader->e_magic = PE_DOS_SIGNATURE;
+  dosHeader->e_lfanew = sizeof(PeDosHeader);
+
+  const WORD sectionCount = 2 + (pdataRawSize != 0 ? 1 : 0) + (dataRawSize != 0 ? 1 : 0);
+  const DWORD pdataRva = (NANO_RVA + _settings.SectionSize + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1);
+  const DWORD dataRva = pdataRva + ((pdataRawSize + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1));
+  const DWORD sizeOfImage = dataRva + ((dataRawSize + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1));
+
+  // NT headers: signature, file header, optional header
+  DWORD* signature = (DWORD*)(headers.data() + dosHeader->e_lfanew);
+  *signature = PE_NT_SIGNATURE;
+  PeFileHeader* fileHeader = (PeFileHeader*)(signature + 1);
+  fileHeader->NumberOfSections = sectionCount;
+  PeSectionHeader* sectionHeaders;
+  if (_settings.Is64Bit)
+  {
+    fileHeader->Machine = PE_MACHINE_AMD64;
+    fileHeader->SizeOfOptionalHeader = sizeof(PeOptionalHeader64);
+    fileHeader->Characteristics = PE_FILE_EXECUTABLE_IMAGE | PE_FILE_RELOCS_STRIPPED | PE_FILE_LARGE_ADDRESS_AWARE;
+
+    PeOptionalHeader64& optionalHeader = *(PeOptionalHeader64*)(fileHeader + 1);
+    optionalHeader.Magic = PE_OPTIONAL_HEADER64_MAGIC;
+    optionalHeader.SizeOfCode = FILE_ALIGNMENT + nanoRawSize;
+    optionalHeader.AddressOfEntryPoint = TEXT_RVA;
+    optionalHeader.BaseOfCode = TEXT_RVA;
+    optionalHeader.ImageBase = 0x140000000;
+    optionalHeader.SectionAlignment = SECTION_ALIGNMENT;
+    optionalHeader.FileAlignment = FILE_ALIGNMENT;
+    optionalHeader.MajorOperatingSystemVersion = 6;
+    optionalHeader.MajorSubsystemVersion = 6;
+    optionalHeader.SizeOfImage = sizeOfImage;
+    optionalHeader.SizeOfHeaders = HEADERS_SIZE;
+    optionalHeader.Subsystem = PE_SUBSYSTEM_WINDOWS_CUI;
+    optionalHeader.SizeOfStackReserve = 0x100000;
+    optionalHeader.SizeOfStackCommit = 0x1000;
+    optionalHeader.SizeOfHeapReserve = 0x100000;
+    optionalHeader.SizeOfHeapCommit = 0x1000;
+    optionalHeader.NumberOfRvaAndSizes = PE_NUMBEROF_DIRECTORY_ENTRIES;
+    if (pdataRawSize != 0)
+    {
+      optionalHeader.DataDirectory[PE_DIRECTORY_ENTRY_EXCEPTION].VirtualAddress = pdataRva;
+      optionalHeader.DataDirectory[PE_DIRECTORY_ENTRY_EXCEPTION].Size = (DWORD)(_functions.size() * sizeof(PeRuntimeFunction));
+    }
+    sectionHeaders = (PeSectionHeader*)(&optionalHeader + 1);
+  }
+  else
+  {
+    fileHeader->Machine = PE_MACHINE_I386;
+    fileHeader->SizeOfOptionalHeader = sizeof(PeOptionalHeader32);
+    fileHeader->Characteristics = PE_FILE_EXECUTABLE_IMAGE | PE_FILE_RELOCS_STRIPPED | PE_FILE_32BIT_MACHINE;
+
+    PeOptionalHeader32& optionalHeader = *(PeOptionalHeader32*)(fileHeader + 1);
+    optionalHeader.Magic = PE_OPTIONAL_HEADER32_MAGIC;
+    optionalHeader.SizeOfCode = FILE_ALIGNMENT + nanoRawSize;
+    optionalHeader.AddressOfEntryPoint = TEXT_RVA;
+    optionalHeader.BaseOfCode = TEXT_RVA;
+    optionalHeader.ImageBase = 0x400000;
+    optionalHeader.SectionAlignment = SECTION_ALIGNMENT;
+    optionalHeader.FileAlignment = FILE_ALIGNMENT;
+    optionalHeader.MajorOperatingSystemVersion = 6;
+    optionalHeader.MajorSubsystemVersion = 6;
+    optionalHeader.SizeOfImage = sizeOfImage;
+    optionalHeader.SizeOfHeaders = HEADERS_SIZE;
+    optionalHeader.Subsystem = PE_SUBSYSTEM_WINDOWS_CUI;
+    optionalHeader.SizeOfStackReserve = 0x100000;
+    optionalHeader.SizeOfStackCommit = 0x1000;
+    optionalHeader.SizeOfHeapReserve = 0x100000;
+    optionalHeader.SizeOfHeapCommit = 0x1000;
+    optionalHeader.NumberOfRvaAndSizes = PE_NUMBEROF_DIRECTORY_ENTRIES;
+    sectionHeaders = (PeSectionHeader*)(&optionalHeader + 1);
+  }
+
+  memcpy(sectionHeaders[0].Name, ".text", 5);
+  sectionHeaders[0].VirtualSize = 1;
+  sectionHeaders[0].VirtualAddress = TEXT_RVA;
+  sectionHeaders[0].SizeOfRawData = FILE_ALIGNMENT;
+  sectionHeaders[0].PointerToRawData = HEADERS_SIZE;
+  sectionHeaders[0].Characteristics = PE_SCN_CNT_CODE | PE_SCN_MEM_EXECUTE | PE_SCN_MEM_READ;
+
+  memcpy(sectionHeaders[1].Name, ".nano", 5);
+  sectionHeaders[1].VirtualSize = _settings.SectionSize;
+  sectionHeaders[1].VirtualAddress = NANO_RVA;
+  sectionHeaders[1].SizeOfRawData = nanoRawSize;
+  sectionHeaders[1].PointerToRawData = HEADERS_SIZE + FILE_ALIGNMENT;
+  sectionHeaders[1].Characteristics = PE_SCN_CNT_CODE | PE_SCN_MEM_EXECUTE | PE_SCN_MEM_READ;
+
+  if (pdataRawSize != 0)
+  {
+    memcpy(sectionHeaders[2].Name, ".pdata", 6);
+    sectionHeaders[2].VirtualSize = pdataRawSize;
+    sectionHeaders[2].VirtualAddress = pdataRva;
+    sectionHeaders[2].SizeOfRawData = pdataRawSize;
+    sectionHeaders[2].PointerToRawData = HEADERS_SIZE + FILE_ALIGNMENT + nanoRawSize;
+    sectionHeaders[2].Characteristics = PE_SCN_CNT_INITIALIZED_DATA | PE_SCN_MEM_READ;
+  }
+
+  if (dataRawSize != 0)
+  {
+    PeSectionHeader* sectionHeader = &sectionHeaders[sectionCount - 1];
+    memcpy(sectionHeader->Name, ".rdata", 6);
+    sectionHeader->VirtualSize = dataRawSize;
+    sectionHeader->VirtualAddress = dataRva;
+    sectionHeader->SizeOfRawData = dataRawSize;
+    sectionHeader->PointerToRawData = HEADERS_SIZE + FILE_ALIGNMENT + nanoRawSize + pdataRawSize;
+    sectionHeader->Characteristics = PE_SCN_CNT_INITIALIZED_DATA | PE_SCN_MEM_READ;
+  }
+
+  file.write((const char*)headers.data(), headers.size());
+}
+
+void SyntheticPEGenerator::WriteFunctionTable(std::ofstream& file, DWORD pdataRawSize)
+{
+  // Section relative ranges become RVAs, all functions share the UNWIND_INFO behind the table (version 1, no codes)
+  const DWORD pdataRva = (NANO_RVA + _settings.SectionSize + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1);
+  const DWORD unwindInfoRva = pdataRva + (DWORD)(_functions.size() * sizeof(PeRuntimeFunction));
+  for (PeRuntimeFunction& function : _functions)
+  {
+    function.BeginAddress += NANO_RVA;
+    function.EndAddress += NANO_RVA;
+    function.UnwindInfoAddress = unwindInfoRva;
+  }
+
+  std::vector<BYTE> pdata(pdataRawSize, 0);
+  memcpy(pdata.data(), _functions.data(), _functions.size() * sizeof(PeRuntimeFunction));
+  pdata[unwindInfoRva - pdataRva] = 0x01;
+  file.write((const char*)pdata.data(), pdata.size());
+}
+
+void SyntheticPEGenerator::WriteData(std::ofstream& file, DWORD dataRawSize)
+{
+  std::vector<BYTE> data;
+  data.reserve(FLUSH_SIZE);
+  for (DWORD written = 0; written < dataRawSize; written += (DWORD)data.size())
+  {
+    data.resize(std::min((DWORD)FLUSH_SIZE, dataRawSize - written));
+    for (BYTE& value : data) value = (BYTE)NextRandom();
+    file.write((const char*)data.data(), data.size());
+  }
+}
+
+void SyntheticPEGenerator::EmitFunction(std::vector<BYTE>& code, DWORD size)
+{
+  const size_t functionStart = code.size();
+  const size_t functionEnd = functionStart + size;
+  _functionStart = _written + (DWORD)functionStart;
+  _instructionStarts.clear();
+  _fixups.clear();
+
+  // push ebp/rbp; mov ebp, esp
+  _instructionStarts.push_back(code.size());
+  code.push_back(0x55);
+  _instructionStarts.push_back(code.size());
+  code.insert(code.end(), { 0x8B, 0xEC });
+
+  // Body, leaving room for the longest instruction and the epilogue
+  while (code.size() + 8 < functionEnd)
+  {
+    const DWORD before = (DWORD)code.size();
+    _instructionStarts.push_back(code.size());
+    if (_bytesUntilJump == 0)
+    {
+      EmitJump(code, functionStart, functionEnd);
+      _bytesUntilJump = NextRandom(2 * 1024 / _settings.JumpsPerKb + 1);
+    }
+    else
+    {
+      EmitInstruction(code);
+      const DWORD length = (DWORD)code.size() - before;
+      _bytesUntilJump = _bytesUntilJump > length ? _bytesUntilJump - length : 0;
+    }
+  }
+  while (code.size() + 2 < functionEnd)
+  {
+    _instructionStarts.push_back(code.size());
+    code.push_back(0x90);
+  }
+
+  // pop ebp/rbp; ret
+  _instructionStarts.push_back(code.size());
+  code.push_back(0x5D);
+  _instructionStarts.push_back(code.size());
+  code.push_back(0xC3);
+
+  ResolveJumps(code);
+
+  PeRuntimeFunction function = {};
+  function.BeginAddress = _functionStart;
+  function.EndAddress = _written + (DWORD)functionEnd;
+  _functions.push_back(function);
+}
+
+void SyntheticPEGenerator::EmitInstruction(std::vector<BYTE>& code)
+{
+  // Register and stack frame instructions without REX prefix, common in compiled code
+  const BYTE modrm = 0xC0 | (BYTE)NextRandom(64);
+  const BYTE imm8 = (BYTE)NextRandom(0x80);
+  switch (NextRandom(12))
+  {
+  case 0: code.insert(code.end(), { 0x89, modrm }); break;                 // mov r32, r32
+  case 1: code.insert(code.end(), { 0x8B, 0x45, (BYTE)(0xF0 - (imm8 & 0x3C)) }); break; // mov eax, [ebp - x]
+  case 2: code.insert(code.end(), { 0x89, 0x45, (BYTE)(0xF0 - (imm8 & 0x3C)) }); break; // mov [ebp - x], eax
+  case 3: code.insert(code.end(), { 0x83, (BYTE)(0xC0 | NextRandom(8)), imm8 }); break;  // add r32, imm8
+  case 4: code.insert(code.end(), { 0x83, (BYTE)(0xF8 | NextRandom(8)), imm8 }); break;  // cmp r32, imm8
+  case 5: code.insert(code.end(), { 0x85, modrm }); break;                 // test r32, r32
+  case 6: code.insert(code.end(), { 0x31, modrm }); break;                 // xor r32, r32
+  case 7: code.insert(code.end(), { 0x01, modrm }); break;                 // add r32, r32
+  case 8: code.insert(code.end(), { 0x0F, 0xAF, modrm }); break;           // imul r32, r32
+  case 9: code.insert(code.end(), { 0xC1, (BYTE)(0xE0 | NextRandom(8)), (BYTE)NextRandom(32) }); break; // shl r32, imm8
+  case 10: code.insert(code.end(), { 0xB8, imm8, 0x00, 0x00, 0x00 }); break; // mov eax, imm32
+  default:                                                                 // call rel32, not a jump
+  {
+    // Calls one of the previous functions or the current one recursively
+    const size_t recent = _functions.size() < RECENT_FUNCTIONS ? _functions.size() : RECENT_FUNCTIONS;
+    const DWORD target = recent != 0 ? _functions[_functions.size() - 1 - NextRandom((DWORD)recent)].BeginAddress : _functionStart;
+    const DWORD displacement = target - (_written + (DWORD)code.size() + 5);
+    code.insert(code.end(), { 0xE8, (BYTE)displacement, (BYTE)(displacement >> 8), (BYTE)(displacement >> 16), (BYTE)(displacement >> 24) });
+    break;
+  }
+  }
+}
+
+void SyntheticPEGenerator::EmitJump(std::vector<BYTE>& code, size_t functionStart, size_t functionEnd)
+{
+  // Mix of jcc short/near and jmp short/near as seen in compiled code
+  const DWORD kind = NextRandom(100);
+  const bool isShort = kind < 60 || (kind >= 80 && kind < 92);
+  const bool isJmp = kind >= 80;
+  const DWORD length = isShort ? 2 : (isJmp ? 5 : 6);
+  const size_t next = code.size() + length;
+
+  // Target anywhere inside the function, short jumps within their range
+  long long low = (long long)functionStart - (long long)next;
+  long long high = (long long)functionEnd - 1 - (long long)next;
+  if (isShort)
+  {
+    if (low < -128) low = -128;
+    if (high > 127) high = 127;
+  }
+  const int displacement = (int)(low + NextRandom((DWORD)(high - low + 1)));
+
+  // The displacement is replaced by ResolveJumps once all instruction starts of the function are known
+  JumpFixup fixup;
+  fixup.Position = code.size();
+  fixup.Length = length;
+  fixup.Target = next + displacement;
+  _fixups.push_back(fixup);
+
+  const BYTE condition = (BYTE)NextRandom(16);
+  if (isShort && isJmp) code.insert(code.end(), { 0xEB, (BYTE)displacement });
+  else if (isShort) code.insert(code.end(), { (BYTE)(0x70 | condition), (BYTE)displacement });
+  else if (isJmp) code.insert(code.end(), { 0xE9, (BYTE)displacement, (BYTE)(displacement >> 8), (BYTE)(displacement >> 16), (BYTE)(displacement >> 24) });
+  else code.insert(code.end(), { 0x0F, (BYTE)(0x80 | condition), (BYTE)displacement, (BYTE)(displacement >> 8), (BYTE)(displacement >> 16), (BYTE)(displacement >> 24) });
+  _jumpCount++;
+}
+
+void SyntheticPEGenerator::ResolveJumps(std::vector<BYTE>& code)
+{
+  for (const JumpFixup& fixup : _fixups)
+  {
+    // First instruction start at or after the wanted target; a short jump that gets out of range takes the last
+    // start before it, which lies between the jump and the wanted target
+    const size_t next = fixup.Position + fixup.Length;
+    auto start = std::lower_bound(_instructionStarts.begin(), _instructionStarts.end(), fixup.Target);
+    long long displacement = (long long)*start - (long long)next;
+    if (fixup.Length == 2 && displacement > 127)
+    {
+      displacement = (long long)*(start - 1) - (long long)next;
+    }
+
+    if (fixup.Length == 2)
+    {
+      code[fixup.Position + 1] = (BYTE)displacement;
+    }
+    else
+    {
+      const int displacement32 = (int)displacement;
+      memcpy(&code[fixup.Position + fixup.Length - 4], &displacement32, sizeof(displacement32));
+    }
+  }
+}
+
+DWORD SyntheticPEGenerator::NextRandom()
+{
+  _random ^= _random << 13;
+  _random ^= _random >> 17;
+  _random ^= _random << 5;
+  return _random;
+}
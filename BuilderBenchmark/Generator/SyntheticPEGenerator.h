@@ -0,0 +1,67 @@
+#pragma once
+#include <fstream>
+#include <string>
+#include <vector>
+#include "../../Builder/PEFile/PEFormat.h"
+
+struct SyntheticPESettings
+{
+  bool Is64Bit;        // PE32+ instead of PE32
+  DWORD SectionSize;   // Size of the .nano section in bytes
+  DWORD JumpsPerKb;    // Average relative jumps per KB of code
+  DWORD PaddingBytes;  // Average int3 padding between functions, which are then aligned to 16 bytes
+  bool FunctionTable;  // PE32+ only: adds a .pdata section with a RUNTIME_FUNCTION entry per function
+  DWORD DataSize;      // Size of a trailing .rdata section of random bytes which the Builder never touches, 0 for none
+  DWORD Seed;
+};
+
+// Writes a valid PE32/PE32+ executable with a .text section and a .nano section of the requested size, optionally
+// followed by .pdata and .rdata.
+// .nano is filled with functions made of common instructions, relative jumps and int3 padding; the
+// instructions decode identically in 32 and 64 bit mode, so the Builder sees the same stream in both.
+// Jumps and calls always target instruction starts, so recursive descent finds the same code as a linear sweep.
+class SyntheticPEGenerator
+{
+public:
+  SyntheticPEGenerator();
+  ~SyntheticPEGenerator();
+
+  bool Generate(const char* fileName, const SyntheticPESettings& settings);
+  // Path of the file in the temporary directory, the name alone if there is none
+  static std::string GetTempFileName(const char* name);
+
+  // Results of the last call of Generate
+  DWORD GetJumpCount() const { return _jumpCount; }
+  DWORD GetPaddingCount() const { return _paddingCount; }
+  DWORD GetFunctionCount() const { return (DWORD)_functions.size(); }
+
+private:
+  struct JumpFixup
+  {
+    size_t Position;  // Of the jump instruction in the code buffer
+    DWORD Length;
+    size_t Target;    // Wanted target, moved to an instruction start once the function is complete
+  };
+
+  void WriteHeaders(std::ofstream& file, DWORD nanoRawSize, DWORD pdataRawSize, DWORD dataRawSize);
+  void WriteFunctionTable(std::ofstream& file, DWORD pdataRawSize);
+  void WriteData(std::ofstream& file, DWORD dataRawSize);
+  void EmitFunction(std::vector<BYTE>& code, DWORD size);
+  void EmitInstruction(std::vector<BYTE>& code);
+  void EmitJump(std::vector<BYTE>& code, size_t functionStart, size_t functionEnd);
+  void ResolveJumps(std::vector<BYTE>& code);
+  DWORD NextRandom();
+  DWORD NextRandom(DWORD bound) { return NextRandom() % bound; }
+
+private:
+  SyntheticPESettings _settings;
+  DWORD _random;
+  DWORD _bytesUntilJump;
+  DWORD _jumpCount;
+  DWORD _paddingCount;
+  DWORD _written;                                  // Bytes of .nano already written, the code buffer follows
+  DWORD _functionStart;                            // Section relative start of the current function
+  std::vector<size_t> _instructionStarts;          // Of the current function, in the code buffer
+  std::vector<JumpFixup> _fixups;
+  std::vector<PeRuntimeFunction> _functions;
+};
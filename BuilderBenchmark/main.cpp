@@ -0,0 +1,72 @@
+#include <iostream>
+#include <string>
+#include "../Benchmark/Common/BenchmarkOptions.h"
+#include "../Benchmark/Common/BenchmarkReporter.h"
+#include "Benchmarks/PipelineBenchmark.h"
+#include "Benchmarks/BatchBenchmark.h"
+#include "Benchmarks/DisassemblerBenchmark.h"
+#include "Benchmarks/CacheBenchmark.h"
+#include "Benchmarks/ScanBenchmark.h"
+#include "Benchmarks/FillerBenchmark.h"
+#include "Benchmarks/DensityBenchmark.h"
+
+void PrintUsage();
+
+// --- main program --- Usage: BuilderBenchmark.exe [filter] [--json <file>] [--<option> <value> ...]
+// Measures the Builder on synthetic executables, results are printed and optionally written as JSON lines.
+int main(int argc, char* argv[])
+{
+  BenchmarkOptions options;
+  if (!options.Parse(argc, argv))
+  {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  BenchmarkReporter reporter;
+  reporter.SetFilter(options.GetFilter());
+  if (options.Has("json") && !reporter.OpenJson(options.GetString("json", "").c_str()))
+  {
+    std::cout << "Opening " << options.GetString("json", "") << " failed!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  PipelineBenchmark pipelineBenchmark;
+  pipelineBenchmark.Run(reporter, options);
+
+  BatchBenchmark batchBenchmark;
+  batchBenchmark.Run(reporter, options);
+
+  DisassemblerBenchmark disassemblerBenchmark;
+  disassemblerBenchmark.Run(reporter, options);
+
+  CacheBenchmark cacheBenchmark;
+  cacheBenchmark.Run(reporter, options);
+
+  ScanBenchmark scanBenchmark;
+  scanBenchmark.Run(reporter, options);
+
+  FillerBenchmark fillerBenchmark;
+  fillerBenchmark.Run(reporter, options);
+
+  DensityBenchmark densityBenchmark;
+  densityBenchmark.Run(reporter, options);
+
+  return EXIT_SUCCESS;
+}
+
+void PrintUsage()
+{
+  std::cout << "Usage: BuilderBenchmark.exe [filter] [--json <file>] [--<option> <value> ...]" << std::endl;
+  std::cout << "  builder : --size-mb <.nano size, 1 to 1024> --density <jumps per KB> --padding <avg int3 bytes between functions>" << std::endl;
+  std::cout << "            --pe64 <0|1> --repetitions <count> --load <map|buffer|both> --data-mb <untouched .rdata size>" << std::endl;
+  std::cout << "            --write <replace|in-place|both>" << std::endl;
+  std::cout << "  batch : --files <count> --size-mb <.nano size per file, default 4> --threads <max threads> --io-threads <count> --repetitions <count>" << std::endl;
+  std::cout << "  disassembler : --size-mb <.nano size, default 128> --density <jumps per KB> --padding <avg int3 bytes> --repetitions <count> --threads <max threads> --pdata <0|1>" << std::endl;
+  std::cout << "  cache : --size-mb <.nano size, default 128> --density <jumps per KB> --padding <avg int3 bytes> --repetitions <count> --changed-pct <functions changed, default 1>" << std::endl;
+  std::cout << "  scan : --size-mb <.nano size, default 128> --padding <avg int3 bytes, default 64> --repetitions <count>" << std::endl;
+  std::cout << "  filler : --sites <count, default 4194304> --threads <max threads> --repetitions <count>" << std::endl;
+  std::cout << "  density : --size-mb <.nano size, default 16> --density <jumps per KB> --padding <avg int3 bytes> --repetitions <count>" << std::endl;
+  std::cout << "            --exe <unprotected executable> --section <name> --fraction <0 to 1> --max-per-function <count> --max-per-block <count>" << std::endl;
+  std::cout << "            --corpus <unprotected Nanomites.exe, runs its workload corpus per policy> --corpus-scale <input scale>" << std::endl;
+}
@@ -0,0 +1,178 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include "CorpusHarness.h"
+#include "..\ProtectedCode\CorpusKernels.h"
+#include "..\Tracer\Tracer.h"
+
+CorpusHarness::CorpusHarness(DWORD scale)
+{
+  _scale = scale == 0 ? 1 : scale;
+  _random = 0x6C078965;
+  CreateInputs();
+}
+
+CorpusHarness::~CorpusHarness()
+{
+}
+
+bool CorpusHarness::Run(DWORD repetitions)
+{
+  ReferenceCorpusKernels reference;
+  ProtectedCorpusKernels protectedKernels;
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  bool result = true;
+
+  std::cout << std::left << std::setw(22) << "kernel" << std::right << std::setw(12) << "input" << std::setw(14) << "unprotected" << std::setw(14) << "protected" << std::setw(10) << "slowdown" << std::setw(12) << "traps" << std::setw(12) << "traps/byte" << std::endl;
+
+  for (int k = 0; k < CORPUS_KERNEL_COUNT; k++)
+  {
+    const CorpusKernel kernel = (CorpusKernel)k;
+    std::vector<double> unprotectedUs, protectedUs;
+    DWORD expected = 0, actual = 0;
+    ULONGLONG traps = 0;
+
+    for (DWORD r = 0; r < repetitions; r++)
+    {
+      LARGE_INTEGER start, end;
+
+      Prepare(kernel);
+      QueryPerformanceCounter(&start);
+      expected = Execute(reference, kernel);
+      QueryPerformanceCounter(&end);
+      unprotectedUs.push_back((double)(end.QuadPart - start.QuadPart) * 1e6 / frequency.QuadPart);
+
+      Prepare(kernel);
+      const ULONGLONG trapsBefore = Tracer::Instance().GetStatistics().GetTraps();
+      QueryPerformanceCounter(&start);
+      actual = Execute(protectedKernels, kernel);
+      QueryPerformanceCounter(&end);
+      protectedUs.push_back((double)(end.QuadPart - start.QuadPart) * 1e6 / frequency.QuadPart);
+      traps = Tracer::Instance().GetStatistics().GetTraps() - trapsBefore;
+    }
+
+    const double unprotectedMedian = Median(unprotectedUs);
+    const double protectedMedian = Median(protectedUs);
+    const DWORD inputBytes = GetInputBytes(kernel);
+    std::cout << std::left << std::setw(22) << GetName(kernel) << std::right << std::fixed << std::setprecision(2);
+    std::cout << std::setw(12) << inputBytes << std::setw(11) << unprotectedMedian << " us" << std::setw(11) << protectedMedian << " us";
+    std::cout << std::setw(9) << protectedMedian / unprotectedMedian << "x" << std::setw(12) << traps << std::setw(12) << (double)traps / inputBytes;
+    if (expected != actual)
+    {
+      std::cout << "  RESULT MISMATCH";
+      result = false;
+    }
+    std::cout << std::endl;
+  }
+  return result;
+}
+
+void CorpusHarness::CreateInputs()
+{
+  const DWORD count = 2000 * _scale;
+
+  for (DWORD i = 0; i < count; i++) _unsorted.push_back((int)(NextRandom() % 100000));
+
+  // Hash table with load factor 0.5, half of the probed keys are present
+  DWORD tableSize = 1;
+  while (tableSize < count * 2) tableSize <<= 1;
+  _hashTable.assign(tableSize, 0);
+  for (DWORD i = 0; i < count; i++)
+  {
+    DWORD key = (NextRandom() | 1);
+    DWORD slot = (key * 0x9E3779B1) & (tableSize - 1);
+    while (_hashTable[slot] != 0) slot = (slot + 1) & (tableSize - 1);
+    _hashTable[slot] = key;
+    _hashKeys.push_back((i % 2 == 0) ? key : (NextRandom() & ~1u));
+  }
+
+  // JSON-like document
+  while (_json.size() < count * 4)
+  {
+    _json += "{\"id\": " + std::to_string(NextRandom() % 100000) + ", \"name\": \"item\\\"" + std::to_string(NextRandom() % 1000) + "\", \"tags\": [true, false, null], \"value\": -" + std::to_string(NextRandom() % 1000) + ".5e3},\n";
+  }
+
+  // Records with comments
+  while (_records.size() < count * 4)
+  {
+    if (NextRandom() % 4 == 0) _records += "# comment line\n";
+    _records += "key" + std::to_string(NextRandom() % 100) + "=" + std::to_string(NextRandom() % 100000) + ";\n";
+  }
+
+  _sorted = _unsorted;
+  std::sort(_sorted.begin(), _sorted.end());
+  for (DWORD i = 0; i < count; i++) _searchKeys.push_back((int)(NextRandom() % 100000));
+
+  // Mostly small values, as in typical serialized data
+  for (DWORD i = 0; i < count; i++)
+  {
+    DWORD value = (NextRandom() % 4 == 0) ? NextRandom() : NextRandom() % 300;
+    do
+    {
+      BYTE b = value & 0x7F;
+      value >>= 7;
+      _varints.push_back(value != 0 ? (b | 0x80) : b);
+    } while (value != 0);
+  }
+
+  // 1 of 16 indices is out of bounds
+  for (DWORD i = 0; i < count; i++) _values.push_back((int)NextRandom());
+  for (DWORD i = 0; i < count * 2; i++) _indices.push_back(NextRandom() % (count + count / 16));
+}
+
+void CorpusHarness::Prepare(CorpusKernel kernel)
+{
+  if (kernel == QUICKSORT) _sortBuffer = _unsorted;
+}
+
+template <class Kernels> DWORD CorpusHarness::Execute(Kernels& kernels, CorpusKernel kernel)
+{
+  switch (kernel)
+  {
+  case QUICKSORT: return kernels.QuickSort(_sortBuffer.data(), (DWORD)_sortBuffer.size());
+  case HASH_PROBE: return kernels.HashProbe(_hashTable.data(), (DWORD)_hashTable.size() - 1, _hashKeys.data(), (DWORD)_hashKeys.size());
+  case TOKENIZER: return kernels.Tokenize(_json.c_str(), (DWORD)_json.size());
+  case STATE_MACHINE: return kernels.ParseRecords(_records.c_str(), (DWORD)_records.size());
+  case BINARY_SEARCH: return kernels.BinarySearch(_sorted.data(), (DWORD)_sorted.size(), _searchKeys.data(), (DWORD)_searchKeys.size());
+  case VARINT_DECODER: return kernels.DecodeVarints(_varints.data(), (DWORD)_varints.size());
+  case BOUNDS_CHECKED_LOOP: return kernels.BoundsCheckedSum(_values.data(), (DWORD)_values.size(), _indices.data(), (DWORD)_indices.size());
+  default: return 0;
+  }
+}
+
+DWORD CorpusHarness::GetInputBytes(CorpusKernel kernel)
+{
+  switch (kernel)
+  {
+  case QUICKSORT: return (DWORD)(_unsorted.size() * sizeof(int));
+  case HASH_PROBE: return (DWORD)(_hashKeys.size() * sizeof(DWORD));
+  case TOKENIZER: return (DWORD)_json.size();
+  case STATE_MACHINE: return (DWORD)_records.size();
+  case BINARY_SEARCH: return (DWORD)(_searchKeys.size() * sizeof(int));
+  case VARINT_DECODER: return (DWORD)_varints.size();
+  case BOUNDS_CHECKED_LOOP: return (DWORD)(_indices.size() * sizeof(DWORD));
+  default: return 0;
+  }
+}
+
+const char* CorpusHarness::GetName(CorpusKernel kernel)
+{
+  static const char* names[] = { "quicksort", "hash_probe", "tokenizer", "state_machine", "binary_search", "varint_decoder", "bounds_checked_loop" };
+  return names[kernel];
+}
+
+DWORD CorpusHarness::NextRandom()
+{
+  _random ^= _random << 13;
+  _random ^= _random >> 17;
+  _random ^= _random << 5;
+  return _random;
+}
+
+double CorpusHarness::Median(std::vector<double>& values)
+{
+  std::sort(values.begin(), values.end());
+  const size_t count = values.size();
+  return (count % 2 == 1) ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2.0;
+}
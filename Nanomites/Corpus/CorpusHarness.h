@@ -0,0 +1,53 @@
+#pragma once
+#include <Windows.h>
+#include <string>
+#include <vector>
+
+enum CorpusKernel
+{
+  QUICKSORT,
+  HASH_PROBE,
+  TOKENIZER,
+  STATE_MACHINE,
+  BINARY_SEARCH,
+  VARINT_DECODER,
+  BOUNDS_CHECKED_LOOP,
+  CORPUS_KERNEL_COUNT
+};
+
+// Runs each corpus kernel protected (under the Tracer) and unprotected with identical inputs and
+// reports the slowdown, the traps per run and the traps per byte of input.
+class CorpusHarness
+{
+public:
+  CorpusHarness(DWORD scale);
+  ~CorpusHarness();
+
+  bool Run(DWORD repetitions);
+
+private:
+  void CreateInputs();
+  void Prepare(CorpusKernel kernel);
+  template <class Kernels> DWORD Execute(Kernels& kernels, CorpusKernel kernel);
+  DWORD GetInputBytes(CorpusKernel kernel);
+  const char* GetName(CorpusKernel kernel);
+
+  DWORD NextRandom();
+  static double Median(std::vector<double>& values);
+
+private:
+  DWORD _scale;
+  DWORD _random;
+
+  std::vector<int> _unsorted;
+  std::vector<int> _sortBuffer;
+  std::vector<DWORD> _hashTable;
+  std::vector<DWORD> _hashKeys;
+  std::string _json;
+  std::string _records;
+  std::vector<int> _sorted;
+  std::vector<int> _searchKeys;
+  std::vector<BYTE> _varints;
+  std::vector<int> _values;
+  std::vector<DWORD> _indices;
+};
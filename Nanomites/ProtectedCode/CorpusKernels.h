@@ -0,0 +1,18 @@
+#pragma once
+#include <Windows.h>
+
+// Representative kernels for measuring the cost of nanomites on realistic branch behavior.
+// The same code is compiled twice: ProtectedCorpusKernels is linked into .nano and protected by the Builder,
+// ReferenceCorpusKernels is the identical, unprotected code in .text.
+
+#define CORPUS_CLASS ProtectedCorpusKernels
+#define CORPUS_SECTION ".nano"
+#include "CorpusKernels.inl"
+#undef CORPUS_CLASS
+#undef CORPUS_SECTION
+
+#define CORPUS_CLASS ReferenceCorpusKernels
+#define CORPUS_SECTION ".text"
+#include "CorpusKernels.inl"
+#undef CORPUS_CLASS
+#undef CORPUS_SECTION
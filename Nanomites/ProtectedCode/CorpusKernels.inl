@@ -0,0 +1,19 @@
+// Declaration of the corpus kernels, included by CorpusKernels.h with CORPUS_CLASS and CORPUS_SECTION defined
+
+class __declspec(code_seg(CORPUS_SECTION)) CORPUS_CLASS
+{
+public:
+  CORPUS_CLASS();
+  ~CORPUS_CLASS();
+
+  __declspec(noinline) DWORD QuickSort(int* values, DWORD count);
+  __declspec(noinline) DWORD HashProbe(const DWORD* table, DWORD tableMask, const DWORD* keys, DWORD keyCount);
+  __declspec(noinline) DWORD Tokenize(const char* text, DWORD length);
+  __declspec(noinline) DWORD ParseRecords(const char* input, DWORD length);
+  __declspec(noinline) DWORD BinarySearch(const int* sorted, DWORD count, const int* keys, DWORD keyCount);
+  __declspec(noinline) DWORD DecodeVarints(const BYTE* input, DWORD length);
+  __declspec(noinline) DWORD BoundsCheckedSum(const int* values, DWORD count, const DWORD* indices, DWORD indexCount);
+
+private:
+  __declspec(noinline) void SortRange(int* values, int low, int high);
+};
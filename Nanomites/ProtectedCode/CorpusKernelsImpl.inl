@@ -0,0 +1,235 @@
+// Implementation of the corpus kernels, included by ProtectedCorpusKernels.cpp and ReferenceCorpusKernels.cpp with CORPUS_CLASS defined
+
+#pragma optimize( "", off )
+
+CORPUS_CLASS::CORPUS_CLASS()
+{
+}
+
+CORPUS_CLASS::~CORPUS_CLASS()
+{
+}
+
+DWORD CORPUS_CLASS::QuickSort(int* values, DWORD count)
+{
+  SortRange(values, 0, (int)count - 1);
+
+  DWORD checksum = 0;
+  for (DWORD i = 0; i < count; i++)
+  {
+    checksum = checksum * 31 + (DWORD)values[i];
+  }
+  return checksum;
+}
+
+void CORPUS_CLASS::SortRange(int* values, int low, int high)
+{
+  while (low < high)
+  {
+    int pivot = values[low + (high - low) / 2];
+    int i = low;
+    int j = high;
+    while (i <= j)
+    {
+      while (values[i] < pivot) i++;
+      while (values[j] > pivot) j--;
+      if (i <= j)
+      {
+        int temp = values[i];
+        values[i] = values[j];
+        values[j] = temp;
+        i++;
+        j--;
+      }
+    }
+
+    // Recurse into the smaller part to bound the stack depth
+    if (j - low < high - i)
+    {
+      SortRange(values, low, j);
+      low = i;
+    }
+    else
+    {
+      SortRange(values, i, high);
+      high = j;
+    }
+  }
+}
+
+DWORD CORPUS_CLASS::HashProbe(const DWORD* table, DWORD tableMask, const DWORD* keys, DWORD keyCount)
+{
+  // Open addressing with linear probing, 0 marks an empty slot
+  DWORD hits = 0;
+  for (DWORD i = 0; i < keyCount; i++)
+  {
+    DWORD key = keys[i];
+    DWORD slot = (key * 0x9E3779B1) & tableMask;
+    while (table[slot] != 0)
+    {
+      if (table[slot] == key)
+      {
+        hits++;
+        break;
+      }
+      slot = (slot + 1) & tableMask;
+    }
+  }
+  return hits;
+}
+
+DWORD CORPUS_CLASS::Tokenize(const char* text, DWORD length)
+{
+  DWORD tokens = 0;
+  DWORD i = 0;
+  while (i < length)
+  {
+    char c = text[i];
+    if (c == ' ' || c == '\n' || c == '\r' || c == '\t')
+    {
+      i++;
+    }
+    else if (c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ',')
+    {
+      tokens++;
+      i++;
+    }
+    else if (c == '"')
+    {
+      i++;
+      while (i < length && text[i] != '"')
+      {
+        if (text[i] == '\\') i++;
+        i++;
+      }
+      i++;
+      tokens++;
+    }
+    else if (c == '-' || (c >= '0' && c <= '9'))
+    {
+      i++;
+      while (i < length && ((text[i] >= '0' && text[i] <= '9') || text[i] == '.' || text[i] == 'e' || text[i] == 'E' || text[i] == '+' || text[i] == '-')) i++;
+      tokens++;
+    }
+    else if (c >= 'a' && c <= 'z')
+    {
+      while (i < length && text[i] >= 'a' && text[i] <= 'z') i++;
+      tokens++;
+    }
+    else
+    {
+      return 0xFFFFFFFF; // Invalid input
+    }
+  }
+  return tokens;
+}
+
+DWORD CORPUS_CLASS::ParseRecords(const char* input, DWORD length)
+{
+  // Lines of "key=value;" records and "#" comments
+  enum State { Key, Value, Comment };
+  State state = Key;
+  DWORD records = 0;
+  DWORD value = 0;
+  DWORD checksum = 0;
+  for (DWORD i = 0; i < length; i++)
+  {
+    char c = input[i];
+    switch (state)
+    {
+    case Key:
+      if (c == '#')
+      {
+        state = Comment;
+      }
+      else if (c == '=')
+      {
+        value = 0;
+        state = Value;
+      }
+      break;
+    case Value:
+      if (c >= '0' && c <= '9')
+      {
+        value = value * 10 + (c - '0');
+      }
+      else if (c == ';')
+      {
+        records++;
+        checksum += value;
+        state = Key;
+      }
+      break;
+    case Comment:
+      if (c == '\n') state = Key;
+      break;
+    }
+  }
+  return records * 31 + checksum;
+}
+
+DWORD CORPUS_CLASS::BinarySearch(const int* sorted, DWORD count, const int* keys, DWORD keyCount)
+{
+  DWORD hits = 0;
+  for (DWORD k = 0; k < keyCount; k++)
+  {
+    int key = keys[k];
+    DWORD low = 0;
+    DWORD high = count;
+    while (low < high)
+    {
+      DWORD middle = low + (high - low) / 2;
+      if (sorted[middle] < key)
+      {
+        low = middle + 1;
+      }
+      else
+      {
+        high = middle;
+      }
+    }
+    if (low < count && sorted[low] == key) hits++;
+  }
+  return hits;
+}
+
+DWORD CORPUS_CLASS::DecodeVarints(const BYTE* input, DWORD length)
+{
+  // LEB128 encoded 32 bit values
+  DWORD sum = 0;
+  DWORD i = 0;
+  while (i < length)
+  {
+    DWORD value = 0;
+    DWORD shift = 0;
+    BYTE b = 0;
+    do
+    {
+      if (i >= length) return sum;
+      b = input[i++];
+      value |= (DWORD)(b & 0x7F) << shift;
+      shift += 7;
+    } while ((b & 0x80) && shift < 35);
+    sum += value;
+  }
+  return sum;
+}
+
+DWORD CORPUS_CLASS::BoundsCheckedSum(const int* values, DWORD count, const DWORD* indices, DWORD indexCount)
+{
+  DWORD sum = 0;
+  DWORD outOfBounds = 0;
+  for (DWORD i = 0; i < indexCount; i++)
+  {
+    DWORD index = indices[i];
+    if (index >= count)
+    {
+      outOfBounds++;
+      continue;
+    }
+    sum += values[index];
+  }
+  return sum + outOfBounds;
+}
+
+#pragma optimize( "", on )
@@ -0,0 +1,5 @@
+#include "CorpusKernels.h"
+
+#define CORPUS_CLASS ReferenceCorpusKernels
+#include "CorpusKernelsImpl.inl"
+#undef CORPUS_CLASS
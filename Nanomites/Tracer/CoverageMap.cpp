@@ -0,0 +1,114 @@
+#include <cstdlib>
+#include <cstring>
+#include "CoverageMap.h"
+#ifndef _WIN32
+#include <sys/shm.h>
+#endif
+
+thread_local DWORD CoverageMap::_previousLocation = 0;
+
+CoverageMap::CoverageMap()
+{
+  _privateBitmap = new BYTE[COVERAGE_MAP_SIZE];
+  memset(_privateBitmap, 0, COVERAGE_MAP_SIZE);
+  _bitmap = _privateBitmap;
+  _mapping = nullptr;
+}
+
+CoverageMap::~CoverageMap()
+{
+  Detach();
+  delete[] _privateBitmap;
+}
+
+#ifdef _WIN32
+bool CoverageMap::AttachSharedMemory(const char* mappingName)
+{
+  Detach();
+  _mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, mappingName);
+  if (_mapping == nullptr) return false;
+
+  BYTE* bitmap = reinterpret_cast<BYTE*>(MapViewOfFile(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, COVERAGE_MAP_SIZE));
+  if (bitmap == nullptr)
+  {
+    Detach();
+    return false;
+  }
+  _bitmap = bitmap;
+  return true;
+}
+
+bool CoverageMap::AttachFromEnvironment()
+{
+  char mappingName[MAX_PATH];
+  DWORD length = GetEnvironmentVariableA(COVERAGE_MAP_SHM_ENV_VAR, mappingName, MAX_PATH);
+  if (length == 0 || length >= MAX_PATH) return false;
+  return AttachSharedMemory(mappingName);
+}
+
+void CoverageMap::Detach()
+{
+  if (_bitmap != _privateBitmap)
+  {
+    UnmapViewOfFile(_bitmap);
+    _bitmap = _privateBitmap;
+  }
+  if (_mapping != nullptr)
+  {
+    CloseHandle(_mapping);
+    _mapping = nullptr;
+  }
+}
+#else
+bool CoverageMap::AttachSharedMemory(const char* mappingName)
+{
+  // AFL on Linux passes the id of a System V shared memory segment instead of a mapping name
+  Detach();
+  char* end = nullptr;
+  const long id = strtol(mappingName, &end, 10);
+  if (end == mappingName || *end != '\0') return false;
+
+  void* bitmap = shmat((int)id, nullptr, 0);
+  if (bitmap == (void*)-1) return false;
+  _bitmap = reinterpret_cast<BYTE*>(bitmap);
+  return true;
+}
+
+bool CoverageMap::AttachFromEnvironment()
+{
+  const char* mappingName = getenv(COVERAGE_MAP_SHM_ENV_VAR);
+  if (mappingName == nullptr) return false;
+  return AttachSharedMemory(mappingName);
+}
+
+void CoverageMap::Detach()
+{
+  if (_bitmap != _privateBitmap)
+  {
+    shmdt(_bitmap);
+    _bitmap = _privateBitmap;
+  }
+}
+#endif
+
+void CoverageMap::Reset()
+{
+  memset(_bitmap, 0, COVERAGE_MAP_SIZE);
+  ResetPreviousLocation();
+}
+
+DWORD CoverageMap::CountEdges()
+{
+  DWORD count = 0;
+  const ULONGLONG* words = reinterpret_cast<const ULONGLONG*>(_bitmap);
+  for (DWORD i = 0; i < COVERAGE_MAP_SIZE / sizeof(ULONGLONG); i++)
+  {
+    ULONGLONG word = words[i];
+    if (word == 0) continue;
+    for (DWORD j = 0; j < sizeof(ULONGLONG); j++, word >>= 8)
+    {
+      if (word & 0xFF) count++;
+    }
+  }
+  return count;
+}
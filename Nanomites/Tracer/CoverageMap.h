@@ -0,0 +1,50 @@
+#pragma once
+#include "Platform.h"
+
+// AFL compatible 64 KiB edge coverage bitmap
+#define COVERAGE_MAP_SIZE_POW2 16
+#define COVERAGE_MAP_SIZE (1 << COVERAGE_MAP_SIZE_POW2)
+// Environment variable naming the fuzzer owned file mapping (AFL shared memory convention)
+#define COVERAGE_MAP_SHM_ENV_VAR "__AFL_SHM_ID"
+
+// Collects edge coverage from resolved nanomites: the location of each nanomite is the RVA execution continues at
+// (jump target or fall-through), the edge (previous, current) is counted in bitmap[current ^ (previous >> 1)].
+class CoverageMap
+{
+public:
+  CoverageMap();
+  ~CoverageMap();
+
+  // Uses the bitmap of a fuzzer instead of the private one: a file mapping name on Windows, a shared memory id on Linux
+  bool AttachSharedMemory(const char* mappingName);
+  bool AttachFromEnvironment();
+  void Detach();
+
+  // Clears the bitmap and the previous location of the calling thread; call before each fuzzing iteration
+  void Reset();
+  static void ResetPreviousLocation() { _previousLocation = 0; }
+
+  void OnEdge(DWORD rva)
+  {
+    const DWORD location = Hash(rva);
+    _bitmap[location ^ _previousLocation]++;
+    _previousLocation = location >> 1;
+  }
+
+  const BYTE* GetBitmap() { return _bitmap; }
+  DWORD GetSize() { return COVERAGE_MAP_SIZE; }
+  DWORD CountEdges();
+
+private:
+  static DWORD Hash(DWORD rva)
+  {
+    // Fibonacci hashing spreads the mostly aligned RVAs over the whole map
+    return (rva * 0x9E3779B1) >> (32 - COVERAGE_MAP_SIZE_POW2);
+  }
+
+private:
+  BYTE* _bitmap;
+  BYTE* _privateBitmap;
+  HANDLE _mapping;
+  static thread_local DWORD _previousLocation;
+};
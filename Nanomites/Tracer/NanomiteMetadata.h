@@ -1,8 +1,25 @@
 #pragma once
-#include <Windows.h>
+#include "Platform.h"
 
 struct Nanomite;
 
+// Resource 1235 written by the Builder: a DWORD count followed by one entry per protected section. The nanomites of a
+// section are the range [FirstNanomite, FirstNanomite + NanomiteCount) of the RVA-sorted table in resource 1234.
+struct NanomiteSection
+{
+  BYTE Name[IMAGE_SIZEOF_SHORT_NAME];  // Null terminated if shorter than 8 characters
+  DWORD VirtualAddress;
+  DWORD VirtualSize;
+  DWORD FirstNanomite;
+  DWORD NanomiteCount;
+};
+
+struct NanomiteSectionTable
+{
+  DWORD SectionCount;
+  NanomiteSection Sections[1];  // SectionCount entries
+};
+
 struct NanomiteMetadata
 {
   DWORD ItemCount;
@@ -0,0 +1,26 @@
+#pragma once
+// Windows types and the register context of the Tracer. On Windows this is <Windows.h>; on Linux the trap path gets
+// the ucontext_t of the signal handler as its context and the few Windows types it uses are defined here.
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cstddef>
+#include <cstdint>
+#include <ucontext.h>
+
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef int32_t LONG;
+typedef uint64_t ULONGLONG;
+typedef int64_t LONGLONG;
+typedef uintptr_t DWORD_PTR;
+typedef size_t SIZE_T;
+typedef void* HANDLE;
+typedef ucontext_t CONTEXT;
+typedef CONTEXT* PCONTEXT;
+
+#define MAXDWORD 0xffffffff
+#define IMAGE_SIZEOF_SHORT_NAME 8
+#define YieldProcessor() __builtin_ia32_pause()
+#endif
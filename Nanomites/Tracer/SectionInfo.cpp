@@ -15,4 +15,6 @@ void SectionInfo::Clear()
   _sectionStart = 0;
   _sectionEnd = 0;
   _sectionSize = 0;
+  _firstNanomite = 0;
+  _nanomiteCount = MAXDWORD;
 }
\ No newline at end of file
@@ -1,5 +1,5 @@
 #pragma once
-#include <Windows.h>
+#include "Platform.h"
 
 class SectionInfo
 {
@@ -18,8 +18,15 @@ public:
   void SetSectionSize(SIZE_T size) { _sectionSize = size; }
   SIZE_T GetSectionSize() { return _sectionSize; }
 
+  // Range of the RVA-sorted nanomite table that belongs to the section, the whole table by default
+  void SetNanomiteRange(DWORD firstNanomite, DWORD nanomiteCount) { _firstNanomite = firstNanomite; _nanomiteCount = nanomiteCount; }
+  DWORD GetFirstNanomite() { return _firstNanomite; }
+  DWORD GetNanomiteCount() { return _nanomiteCount; }
+
 private:
   DWORD_PTR _sectionStart;
   DWORD_PTR _sectionEnd;
   SIZE_T _sectionSize;
+  DWORD _firstNanomite;
+  DWORD _nanomiteCount;
 };
\ No newline at end of file
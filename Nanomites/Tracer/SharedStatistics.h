@@ -0,0 +1,35 @@
+#pragma once
+#include <Windows.h>
+
+// Layout of the shared memory segment published by StatisticsPublisher and read by Nanostat.
+// The mapping name is NANOMITES_STATISTICS_MAPPING_PREFIX followed by the decimal process id.
+#define NANOMITES_STATISTICS_MAPPING_PREFIX "Local\\NanomitesStatistics."
+#define NANOMITES_STATISTICS_MAGIC 0x54534E4E // "NNST"
+#define NANOMITES_STATISTICS_VERSION 1
+#define NANOMITES_STATISTICS_HOT_SITES 16
+
+struct SharedHotSite
+{
+  DWORD Rva;              // Relative to ImageBase
+  DWORD JumpType;
+  ULONGLONG Hits;         // Total traps of this site
+  ULONGLONG HitsPerSecond;
+};
+
+struct SharedStatistics
+{
+  DWORD Magic;
+  DWORD Version;
+  volatile LONG Sequence; // Seqlock: odd while the publisher is writing, readers retry until they see the same even value twice
+  DWORD ProcessId;
+  DWORD IntervalMs;
+  DWORD SiteCount;
+  ULONGLONG Timestamp;    // GetTickCount64() of the last update
+  ULONGLONG Traps;
+  ULONGLONG TrapsPerSecond;
+  ULONGLONG Misses;
+  ULONGLONG ForeignBreakpoints;
+  DWORD HotSiteCount;
+  DWORD Reserved;
+  SharedHotSite HotSites[NANOMITES_STATISTICS_HOT_SITES];
+};
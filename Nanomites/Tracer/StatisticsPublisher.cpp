@@ -0,0 +1,130 @@
+#include <string>
+#include "StatisticsPublisher.h"
+#include "TracerStatistics.h"
+
+StatisticsPublisher::StatisticsPublisher(TracerStatistics* statistics)
+{
+  _statistics = statistics;
+  _mapping = nullptr;
+  _shared = nullptr;
+  _stopEvent = nullptr;
+  _intervalMs = 1000;
+  _previousTraps = 0;
+}
+
+StatisticsPublisher::~StatisticsPublisher()
+{
+  Stop();
+}
+
+bool StatisticsPublisher::Start(DWORD intervalMs)
+{
+  if (_shared != nullptr) return true;
+
+  const DWORD processId = GetCurrentProcessId();
+  const std::string mappingName = NANOMITES_STATISTICS_MAPPING_PREFIX + std::to_string(processId);
+  _mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(SharedStatistics), mappingName.c_str());
+  if (_mapping == nullptr) return false;
+
+  _shared = reinterpret_cast<SharedStatistics*>(MapViewOfFile(_mapping, FILE_MAP_WRITE, 0, 0, sizeof(SharedStatistics)));
+  if (_shared == nullptr)
+  {
+    CloseMapping();
+    return false;
+  }
+
+  memset(_shared, 0, sizeof(SharedStatistics));
+  _shared->Magic = NANOMITES_STATISTICS_MAGIC;
+  _shared->Version = NANOMITES_STATISTICS_VERSION;
+  _shared->ProcessId = processId;
+  _shared->IntervalMs = intervalMs;
+
+  _intervalMs = intervalMs;
+  _previousTraps = _statistics->GetTraps();
+  _previousSiteHits.clear();
+  _stopEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+  _thread = std::thread(&StatisticsPublisher::Run, this);
+  return true;
+}
+
+void StatisticsPublisher::Stop()
+{
+  if (_thread.joinable())
+  {
+    SetEvent(_stopEvent);
+    _thread.join();
+  }
+  if (_stopEvent != nullptr)
+  {
+    CloseHandle(_stopEvent);
+    _stopEvent = nullptr;
+  }
+  CloseMapping();
+}
+
+void StatisticsPublisher::Run()
+{
+  ULONGLONG last = GetTickCount64();
+  while (WaitForSingleObject(_stopEvent, _intervalMs) == WAIT_TIMEOUT)
+  {
+    ULONGLONG now = GetTickCount64();
+    Publish(now > last ? now - last : 1);
+    last = now;
+  }
+}
+
+void StatisticsPublisher::Publish(ULONGLONG elapsedMs)
+{
+  // Everything is gathered into a local snapshot first, so the seqlock write section stays short
+  SharedStatistics snapshot = {};
+  snapshot.IntervalMs = _intervalMs;
+  snapshot.Timestamp = GetTickCount64();
+  snapshot.Traps = _statistics->GetTraps();
+  snapshot.TrapsPerSecond = (snapshot.Traps - _previousTraps) * 1000 / elapsedMs;
+  snapshot.Misses = _statistics->GetMisses();
+  snapshot.ForeignBreakpoints = _statistics->GetForeignBreakpoints();
+  UpdateHotSites(elapsedMs, snapshot);
+  _previousTraps = snapshot.Traps;
+
+  InterlockedIncrement(&_shared->Sequence); // odd: write in progress
+  _shared->IntervalMs = snapshot.IntervalMs;
+  _shared->SiteCount = snapshot.SiteCount;
+  _shared->Timestamp = snapshot.Timestamp;
+  _shared->Traps = snapshot.Traps;
+  _shared->TrapsPerSecond = snapshot.TrapsPerSecond;
+  _shared->Misses = snapshot.Misses;
+  _shared->ForeignBreakpoints = snapshot.ForeignBreakpoints;
+  _shared->HotSiteCount = snapshot.HotSiteCount;
+  memcpy(_shared->HotSites, snapshot.HotSites, sizeof(snapshot.HotSites));
+  InterlockedIncrement(&_shared->Sequence); // even: consistent again
+}
+
+void StatisticsPublisher::UpdateHotSites(ULONGLONG elapsedMs, SharedStatistics& snapshot)
+{
+  std::vector<HotSite> hotSites;
+  _statistics->GetHotSites(_previousSiteHits, NANOMITES_STATISTICS_HOT_SITES, hotSites);
+
+  snapshot.SiteCount = (DWORD)_previousSiteHits.size();
+  snapshot.HotSiteCount = (DWORD)hotSites.size();
+  for (size_t i = 0; i < hotSites.size(); i++)
+  {
+    snapshot.HotSites[i].Rva = hotSites[i].Rva;
+    snapshot.HotSites[i].JumpType = hotSites[i].JumpType;
+    snapshot.HotSites[i].Hits = hotSites[i].Hits;
+    snapshot.HotSites[i].HitsPerSecond = hotSites[i].Delta * 1000 / elapsedMs;
+  }
+}
+
+void StatisticsPublisher::CloseMapping()
+{
+  if (_shared != nullptr)
+  {
+    UnmapViewOfFile(_shared);
+    _shared = nullptr;
+  }
+  if (_mapping != nullptr)
+  {
+    CloseHandle(_mapping);
+    _mapping = nullptr;
+  }
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <Windows.h>
+#include <thread>
+#include <vector>
+#include "SharedStatistics.h"
+
+class TracerStatistics;
+
+// Samples TracerStatistics on a background thread and publishes the results into a named,
+// seqlock protected shared memory segment (see SharedStatistics.h), which can be read by Nanostat.
+class StatisticsPublisher
+{
+public:
+  StatisticsPublisher(TracerStatistics* statistics);
+  ~StatisticsPublisher();
+
+  bool Start(DWORD intervalMs);
+  void Stop();
+
+private:
+  void Run();
+  void Publish(ULONGLONG elapsedMs);
+  void UpdateHotSites(ULONGLONG elapsedMs, SharedStatistics& snapshot);
+  void CloseMapping();
+
+private:
+  TracerStatistics* _statistics;
+  HANDLE _mapping;
+  SharedStatistics* _shared;
+  HANDLE _stopEvent;
+  std::thread _thread;
+  DWORD _intervalMs;
+
+  ULONGLONG _previousTraps;
+  std::vector<ULONGLONG> _previousSiteHits;
+};
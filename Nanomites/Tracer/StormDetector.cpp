@@ -0,0 +1,141 @@
+#include <iostream>
+#include <iomanip>
+#include "StormDetector.h"
+
+StormDetector::StormDetector(TracerStatistics* statistics, const StormDetectorSettings& settings)
+{
+  _statistics = statistics;
+  _settings = settings;
+  _stopEvent = nullptr;
+  _lastSampleMs = 0;
+  _lastTraps = 0;
+  _lastReportMs = 0;
+  _suppressedReports = 0;
+  _hasSample = false;
+  _armed = false;
+}
+
+StormDetector::~StormDetector()
+{
+  Stop();
+}
+
+StormDetectorSettings StormDetector::DefaultSettings(ULONGLONG thresholdTrapsPerSecond)
+{
+  StormDetectorSettings settings;
+  settings.ThresholdTrapsPerSecond = thresholdTrapsPerSecond;
+  settings.SampleIntervalMs = 100;
+  settings.MinReportIntervalMs = 10000;
+  settings.HotSiteCount = 5;
+  settings.Callback = nullptr;
+  return settings;
+}
+
+void StormDetector::Start()
+{
+  if (_thread.joinable()) return;
+  _stopEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+  _thread = std::thread(&StormDetector::Run, this);
+}
+
+void StormDetector::Stop()
+{
+  if (_thread.joinable())
+  {
+    SetEvent(_stopEvent);
+    _thread.join();
+  }
+  if (_stopEvent != nullptr)
+  {
+    CloseHandle(_stopEvent);
+    _stopEvent = nullptr;
+  }
+}
+
+void StormDetector::Run()
+{
+  Sample(GetTickCount64());
+  while (WaitForSingleObject(_stopEvent, _settings.SampleIntervalMs) == WAIT_TIMEOUT)
+  {
+    Sample(GetTickCount64());
+  }
+}
+
+void StormDetector::Sample(ULONGLONG nowMs)
+{
+  const ULONGLONG traps = _statistics->GetTraps();
+  if (!_hasSample || nowMs <= _lastSampleMs)
+  {
+    _hasSample = true;
+    _lastSampleMs = nowMs;
+    _lastTraps = traps;
+    return;
+  }
+
+  const ULONGLONG elapsedMs = nowMs - _lastSampleMs;
+  const ULONGLONG trapsPerSecond = (traps - _lastTraps) * 1000 / elapsedMs;
+  _lastSampleMs = nowMs;
+  _lastTraps = traps;
+
+  if (trapsPerSecond < _settings.ThresholdTrapsPerSecond)
+  {
+    _armed = false;
+    return;
+  }
+
+  if (!_armed)
+  {
+    // First sample above the threshold: remember the site counters, the next sample names the offenders
+    std::vector<HotSite> ignored;
+    _statistics->GetHotSites(_siteHits, 0, ignored);
+    _armed = true;
+    return;
+  }
+
+  if (_lastReportMs != 0 && nowMs - _lastReportMs < _settings.MinReportIntervalMs)
+  {
+    // Keep the site counters current, so the next report covers a single interval
+    std::vector<HotSite> ignored;
+    _statistics->GetHotSites(_siteHits, 0, ignored);
+    _suppressedReports++;
+    return;
+  }
+
+  Report(trapsPerSecond, elapsedMs);
+  _lastReportMs = nowMs;
+}
+
+void StormDetector::Report(ULONGLONG trapsPerSecond, ULONGLONG elapsedMs)
+{
+  StormReport report;
+  report.TrapsPerSecond = trapsPerSecond;
+  report.Threshold = _settings.ThresholdTrapsPerSecond;
+  report.SuppressedReports = _suppressedReports;
+  _statistics->GetHotSites(_siteHits, _settings.HotSiteCount, report.HotSites);
+  for (HotSite& hotSite : report.HotSites)
+  {
+    hotSite.Delta = hotSite.Delta * 1000 / elapsedMs;
+  }
+  _suppressedReports = 0;
+
+  if (_settings.Callback)
+  {
+    _settings.Callback(report);
+  }
+  else
+  {
+    LogReport(report);
+  }
+}
+
+void StormDetector::LogReport(const StormReport& report)
+{
+  std::cout << "Tracer : Exception storm detected, " << report.TrapsPerSecond << " traps/s (threshold " << report.Threshold << ")";
+  if (report.SuppressedReports != 0) std::cout << ", " << report.SuppressedReports << " reports suppressed";
+  std::cout << ", top sites:";
+  for (const HotSite& hotSite : report.HotSites)
+  {
+    std::cout << " 0x" << std::hex << std::uppercase << std::setw(8) << std::setfill('0') << hotSite.Rva << std::dec << std::setfill(' ') << " (" << hotSite.Delta << "/s)";
+  }
+  std::cout << std::endl;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <Windows.h>
+#include <functional>
+#include <thread>
+#include <vector>
+#include "TracerStatistics.h"
+
+struct StormReport
+{
+  ULONGLONG TrapsPerSecond;
+  ULONGLONG Threshold;
+  ULONGLONG SuppressedReports;    // Storm samples not reported because of the rate limit
+  std::vector<HotSite> HotSites;  // Top offending sites, Delta is given in traps per second
+};
+
+typedef std::function<void(const StormReport& report)> StormCallback;
+
+struct StormDetectorSettings
+{
+  ULONGLONG ThresholdTrapsPerSecond;
+  DWORD SampleIntervalMs;
+  DWORD MinReportIntervalMs; // Rate limit for reports
+  DWORD HotSiteCount;
+  StormCallback Callback;    // Writes a log line to std::cout if empty
+};
+
+// Detects exception storms by sampling the total trap counter. The per-site counters are only evaluated
+// once the threshold was exceeded for two consecutive samples, so the trap path is not affected.
+class StormDetector
+{
+public:
+  StormDetector(TracerStatistics* statistics, const StormDetectorSettings& settings);
+  ~StormDetector();
+
+  void Start();
+  void Stop();
+
+  // Called by the sampling thread; may be called directly with a synthetic clock
+  void Sample(ULONGLONG nowMs);
+
+  static StormDetectorSettings DefaultSettings(ULONGLONG thresholdTrapsPerSecond);
+
+private:
+  void Run();
+  void Report(ULONGLONG trapsPerSecond, ULONGLONG elapsedMs);
+  static void LogReport(const StormReport& report);
+
+private:
+  TracerStatistics* _statistics;
+  StormDetectorSettings _settings;
+  HANDLE _stopEvent;
+  std::thread _thread;
+
+  ULONGLONG _lastSampleMs;
+  ULONGLONG _lastTraps;
+  ULONGLONG _lastReportMs;
+  ULONGLONG _suppressedReports;
+  bool _hasSample;
+  bool _armed;
+  std::vector<ULONGLONG> _siteHits;
+};
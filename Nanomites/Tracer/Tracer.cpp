@@ -1,19 +1,37 @@
 #include "Tracer.h"
 #include "NanomiteMetadata.h"
 #include "Nanomite.h"
-#include "PEImage.h"
 #include "SectionInfo.h"
+#include "CoverageMap.h"
+#ifdef _WIN32
+#include "PEImage.h"
+#include "StatisticsPublisher.h"
+#else
+#include <cstring>
+#endif
 
 Tracer::Tracer()
 {
+#ifdef _WIN32
   _exceptionHandler = nullptr;
-  _nanomiteSection = nullptr;
+  _statisticsPublisher = nullptr;
+  _stormDetector = nullptr;
+#else
+  _signalHandlerInstalled = false;
+  memset(&_previousSignalAction, 0, sizeof(_previousSignalAction));
+#endif
   _imageBase = 0;
+  _firstNanomite = nullptr;
+  _coverageMap = nullptr;
 }
 
 Tracer::~Tracer()
 {
   StopTracing();
+#ifdef _WIN32
+  StopPublishingStatistics();
+  StopStormDetection();
+#endif
 }
 
 Tracer& Tracer::Instance()
@@ -23,28 +41,108 @@ Tracer& Tracer::Instance()
 }
 
 void Tracer::StartTracing(DWORD_PTR imageBase, SectionInfo* nanomitesSection, NanomiteMetadata* metadata)
+{
+  StartTracing(imageBase, std::vector<SectionInfo*>(1, nanomitesSection), metadata);
+}
+
+void Tracer::StartTracing(DWORD_PTR imageBase, const std::vector<SectionInfo*>& nanomiteSections, NanomiteMetadata* metadata)
 {
 #define CALL_FIRST 1  
 #define CALL_LAST 0
-  _imageBase = imageBase;
-  _nanomiteSection = nanomitesSection;
-  ReadNanomiteMetadata(metadata);
+  Attach(imageBase, nanomiteSections, metadata);
+#ifdef _WIN32
   if (_exceptionHandler == nullptr)
   {
     _exceptionHandler = AddVectoredExceptionHandler(CALL_FIRST, VectoredHandlerBreakPoint);
   }
+#else
+  if (!_signalHandlerInstalled)
+  {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = SignalHandlerBreakPoint;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    _signalHandlerInstalled = sigaction(SIGTRAP, &action, &_previousSignalAction) == 0;
+  }
+#endif
 }
 
 void Tracer::StopTracing()
 {
-  _imageBase = 0;
-  _nanomiteSection = nullptr;
-  _nanomiteLookup.clear();
+#ifdef _WIN32
   if (_exceptionHandler != nullptr)
   {
     RemoveVectoredExceptionHandler(_exceptionHandler);
     _exceptionHandler = nullptr;
   }
+#else
+  if (_signalHandlerInstalled)
+  {
+    sigaction(SIGTRAP, &_previousSignalAction, nullptr);
+    _signalHandlerInstalled = false;
+  }
+#endif
+  Detach();
+}
+
+void Tracer::Attach(DWORD_PTR imageBase, SectionInfo* nanomitesSection, NanomiteMetadata* metadata)
+{
+  Attach(imageBase, std::vector<SectionInfo*>(1, nanomitesSection), metadata);
+}
+
+void Tracer::Attach(DWORD_PTR imageBase, const std::vector<SectionInfo*>& nanomiteSections, NanomiteMetadata* metadata)
+{
+  _imageBase = imageBase;
+  _nanomiteSections = nanomiteSections;
+  ReadNanomiteMetadata(metadata);
+  if (!_statistics.IsInitializedFor(metadata))
+  {
+    _statistics.Initialize(metadata);
+  }
+}
+
+void Tracer::Detach()
+{
+  _imageBase = 0;
+  _nanomiteSections.clear();
+  _nanomiteLookup.clear();
+  _firstNanomite = nullptr;
+}
+
+#ifdef _WIN32
+bool Tracer::StartPublishingStatistics(DWORD intervalMs)
+{
+  if (_statisticsPublisher == nullptr)
+  {
+    _statisticsPublisher = new StatisticsPublisher(&_statistics);
+  }
+  return _statisticsPublisher->Start(intervalMs);
+}
+
+void Tracer::StopPublishingStatistics()
+{
+  if (_statisticsPublisher != nullptr)
+  {
+    delete _statisticsPublisher;
+    _statisticsPublisher = nullptr;
+  }
+}
+
+void Tracer::StartStormDetection(const StormDetectorSettings& settings)
+{
+  StopStormDetection();
+  _stormDetector = new StormDetector(&_statistics, settings);
+  _stormDetector->Start();
+}
+
+void Tracer::StopStormDetection()
+{
+  if (_stormDetector != nullptr)
+  {
+    delete _stormDetector;
+    _stormDetector = nullptr;
+  }
 }
 
 SectionInfo* Tracer::CreateSectionInfo(const char* sectionName, DWORD_PTR imageBase)
@@ -64,7 +162,33 @@ SectionInfo* Tracer::CreateSectionInfo(const char* sectionName, DWORD_PTR imageB
 
   return sectionInfo;
 }
+#endif
+
+std::vector<SectionInfo*> Tracer::CreateSectionInfos(const NanomiteSectionTable* sectionTable, DWORD_PTR imageBase)
+{
+  std::vector<SectionInfo*> sectionInfos;
+  if (sectionTable == nullptr) return sectionInfos;
+
+  for (DWORD i = 0; i < sectionTable->SectionCount; i++)
+  {
+    const NanomiteSection& section = sectionTable->Sections[i];
+    if (section.VirtualSize == 0) continue;
+
+    SectionInfo* sectionInfo = new SectionInfo();
+    DWORD_PTR sectionStart = imageBase + section.VirtualAddress;
+    DWORD_PTR sectionSize = section.VirtualSize;
+    DWORD_PTR sectionEnd = sectionStart + sectionSize - 1;
+
+    sectionInfo->SetSectionStart(sectionStart);
+    sectionInfo->SetSectionEnd(sectionEnd);
+    sectionInfo->SetSectionSize(sectionSize);
+    sectionInfo->SetNanomiteRange(section.FirstNanomite, section.NanomiteCount);
+    sectionInfos.push_back(sectionInfo);
+  }
+  return sectionInfos;
+}
 
+#ifdef _WIN32
 LONG WINAPI Tracer::VectoredHandlerBreakPoint(_EXCEPTION_POINTERS* ExceptionInfo)
 {
   if (ExceptionInfo->ExceptionRecord->ExceptionCode == EXCEPTION_BREAKPOINT)
@@ -76,16 +200,56 @@ LONG WINAPI Tracer::VectoredHandlerBreakPoint(_EXCEPTION_POINTERS* ExceptionInfo
   }
   return EXCEPTION_CONTINUE_SEARCH;
 }
+#else
+void Tracer::SignalHandlerBreakPoint(int signalNumber, siginfo_t* info, void* context)
+{
+  Tracer& tracer = Tracer::Instance();
+  PCONTEXT contextRecord = reinterpret_cast<PCONTEXT>(context);
+  // int 3 is reported with SI_KERNEL and the instruction pointer behind it, Windows reports it at the int 3
+  const DWORD_PTR address = tracer.GetInstructionPointer(contextRecord) - 1;
+  if (info->si_code == SI_KERNEL)
+  {
+    tracer.SetInstructionPointer(contextRecord, address);
+    if (tracer.ResolveNanomite(contextRecord)) return;
+    tracer.SetInstructionPointer(contextRecord, address + 1);
+  }
+
+  // Like EXCEPTION_CONTINUE_SEARCH: the handler installed before the Tracer gets the signal, by default it terminates
+  const struct sigaction& previous = tracer._previousSignalAction;
+  if ((previous.sa_flags & SA_SIGINFO) != 0)
+  {
+    previous.sa_sigaction(signalNumber, info, context);
+  }
+  else if (previous.sa_handler == SIG_DFL)
+  {
+    signal(SIGTRAP, SIG_DFL);
+    raise(SIGTRAP);
+  }
+  else if (previous.sa_handler != SIG_IGN)
+  {
+    previous.sa_handler(signalNumber);
+  }
+}
+#endif
 
 bool Tracer::ResolveNanomite(PCONTEXT context)
 {
   DWORD_PTR eip = GetInstructionPointer(context);
-  if (eip < _nanomiteSection->GetSectionStart() || eip > _nanomiteSection->GetSectionEnd()) return false;
+  if (!IsTracedAddress(eip))
+  {
+    _statistics.OnForeignBreakpoint();
+    return false;
+  }
 
   DWORD_PTR va = eip;
   DWORD rva = (DWORD)(va - _imageBase);
   Nanomite* nanomite = GetNanomite(rva);
-  if (nanomite == nullptr) return false;
+  if (nanomite == nullptr)
+  {
+    _statistics.OnMiss();
+    return false;
+  }
+  _statistics.OnTrap((DWORD)(nanomite - _firstNanomite));
 
   if (ExecuteJump(nanomite, context))
   {
@@ -98,13 +262,28 @@ bool Tracer::ResolveNanomite(PCONTEXT context)
     SetInstructionPointer(context, eip);
   }
 
+  if (_coverageMap != nullptr)
+  {
+    _coverageMap->OnEdge((DWORD)(eip - _imageBase));
+  }
+
   return true;
 }
 
+bool Tracer::IsTracedAddress(DWORD_PTR address)
+{
+  // Usually one section, rarely more than a few
+  for (SectionInfo* section : _nanomiteSections)
+  {
+    if (address >= section->GetSectionStart() && address <= section->GetSectionEnd()) return true;
+  }
+  return false;
+}
+
 bool Tracer::ExecuteJump(Nanomite* nanomite, PCONTEXT context)
 {
   JumpType jumpType = (JumpType)nanomite->JumpType;
-  DWORD eflags = context->EFlags;
+  DWORD eflags = GetFlags(context);
 
   switch (jumpType)
   {
@@ -140,11 +319,7 @@ bool Tracer::ExecuteJump(Nanomite* nanomite, PCONTEXT context)
   break;
   case JumpType::JCXZ:
   {
-#ifdef _WIN64
-    return context->Rcx == 0;
-#else
-    return context->Ecx == 0;
-#endif    
+    return GetCounter(context) == 0;
   }
   break;
   case JumpType::JNS:
@@ -218,30 +393,71 @@ Nanomite* Tracer::GetNanomite(DWORD rva)
 void Tracer::ReadNanomiteMetadata(NanomiteMetadata* metadata)
 {
   _nanomiteLookup.clear();
+  _firstNanomite = nullptr;
   if (metadata == nullptr || metadata->ItemCount == 0) return;
 
   Nanomite* first = reinterpret_cast<Nanomite*>(reinterpret_cast<BYTE*>(metadata) + sizeof(NanomiteMetadata));
-  for (DWORD i = 0; i < metadata->ItemCount; i++)
+  _firstNanomite = first;
+  // Only the range of each traced section, so a site always resolves through the section that contains it
+  for (SectionInfo* section : _nanomiteSections)
   {
-    Nanomite* nanomite = first + i;
-    _nanomiteLookup[nanomite->Rva] = nanomite;
+    const DWORD begin = section->GetFirstNanomite() < metadata->ItemCount ? section->GetFirstNanomite() : metadata->ItemCount;
+    const DWORD available = metadata->ItemCount - begin;
+    const DWORD end = begin + (section->GetNanomiteCount() < available ? section->GetNanomiteCount() : available);
+    for (DWORD i = begin; i < end; i++)
+    {
+      Nanomite* nanomite = first + i;
+      if (nanomite->Rva < section->GetSectionStart() - _imageBase || nanomite->Rva > section->GetSectionEnd() - _imageBase) continue;
+      _nanomiteLookup[nanomite->Rva] = nanomite;
+    }
   }
 }
 
 void Tracer::SetInstructionPointer(PCONTEXT& context, DWORD_PTR value)
 {
-#ifdef _WIN64
+#if defined(_WIN64)
   context->Rip = value;
-#else
+#elif defined(_WIN32)
   context->Eip = value;
+#elif defined(__x86_64__)
+  context->uc_mcontext.gregs[REG_RIP] = (greg_t)value;
+#else
+  context->uc_mcontext.gregs[REG_EIP] = (greg_t)value;
 #endif  
 }
 
 DWORD_PTR Tracer::GetInstructionPointer(PCONTEXT& context)
 {
-#ifdef _WIN64
+#if defined(_WIN64)
   return context->Rip;
-#else
+#elif defined(_WIN32)
   return context->Eip;
+#elif defined(__x86_64__)
+  return (DWORD_PTR)context->uc_mcontext.gregs[REG_RIP];
+#else
+  return (DWORD_PTR)context->uc_mcontext.gregs[REG_EIP];
+#endif
+}
+
+DWORD Tracer::GetFlags(PCONTEXT context)
+{
+#ifdef _WIN32
+  return context->EFlags;
+#else
+  return (DWORD)context->uc_mcontext.gregs[REG_EFL];
+#endif
+}
+
+DWORD_PTR Tracer::GetCounter(PCONTEXT context)
+{
+  // rcx for jrcxz on x64, ecx for jecxz on x86
+#if defined(_WIN64)
+  return context->Rcx;
+#elif defined(_WIN32)
+  return context->Ecx;
+#elif defined(__x86_64__)
+  return (DWORD_PTR)context->uc_mcontext.gregs[REG_RCX];
+#else
+  return (DWORD_PTR)context->uc_mcontext.gregs[REG_ECX];
 #endif
 }
\ No newline at end of file
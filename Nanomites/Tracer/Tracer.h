@@ -1,30 +1,78 @@
 #pragma once
-#include <Windows.h>
+#include "Platform.h"
 #include <map>
+#include <vector>
+#include "TracerStatistics.h"
+#ifdef _WIN32
+#include "StormDetector.h"
+#else
+#include <signal.h>
+#endif
 
 struct NanomiteMetadata;
+struct NanomiteSectionTable;
 struct Nanomite;
 class SectionInfo;
+class StatisticsPublisher;
+class CoverageMap;
 
+// Resolves the nanomites of the protected sections, on Windows in a vectored exception handler, on Linux in a SIGTRAP
+// handler. The PE image of the process, the statistics publishing and the storm detection are Windows-only.
 class Tracer
 {
 public:
   static Tracer& Instance();
 
+#ifdef _WIN32
   SectionInfo* CreateSectionInfo(const char* sectionName, DWORD_PTR imageBase);
+#endif
+  // One SectionInfo per protected section of resource 1235, each limited to its range of the nanomite table
+  std::vector<SectionInfo*> CreateSectionInfos(const NanomiteSectionTable* sectionTable, DWORD_PTR imageBase);
 
   void StartTracing(DWORD_PTR imageBase, SectionInfo* nanomitesSection, NanomiteMetadata* metadata);
+  void StartTracing(DWORD_PTR imageBase, const std::vector<SectionInfo*>& nanomiteSections, NanomiteMetadata* metadata);
   void StopTracing();
 
+#ifdef _WIN32
+  // Publishes the trap counters into shared memory for Nanostat (see StatisticsPublisher)
+  bool StartPublishingStatistics(DWORD intervalMs);
+  void StopPublishingStatistics();
+#endif
+  TracerStatistics& GetStatistics() { return _statistics; }
+
+#ifdef _WIN32
+  // Reports trap rates above the threshold together with the top offending sites (see StormDetector)
+  void StartStormDetection(const StormDetectorSettings& settings);
+  void StopStormDetection();
+#endif
+
+  // Records edge coverage of resolved nanomites into the given map, nullptr disables it (see CoverageMap)
+  void SetCoverageMap(CoverageMap* coverageMap) { _coverageMap = coverageMap; }
+  CoverageMap* GetCoverageMap() { return _coverageMap; }
+
 private:
+  friend class TracerBenchmark; // Drives the resolver with synthetic contexts
+
   Tracer();
   ~Tracer();
 
+  // Sets up the lookup for the given sections without registering the exception handler
+  void Attach(DWORD_PTR imageBase, SectionInfo* nanomitesSection, NanomiteMetadata* metadata);
+  void Attach(DWORD_PTR imageBase, const std::vector<SectionInfo*>& nanomiteSections, NanomiteMetadata* metadata);
+  void Detach();
+
+#ifdef _WIN32
   static LONG WINAPI VectoredHandlerBreakPoint(_EXCEPTION_POINTERS* ExceptionInfo);
+#else
+  static void SignalHandlerBreakPoint(int signalNumber, siginfo_t* info, void* context);
+#endif
 
   bool ResolveNanomite(PCONTEXT context);
+  bool IsTracedAddress(DWORD_PTR address);
 
   bool ExecuteJump(Nanomite* nanomite, PCONTEXT context);
+  DWORD GetFlags(PCONTEXT context);
+  DWORD_PTR GetCounter(PCONTEXT context);
   bool ZF(DWORD eflags) { return (eflags & 0x00000040) != 0; }
   bool OF(DWORD eflags) { return (eflags & 0x00000800) != 0; }
   bool SF(DWORD eflags) { return (eflags & 0x00000080) != 0; }
@@ -38,9 +86,21 @@ private:
   DWORD_PTR GetInstructionPointer(PCONTEXT& context);
 
 private:
+#ifdef _WIN32
   PVOID _exceptionHandler;
+#else
+  bool _signalHandlerInstalled;
+  struct sigaction _previousSignalAction; // Gets the breakpoints that are no nanomites
+#endif
   DWORD_PTR _imageBase;
-  SectionInfo* _nanomiteSection;
+  std::vector<SectionInfo*> _nanomiteSections;
   std::map<DWORD, Nanomite*> _nanomiteLookup;
+  Nanomite* _firstNanomite;
+  TracerStatistics _statistics;
+#ifdef _WIN32
+  StatisticsPublisher* _statisticsPublisher;
+  StormDetector* _stormDetector;
+#endif
+  CoverageMap* _coverageMap;
 };
 
@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include "TracerStatistics.h"
+#include "NanomiteMetadata.h"
+#include "Nanomite.h"
+
+TracerStatistics::TracerStatistics()
+{
+  _traps = 0;
+  _misses = 0;
+  _foreignBreakpoints = 0;
+  _epoch = 0;
+  _activeTraps[0].Count = 0;
+  _activeTraps[1].Count = 0;
+  _metadata = nullptr;
+  _sites = nullptr;
+  _siteCount = 0;
+  _siteCounters = nullptr;
+}
+
+TracerStatistics::~TracerStatistics()
+{
+  // The exception handler is removed before the Tracer and its statistics are destroyed
+  delete[] _sites;
+  DeleteCounters(_siteCounters.exchange(nullptr));
+}
+
+void TracerStatistics::Initialize(NanomiteMetadata* metadata)
+{
+  std::lock_guard<std::mutex> lock(_siteLock);
+
+  // Readers hold the lock, so the copy of the sites can be replaced directly
+  delete[] _sites;
+  _sites = nullptr;
+  _siteCount = 0;
+  _traps = 0;
+  _misses = 0;
+  _foreignBreakpoints = 0;
+  _metadata = metadata;
+
+  SiteCounters* counters = new SiteCounters();
+  counters->Count = 0;
+  counters->Hits = nullptr;
+  if (metadata != nullptr && metadata->ItemCount != 0)
+  {
+    // Keep a private copy of the sites, so readers do not depend on the lifetime of the metadata
+    const Nanomite* first = reinterpret_cast<const Nanomite*>(reinterpret_cast<BYTE*>(metadata) + sizeof(NanomiteMetadata));
+    _siteCount = metadata->ItemCount;
+    _sites = new Nanomite[_siteCount];
+    memcpy(_sites, first, _siteCount * sizeof(Nanomite));
+    counters->Count = _siteCount;
+    counters->Hits = new std::atomic<ULONGLONG>[_siteCount];
+    for (DWORD i = 0; i < _siteCount; i++)
+    {
+      counters->Hits[i] = 0;
+    }
+  }
+
+  ReplaceCounters(counters);
+}
+
+void TracerStatistics::GetHotSites(std::vector<ULONGLONG>& previousHits, DWORD maxCount, std::vector<HotSite>& result)
+{
+  std::lock_guard<std::mutex> lock(_siteLock);
+
+  result.clear();
+  if (previousHits.size() != _siteCount)
+  {
+    previousHits.assign(_siteCount, 0);
+  }
+
+  std::vector<std::pair<ULONGLONG, DWORD>> deltas;
+  for (DWORD i = 0; i < _siteCount; i++)
+  {
+    ULONGLONG hits = GetSiteHits(i);
+    ULONGLONG delta = hits - previousHits[i];
+    previousHits[i] = hits;
+    if (delta != 0) deltas.push_back({ delta, i });
+  }
+
+  const size_t count = deltas.size() < maxCount ? deltas.size() : maxCount;
+  std::partial_sort(deltas.begin(), deltas.begin() + count, deltas.end(), [](const auto& a, const auto& b) -> bool
+  {
+    return a.first > b.first;
+  });
+
+  for (size_t i = 0; i < count; i++)
+  {
+    const DWORD siteIndex = deltas[i].second;
+    HotSite hotSite;
+    hotSite.Rva = _sites[siteIndex].Rva;
+    hotSite.JumpType = _sites[siteIndex].JumpType;
+    hotSite.Hits = previousHits[siteIndex];
+    hotSite.Delta = deltas[i].first;
+    result.push_back(hotSite);
+  }
+}
+
+bool TracerStatistics::WriteProfile(const char* fileName)
+{
+  std::ofstream file(fileName);
+  if (!file.is_open()) return false;
+
+  std::lock_guard<std::mutex> lock(_siteLock);
+  file << "# rva,hits" << std::endl;
+  for (DWORD i = 0; i < _siteCount; i++)
+  {
+    const ULONGLONG hits = GetSiteHits(i);
+    if (hits != 0) file << "0x" << std::hex << _sites[i].Rva << std::dec << "," << hits << "\n";
+  }
+  return file.good();
+}
+
+const Nanomite* TracerStatistics::GetSite(DWORD siteIndex)
+{
+  return &_sites[siteIndex];
+}
+
+void TracerStatistics::ReplaceCounters(SiteCounters* counters)
+{
+  // The exception handler may be incrementing the old block right now. Traps that entered the old epoch may hold
+  // it, traps of the new epoch load the block after the exchange and get the new one. The old epoch only drains,
+  // so the wait is bounded by one pass through OnTrap.
+  SiteCounters* previous = _siteCounters.exchange(counters, std::memory_order_seq_cst);
+  const DWORD epoch = _epoch.fetch_add(1, std::memory_order_seq_cst);
+  while (_activeTraps[epoch & 1].Count.load(std::memory_order_seq_cst) != 0)
+  {
+    YieldProcessor();
+  }
+  DeleteCounters(previous);
+}
+
+void TracerStatistics::DeleteCounters(SiteCounters* counters)
+{
+  if (counters == nullptr) return;
+  delete[] counters->Hits;
+  delete counters;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include "Platform.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+struct NanomiteMetadata;
+struct Nanomite;
+
+struct HotSite
+{
+  DWORD Rva;       // Relative to ImageBase
+  DWORD JumpType;
+  ULONGLONG Hits;  // Total traps of this site
+  ULONGLONG Delta; // Traps since the previous call of GetHotSites
+};
+
+// Trap counters updated by the exception handler. The handler only performs relaxed increments,
+// everything else (rates, rankings, publishing) is done by the readers. The site counters may be
+// replaced while the handler runs on other threads: Initialize publishes a new block with one
+// atomic exchange and frees the old one once the traps that may hold it have left OnTrap.
+class TracerStatistics
+{
+public:
+  TracerStatistics();
+  ~TracerStatistics();
+
+  void Initialize(NanomiteMetadata* metadata);
+  bool IsInitializedFor(NanomiteMetadata* metadata) { return _metadata == metadata; }
+
+  void OnTrap(DWORD siteIndex)
+  {
+    _traps.fetch_add(1, std::memory_order_relaxed);
+    // The trap enters the current epoch before it loads the block, see ReplaceCounters
+    std::atomic<DWORD>& activeTraps = _activeTraps[_epoch.load(std::memory_order_seq_cst) & 1].Count;
+    activeTraps.fetch_add(1, std::memory_order_seq_cst);
+    SiteCounters* counters = _siteCounters.load(std::memory_order_seq_cst);
+    if (counters != nullptr && siteIndex < counters->Count)
+    {
+      counters->Hits[siteIndex].fetch_add(1, std::memory_order_relaxed);
+    }
+    activeTraps.fetch_sub(1, std::memory_order_release);
+  }
+  void OnMiss() { _misses.fetch_add(1, std::memory_order_relaxed); }
+  void OnForeignBreakpoint() { _foreignBreakpoints.fetch_add(1, std::memory_order_relaxed); }
+
+  ULONGLONG GetTraps() { return _traps.load(std::memory_order_relaxed); }
+  ULONGLONG GetMisses() { return _misses.load(std::memory_order_relaxed); }
+  ULONGLONG GetForeignBreakpoints() { return _foreignBreakpoints.load(std::memory_order_relaxed); }
+
+  // Ranks the sites by their traps since the last call; previousHits holds the caller's last seen counters
+  void GetHotSites(std::vector<ULONGLONG>& previousHits, DWORD maxCount, std::vector<HotSite>& result);
+
+  // Writes the hit count of every executed site as "rva,hits" lines (input of Nanoprof and Nanosim)
+  bool WriteProfile(const char* fileName);
+
+  // Site accessors must be called while holding the lock returned by GetSiteLock()
+  std::mutex& GetSiteLock() { return _siteLock; }
+  DWORD GetSiteCount() { return _siteCount; }
+  const Nanomite* GetSite(DWORD siteIndex);
+  ULONGLONG GetSiteHits(DWORD siteIndex) { return _siteCounters.load(std::memory_order_acquire)->Hits[siteIndex].load(std::memory_order_relaxed); }
+
+private:
+  // Immutable once published, only the counters change
+  struct SiteCounters
+  {
+    DWORD Count;
+    std::atomic<ULONGLONG>* Hits;
+  };
+
+  // Traps in flight that entered in an epoch, each on its own cache line
+  struct alignas(64) ActiveTraps
+  {
+    std::atomic<DWORD> Count;
+  };
+
+  void ReplaceCounters(SiteCounters* counters);
+  static void DeleteCounters(SiteCounters* counters);
+
+private:
+  alignas(64) std::atomic<ULONGLONG> _traps;
+  alignas(64) std::atomic<ULONGLONG> _misses;
+  alignas(64) std::atomic<ULONGLONG> _foreignBreakpoints;
+  alignas(64) std::atomic<DWORD> _epoch;
+  ActiveTraps _activeTraps[2];
+
+  alignas(64) std::mutex _siteLock;
+  NanomiteMetadata* _metadata;
+  Nanomite* _sites;
+  DWORD _siteCount;
+  std::atomic<SiteCounters*> _siteCounters;
+};
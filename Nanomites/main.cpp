@@ -2,39 +2,78 @@
 #include <format>
 #include "Tracer\Tracer.h"
 #include "Tracer\SectionInfo.h"
+#include "Tracer\NanomiteMetadata.h"
 #include "ProtectedCode\ProtectedCodeExecutor.h"
+#include "Corpus\CorpusHarness.h"
 
-NanomiteMetadata* LoadMetaDataFromResource(LPCWSTR resourceName, LPCWSTR resourceType);
+BYTE* LoadResourceData(LPCWSTR resourceName, LPCWSTR resourceType);
 
 // --- main program : Builder.exe will be executed as post build event in the Builder project; make sure to rebuild the solution after making changes!
-int main()
+// "Nanomites.exe --corpus [scale]" runs the workload corpus instead of the demo
+int main(int argc, char* argv[])
 {
-  NanomiteMetadata* metadata = LoadMetaDataFromResource(MAKEINTRESOURCE(1234), RT_RCDATA);
+  const bool runCorpus = argc > 1 && strcmp(argv[1], "--corpus") == 0;
 
+  NanomiteMetadata* metadata = reinterpret_cast<NanomiteMetadata*>(LoadResourceData(MAKEINTRESOURCE(1234), RT_RCDATA));
+  NanomiteSectionTable* sectionTable = reinterpret_cast<NanomiteSectionTable*>(LoadResourceData(MAKEINTRESOURCE(1235), RT_RCDATA));
+
+  // Every section protected by the Builder, only .nano for metadata without section table
   const DWORD_PTR imageBase = (DWORD_PTR)GetModuleHandle(nullptr);
-  SectionInfo* nanomitesSection = Tracer::Instance().CreateSectionInfo(".nano", imageBase);
+  std::vector<SectionInfo*> nanomiteSections = Tracer::Instance().CreateSectionInfos(sectionTable, imageBase);
+  if (nanomiteSections.empty())
+  {
+    SectionInfo* nanomitesSection = Tracer::Instance().CreateSectionInfo(".nano", imageBase);
+    if (nanomitesSection != nullptr) nanomiteSections.push_back(nanomitesSection);
+  }
+
+  // Live trap statistics, can be displayed with "Nanostat.exe <pid>"
+  Tracer::Instance().StartPublishingStatistics(1000);
+  // Logs the hottest sites if protected code traps more than 1.000.000 times per second
+  Tracer::Instance().StartStormDetection(StormDetector::DefaultSettings(1000000));
   
-  std::cout << "Unprotected code : Calling protected code..." << std::endl;
+  if (runCorpus)
+  {
+    // Unprotected reference kernels never trap, so tracing for the whole run only affects the protected ones
+    CorpusHarness harness(argc > 2 ? (DWORD)atoi(argv[2]) : 1);
+    Tracer::Instance().StartTracing(imageBase, nanomiteSections, metadata);
+    const bool success = harness.Run(3);
+    Tracer::Instance().StopTracing();
+    std::cout << (success ? "All kernel results match." : "Protected and unprotected results differ!") << std::endl;
+  }
+  else
+  {
+    std::cout << "Unprotected code : Calling protected code..." << std::endl;
+
+    // Tracing the protected sections (protected methods from .nano may be called)
+    Tracer::Instance().StartTracing(imageBase, nanomiteSections, metadata);
+    ProtectedCodeExecutor* executor = new ProtectedCodeExecutor();
+    executor->EnterText();
+    DWORD checksum = executor->GetCrc32();
+    delete executor;
+    Tracer::Instance().StopTracing();
 
-  // Tracing protected section .nano (protected methods from .nano may be called)
-  Tracer::Instance().StartTracing(imageBase, nanomitesSection, metadata);
-  ProtectedCodeExecutor* executor = new ProtectedCodeExecutor();
-  executor->EnterText();
-  DWORD checksum = executor->GetCrc32();
-  delete executor;
-  Tracer::Instance().StopTracing();
+    std::cout << "Unprotected code : The calculated CRC32 is " << std::format("0x{:08X}", checksum) << std::endl;
+    std::cout << "Unprotected code : End of Demo." << std::endl;
+  }
 
-  std::cout << "Unprotected code : The calculated CRC32 is " << std::format("0x{:08X}", checksum) << std::endl;
-  std::cout << "Unprotected code : End of Demo." << std::endl;
+  for (SectionInfo* nanomitesSection : nanomiteSections) delete nanomitesSection;
+  delete[] reinterpret_cast<BYTE*>(sectionTable);
+  Tracer::Instance().StopPublishingStatistics();
+  Tracer::Instance().StopStormDetection();
 
-  delete nanomitesSection;
+  // Site hit counts for Nanoprof, e.g. "set NANOMITES_PROFILE=Nanomites.profile"
+  char profileFile[MAX_PATH];
+  if (GetEnvironmentVariableA("NANOMITES_PROFILE", profileFile, MAX_PATH) > 0)
+  {
+    Tracer::Instance().GetStatistics().WriteProfile(profileFile);
+  }
 
   std::cout << "Press ENTER to exit..." << std::endl;
   std::cin.ignore();
   std::cin.get();
 }
 
-NanomiteMetadata* LoadMetaDataFromResource(LPCWSTR resourceName, LPCWSTR resourceType)
+BYTE* LoadResourceData(LPCWSTR resourceName, LPCWSTR resourceType)
 {
   DWORD resourceSize = 0;
 
@@ -53,5 +92,5 @@ NanomiteMetadata* LoadMetaDataFromResource(LPCWSTR resourceName, LPCWSTR resourc
 
   BYTE* buffer = new BYTE[resourceSize];
   memcpy(buffer, resourceData, resourceSize);
-  return reinterpret_cast<NanomiteMetadata*>(buffer);
+  return buffer;
 }
\ No newline at end of file
@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <map>
+#include "OverheadAttribution.h"
+#include "..\Profile\ProfileFile.h"
+#include "..\..\Nanosim\Symbols\MapFile.h"
+
+OverheadAttribution::OverheadAttribution(const std::vector<Nanomite>& nanomites, const MapFile* symbols)
+{
+  _traps = 0;
+
+  for (const auto& nanomite : nanomites)
+  {
+    const MapSymbol* symbol = symbols != nullptr ? symbols->FindSymbol(nanomite.Rva) : nullptr;
+    _sites.push_back({ nanomite.Rva, nanomite.JumpType, 0, 0, symbol != nullptr ? symbol->Name.c_str() : nullptr });
+  }
+  std::sort(_sites.begin(), _sites.end(), [](const SiteEntry& s1, const SiteEntry& s2) -> bool
+  {
+    return s1.Rva < s2.Rva;
+  });
+
+  _siteIndices.reserve(_sites.size());
+  for (DWORD i = 0; i < _sites.size(); i++)
+  {
+    _siteIndices[_sites[i].Rva] = i;
+  }
+
+  ComputeLoopDepths(nanomites);
+}
+
+OverheadAttribution::~OverheadAttribution()
+{
+}
+
+ULONGLONG OverheadAttribution::AddProfile(const ProfileFile& profile)
+{
+  ULONGLONG unknown = 0;
+  profile.ForEach([&](DWORD rva, ULONGLONG count)
+  {
+    auto it = _siteIndices.find(rva);
+    if (it == _siteIndices.end())
+    {
+      unknown++;
+      return;
+    }
+    _sites[it->second].Traps += count;
+    _traps += count;
+  });
+  return unknown;
+}
+
+void OverheadAttribution::GetSites(std::vector<SiteEntry>& outSites) const
+{
+  outSites = _sites;
+  std::sort(outSites.begin(), outSites.end(), [](const SiteEntry& s1, const SiteEntry& s2) -> bool
+  {
+    return s1.Traps > s2.Traps;
+  });
+}
+
+void OverheadAttribution::GetFunctions(std::vector<FunctionEntry>& outFunctions) const
+{
+  std::map<std::string, FunctionEntry> functions;
+  for (const auto& site : _sites)
+  {
+    const std::string name = site.Function != nullptr ? site.Function : "<unknown>";
+    FunctionEntry& function = functions[name];
+    function.Name = name;
+    function.Sites++;
+    function.Traps += site.Traps;
+    if (site.LoopDepth > function.MaxLoopDepth) function.MaxLoopDepth = site.LoopDepth;
+  }
+
+  outFunctions.clear();
+  for (const auto& function : functions) outFunctions.push_back(function.second);
+  std::sort(outFunctions.begin(), outFunctions.end(), [](const FunctionEntry& f1, const FunctionEntry& f2) -> bool
+  {
+    return f1.Traps > f2.Traps;
+  });
+}
+
+void OverheadAttribution::SelectExclusions(double share, DWORD maxCount, std::vector<SiteEntry>& outSites) const
+{
+  std::vector<SiteEntry> sites;
+  GetSites(sites);
+
+  outSites.clear();
+  ULONGLONG covered = 0;
+  for (const auto& site : sites)
+  {
+    if (site.Traps == 0 || outSites.size() >= maxCount) break;
+    if (_traps > 0 && (double)covered / _traps >= share) break;
+    outSites.push_back(site);
+    covered += site.Traps;
+  }
+}
+
+void OverheadAttribution::ComputeLoopDepths(const std::vector<Nanomite>& nanomites)
+{
+  // Every backward jump closes a loop [target, jump]; the depth of a site is the number of loops containing it.
+  // Decoy nanomites always jump forward and never form loops.
+  std::vector<std::pair<DWORD, int>> boundaries;
+  for (const auto& nanomite : nanomites)
+  {
+    const DWORD target = nanomite.Rva + nanomite.OpcodeLength + (int)nanomite.JumpLength;
+    if (target > nanomite.Rva) continue;
+    boundaries.push_back({ target, 1 });
+    boundaries.push_back({ nanomite.Rva + 1, -1 });
+  }
+  std::sort(boundaries.begin(), boundaries.end());
+
+  int depth = 0;
+  size_t position = 0;
+  for (auto& site : _sites)
+  {
+    while (position < boundaries.size() && boundaries[position].first <= site.Rva)
+    {
+      depth += boundaries[position].second;
+      position++;
+    }
+    site.LoopDepth = (DWORD)depth;
+  }
+}
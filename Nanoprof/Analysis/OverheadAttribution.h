@@ -0,0 +1,53 @@
+#pragma once
+#include <Windows.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "..\..\Nanomites\Tracer\Nanomite.h"
+
+class MapFile;
+class ProfileFile;
+
+struct SiteEntry
+{
+  DWORD Rva;
+  DWORD JumpType;
+  DWORD LoopDepth;
+  ULONGLONG Traps;
+  const char* Function; // nullptr without symbols
+};
+
+struct FunctionEntry
+{
+  std::string Name;
+  DWORD Sites;
+  DWORD MaxLoopDepth;
+  ULONGLONG Traps;
+};
+
+// Joins a runtime profile with the nanomite metadata and the symbols of the protected executable
+class OverheadAttribution
+{
+public:
+  OverheadAttribution(const std::vector<Nanomite>& nanomites, const MapFile* symbols);
+  ~OverheadAttribution();
+
+  // Returns the number of profile records that do not belong to a nanomite site
+  ULONGLONG AddProfile(const ProfileFile& profile);
+
+  ULONGLONG GetTraps() const { return _traps; }
+  // Entries ordered by trap count, highest first
+  void GetSites(std::vector<SiteEntry>& outSites) const;
+  void GetFunctions(std::vector<FunctionEntry>& outFunctions) const;
+
+  // Selects the hottest sites until they cover the given share of all traps, at most maxCount sites
+  void SelectExclusions(double share, DWORD maxCount, std::vector<SiteEntry>& outSites) const;
+
+private:
+  void ComputeLoopDepths(const std::vector<Nanomite>& nanomites);
+
+private:
+  std::vector<SiteEntry> _sites;                  // Sorted by RVA
+  std::unordered_map<DWORD, DWORD> _siteIndices;  // RVA -> index into _sites
+  ULONGLONG _traps;
+};
@@ -0,0 +1,134 @@
+#include <string>
+#include "ProfileFile.h"
+
+ProfileFile::ProfileFile()
+{
+  _file = INVALID_HANDLE_VALUE;
+  _mapping = nullptr;
+  _view = nullptr;
+  _size = 0;
+  _isBinary = false;
+}
+
+ProfileFile::~ProfileFile()
+{
+  Close();
+}
+
+bool ProfileFile::Open(const char* fileName)
+{
+  Close();
+
+  const std::string name = fileName;
+  _isBinary = name.size() > 4 && name.compare(name.size() - 4, 4, ".bin") == 0;
+
+  _file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (_file == INVALID_HANDLE_VALUE) return false;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(_file, &size)) return false;
+  _size = (ULONGLONG)size.QuadPart;
+  if (_size == 0) return true; // Empty files can not be mapped
+
+  _mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (_mapping == nullptr) return false;
+
+  _view = (const char*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+  return _view != nullptr;
+}
+
+void ProfileFile::Close()
+{
+  if (_view != nullptr)
+  {
+    UnmapViewOfFile(_view);
+    _view = nullptr;
+  }
+  if (_mapping != nullptr)
+  {
+    CloseHandle(_mapping);
+    _mapping = nullptr;
+  }
+  if (_file != INVALID_HANDLE_VALUE)
+  {
+    CloseHandle(_file);
+    _file = INVALID_HANDLE_VALUE;
+  }
+  _size = 0;
+}
+
+void ProfileFile::ForEach(const std::function<void(DWORD rva, ULONGLONG count)>& handler) const
+{
+  if (_view == nullptr) return;
+
+  if (_isBinary)
+  {
+    ForEachBinary(handler);
+  }
+  else
+  {
+    ForEachText(handler);
+  }
+}
+
+void ProfileFile::ForEachText(const std::function<void(DWORD rva, ULONGLONG count)>& handler) const
+{
+  const char* position = _view;
+  const char* end = _view + _size;
+  while (position < end)
+  {
+    while (position < end && (*position == ' ' || *position == '\t' || *position == '\r' || *position == '\n')) position++;
+    if (position == end) break;
+
+    if (*position != '#')
+    {
+      const ULONGLONG rva = ParseNumber(position, end);
+      ULONGLONG count = 1;
+      while (position < end && (*position == ' ' || *position == '\t')) position++;
+      if (position < end && *position == ',')
+      {
+        position++;
+        while (position < end && (*position == ' ' || *position == '\t')) position++;
+        count = ParseNumber(position, end);
+      }
+      handler((DWORD)rva, count);
+    }
+
+    // Skip the rest of the line
+    while (position < end && *position != '\n') position++;
+  }
+}
+
+void ProfileFile::ForEachBinary(const std::function<void(DWORD rva, ULONGLONG count)>& handler) const
+{
+  const DWORD* rvas = (const DWORD*)_view;
+  const ULONGLONG count = _size / sizeof(DWORD);
+  for (ULONGLONG i = 0; i < count; i++)
+  {
+    handler(rvas[i], 1);
+  }
+}
+
+ULONGLONG ProfileFile::ParseNumber(const char*& position, const char* end)
+{
+  ULONGLONG result = 0;
+  if (end - position > 2 && position[0] == '0' && (position[1] == 'x' || position[1] == 'X'))
+  {
+    position += 2;
+    for (; position < end; position++)
+    {
+      const char c = *position;
+      if (c >= '0' && c <= '9') result = (result << 4) | (c - '0');
+      else if (c >= 'a' && c <= 'f') result = (result << 4) | (c - 'a' + 10);
+      else if (c >= 'A' && c <= 'F') result = (result << 4) | (c - 'A' + 10);
+      else break;
+    }
+    return result;
+  }
+
+  for (; position < end && *position >= '0' && *position <= '9'; position++)
+  {
+    result = result * 10 + (*position - '0');
+  }
+  return result;
+}
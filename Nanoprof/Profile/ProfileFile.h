@@ -0,0 +1,32 @@
+#pragma once
+#include <Windows.h>
+#include <functional>
+
+// Memory mapped runtime profile:
+// - text profile as written by TracerStatistics::WriteProfile: one "rva[,count]" per line, '#' starts a comment
+// - binary branch log (*.bin): one DWORD RVA per executed branch
+class ProfileFile
+{
+public:
+  ProfileFile();
+  ~ProfileFile();
+
+  bool Open(const char* fileName);
+  void Close();
+
+  // Calls the handler once per record without copying the file
+  void ForEach(const std::function<void(DWORD rva, ULONGLONG count)>& handler) const;
+  ULONGLONG GetSize() const { return _size; }
+
+private:
+  void ForEachText(const std::function<void(DWORD rva, ULONGLONG count)>& handler) const;
+  void ForEachBinary(const std::function<void(DWORD rva, ULONGLONG count)>& handler) const;
+  static ULONGLONG ParseNumber(const char*& position, const char* end);
+
+private:
+  HANDLE _file;
+  HANDLE _mapping;
+  const char* _view;
+  ULONGLONG _size;
+  bool _isBinary;
+};
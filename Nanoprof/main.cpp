@@ -0,0 +1,188 @@
+#include <stdlib.h>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include "Profile\ProfileFile.h"
+#include "Analysis\OverheadAttribution.h"
+#include "..\Nanosim\Metadata\MetadataLoader.h"
+#include "..\Nanosim\Symbols\MapFile.h"
+
+void PrintUsage();
+bool ReadNumber(int argc, char* argv[], int& i, int base, ULONGLONG& outValue);
+bool ReadDouble(int argc, char* argv[], int& i, double& outValue);
+void PrintFunctions(const OverheadAttribution& attribution, double cyclesPerTrap, DWORD top);
+void PrintSites(const OverheadAttribution& attribution, double cyclesPerTrap, DWORD top);
+bool WriteExclusions(const char* fileName, const std::vector<SiteEntry>& sites);
+const char* ToJumpName(DWORD jumpType);
+
+// --- main program --- Attributes the trap overhead of a profiled run to functions and nanomite sites
+// Usage: Nanoprof.exe <protected exe> <profile> [options]
+int main(int argc, char* argv[])
+{
+  if (argc < 3)
+  {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  // Calibrate with "Benchmark.exe trap" (ns_per_trap_added times the clock rate)
+  double cyclesPerTrap = 6000.0;
+  DWORD top = 20;
+  double excludeShare = 0.8;
+  DWORD excludeTop = 100;
+  const char* mapFile = nullptr;
+  const char* exclusionFile = nullptr;
+  for (int i = 3; i < argc; i++)
+  {
+    const std::string option = argv[i];
+    const bool hasValue = i + 1 < argc;
+    ULONGLONG value = 0;
+    double number = 0.0;
+    if (option == "--map" && hasValue) mapFile = argv[++i];
+    else if (option == "--cycles" && ReadDouble(argc, argv, i, number)) cyclesPerTrap = number;
+    else if (option == "--top" && ReadNumber(argc, argv, i, 10, value) && value <= MAXDWORD) top = (DWORD)value;
+    else if (option == "--exclude-out" && hasValue) exclusionFile = argv[++i];
+    else if (option == "--exclude-share" && ReadDouble(argc, argv, i, number) && number <= 100.0) excludeShare = number / 100.0;
+    else if (option == "--exclude-top" && ReadNumber(argc, argv, i, 10, value) && value <= MAXDWORD) excludeTop = (DWORD)value;
+    else
+    {
+      std::cout << "Invalid option " << option << "." << std::endl;
+      PrintUsage();
+      return EXIT_FAILURE;
+    }
+  }
+
+  std::vector<Nanomite> nanomites;
+  MetadataLoader loader;
+  if (!loader.Load(argv[1], nanomites))
+  {
+    std::cout << "Reading nanomite metadata from " << argv[1] << " failed!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  MapFile symbols;
+  if (mapFile != nullptr && !symbols.Load(mapFile))
+  {
+    std::cout << "Reading map file " << mapFile << " failed!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  ProfileFile profile;
+  if (!profile.Open(argv[2]))
+  {
+    std::cout << "Opening profile " << argv[2] << " failed!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  OverheadAttribution attribution(nanomites, mapFile != nullptr ? &symbols : nullptr);
+  const ULONGLONG unknown = attribution.AddProfile(profile);
+
+  std::cout << "Sites: " << nanomites.size() << ", traps: " << attribution.GetTraps() << ", estimated cycles: " << std::fixed << std::setprecision(0) << attribution.GetTraps() * cyclesPerTrap;
+  std::cout << ", records without site: " << unknown << std::endl << std::endl;
+  PrintFunctions(attribution, cyclesPerTrap, top);
+  PrintSites(attribution, cyclesPerTrap, top);
+
+  if (exclusionFile != nullptr)
+  {
+    std::vector<SiteEntry> exclusions;
+    attribution.SelectExclusions(excludeShare, excludeTop, exclusions);
+    if (!WriteExclusions(exclusionFile, exclusions))
+    {
+      std::cout << "Writing " << exclusionFile << " failed!" << std::endl;
+      return EXIT_FAILURE;
+    }
+    std::cout << "Wrote " << exclusions.size() << " sites to " << exclusionFile << "." << std::endl;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+void PrintUsage()
+{
+  std::cout << "Usage: Nanoprof.exe <protected exe> <profile> [options]" << std::endl;
+  std::cout << "  <profile>            : \"rva,hits\" profile (NANOMITES_PROFILE) or *.bin branch log" << std::endl;
+  std::cout << "  --map file           : linker map file for the per-function breakdown" << std::endl;
+  std::cout << "  --cycles n           : cycles per trap (default 6000)" << std::endl;
+  std::cout << "  --top n              : number of functions and sites to list (default 20)" << std::endl;
+  std::cout << "  --exclude-out file   : write the hottest sites as exclusion list for the Builder (<exe>.exclude)" << std::endl;
+  std::cout << "  --exclude-share pct  : share of all traps the exclusion list should cover (default 80)" << std::endl;
+  std::cout << "  --exclude-top n      : maximum number of excluded sites (default 100)" << std::endl;
+}
+
+bool ReadNumber(int argc, char* argv[], int& i, int base, ULONGLONG& outValue)
+{
+  // Consumes the value of the option at argv[i] if it is a number; strtoull alone would accept a sign and blanks
+  if (i + 1 >= argc) return false;
+  const char* text = argv[i + 1];
+  if (!isxdigit((unsigned char)text[0])) return false;
+  char* end = nullptr;
+  outValue = strtoull(text, &end, base);
+  if (end == text || *end != '\0') return false;
+  i++;
+  return true;
+}
+
+bool ReadDouble(int argc, char* argv[], int& i, double& outValue)
+{
+  // Consumes the value of the option at argv[i] if it is a finite, non-negative number
+  if (i + 1 >= argc) return false;
+  const char* text = argv[i + 1];
+  char* end = nullptr;
+  outValue = strtod(text, &end);
+  if (end == text || *end != '\0' || !std::isfinite(outValue) || outValue < 0.0) return false;
+  i++;
+  return true;
+}
+
+void PrintFunctions(const OverheadAttribution& attribution, double cyclesPerTrap, DWORD top)
+{
+  std::vector<FunctionEntry> functions;
+  attribution.GetFunctions(functions);
+
+  std::cout << std::left << std::setw(48) << "function" << std::right << std::setw(8) << "sites" << std::setw(16) << "traps" << std::setw(18) << "est. cycles" << std::setw(7) << "loop" << std::setw(9) << "share" << std::endl;
+  for (DWORD i = 0; i < functions.size() && i < top && functions[i].Traps > 0; i++)
+  {
+    const FunctionEntry& function = functions[i];
+    std::cout << std::left << std::setw(48) << function.Name.substr(0, 47) << std::right << std::setw(8) << function.Sites << std::setw(16) << function.Traps;
+    std::cout << std::setw(18) << std::setprecision(0) << function.Traps * cyclesPerTrap << std::setw(7) << function.MaxLoopDepth << std::setw(8) << std::setprecision(1) << 100.0 * function.Traps / attribution.GetTraps() << "%" << std::endl;
+  }
+  std::cout << std::endl;
+}
+
+void PrintSites(const OverheadAttribution& attribution, double cyclesPerTrap, DWORD top)
+{
+  std::vector<SiteEntry> sites;
+  attribution.GetSites(sites);
+
+  std::cout << std::setw(12) << "rva" << std::setw(6) << "jump" << std::setw(16) << "traps" << std::setw(18) << "est. cycles" << std::setw(7) << "loop" << "  function" << std::endl;
+  for (DWORD i = 0; i < sites.size() && i < top && sites[i].Traps > 0; i++)
+  {
+    const SiteEntry& site = sites[i];
+    std::cout << "  0x" << std::hex << std::uppercase << std::setw(8) << std::setfill('0') << site.Rva << std::dec << std::setfill(' ') << std::setw(6) << ToJumpName(site.JumpType);
+    std::cout << std::setw(16) << site.Traps << std::setw(18) << std::setprecision(0) << site.Traps * cyclesPerTrap << std::setw(7) << site.LoopDepth << "  " << (site.Function != nullptr ? site.Function : "") << std::endl;
+  }
+  std::cout << std::endl;
+}
+
+bool WriteExclusions(const char* fileName, const std::vector<SiteEntry>& sites)
+{
+  std::ofstream file(fileName);
+  if (!file.is_open()) return false;
+
+  file << "# Nanomite sites the Builder should leave untouched (RVA relative to ImageBase)" << std::endl;
+  for (const auto& site : sites)
+  {
+    file << "0x" << std::hex << std::uppercase << std::setw(8) << std::setfill('0') << site.Rva << std::dec << std::setfill(' ');
+    file << " # " << site.Traps << " traps" << (site.Function != nullptr ? std::string(", ") + site.Function : "") << std::endl;
+  }
+  return file.good();
+}
+
+const char* ToJumpName(DWORD jumpType)
+{
+  static const char* names[] = { "?", "JO", "JNO", "JB", "JNB", "JE", "JNE", "JBE", "JA", "JS", "JNS", "JP", "JNP", "JL", "JGE", "JLE", "JG", "JCXZ", "JMP" };
+  if (jumpType > JumpType::JMP) return names[0];
+  return names[jumpType];
+}
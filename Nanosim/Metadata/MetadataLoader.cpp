@@ -0,0 +1,39 @@
+#include "MetadataLoader.h"
+
+MetadataLoader::MetadataLoader()
+{
+}
+
+MetadataLoader::~MetadataLoader()
+{
+}
+
+bool MetadataLoader::Load(const char* exeFile, std::vector<Nanomite>& outNanomites)
+{
+  HMODULE moduleHandle = LoadLibraryExA(exeFile, nullptr, LOAD_LIBRARY_AS_DATAFILE | LOAD_LIBRARY_AS_IMAGE_RESOURCE);
+  if (moduleHandle == nullptr) return false;
+
+  bool result = false;
+  HRSRC resourceHandle = FindResourceW(moduleHandle, MAKEINTRESOURCE(1234), RT_RCDATA);
+  if (resourceHandle != nullptr)
+  {
+    const DWORD resourceSize = SizeofResource(moduleHandle, resourceHandle);
+    HGLOBAL resourceDataHandle = LoadResource(moduleHandle, resourceHandle);
+    const BYTE* resourceData = resourceDataHandle != nullptr ? (const BYTE*)LockResource(resourceDataHandle) : nullptr;
+    if (resourceData != nullptr && resourceSize >= sizeof(DWORD))
+    {
+      // The header contains a pointer, its size depends on the platform of the Builder; the entries are at the end
+      const DWORD itemCount = *(const DWORD*)resourceData;
+      const DWORD itemsSize = itemCount * sizeof(Nanomite);
+      if (itemsSize <= resourceSize - sizeof(DWORD))
+      {
+        const Nanomite* nanomites = (const Nanomite*)(resourceData + resourceSize - itemsSize);
+        outNanomites.assign(nanomites, nanomites + itemCount);
+        result = true;
+      }
+    }
+  }
+
+  FreeLibrary(moduleHandle);
+  return result;
+}
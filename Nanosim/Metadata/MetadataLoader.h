@@ -0,0 +1,14 @@
+#pragma once
+#include <Windows.h>
+#include <vector>
+#include "..\..\Nanomites\Tracer\Nanomite.h"
+
+// Reads the nanomite metadata resource written by the Builder from an executable without running it
+class MetadataLoader
+{
+public:
+  MetadataLoader();
+  ~MetadataLoader();
+
+  bool Load(const char* exeFile, std::vector<Nanomite>& outNanomites);
+};
@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <map>
+#include "OverheadSimulator.h"
+#include "..\Symbols\MapFile.h"
+
+OverheadSimulator::OverheadSimulator(const std::vector<Nanomite>& nanomites, double nsPerTrap)
+{
+  _nsPerTrap = nsPerTrap;
+  _lastSite = -1;
+  _events = 0;
+  _traps = 0;
+  _excludedTraps = 0;
+
+  for (const auto& nanomite : nanomites)
+  {
+    _sites.push_back({ nanomite.Rva, nanomite.JumpType, 0, false });
+  }
+  std::sort(_sites.begin(), _sites.end(), [](const SiteCost& s1, const SiteCost& s2) -> bool
+  {
+    return s1.Rva < s2.Rva;
+  });
+}
+
+OverheadSimulator::~OverheadSimulator()
+{
+}
+
+bool OverheadSimulator::Exclude(DWORD rva)
+{
+  const int index = FindSite(rva);
+  if (index < 0) return false;
+  _sites[index].Excluded = true;
+  return true;
+}
+
+void OverheadSimulator::AddEvents(DWORD rva, ULONGLONG count)
+{
+  _events += count;
+
+  const int index = FindSite(rva);
+  if (index < 0) return;
+
+  _sites[index].Traps += count;
+  if (_sites[index].Excluded)
+  {
+    _excludedTraps += count;
+  }
+  else
+  {
+    _traps += count;
+  }
+}
+
+void OverheadSimulator::GetSiteCosts(std::vector<SiteCost>& outCosts) const
+{
+  outCosts = _sites;
+  std::sort(outCosts.begin(), outCosts.end(), [](const SiteCost& s1, const SiteCost& s2) -> bool
+  {
+    return s1.Traps > s2.Traps;
+  });
+}
+
+void OverheadSimulator::GetFunctionCosts(const MapFile* symbols, std::vector<FunctionCost>& outCosts) const
+{
+  std::map<std::string, FunctionCost> functions;
+  for (const auto& site : _sites)
+  {
+    if (site.Excluded) continue;
+
+    const MapSymbol* symbol = symbols != nullptr ? symbols->FindSymbol(site.Rva) : nullptr;
+    const std::string name = symbol != nullptr ? symbol->Name : "<unknown>";
+    FunctionCost& function = functions[name];
+    function.Name = name;
+    function.Sites++;
+    function.Traps += site.Traps;
+  }
+
+  outCosts.clear();
+  for (const auto& function : functions) outCosts.push_back(function.second);
+  std::sort(outCosts.begin(), outCosts.end(), [](const FunctionCost& f1, const FunctionCost& f2) -> bool
+  {
+    return f1.Traps > f2.Traps;
+  });
+}
+
+int OverheadSimulator::FindSite(DWORD rva)
+{
+  // Branch traces are highly repetitive, check the previous site first
+  if (_lastSite >= 0 && _sites[_lastSite].Rva == rva) return _lastSite;
+
+  auto it = std::lower_bound(_sites.begin(), _sites.end(), rva, [](const SiteCost& site, DWORD value) -> bool
+  {
+    return site.Rva < value;
+  });
+  if (it == _sites.end() || it->Rva != rva) return -1;
+
+  _lastSite = (int)(it - _sites.begin());
+  return _lastSite;
+}
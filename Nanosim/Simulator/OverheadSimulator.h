@@ -0,0 +1,56 @@
+#pragma once
+#include <Windows.h>
+#include <string>
+#include <vector>
+#include "..\..\Nanomites\Tracer\Nanomite.h"
+
+class MapFile;
+
+struct SiteCost
+{
+  DWORD Rva;
+  DWORD JumpType;
+  ULONGLONG Traps;
+  bool Excluded;
+};
+
+struct FunctionCost
+{
+  std::string Name;
+  DWORD Sites;
+  ULONGLONG Traps;
+};
+
+// Predicts the runtime cost of protecting a module: every trace event at a nanomite site costs one trap.
+// Memory is bounded by the number of sites, independent of the trace length.
+class OverheadSimulator
+{
+public:
+  OverheadSimulator(const std::vector<Nanomite>& nanomites, double nsPerTrap);
+  ~OverheadSimulator();
+
+  bool Exclude(DWORD rva);
+  void AddEvents(DWORD rva, ULONGLONG count);
+
+  ULONGLONG GetEvents() const { return _events; }
+  ULONGLONG GetTraps() const { return _traps; }
+  ULONGLONG GetExcludedTraps() const { return _excludedTraps; }
+  DWORD GetSiteCount() const { return (DWORD)_sites.size(); }
+  double GetNsPerTrap() const { return _nsPerTrap; }
+
+  // Sites ordered by trap count, highest first
+  void GetSiteCosts(std::vector<SiteCost>& outCosts) const;
+  // Functions ordered by trap count, highest first; without symbols all sites fall into "<unknown>"
+  void GetFunctionCosts(const MapFile* symbols, std::vector<FunctionCost>& outCosts) const;
+
+private:
+  int FindSite(DWORD rva);
+
+private:
+  std::vector<SiteCost> _sites; // Sorted by RVA like the metadata
+  double _nsPerTrap;
+  int _lastSite;
+  ULONGLONG _events;
+  ULONGLONG _traps;
+  ULONGLONG _excludedTraps;
+};
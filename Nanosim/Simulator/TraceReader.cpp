@@ -0,0 +1,71 @@
+#include <string>
+#include "TraceReader.h"
+
+TraceReader::TraceReader()
+{
+  _isBinary = false;
+  _imageBase = 0;
+  _chunkPosition = 0;
+  _chunkCount = 0;
+  _bytesRead = 0;
+}
+
+TraceReader::~TraceReader()
+{
+}
+
+bool TraceReader::Open(const char* traceFile, ULONGLONG imageBase)
+{
+  const std::string fileName = traceFile;
+  _isBinary = fileName.size() > 4 && fileName.compare(fileName.size() - 4, 4, ".bin") == 0;
+  _imageBase = imageBase;
+  _file.open(traceFile, _isBinary ? std::ios::binary : std::ios::in);
+  if (_isBinary) _chunk.resize(CHUNK_SIZE);
+  return _file.is_open();
+}
+
+bool TraceReader::Next(DWORD& outRva, ULONGLONG& outCount)
+{
+  return _isBinary ? NextBinary(outRva, outCount) : NextText(outRva, outCount);
+}
+
+bool TraceReader::NextBinary(DWORD& outRva, ULONGLONG& outCount)
+{
+  if (_chunkPosition == _chunkCount)
+  {
+    _file.read((char*)_chunk.data(), CHUNK_SIZE * sizeof(DWORD));
+    _chunkCount = (size_t)_file.gcount() / sizeof(DWORD);
+    _chunkPosition = 0;
+    _bytesRead += _chunkCount * sizeof(DWORD);
+    if (_chunkCount == 0) return false;
+  }
+
+  outRva = _chunk[_chunkPosition++];
+  if (_imageBase != 0 && outRva >= _imageBase) outRva -= (DWORD)_imageBase;
+  outCount = 1;
+  return true;
+}
+
+bool TraceReader::NextText(DWORD& outRva, ULONGLONG& outCount)
+{
+  std::string line;
+  while (std::getline(_file, line))
+  {
+    _bytesRead += line.size() + 1;
+
+    const size_t comment = line.find('#');
+    if (comment != std::string::npos) line.erase(comment);
+    const size_t start = line.find_first_not_of(" \t\r");
+    if (start == std::string::npos) continue;
+
+    size_t parsed = 0;
+    ULONGLONG address = std::stoull(line.substr(start), &parsed, 0);
+    const size_t separator = line.find(',', start + parsed);
+    outCount = separator != std::string::npos ? std::stoull(line.substr(separator + 1), nullptr, 0) : 1;
+
+    if (_imageBase != 0 && address >= _imageBase) address -= _imageBase;
+    outRva = (DWORD)address;
+    return true;
+  }
+  return false;
+}
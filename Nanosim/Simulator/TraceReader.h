@@ -0,0 +1,33 @@
+#pragma once
+#include <Windows.h>
+#include <fstream>
+#include <vector>
+
+// Streams a recorded trace as (rva, count) events with constant memory:
+// - binary branch log (*.bin): one little endian DWORD RVA per executed branch
+// - text profile: one "rva[,count]" per line, decimal or 0x-prefixed hex, '#' starts a comment
+class TraceReader
+{
+public:
+  TraceReader();
+  ~TraceReader();
+
+  bool Open(const char* traceFile, ULONGLONG imageBase);
+  bool Next(DWORD& outRva, ULONGLONG& outCount);
+  ULONGLONG GetBytesRead() const { return _bytesRead; }
+
+private:
+  bool NextBinary(DWORD& outRva, ULONGLONG& outCount);
+  bool NextText(DWORD& outRva, ULONGLONG& outCount);
+
+private:
+  static const DWORD CHUNK_SIZE = 1 << 18; // RVAs per read
+
+  std::ifstream _file;
+  bool _isBinary;
+  ULONGLONG _imageBase; // Subtracted from addresses that are VAs
+  std::vector<DWORD> _chunk;
+  size_t _chunkPosition;
+  size_t _chunkCount;
+  ULONGLONG _bytesRead;
+};
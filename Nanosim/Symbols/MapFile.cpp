@@ -0,0 +1,85 @@
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include "MapFile.h"
+
+MapFile::MapFile()
+{
+}
+
+MapFile::~MapFile()
+{
+}
+
+bool MapFile::Load(const char* mapFile)
+{
+  std::ifstream file(mapFile);
+  if (!file.is_open()) return false;
+
+  // " Preferred load address is 0000000140000000" precedes the tables "Publics by Value" and "Static symbols":
+  // " 0001:00000040       ?Run@@YAXXZ                0000000140001040 f   main.obj"
+  ULONGLONG preferredLoadAddress = 0;
+  bool inSymbolTable = false;
+  std::string line;
+  while (std::getline(file, line))
+  {
+    if (line.find("Preferred load address is") != std::string::npos)
+    {
+      preferredLoadAddress = std::stoull(line.substr(line.find_last_of(' ') + 1), nullptr, 16);
+    }
+    else if (line.find("Publics by Value") != std::string::npos || line.find("Static symbols") != std::string::npos)
+    {
+      inSymbolTable = true;
+    }
+    else if (line.find("entry point at") != std::string::npos)
+    {
+      inSymbolTable = false;
+    }
+    else if (inSymbolTable)
+    {
+      MapSymbol symbol;
+      if (ParseSymbolLine(line, preferredLoadAddress, symbol)) _symbols.push_back(symbol);
+    }
+  }
+
+  std::sort(_symbols.begin(), _symbols.end(), [](const MapSymbol& s1, const MapSymbol& s2) -> bool
+  {
+    return s1.Rva < s2.Rva;
+  });
+  return !_symbols.empty();
+}
+
+const MapSymbol* MapFile::FindSymbol(DWORD rva) const
+{
+  auto it = std::upper_bound(_symbols.begin(), _symbols.end(), rva, [](DWORD value, const MapSymbol& symbol) -> bool
+  {
+    return value < symbol.Rva;
+  });
+  if (it == _symbols.begin()) return nullptr;
+  return &*(it - 1);
+}
+
+const MapSymbol* MapFile::FindSymbol(const std::string& name) const
+{
+  for (const auto& symbol : _symbols)
+  {
+    if (symbol.Name == name) return &symbol;
+  }
+  return nullptr;
+}
+
+bool MapFile::ParseSymbolLine(const std::string& line, ULONGLONG preferredLoadAddress, MapSymbol& outSymbol) const
+{
+  std::istringstream stream(line);
+  std::string address, name, virtualAddress, flag;
+  if (!(stream >> address >> name >> virtualAddress)) return false;
+  if (address.size() != 13 || address[4] != ':') return false;
+
+  const ULONGLONG value = std::stoull(virtualAddress, nullptr, 16);
+  if (value < preferredLoadAddress) return false; // Absolute symbols
+
+  outSymbol.Rva = (DWORD)(value - preferredLoadAddress);
+  outSymbol.Name = name;
+  outSymbol.IsFunction = (stream >> flag) && flag == "f";
+  return true;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <Windows.h>
+#include <string>
+#include <vector>
+
+struct MapSymbol
+{
+  DWORD Rva;
+  std::string Name;
+  bool IsFunction;
+};
+
+// Symbols of an MSVC linker map file (/MAP), sorted by RVA
+class MapFile
+{
+public:
+  MapFile();
+  ~MapFile();
+
+  bool Load(const char* mapFile);
+
+  // Returns the symbol containing the given RVA or nullptr if it lies before the first symbol
+  const MapSymbol* FindSymbol(DWORD rva) const;
+  const MapSymbol* FindSymbol(const std::string& name) const;
+  const std::vector<MapSymbol>& GetSymbols() const { return _symbols; }
+
+private:
+  bool ParseSymbolLine(const std::string& line, ULONGLONG preferredLoadAddress, MapSymbol& outSymbol) const;
+
+private:
+  std::vector<MapSymbol> _symbols;
+};
@@ -0,0 +1,262 @@
+#include <stdlib.h>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include "Metadata\MetadataLoader.h"
+#include "Simulator\OverheadSimulator.h"
+#include "Simulator\TraceReader.h"
+#include "Symbols\MapFile.h"
+
+void PrintUsage();
+bool ReadNumber(int argc, char* argv[], int& i, int base, ULONGLONG& outValue);
+bool ReadDouble(int argc, char* argv[], int& i, double& outValue);
+bool ReadExclusions(const char* exclusionFile, const MapFile* symbols, OverheadSimulator& simulator);
+void PrintSummary(const OverheadSimulator& simulator, double baselineMs);
+void PrintFunctions(const OverheadSimulator& simulator, const MapFile* symbols, DWORD top);
+void PrintSites(const OverheadSimulator& simulator, const MapFile* symbols, DWORD top);
+void PrintExclusionCurve(const OverheadSimulator& simulator);
+const char* ToJumpName(DWORD jumpType);
+
+// --- main program --- Estimates the overhead of protecting a module from a recorded branch trace, without running the protected code
+// Usage: Nanosim.exe <protected exe> <trace> [options]
+int main(int argc, char* argv[])
+{
+  if (argc < 3)
+  {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  // Calibrate with "Benchmark.exe trap" (ns_per_trap_added) on the target machine
+  double nsPerTrap = 2000.0;
+  double baselineMs = 0.0;
+  ULONGLONG imageBase = 0;
+  DWORD top = 10;
+  const char* mapFile = nullptr;
+  const char* exclusionFile = nullptr;
+  for (int i = 3; i < argc; i++)
+  {
+    const std::string option = argv[i];
+    const bool hasValue = i + 1 < argc;
+    ULONGLONG value = 0;
+    double number = 0.0;
+    if (option == "--cost" && ReadDouble(argc, argv, i, number)) nsPerTrap = number;
+    else if (option == "--baseline" && ReadDouble(argc, argv, i, number)) baselineMs = number;
+    else if (option == "--base" && ReadNumber(argc, argv, i, 16, value)) imageBase = value;
+    else if (option == "--top" && ReadNumber(argc, argv, i, 10, value) && value <= MAXDWORD) top = (DWORD)value;
+    else if (option == "--map" && hasValue) mapFile = argv[++i];
+    else if (option == "--exclude" && hasValue) exclusionFile = argv[++i];
+    else
+    {
+      std::cout << "Invalid option " << option << "." << std::endl;
+      PrintUsage();
+      return EXIT_FAILURE;
+    }
+  }
+
+  std::vector<Nanomite> nanomites;
+  MetadataLoader loader;
+  if (!loader.Load(argv[1], nanomites))
+  {
+    std::cout << "Reading nanomite metadata from " << argv[1] << " failed!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  MapFile symbols;
+  if (mapFile != nullptr && !symbols.Load(mapFile))
+  {
+    std::cout << "Reading map file " << mapFile << " failed!" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const MapFile* symbolsOrNull = mapFile != nullptr ? &symbols : nullptr;
+
+  OverheadSimulator simulator(nanomites, nsPerTrap);
+  if (exclusionFile != nullptr && !ReadExclusions(exclusionFile, symbolsOrNull, simulator))
+  {
+    std::cout << "Reading exclusions from " << exclusionFile << " failed!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  TraceReader trace;
+  if (!trace.Open(argv[2], imageBase))
+  {
+    std::cout << "Opening trace " << argv[2] << " failed!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const ULONGLONG start = GetTickCount64();
+  DWORD rva = 0;
+  ULONGLONG count = 0;
+  while (trace.Next(rva, count))
+  {
+    simulator.AddEvents(rva, count);
+  }
+  const ULONGLONG elapsedMs = GetTickCount64() - start;
+
+  std::cout << "Processed " << trace.GetBytesRead() / (1024 * 1024) << " MiB of trace in " << elapsedMs << " ms." << std::endl << std::endl;
+  PrintSummary(simulator, baselineMs);
+  PrintFunctions(simulator, symbolsOrNull, top);
+  PrintSites(simulator, symbolsOrNull, top);
+  PrintExclusionCurve(simulator);
+
+  return EXIT_SUCCESS;
+}
+
+void PrintUsage()
+{
+  std::cout << "Usage: Nanosim.exe <protected exe> <trace> [options]" << std::endl;
+  std::cout << "  <trace>          : *.bin branch log (DWORD RVAs) or text profile with \"rva[,count]\" lines" << std::endl;
+  std::cout << "  --cost ns        : added latency per trap (default 2000, see \"Benchmark.exe trap\")" << std::endl;
+  std::cout << "  --baseline ms    : run time of the traced run without protection, enables the slowdown estimate" << std::endl;
+  std::cout << "  --base hex       : image base to subtract if the trace contains virtual addresses" << std::endl;
+  std::cout << "  --map file       : linker map file for the per-function breakdown" << std::endl;
+  std::cout << "  --exclude file   : RVAs or function names (one per line) to simulate without nanomites" << std::endl;
+  std::cout << "  --top n          : number of functions and sites to list (default 10)" << std::endl;
+}
+
+bool ReadNumber(int argc, char* argv[], int& i, int base, ULONGLONG& outValue)
+{
+  // Consumes the value of the option at argv[i] if it is a number; strtoull alone would accept a sign and blanks
+  if (i + 1 >= argc) return false;
+  const char* text = argv[i + 1];
+  if (!isxdigit((unsigned char)text[0])) return false;
+  char* end = nullptr;
+  outValue = strtoull(text, &end, base);
+  if (end == text || *end != '\0') return false;
+  i++;
+  return true;
+}
+
+bool ReadDouble(int argc, char* argv[], int& i, double& outValue)
+{
+  // Consumes the value of the option at argv[i] if it is a finite, non-negative number
+  if (i + 1 >= argc) return false;
+  const char* text = argv[i + 1];
+  char* end = nullptr;
+  outValue = strtod(text, &end);
+  if (end == text || *end != '\0' || !std::isfinite(outValue) || outValue < 0.0) return false;
+  i++;
+  return true;
+}
+
+bool ReadExclusions(const char* exclusionFile, const MapFile* symbols, OverheadSimulator& simulator)
+{
+  std::ifstream file(exclusionFile);
+  if (!file.is_open()) return false;
+
+  std::vector<SiteCost> sites;
+  simulator.GetSiteCosts(sites);
+
+  std::string line;
+  while (std::getline(file, line))
+  {
+    if (line.empty() || line[0] == '#') continue;
+    if (line.back() == '\r') line.pop_back();
+
+    if (line.rfind("0x", 0) == 0)
+    {
+      simulator.Exclude((DWORD)std::stoul(line, nullptr, 16));
+      continue;
+    }
+
+    // Function name : exclude every site of the function
+    const MapSymbol* function = symbols != nullptr ? symbols->FindSymbol(line) : nullptr;
+    if (function == nullptr)
+    {
+      std::cout << "Unknown function " << line << " ignored." << std::endl;
+      continue;
+    }
+    for (const auto& site : sites)
+    {
+      if (symbols->FindSymbol(site.Rva) == function) simulator.Exclude(site.Rva);
+    }
+  }
+  return true;
+}
+
+void PrintSummary(const OverheadSimulator& simulator, double baselineMs)
+{
+  const double addedMs = simulator.GetTraps() * simulator.GetNsPerTrap() / 1e6;
+  std::cout << "Nanomite sites       : " << simulator.GetSiteCount() << std::endl;
+  std::cout << "Trace events         : " << simulator.GetEvents() << std::endl;
+  std::cout << "Predicted traps      : " << simulator.GetTraps() << std::endl;
+  std::cout << "Added latency        : " << std::fixed << std::setprecision(2) << addedMs << " ms (" << simulator.GetNsPerTrap() << " ns per trap)" << std::endl;
+  if (baselineMs > 0.0)
+  {
+    std::cout << "Predicted slowdown   : " << (baselineMs + addedMs) / baselineMs << "x" << std::endl;
+  }
+  if (simulator.GetExcludedTraps() > 0)
+  {
+    std::cout << "Saved by exclusions  : " << simulator.GetExcludedTraps() * simulator.GetNsPerTrap() / 1e6 << " ms (" << simulator.GetExcludedTraps() << " traps)" << std::endl;
+  }
+  std::cout << std::endl;
+}
+
+void PrintFunctions(const OverheadSimulator& simulator, const MapFile* symbols, DWORD top)
+{
+  std::vector<FunctionCost> functions;
+  simulator.GetFunctionCosts(symbols, functions);
+
+  std::cout << std::left << std::setw(48) << "function" << std::right << std::setw(8) << "sites" << std::setw(16) << "traps" << std::setw(14) << "added ms" << std::setw(10) << "share" << std::endl;
+  for (DWORD i = 0; i < functions.size() && i < top && functions[i].Traps > 0; i++)
+  {
+    const FunctionCost& function = functions[i];
+    std::cout << std::left << std::setw(48) << function.Name.substr(0, 47) << std::right << std::setw(8) << function.Sites << std::setw(16) << function.Traps;
+    std::cout << std::setw(14) << function.Traps * simulator.GetNsPerTrap() / 1e6 << std::setw(9) << 100.0 * function.Traps / simulator.GetTraps() << "%" << std::endl;
+  }
+  std::cout << std::endl;
+}
+
+void PrintSites(const OverheadSimulator& simulator, const MapFile* symbols, DWORD top)
+{
+  std::vector<SiteCost> sites;
+  simulator.GetSiteCosts(sites);
+
+  std::cout << std::setw(12) << "rva" << std::setw(6) << "jump" << std::setw(16) << "traps" << std::setw(14) << "added ms" << "  function" << std::endl;
+  for (DWORD i = 0; i < sites.size() && i < top && sites[i].Traps > 0; i++)
+  {
+    const SiteCost& site = sites[i];
+    const MapSymbol* symbol = symbols != nullptr ? symbols->FindSymbol(site.Rva) : nullptr;
+    std::cout << "  0x" << std::hex << std::uppercase << std::setw(8) << std::setfill('0') << site.Rva << std::dec << std::setfill(' ') << std::setw(6) << ToJumpName(site.JumpType);
+    std::cout << std::setw(16) << site.Traps << std::setw(14) << site.Traps * simulator.GetNsPerTrap() / 1e6 << "  " << (site.Excluded ? "(excluded) " : "") << (symbol != nullptr ? symbol->Name : "") << std::endl;
+  }
+  std::cout << std::endl;
+}
+
+void PrintExclusionCurve(const OverheadSimulator& simulator)
+{
+  // Effect of additionally excluding the hottest protected sites
+  std::vector<SiteCost> sites;
+  simulator.GetSiteCosts(sites);
+
+  const DWORD steps[] = { 1, 5, 10, 50, 100, 500 };
+  std::cout << std::setw(16) << "excluded sites" << std::setw(16) << "remaining ms" << std::setw(10) << "saved" << std::endl;
+  ULONGLONG removed = 0;
+  DWORD excluded = 0;
+  size_t position = 0;
+  for (DWORD step : steps)
+  {
+    while (excluded < step && position < sites.size())
+    {
+      if (!sites[position].Excluded)
+      {
+        removed += sites[position].Traps;
+        excluded++;
+      }
+      position++;
+    }
+    const ULONGLONG remaining = simulator.GetTraps() - removed;
+    std::cout << std::setw(16) << excluded << std::setw(16) << remaining * simulator.GetNsPerTrap() / 1e6;
+    std::cout << std::setw(9) << (simulator.GetTraps() > 0 ? 100.0 * removed / simulator.GetTraps() : 0.0) << "%" << std::endl;
+    if (position == sites.size()) break;
+  }
+}
+
+const char* ToJumpName(DWORD jumpType)
+{
+  static const char* names[] = { "?", "JO", "JNO", "JB", "JNB", "JE", "JNE", "JBE", "JA", "JS", "JNS", "JP", "JNP", "JL", "JGE", "JLE", "JG", "JCXZ", "JMP" };
+  if (jumpType > JumpType::JMP) return names[0];
+  return names[jumpType];
+}
@@ -0,0 +1,65 @@
+#include <string>
+#include <atomic>
+#include "StatisticsReader.h"
+
+StatisticsReader::StatisticsReader()
+{
+  _mapping = nullptr;
+  _shared = nullptr;
+}
+
+StatisticsReader::~StatisticsReader()
+{
+  Close();
+}
+
+bool StatisticsReader::Open(DWORD processId)
+{
+  Close();
+  const std::string mappingName = NANOMITES_STATISTICS_MAPPING_PREFIX + std::to_string(processId);
+  _mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, mappingName.c_str());
+  if (_mapping == nullptr) return false;
+
+  _shared = reinterpret_cast<const SharedStatistics*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, sizeof(SharedStatistics)));
+  if (_shared == nullptr || _shared->Magic != NANOMITES_STATISTICS_MAGIC || _shared->Version != NANOMITES_STATISTICS_VERSION)
+  {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void StatisticsReader::Close()
+{
+  if (_shared != nullptr)
+  {
+    UnmapViewOfFile(_shared);
+    _shared = nullptr;
+  }
+  if (_mapping != nullptr)
+  {
+    CloseHandle(_mapping);
+    _mapping = nullptr;
+  }
+}
+
+bool StatisticsReader::Read(SharedStatistics& snapshot)
+{
+  if (_shared == nullptr) return false;
+
+  // Seqlock read: retry while the publisher is writing or has written in between
+  for (int attempt = 0; attempt < 1000; attempt++)
+  {
+    LONG before = _shared->Sequence;
+    if (before & 1)
+    {
+      YieldProcessor();
+      continue;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    memcpy(&snapshot, (const void*)_shared, sizeof(SharedStatistics));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (_shared->Sequence == before) return true;
+  }
+  return false;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <Windows.h>
+#include "..\..\Nanomites\Tracer\SharedStatistics.h"
+
+// Read-only view of the statistics segment published by a traced process
+class StatisticsReader
+{
+public:
+  StatisticsReader();
+  ~StatisticsReader();
+
+  bool Open(DWORD processId);
+  void Close();
+
+  bool Read(SharedStatistics& snapshot);
+
+private:
+  HANDLE _mapping;
+  const SharedStatistics* _shared;
+};
@@ -0,0 +1,120 @@
+#include <stdlib.h>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include "StatisticsReader\StatisticsReader.h"
+#include "..\Nanomites\Tracer\Nanomite.h"
+
+void PrintUsage();
+bool ReadNumber(const char* text, DWORD& outValue);
+void PrintHeader();
+void PrintLine(const SharedStatistics& statistics);
+void PrintHotSites(const SharedStatistics& statistics);
+const char* ToJumpName(DWORD jumpType);
+
+// --- main program --- Displays the live statistics of a traced process, similar to vmstat
+// Usage: Nanostat.exe <pid> [interval_ms] [count] [-t]
+int main(int argc, char* argv[])
+{
+  DWORD processId = 0;
+  if (argc < 2 || !ReadNumber(argv[1], processId))
+  {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  DWORD intervalMs = 1000;
+  DWORD count = 0; // 0 : until the process stops publishing
+  bool showHotSites = false;
+  int position = 0;
+  for (int i = 2; i < argc; i++)
+  {
+    std::string argument = argv[i];
+    if (argument == "-t")
+    {
+      showHotSites = true;
+    }
+    else if (position >= 2 || !ReadNumber(argv[i], position == 0 ? intervalMs : count))
+    {
+      std::cout << "Invalid argument " << argument << "." << std::endl;
+      PrintUsage();
+      return EXIT_FAILURE;
+    }
+    else
+    {
+      position++;
+    }
+  }
+
+  StatisticsReader reader;
+  if (!reader.Open(processId))
+  {
+    std::cout << "No nanomite statistics found for process " << processId << "." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  for (DWORD i = 0; count == 0 || i < count; i++)
+  {
+    SharedStatistics statistics;
+    if (!reader.Read(statistics))
+    {
+      std::cout << "Reading statistics failed!" << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (i % 20 == 0 || showHotSites) PrintHeader();
+    PrintLine(statistics);
+    if (showHotSites) PrintHotSites(statistics);
+    Sleep(intervalMs);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+void PrintUsage()
+{
+  std::cout << "Usage: Nanostat.exe <pid> [interval_ms] [count] [-t]" << std::endl;
+  std::cout << "  -t : show the hottest nanomite sites of the last interval" << std::endl;
+}
+
+bool ReadNumber(const char* text, DWORD& outValue)
+{
+  // Only plain decimal numbers, strtoull would also accept a sign and leading blanks
+  if (*text < '0' || *text > '9') return false;
+  char* end = nullptr;
+  const ULONGLONG value = strtoull(text, &end, 10);
+  if (*end != '\0' || value > MAXDWORD) return false;
+  outValue = (DWORD)value;
+  return true;
+}
+
+void PrintHeader()
+{
+  std::cout << std::setw(14) << "traps" << std::setw(12) << "traps/s" << std::setw(10) << "misses" << std::setw(10) << "foreign" << std::setw(8) << "sites" << std::setw(14) << "top-rva" << std::setw(12) << "top/s" << std::endl;
+}
+
+void PrintLine(const SharedStatistics& statistics)
+{
+  std::cout << std::setw(14) << statistics.Traps << std::setw(12) << statistics.TrapsPerSecond << std::setw(10) << statistics.Misses << std::setw(10) << statistics.ForeignBreakpoints << std::setw(8) << statistics.SiteCount;
+  if (statistics.HotSiteCount > 0)
+  {
+    std::cout << "    0x" << std::hex << std::uppercase << std::setw(8) << std::setfill('0') << statistics.HotSites[0].Rva << std::dec << std::setfill(' ') << std::setw(12) << statistics.HotSites[0].HitsPerSecond;
+  }
+  std::cout << std::endl;
+}
+
+void PrintHotSites(const SharedStatistics& statistics)
+{
+  for (DWORD i = 0; i < statistics.HotSiteCount; i++)
+  {
+    const SharedHotSite& site = statistics.HotSites[i];
+    std::cout << "    #" << std::setw(2) << std::left << i + 1 << std::right << " 0x" << std::hex << std::uppercase << std::setw(8) << std::setfill('0') << site.Rva << std::dec << std::setfill(' ');
+    std::cout << std::setw(6) << ToJumpName(site.JumpType) << std::setw(14) << site.HitsPerSecond << "/s" << std::setw(16) << site.Hits << " total" << std::endl;
+  }
+}
+
+const char* ToJumpName(DWORD jumpType)
+{
+  static const char* names[] = { "?", "JO", "JNO", "JB", "JNB", "JE", "JNE", "JBE", "JA", "JS", "JNS", "JP", "JNP", "JL", "JGE", "JLE", "JG", "JCXZ", "JMP" };
+  if (jumpType > JumpType::JMP) return names[0];
+  return names[jumpType];
+}
@@ -0,0 +1,254 @@
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <vector>
+#include "AnalysisCacheTests.h"
+#include "../Common/TestReporter.h"
+
+AnalysisCacheTests::AnalysisCacheTests()
+{
+  _directory = (std::filesystem::temp_directory_path() / "nanomites-cache-test").string();
+}
+
+AnalysisCacheTests::~AnalysisCacheTests()
+{
+  Clear();
+}
+
+void AnalysisCacheTests::Run(TestReporter& reporter)
+{
+  if (reporter.Begin("cache/key")) TestKey(reporter);
+  if (reporter.Begin("cache/round-trip")) TestRoundTrip(reporter);
+  if (reporter.Begin("cache/concurrent-builds")) TestConcurrentBuilds(reporter);
+  if (reporter.Begin("cache/damaged-shard")) TestDamagedShard(reporter);
+  if (reporter.Begin("cache/full-shard")) TestFullShard(reporter);
+}
+
+void AnalysisCacheTests::TestKey(TestReporter& reporter)
+{
+  // mov rax, imm64 with a DIR64 relocation at offset 2; ret
+  std::vector<BYTE> code = { 0x48, 0xB8, 0x00, 0x10, 0x00, 0x40, 0x01, 0x00, 0x00, 0x00, 0xC3 };
+  std::vector<BYTE> buffer;
+  const FunctionKey key = AnalysisCache::GetKey(code.data(), (DWORD)code.size(), { 2 }, 8, true, 1, buffer);
+  CHECK(reporter, buffer.size() == code.size() && buffer[2] == 0 && buffer[9] == 0 && buffer[10] == 0xC3);
+
+  // Rebased: only the relocated bytes differ
+  std::vector<BYTE> rebased = code;
+  rebased[5] = 0x50;
+  CHECK(reporter, AnalysisCache::GetKey(rebased.data(), (DWORD)rebased.size(), { 2 }, 8, true, 1, buffer) == key);
+
+  std::vector<BYTE> changed = code;
+  changed[10] = 0xCC;
+  CHECK(reporter, !(AnalysisCache::GetKey(changed.data(), (DWORD)changed.size(), { 2 }, 8, true, 1, buffer) == key));
+  CHECK(reporter, !(AnalysisCache::GetKey(code.data(), (DWORD)code.size() - 1, { 2 }, 8, true, 1, buffer) == key));
+  CHECK(reporter, !(AnalysisCache::GetKey(code.data(), (DWORD)code.size(), { 2 }, 8, false, 1, buffer) == key));
+  CHECK(reporter, !(AnalysisCache::GetKey(code.data(), (DWORD)code.size(), { 2 }, 8, true, 2, buffer) == key));
+  // Same normalized bytes, but without the relocation
+  std::vector<BYTE> zeroed = code;
+  memset(zeroed.data() + 2, 0, 8);
+  CHECK(reporter, !(AnalysisCache::GetKey(zeroed.data(), (DWORD)zeroed.size(), {}, 8, true, 1, buffer) == key));
+}
+
+void AnalysisCacheTests::TestRoundTrip(TestReporter& reporter)
+{
+  // Four threads insert into every shard at the same time
+  Clear();
+  const ULONGLONG entryCount = 1024;
+  {
+    AnalysisCache cache;
+    CHECK(reporter, cache.Open(_directory.c_str()));
+    std::vector<std::thread> threads;
+    for (ULONGLONG t = 0; t < 4; t++)
+    {
+      threads.emplace_back([&cache, t, entryCount]()
+      {
+        FunctionAnalysis analysis;
+        for (ULONGLONG id = t; id < entryCount; id += 4)
+        {
+          cache.Find(MakeKey((DWORD)(id & 0xFF), id), analysis);
+          cache.Insert(MakeKey((DWORD)(id & 0xFF), id), MakeAnalysis(id));
+        }
+      });
+    }
+    for (auto& thread : threads) thread.join();
+    CHECK(reporter, cache.GetMissCount() == entryCount && cache.GetAddedCount() == entryCount && cache.GetHitCount() == 0);
+    CHECK(reporter, cache.Save());
+  }
+
+  std::error_code error;
+  DWORD shardCount = 0;
+  for (const auto& file : std::filesystem::directory_iterator(_directory, error))
+  {
+    if (file.path().extension() == ".nmc") shardCount++;
+    else CHECK(reporter, false);
+  }
+  CHECK(reporter, shardCount == 256);
+
+  AnalysisCache cache;
+  CHECK(reporter, cache.Open(_directory.c_str()));
+  FunctionAnalysis analysis;
+  DWORD equalCount = 0;
+  for (ULONGLONG id = 0; id < entryCount; id++)
+  {
+    if (cache.Find(MakeKey((DWORD)(id & 0xFF), id), analysis) && IsEqual(analysis, MakeAnalysis(id))) equalCount++;
+  }
+  CHECK(reporter, equalCount == entryCount && cache.GetHitCount() == entryCount);
+  CHECK(reporter, !cache.Find(MakeKey(0, entryCount), analysis) && cache.GetMissCount() == 1);
+  // Nothing new, nothing to write
+  CHECK(reporter, cache.Save());
+}
+
+void AnalysisCacheTests::TestConcurrentBuilds(TestReporter& reporter)
+{
+  // Two builds load the same shard before either saves; the second save merges the entry of the first one
+  Clear();
+  FunctionAnalysis analysis;
+  AnalysisCache first, second;
+  CHECK(reporter, first.Open(_directory.c_str()) && second.Open(_directory.c_str()));
+  CHECK(reporter, !first.Find(MakeKey(5, 1), analysis) && !second.Find(MakeKey(5, 2), analysis));
+  first.Insert(MakeKey(5, 1), MakeAnalysis(1));
+  second.Insert(MakeKey(5, 2), MakeAnalysis(2));
+  CHECK(reporter, first.Save() && second.Save());
+
+  AnalysisCache cache;
+  CHECK(reporter, cache.Open(_directory.c_str()));
+  CHECK(reporter, cache.Find(MakeKey(5, 1), analysis) && IsEqual(analysis, MakeAnalysis(1)));
+  CHECK(reporter, cache.Find(MakeKey(5, 2), analysis) && IsEqual(analysis, MakeAnalysis(2)));
+
+  // A newer analysis of the same key wins over the one on disk
+  FunctionAnalysis newer = MakeAnalysis(3);
+  first.Insert(MakeKey(5, 1), newer);
+  CHECK(reporter, first.Save());
+  AnalysisCache reloaded;
+  CHECK(reporter, reloaded.Open(_directory.c_str()));
+  CHECK(reporter, reloaded.Find(MakeKey(5, 1), analysis) && IsEqual(analysis, newer));
+  CHECK(reporter, reloaded.Find(MakeKey(5, 2), analysis));
+
+  // No temporary file stays behind
+  std::error_code error;
+  DWORD fileCount = 0;
+  for (const auto& file : std::filesystem::directory_iterator(_directory, error)) fileCount += file.path().extension() == ".nmc" ? 1 : 100;
+  CHECK(reporter, fileCount == 1);
+}
+
+void AnalysisCacheTests::TestDamagedShard(TestReporter& reporter)
+{
+  Clear();
+  {
+    AnalysisCache cache;
+    CHECK(reporter, cache.Open(_directory.c_str()));
+    cache.Insert(MakeKey(3, 1), MakeAnalysis(1));
+    cache.Insert(MakeKey(3, 2), MakeAnalysis(2));
+    CHECK(reporter, cache.Save());
+  }
+  std::vector<BYTE> shard;
+  {
+    std::ifstream file(GetShardName(3), std::ios::binary);
+    shard.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  }
+  CHECK(reporter, shard.size() > 32);
+  if (shard.size() <= 32) return;
+
+  // Torn, flipped, and a valid hash over a shard of another version: all entries are ignored
+  std::vector<BYTE> otherVersion = shard;
+  otherVersion[4]++;
+  DWORD hash = 0x811C9DC5;
+  for (size_t i = 0; i < otherVersion.size() - 8; i++) hash = (hash ^ otherVersion[i]) * 0x01000193;
+  memcpy(otherVersion.data() + otherVersion.size() - 4, &hash, sizeof(hash));
+  std::vector<BYTE> flipped = shard;
+  flipped[shard.size() / 2] ^= 0x01;
+  const std::vector<std::vector<BYTE>> damagedShards = { std::vector<BYTE>(shard.begin(), shard.end() - 1), flipped, otherVersion };
+  for (const std::vector<BYTE>& damaged : damagedShards)
+  {
+    std::ofstream(GetShardName(3), std::ios::binary | std::ios::trunc).write((const char*)damaged.data(), damaged.size());
+    FunctionAnalysis analysis;
+    AnalysisCache cache;
+    CHECK(reporter, cache.Open(_directory.c_str()));
+    CHECK(reporter, !cache.Find(MakeKey(3, 1), analysis) && !cache.Find(MakeKey(3, 2), analysis));
+  }
+
+  // The next save replaces the damaged shard
+  FunctionAnalysis analysis;
+  {
+    AnalysisCache cache;
+    CHECK(reporter, cache.Open(_directory.c_str()));
+    CHECK(reporter, !cache.Find(MakeKey(3, 1), analysis));
+    cache.Insert(MakeKey(3, 1), MakeAnalysis(1));
+    CHECK(reporter, cache.Save());
+  }
+  AnalysisCache cache;
+  CHECK(reporter, cache.Open(_directory.c_str()));
+  CHECK(reporter, cache.Find(MakeKey(3, 1), analysis) && IsEqual(analysis, MakeAnalysis(1)));
+  CHECK(reporter, !cache.Find(MakeKey(3, 2), analysis));
+}
+
+void AnalysisCacheTests::TestFullShard(TestReporter& reporter)
+{
+  // A shard holds 65536 entries; a build that uses one of them and adds another keeps both and drops an unused one
+  Clear();
+  const ULONGLONG entryCount = 1 << 16;
+  {
+    AnalysisCache cache;
+    CHECK(reporter, cache.Open(_directory.c_str()));
+    for (ULONGLONG id = 0; id < entryCount; id++) cache.Insert(MakeKey(7, id), MakeAnalysis(id));
+    CHECK(reporter, cache.Save());
+  }
+  FunctionAnalysis analysis;
+  {
+    AnalysisCache cache;
+    CHECK(reporter, cache.Open(_directory.c_str()));
+    CHECK(reporter, cache.Find(MakeKey(7, 12345), analysis));
+    cache.Insert(MakeKey(7, entryCount), MakeAnalysis(entryCount));
+    CHECK(reporter, cache.Save());
+  }
+
+  AnalysisCache cache;
+  CHECK(reporter, cache.Open(_directory.c_str()));
+  CHECK(reporter, cache.Find(MakeKey(7, 12345), analysis) && IsEqual(analysis, MakeAnalysis(12345)));
+  CHECK(reporter, cache.Find(MakeKey(7, entryCount), analysis) && IsEqual(analysis, MakeAnalysis(entryCount)));
+  for (ULONGLONG id = 0; id < entryCount; id++)
+  {
+    if (id != 12345) cache.Find(MakeKey(7, id), analysis);
+  }
+  CHECK(reporter, cache.GetHitCount() == entryCount && cache.GetMissCount() == 1);
+}
+
+FunctionKey AnalysisCacheTests::MakeKey(DWORD shard, ULONGLONG id)
+{
+  FunctionKey key;
+  key.Low = id * 0x9E3779B97F4A7C15ULL + 1;
+  key.High = ((ULONGLONG)shard << 56) | id;
+  return key;
+}
+
+FunctionAnalysis AnalysisCacheTests::MakeAnalysis(ULONGLONG id)
+{
+  FunctionAnalysis analysis;
+  analysis.Jumps.push_back({ (DWORD)(id % 1000), 0x74, 1, 2 });
+  analysis.Calls.push_back(-(LONGLONG)id);
+  return analysis;
+}
+
+bool AnalysisCacheTests::IsEqual(const FunctionAnalysis& analysis, const FunctionAnalysis& other)
+{
+  if (analysis.Jumps.size() != other.Jumps.size() || analysis.Calls != other.Calls) return false;
+  for (size_t i = 0; i < analysis.Jumps.size(); i++)
+  {
+    if (memcmp(&analysis.Jumps[i], &other.Jumps[i], sizeof(RelativeJump)) != 0) return false;
+  }
+  return true;
+}
+
+std::string AnalysisCacheTests::GetShardName(DWORD shard) const
+{
+  const char* digits = "0123456789abcdef";
+  return (std::filesystem::path(_directory) / (std::string() + digits[shard >> 4] + digits[shard & 15] + ".nmc")).string();
+}
+
+void AnalysisCacheTests::Clear()
+{
+  std::error_code error;
+  std::filesystem::remove_all(_directory, error);
+}
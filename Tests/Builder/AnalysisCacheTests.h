@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+#include "../../Builder/Disassembler/AnalysisCache.h"
+
+class TestReporter;
+
+// The shard files of AnalysisCache: keys that survive a rebase, entries that survive a save, concurrent builds that
+// merge their shards, damaged shards that are ignored and full shards that keep the entries of the last build.
+class AnalysisCacheTests
+{
+public:
+  AnalysisCacheTests();
+  ~AnalysisCacheTests();
+
+  void Run(TestReporter& reporter);
+
+private:
+  void TestKey(TestReporter& reporter);
+  void TestRoundTrip(TestReporter& reporter);
+  void TestConcurrentBuilds(TestReporter& reporter);
+  void TestDamagedShard(TestReporter& reporter);
+  void TestFullShard(TestReporter& reporter);
+
+  // Key in the given shard, the shard is the top byte of High
+  static FunctionKey MakeKey(DWORD shard, ULONGLONG id);
+  // Analysis with one jump and one call derived from the id
+  static FunctionAnalysis MakeAnalysis(ULONGLONG id);
+  static bool IsEqual(const FunctionAnalysis& analysis, const FunctionAnalysis& other);
+  std::string GetShardName(DWORD shard) const;
+  void Clear();
+
+private:
+  std::string _directory;
+};
@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include "BatchBuilderTests.h"
+#include "PEFixture.h"
+#include "../Common/TestReporter.h"
+#include "../../Builder/PEFile/PEFile.h"
+#include "../../Builder/Pipeline/BatchBuilder.h"
+#include "../../Builder/Pipeline/InputList.h"
+
+BatchBuilderTests::BatchBuilderTests()
+{
+  _directory = (std::filesystem::temp_directory_path() / "nanomites-batch-test").string();
+  std::error_code error;
+  std::filesystem::create_directories(_directory, error);
+}
+
+BatchBuilderTests::~BatchBuilderTests()
+{
+  std::error_code error;
+  std::filesystem::remove_all(_directory, error);
+}
+
+void BatchBuilderTests::Run(TestReporter& reporter)
+{
+  if (reporter.Begin("batch/status")) TestStatus(reporter);
+  if (reporter.Begin("batch/memory-budget")) TestMemoryBudget(reporter);
+  if (reporter.Begin("batch/section-names")) TestSectionNames(reporter);
+}
+
+void BatchBuilderTests::TestStatus(TestReporter& reporter)
+{
+  // Every kind of failure between two good files; one failed file fails the run, but not the other files
+  const std::vector<std::string> fileNames = { GetFileName(0), GetFileName(1), GetFileName(2), GetFileName(3), GetFileName(4) };
+  CHECK(reporter, WriteImage(fileNames[0]));
+  std::ofstream(fileNames[2]) << "not an executable";
+  CHECK(reporter, WriteImage(fileNames[3], ".text2"));
+  CHECK(reporter, WriteImage(fileNames[4]));
+
+  std::vector<std::string> finished;
+  BatchBuilder batchBuilder;
+  batchBuilder.SetThreadCount(3);
+  batchBuilder.SetSeed(1);
+  batchBuilder.SetResultCallback([&](const BatchResult& result) { finished.push_back(result.FileName); });
+  CHECK(reporter, !batchBuilder.Run(fileNames));
+
+  const std::vector<BatchResult>& results = batchBuilder.GetResults();
+  CHECK(reporter, results.size() == fileNames.size());
+  if (results.size() != fileNames.size()) return;
+  for (size_t i = 0; i < results.size(); i++) CHECK(reporter, results[i].FileName == fileNames[i]);
+  CHECK(reporter, results[0].Status == BatchStatus::Succeeded && results[4].Status == BatchStatus::Succeeded);
+  CHECK(reporter, results[1].Status == BatchStatus::ReadFailed);
+  CHECK(reporter, results[2].Status == BatchStatus::ReadFailed);
+  CHECK(reporter, results[3].Status == BatchStatus::ProtectFailed);
+  CHECK(reporter, results[0].SectionCount == 1 && results[0].JumpCount != 0 && results[0].FunctionCount == 4);
+  CHECK(reporter, results[0].JumpCount == results[4].JumpCount);
+  CHECK(reporter, results[3].SectionCount == 0 && results[3].JumpCount == 0);
+
+  // The callback sees every file once
+  std::sort(finished.begin(), finished.end());
+  CHECK(reporter, finished == fileNames);
+
+  // The protected files carry the metadata resources
+  PEFile peFile;
+  CHECK(reporter, peFile.OpenFile(fileNames[0].c_str(), LoadMode::Buffer) && peFile.FindSectionByName(".rsrc") != nullptr);
+  peFile.Close();
+
+  // A run without failures succeeds, the results of the previous run are gone
+  CHECK(reporter, WriteImage(fileNames[0]) && WriteImage(fileNames[4]));
+  CHECK(reporter, batchBuilder.Run({ fileNames[0], fileNames[4] }));
+  CHECK(reporter, batchBuilder.GetResults().size() == 2);
+  CHECK(reporter, batchBuilder.Run({}) && batchBuilder.GetResults().empty());
+}
+
+void BatchBuilderTests::TestMemoryBudget(TestReporter& reporter)
+{
+  std::vector<std::string> fileNames;
+  for (size_t i = 0; i < 8; i++)
+  {
+    fileNames.push_back(GetFileName(i));
+  }
+  std::error_code error;
+  std::vector<std::string> finished;
+  BatchBuilder batchBuilder;
+  batchBuilder.SetThreadCount(4);
+  batchBuilder.SetIoThreadCount(4);
+  batchBuilder.SetSeed(1);
+  batchBuilder.SetResultCallback([&](const BatchResult& result) { finished.push_back(result.FileName); });
+
+  // Each file is larger than the budget, so it is built alone: the files finish in the order of the inputs
+  for (const std::string& fileName : fileNames) CHECK(reporter, WriteImage(fileName));
+  const ULONGLONG fileSize = std::filesystem::file_size(fileNames[0], error);
+  batchBuilder.SetMemoryBudget(1);
+  CHECK(reporter, batchBuilder.Run(fileNames));
+  CHECK(reporter, finished == fileNames);
+  CHECK(reporter, batchBuilder.GetPeakBytesInFlight() == fileSize);
+
+  // Room for two and a half files
+  for (const std::string& fileName : fileNames) CHECK(reporter, WriteImage(fileName));
+  batchBuilder.SetMemoryBudget(fileSize * 5 / 2);
+  CHECK(reporter, batchBuilder.Run(fileNames));
+  CHECK(reporter, batchBuilder.GetPeakBytesInFlight() >= fileSize && batchBuilder.GetPeakBytesInFlight() <= fileSize * 2);
+
+  // A missing file is not charged
+  for (const std::string& fileName : fileNames) CHECK(reporter, WriteImage(fileName));
+  batchBuilder.SetMemoryBudget(1);
+  CHECK(reporter, !batchBuilder.Run({ GetFileName(8), fileNames[0], GetFileName(9) }));
+  CHECK(reporter, batchBuilder.GetPeakBytesInFlight() == fileSize);
+  CHECK(reporter, batchBuilder.GetResults().size() == 3 && batchBuilder.GetResults()[1].Status == BatchStatus::Succeeded);
+}
+
+void BatchBuilderTests::TestSectionNames(TestReporter& reporter)
+{
+  // Section names are compared byte by byte on every platform, file patterns ignore the case on Windows
+  CHECK(reporter, InputList::MatchesExactCase(".nano*", ".nanohot") && InputList::MatchesExactCase(".n?no", ".nano"));
+  CHECK(reporter, !InputList::MatchesExactCase(".NANO", ".nano") && !InputList::MatchesExactCase(".Nano*", ".nanohot"));
+#ifdef _WIN32
+  CHECK(reporter, InputList::Matches("*.EXE", "demo.exe"));
+#else
+  CHECK(reporter, !InputList::Matches("*.EXE", "demo.exe"));
+#endif
+
+  const std::vector<std::string> fileNames = { GetFileName(0), GetFileName(1) };
+  BatchBuilder batchBuilder;
+  batchBuilder.SetThreadCount(2);
+  batchBuilder.SetSeed(1);
+  CHECK(reporter, WriteImage(fileNames[0]) && WriteImage(fileNames[1], ".NANO"));
+  batchBuilder.SetSectionNames({ ".nano" });
+  CHECK(reporter, !batchBuilder.Run(fileNames));
+  CHECK(reporter, batchBuilder.GetResults().size() == 2 && batchBuilder.GetResults()[0].Status == BatchStatus::Succeeded);
+  CHECK(reporter, batchBuilder.GetResults().size() == 2 && batchBuilder.GetResults()[1].Status == BatchStatus::ProtectFailed);
+
+  CHECK(reporter, WriteImage(fileNames[0]) && WriteImage(fileNames[1], ".NANO"));
+  batchBuilder.SetSectionNames({ ".NA*" });
+  CHECK(reporter, !batchBuilder.Run(fileNames));
+  CHECK(reporter, batchBuilder.GetResults().size() == 2 && batchBuilder.GetResults()[0].Status == BatchStatus::ProtectFailed);
+  CHECK(reporter, batchBuilder.GetResults().size() == 2 && batchBuilder.GetResults()[1].Status == BatchStatus::Succeeded);
+}
+
+bool BatchBuilderTests::WriteImage(const std::string& fileName, const char* sectionName)
+{
+  // Four functions of push rbp; test ecx, ecx; jnz +2; xor eax, eax; jmp +1; nop; pop rbp; ret
+  const std::vector<BYTE> function = { 0x55, 0x85, 0xC9, 0x0F, 0x85, 0x02, 0x00, 0x00, 0x00, 0x31, 0xC0, 0xEB, 0x01, 0x90, 0x5D, 0xC3 };
+  std::vector<BYTE> code;
+  std::vector<PEFixture::Function> functions;
+  for (DWORD i = 0; i < 4; i++)
+  {
+    functions.push_back({ (DWORD)code.size(), (DWORD)(code.size() + function.size()) });
+    code.insert(code.end(), function.begin(), function.end());
+  }
+  if (!PEFixture::Write(fileName.c_str(), code, functions)) return false;
+  if (strcmp(sectionName, ".nano") == 0) return true;
+
+  // Renames the section in the section table of the headers
+  std::fstream file(fileName, std::ios::binary | std::ios::in | std::ios::out);
+  std::vector<char> headers(0x400);
+  file.read(headers.data(), headers.size());
+  const char nano[8] = ".nano";
+  const auto position = std::search(headers.begin(), headers.end(), nano, nano + sizeof(nano));
+  if (!file.good() || position == headers.end()) return false;
+
+  char name[8] = {};
+  strncpy(name, sectionName, sizeof(name));
+  file.seekp(position - headers.begin());
+  file.write(name, sizeof(name));
+  return file.good();
+}
+
+std::string BatchBuilderTests::GetFileName(size_t index) const
+{
+  return (std::filesystem::path(_directory) / ("input" + std::to_string(index) + ".exe")).string();
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <vector>
+
+class TestReporter;
+
+// Scheduling of BatchBuilder on small PEFixture images: a status per file in the order of the inputs, and the memory
+// budget that limits the files between read and write.
+class BatchBuilderTests
+{
+public:
+  BatchBuilderTests();
+  ~BatchBuilderTests();
+
+  void Run(TestReporter& reporter);
+
+private:
+  void TestStatus(TestReporter& reporter);
+  void TestMemoryBudget(TestReporter& reporter);
+  void TestSectionNames(TestReporter& reporter);
+
+  // Writes a fixture with a few functions and jumps in .nano; sectionName renames .nano
+  bool WriteImage(const std::string& fileName, const char* sectionName = ".nano");
+  std::string GetFileName(size_t index) const;
+
+private:
+  std::string _directory;
+};
@@ -0,0 +1,194 @@
+#include <filesystem>
+#include <fstream>
+#include "DensityPolicyTests.h"
+#include "../Common/TestReporter.h"
+#include "../../Builder/Nanomites/DensityPolicy.h"
+
+DensityPolicyTests::DensityPolicyTests()
+{
+  _fileName = (std::filesystem::temp_directory_path() / "nanomites-density-test.policy").string();
+}
+
+DensityPolicyTests::~DensityPolicyTests()
+{
+  std::error_code error;
+  std::filesystem::remove(_fileName, error);
+}
+
+void DensityPolicyTests::Run(TestReporter& reporter)
+{
+  if (reporter.Begin("density/fraction")) TestFraction(reporter);
+  if (reporter.Begin("density/limits")) TestLimits(reporter);
+  if (reporter.Begin("density/direction")) TestDirection(reporter);
+  if (reporter.Begin("density/load")) TestLoad(reporter);
+}
+
+void DensityPolicyTests::TestFraction(TestReporter& reporter)
+{
+  // 10000 forward jumps, every other one a candidate
+  const size_t count = 10000;
+  std::vector<RelativeJump> jumps;
+  std::vector<bool> candidates;
+  for (DWORD i = 0; i < count; i++)
+  {
+    jumps.push_back(MakeJump(i * 16, 4));
+    candidates.push_back(i % 2 == 0);
+  }
+
+  DensityPolicy policy;
+  std::vector<bool> selected = candidates;
+  policy.Sample(jumps, {}, 0x1000, 1, selected);
+  CHECK(reporter, selected == candidates);
+
+  // About a quarter of the candidates, never a jump that was no candidate
+  policy.SetFraction(0.25);
+  std::vector<bool> quarter = candidates;
+  policy.Sample(jumps, {}, 0x1000, 1, quarter);
+  const size_t quarterCount = CountSelected(quarter, 0, count);
+  CHECK(reporter, quarterCount > count / 2 * 23 / 100 && quarterCount < count / 2 * 27 / 100);
+  bool isSubset = true;
+  for (size_t i = 0; i < count; i++) isSubset = isSubset && (!quarter[i] || candidates[i]);
+  CHECK(reporter, isSubset);
+
+  // The same seed selects the same jumps, a smaller fraction a subset of them
+  std::vector<bool> repeated = candidates;
+  policy.Sample(jumps, {}, 0x1000, 1, repeated);
+  CHECK(reporter, repeated == quarter);
+  policy.SetFraction(0.1);
+  std::vector<bool> tenth = candidates;
+  policy.Sample(jumps, {}, 0x1000, 1, tenth);
+  isSubset = CountSelected(tenth, 0, count) < quarterCount;
+  for (size_t i = 0; i < count; i++) isSubset = isSubset && (!tenth[i] || quarter[i]);
+  CHECK(reporter, isSubset);
+
+  // Another build seed or section changes the choice, a seed of the policy makes it independent of the build
+  policy.SetFraction(0.25);
+  std::vector<bool> otherSeed = candidates, otherSection = candidates;
+  policy.Sample(jumps, {}, 0x1000, 2, otherSeed);
+  policy.Sample(jumps, {}, 0x2000, 1, otherSection);
+  CHECK(reporter, otherSeed != quarter && otherSection != quarter);
+  policy.SetSeed(1234);
+  std::vector<bool> first = candidates, second = candidates;
+  policy.Sample(jumps, {}, 0x1000, 1, first);
+  policy.Sample(jumps, {}, 0x1000, 2, second);
+  CHECK(reporter, first == second);
+
+  policy.SetFraction(0.0);
+  std::vector<bool> none = candidates;
+  policy.Sample(jumps, {}, 0x1000, 1, none);
+  CHECK(reporter, CountSelected(none, 0, count) == 0);
+}
+
+void DensityPolicyTests::TestLimits(TestReporter& reporter)
+{
+  // Function 0 at 0x000: 6 jumps, the one at 0x30 jumps to 0x48, which starts a second block of 2 jumps
+  // Function 1 at 0x100: 2 jumps
+  // Function 2 at 0x200: 9 jumps
+  // The other jumps target 0x1000 behind every jump, such targets do not split a block
+  std::vector<RelativeJump> jumps;
+  for (DWORD rva : { 0x00, 0x10, 0x20 }) jumps.push_back(MakeJump(rva, 0x1000 - rva - 2));
+  jumps.push_back(MakeJump(0x30, 0x48 - 0x32));
+  for (DWORD rva : { 0x50, 0x60 }) jumps.push_back(MakeJump(rva, 0x1000 - rva - 2));
+  for (DWORD rva : { 0x100, 0x110 }) jumps.push_back(MakeJump(rva, 0x1000 - rva - 2));
+  for (DWORD rva = 0x200; rva <= 0x280; rva += 0x10) jumps.push_back(MakeJump(rva, 0x1000 - rva - 2));
+  const std::vector<DWORD> functionStarts = { 0x000, 0x100, 0x200 };
+  const std::vector<bool> candidates(jumps.size(), true);
+
+  // One per block: [0x00, 0x48), [0x48, 0x100), [0x100, 0x200), [0x200, end)
+  DensityPolicy policy;
+  policy.SetMaxPerBlock(1);
+  std::vector<bool> selected = candidates;
+  policy.Sample(jumps, functionStarts, 0x1000, 1, selected);
+  CHECK(reporter, CountSelected(selected, 0, 4) == 1 && CountSelected(selected, 4, 6) == 1);
+  CHECK(reporter, CountSelected(selected, 6, 8) == 1 && CountSelected(selected, 8, jumps.size()) == 1);
+
+  // Three per function; a function with fewer candidates keeps them all
+  policy.SetMaxPerBlock(0);
+  policy.SetMaxPerFunction(3);
+  selected = candidates;
+  policy.Sample(jumps, functionStarts, 0x1000, 1, selected);
+  CHECK(reporter, CountSelected(selected, 0, 6) == 3 && CountSelected(selected, 6, 8) == 2 && CountSelected(selected, 8, jumps.size()) == 3);
+  // Without function starts the section is one function
+  selected = candidates;
+  policy.Sample(jumps, {}, 0x1000, 1, selected);
+  CHECK(reporter, CountSelected(selected, 0, jumps.size()) == 3);
+
+  // Both limits and a fraction: the limits only remove jumps the fraction kept
+  policy.SetMaxPerBlock(2);
+  policy.SetFraction(0.5);
+  std::vector<bool> sampled = candidates;
+  DensityPolicy fractionOnly;
+  fractionOnly.SetFraction(0.5);
+  fractionOnly.Sample(jumps, functionStarts, 0x1000, 1, sampled);
+  selected = candidates;
+  policy.Sample(jumps, functionStarts, 0x1000, 1, selected);
+  bool isSubset = true;
+  for (size_t i = 0; i < jumps.size(); i++) isSubset = isSubset && (!selected[i] || sampled[i]);
+  CHECK(reporter, isSubset && CountSelected(selected, 0, 6) <= 3 && CountSelected(selected, 0, 4) <= 2 && CountSelected(selected, 8, jumps.size()) <= 2);
+}
+
+void DensityPolicyTests::TestDirection(TestReporter& reporter)
+{
+  const RelativeJump forward = MakeJump(0x100, 0x10);
+  const RelativeJump backward = MakeJump(0x100, -0x20);
+  const RelativeJump self = MakeJump(0x100, -2);          // jmp $, a loop without body
+
+  DensityPolicy policy;
+  CHECK(reporter, policy.Accepts(JE, forward) && policy.Accepts(JMP, backward) && policy.Accepts(JCXZ, self));
+  CHECK(reporter, !policy.Accepts(UNKNOWN, forward));
+  policy.SetDirection(JumpDirection::Forward);
+  CHECK(reporter, policy.Accepts(JE, forward) && !policy.Accepts(JE, backward) && !policy.Accepts(JMP, self));
+  policy.SetDirection(JumpDirection::Backward);
+  CHECK(reporter, !policy.Accepts(JE, forward) && policy.Accepts(JE, backward) && policy.Accepts(JMP, self));
+
+  policy.SetDirection(JumpDirection::Any);
+  policy.SetJumpTypes((1 << JE) | (1 << JNE));
+  CHECK(reporter, policy.Accepts(JE, forward) && policy.Accepts(JNE, backward) && !policy.Accepts(JMP, forward) && !policy.Accepts(JL, forward));
+  CHECK(reporter, !policy.IsDefault());
+}
+
+void DensityPolicyTests::TestLoad(TestReporter& reporter)
+{
+  DensityPolicy policy;
+  CHECK(reporter, WritePolicy("# hot loops only\nfraction = 0.25\nmax-per-function = 4\njump-types = JE, jne\ndirection = backward\n\nseed = 7\n"));
+  CHECK(reporter, policy.Load(_fileName.c_str()));
+  CHECK(reporter, policy.GetDescription() == "25% of the backward je, jne jumps, at most 4 per function, sampling seed 7");
+  CHECK(reporter, policy.Accepts(JE, MakeJump(0x100, -0x20)) && !policy.Accepts(JE, MakeJump(0x100, 0x20)) && !policy.Accepts(JMP, MakeJump(0x100, -0x20)));
+
+  DensityPolicy conditional;
+  CHECK(reporter, WritePolicy("jump-types = jcc\n"));
+  CHECK(reporter, conditional.Load(_fileName.c_str()) && conditional.GetDescription() == "100% of the conditional jumps");
+  CHECK(reporter, conditional.Accepts(JCXZ, MakeJump(0, 4)) && !conditional.Accepts(JMP, MakeJump(0, 4)));
+  DensityPolicy all;
+  CHECK(reporter, all.IsDefault() && all.GetDescription() == "every jump");
+
+  // The line of the first invalid entry
+  for (const char* text : { "fraction = 0.5\nfraction = 2\n", "fraction = 0.5\ndirection = sideways\n", "\njump-types = jz\n", "# x\nmax-per-block\n" })
+  {
+    DensityPolicy invalid;
+    CHECK(reporter, WritePolicy(text) && !invalid.Load(_fileName.c_str()) && invalid.GetErrorLine() == 2);
+  }
+  DensityPolicy missing;
+  std::error_code error;
+  std::filesystem::remove(_fileName, error);
+  CHECK(reporter, !missing.Load(_fileName.c_str()) && missing.GetErrorLine() == 0);
+}
+
+RelativeJump DensityPolicyTests::MakeJump(DWORD rva, LONG displacement)
+{
+  return { rva, 0xEB, 2, (DWORD)displacement };
+}
+
+size_t DensityPolicyTests::CountSelected(const std::vector<bool>& selected, size_t first, size_t last)
+{
+  size_t count = 0;
+  for (size_t i = first; i < last; i++) count += selected[i] ? 1 : 0;
+  return count;
+}
+
+bool DensityPolicyTests::WritePolicy(const std::string& text)
+{
+  std::ofstream file(_fileName, std::ios::trunc);
+  file << text;
+  return file.good();
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "../../Builder/Disassembler/RelativeJump.h"
+
+class TestReporter;
+
+// Site selection of DensityPolicy on synthetic jump lists: the sampled fraction, the limits per block and per
+// function, the type and direction filter and the policy file.
+class DensityPolicyTests
+{
+public:
+  DensityPolicyTests();
+  ~DensityPolicyTests();
+
+  void Run(TestReporter& reporter);
+
+private:
+  void TestFraction(TestReporter& reporter);
+  void TestLimits(TestReporter& reporter);
+  void TestDirection(TestReporter& reporter);
+  void TestLoad(TestReporter& reporter);
+
+  // Short jump at rva to rva + 2 + displacement
+  static RelativeJump MakeJump(DWORD rva, LONG displacement);
+  static size_t CountSelected(const std::vector<bool>& selected, size_t first, size_t last);
+  bool WritePolicy(const std::string& text);
+
+private:
+  std::string _fileName;
+};
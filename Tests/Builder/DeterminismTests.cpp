@@ -0,0 +1,130 @@
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include "DeterminismTests.h"
+#include "PEFixture.h"
+#include "../Common/TestReporter.h"
+#include "../../Builder/Nanomites/RandomGenerator.h"
+#include "../../Builder/Pipeline/BatchBuilder.h"
+#include "../../Builder/Pipeline/BuildPipeline.h"
+
+DeterminismTests::DeterminismTests()
+{
+  _directory = (std::filesystem::temp_directory_path() / "nanomites-determinism-test").string();
+  std::error_code error;
+  std::filesystem::create_directories(_directory, error);
+}
+
+DeterminismTests::~DeterminismTests()
+{
+  std::error_code error;
+  std::filesystem::remove_all(_directory, error);
+}
+
+void DeterminismTests::Run(TestReporter& reporter)
+{
+  if (reporter.Begin("determinism/random-generator")) TestRandomGenerator(reporter);
+  if (reporter.Begin("determinism/thread-count")) TestThreadCount(reporter);
+}
+
+void DeterminismTests::TestRandomGenerator(TestReporter& reporter)
+{
+  // Stream 0 xors the seed with the first SplitMix64 output of 0, so this seed starts from the state that splitmix64.c
+  // seeded with 0 gives; the expected values are the first outputs of xoshiro256starstar.c from that state
+  const ULONGLONG seed = 0xE220A8397B1DCDAFULL;
+  const ULONGLONG expected[] = { 0x99EC5F36CB75F2B4ULL, 0xBF6E1F784956452AULL, 0x1A5F849D4933E6E0ULL,
+    0x6AA594F1262D2D2CULL, 0xBBA5AD4A1F842E59ULL, 0xFFEF8375D9EBCACAULL };
+  RandomGenerator generator(seed);
+  for (ULONGLONG value : expected) CHECK(reporter, generator.Next() == value);
+
+  // The same seed and stream repeat the sequence, another stream does not
+  RandomGenerator same(seed, 0x1234), other(seed, 0x1235);
+  RandomGenerator repeated(seed, 0x1234);
+  bool isRepeated = true, isOther = false;
+  for (int i = 0; i < 16; i++)
+  {
+    const ULONGLONG value = same.Next();
+    isRepeated = isRepeated && repeated.Next() == value;
+    isOther = isOther || other.Next() != value;
+  }
+  CHECK(reporter, isRepeated && isOther);
+
+  // Fill draws once per 8 bytes and cuts the last draw
+  BYTE data[12] = {};
+  RandomGenerator filled(seed);
+  filled.Fill(data, sizeof(data));
+  CHECK(reporter, *(ULONGLONG*)data == expected[0] && *(DWORD*)(data + 8) == (DWORD)expected[1]);
+
+  bool inRange = true;
+  for (int i = 0; i < 1000; i++)
+  {
+    const BYTE value = generator.NextByte(0x10, 0x1F);
+    inRange = inRange && value >= 0x10 && value <= 0x1F;
+  }
+  CHECK(reporter, inRange);
+}
+
+void DeterminismTests::TestThreadCount(TestReporter& reporter)
+{
+  // One file analyzed by 1 and by 4 threads
+  const std::string fileName = (std::filesystem::path(_directory) / "input.exe").string();
+  std::vector<BYTE> input, serial, parallel, otherSeed;
+  CHECK(reporter, WriteImage(fileName) && ReadBytes(fileName, input));
+  CHECK(reporter, Protect(fileName, 1, 1, serial));
+  CHECK(reporter, Protect(fileName, 1, 4, parallel));
+  CHECK(reporter, !serial.empty() && serial != input && serial == parallel);
+  // The seed does matter
+  CHECK(reporter, Protect(fileName, 2, 4, otherSeed));
+  CHECK(reporter, otherSeed.size() == serial.size() && otherSeed != serial);
+
+  // A batch of copies on 1 and on 4 worker threads, every copy equal to the single build
+  std::vector<std::string> fileNames;
+  for (int i = 0; i < 4; i++)
+  {
+    fileNames.push_back((std::filesystem::path(_directory) / ("copy" + std::to_string(i) + ".exe")).string());
+  }
+  for (DWORD threadCount : { 1, 4 })
+  {
+    for (const std::string& copy : fileNames) CHECK(reporter, WriteImage(copy));
+    BatchBuilder batchBuilder;
+    batchBuilder.SetThreadCount(threadCount);
+    batchBuilder.SetSeed(1);
+    CHECK(reporter, batchBuilder.Run(fileNames));
+    for (const std::string& copy : fileNames)
+    {
+      std::vector<BYTE> data;
+      CHECK(reporter, ReadBytes(copy, data) && data == serial);
+    }
+  }
+}
+
+bool DeterminismTests::WriteImage(const std::string& fileName)
+{
+  // 256 KB of push rbp; test ecx, ecx; jnz +2; xor eax, eax; jmp +1; nop; pop rbp; ret, enough for the function
+  // analysis to split the section into blocks for 4 threads
+  const std::vector<BYTE> function = { 0x55, 0x85, 0xC9, 0x0F, 0x85, 0x02, 0x00, 0x00, 0x00, 0x31, 0xC0, 0xEB, 0x01, 0x90, 0x5D, 0xC3 };
+  std::vector<BYTE> code;
+  std::vector<PEFixture::Function> functions;
+  for (DWORD i = 0; i < 16384; i++)
+  {
+    functions.push_back({ (DWORD)code.size(), (DWORD)(code.size() + function.size()) });
+    code.insert(code.end(), function.begin(), function.end());
+  }
+  return PEFixture::Write(fileName.c_str(), code, functions);
+}
+
+bool DeterminismTests::Protect(const std::string& fileName, ULONGLONG seed, DWORD threadCount, std::vector<BYTE>& outData)
+{
+  BuildPipeline pipeline;
+  pipeline.SetSeed(seed);
+  pipeline.SetThreadCount(threadCount);
+  return WriteImage(fileName) && pipeline.Run(fileName.c_str(), ".nano") && ReadBytes(fileName, outData);
+}
+
+bool DeterminismTests::ReadBytes(const std::string& fileName, std::vector<BYTE>& outData)
+{
+  std::ifstream file(fileName, std::ios::binary);
+  if (!file.is_open()) return false;
+  outData.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  return true;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "../../Builder/PEFile/PEFormat.h"
+
+class TestReporter;
+
+// Reproducible builds: the random generator against the reference xoshiro256**, and protected images that only depend
+// on the seed and the input, not on the number of threads.
+class DeterminismTests
+{
+public:
+  DeterminismTests();
+  ~DeterminismTests();
+
+  void Run(TestReporter& reporter);
+
+private:
+  void TestRandomGenerator(TestReporter& reporter);
+  void TestThreadCount(TestReporter& reporter);
+
+  // Writes a fixture with many small functions, each with a conditional and an unconditional jump
+  bool WriteImage(const std::string& fileName);
+  // Protects a fresh fixture and returns the output bytes
+  bool Protect(const std::string& fileName, ULONGLONG seed, DWORD threadCount, std::vector<BYTE>& outData);
+  static bool ReadBytes(const std::string& fileName, std::vector<BYTE>& outData);
+
+private:
+  std::string _directory;
+};
@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <filesystem>
+#include "DisassemblerTests.h"
+#include "../Common/TestReporter.h"
+#include "../../Builder/Disassembler/Disassembler.h"
+#include "../../Builder/PEFile/PEFile.h"
+#include "ReferenceDisassembler.h"
+
+DisassemblerTests::DisassemblerTests()
+{
+  _fileName = (std::filesystem::temp_directory_path() / "nanomites-disassembler-test.exe").string();
+  _cacheDirectory = (std::filesystem::temp_directory_path() / "nanomites-disassembler-test-cache").string();
+}
+
+DisassemblerTests::~DisassemblerTests()
+{
+  std::error_code error;
+  std::filesystem::remove(_fileName, error);
+  std::filesystem::remove_all(_cacheDirectory, error);
+}
+
+void DisassemblerTests::Run(TestReporter& reporter)
+{
+  if (reporter.Begin("disassembler/leaf-function")) TestLeafFunction(reporter);
+  if (reporter.Begin("disassembler/jump-table")) TestJumpTable(reporter);
+  if (reporter.Begin("disassembler/cache-validation")) TestCacheValidation(reporter);
+  if (reporter.Begin("disassembler/linear-sweep")) TestLinearSweep(reporter);
+}
+
+void DisassemblerTests::TestLeafFunction(TestReporter& reporter)
+{
+  // A leaf function has no .pdata entry; this one is neither called from the section nor the entry point
+  std::vector<BYTE> code;
+  Append(code, { 0x55, 0x85, 0xC9, 0x74, 0x02, 0x31, 0xC0, 0x5D, 0xC3 });               // 0x00: push rbp; test ecx, ecx; jz +2; xor eax, eax; pop rbp; ret
+  const DWORD first = (DWORD)code.size();
+  Pad(code, 16);
+  Append(code, { 0x85, 0xC9, 0x75, 0x05, 0xB8, 0x01, 0x00, 0x00, 0x00, 0xC3 });        // 0x10: test ecx, ecx; jnz +5; mov eax, 1; ret
+  Pad(code, 16);
+  Append(code, { 0x31, 0xC0, 0xEB, 0x01, 0x90, 0xC3 });                                // 0x20: xor eax, eax; jmp +1; nop; ret
+  const DWORD last = (DWORD)code.size();
+  Pad(code, 16);
+
+  std::vector<RelativeJump> jumps;
+  std::vector<DWORD> functionStarts;
+  if (!Analyze(code, { { 0x00, first }, { 0x20, last } }, jumps, functionStarts))
+  {
+    CHECK(reporter, false);
+    return;
+  }
+  CHECK(reporter, jumps.size() == 3);
+  CHECK(reporter, HasJumpAt(jumps, 0x03));
+  CHECK(reporter, HasJumpAt(jumps, 0x12));
+  CHECK(reporter, HasJumpAt(jumps, 0x22));
+  CHECK(reporter, std::find(functionStarts.begin(), functionStarts.end(), 0x10) != functionStarts.end());
+}
+
+void DisassemblerTests::TestJumpTable(TestReporter& reporter)
+{
+  // A jump table behind the padding of a function holds RVAs of the section; 0x74 would decode as jz
+  std::vector<BYTE> code;
+  Append(code, { 0x55, 0x85, 0xC9, 0x74, 0x02, 0x31, 0xC0, 0x5D, 0xC3 });               // 0x00: as above
+  const DWORD first = (DWORD)code.size();
+  Pad(code, 16);
+  Append(code, { 0x74, 0x20, 0x00, 0x00, 0x10, 0x20, 0x00, 0x00 });                    // 0x10: dd 0x2074, 0x2010
+  Pad(code, 16);
+  Append(code, { 0x31, 0xC0, 0xEB, 0x01, 0x90, 0xC3 });                                // 0x20: xor eax, eax; jmp +1; nop; ret
+  const DWORD last = (DWORD)code.size();
+  Pad(code, 16);
+
+  std::vector<RelativeJump> jumps;
+  std::vector<DWORD> functionStarts;
+  if (!Analyze(code, { { 0x00, first }, { 0x20, last } }, jumps, functionStarts))
+  {
+    CHECK(reporter, false);
+    return;
+  }
+  CHECK(reporter, jumps.size() == 2);
+  CHECK(reporter, !HasJumpAt(jumps, 0x10));
+  CHECK(reporter, std::find(functionStarts.begin(), functionStarts.end(), 0x10) == functionStarts.end());
+}
+
+void DisassemblerTests::TestCacheValidation(TestReporter& reporter)
+{
+  // Two .pdata functions without relocations; the entry of the second one is replaced by an analysis that claims a
+  // jump on an operand byte, as after a key collision
+  std::vector<BYTE> code;
+  Append(code, { 0x55, 0x85, 0xC9, 0x74, 0x02, 0x31, 0xC0, 0x5D, 0xC3 });               // 0x00: as above
+  const DWORD first = (DWORD)code.size();
+  Pad(code, 16);
+  Append(code, { 0x31, 0xC0, 0xEB, 0x01, 0x90, 0xC3 });                                // 0x10: xor eax, eax; jmp +1; nop; ret
+  const DWORD last = (DWORD)code.size();
+  Pad(code, 16);
+
+  std::error_code error;
+  std::filesystem::remove_all(_cacheDirectory, error);
+  AnalysisCache cache;
+  std::vector<RelativeJump> jumps;
+  std::vector<DWORD> functionStarts;
+  DWORD cachedCount = 0;
+  if (!cache.Open(_cacheDirectory.c_str()) || !Analyze(code, { { 0x00, first }, { 0x10, last } }, jumps, functionStarts, &cache, &cachedCount))
+  {
+    CHECK(reporter, false);
+    return;
+  }
+  CHECK(reporter, cachedCount == 0 && cache.GetAddedCount() == 2);
+
+  std::vector<BYTE> buffer;
+  const FunctionKey key = AnalysisCache::GetKey(code.data() + 0x10, last - 0x10, {}, sizeof(ULONGLONG), true, ZydisGetVersion(), buffer);
+  FunctionAnalysis analysis;
+  CHECK(reporter, cache.Find(key, analysis) && analysis.Jumps.size() == 1 && analysis.Jumps[0].Rva == 0x02);
+  FunctionAnalysis damaged = analysis;
+  damaged.Jumps[0].Rva = 0x03;
+  cache.Insert(key, damaged);
+
+  // The first function is reused, the second one is analyzed again and its entry replaced
+  if (!Analyze(code, { { 0x00, first }, { 0x10, last } }, jumps, functionStarts, &cache, &cachedCount))
+  {
+    CHECK(reporter, false);
+    return;
+  }
+  CHECK(reporter, cachedCount == 1);
+  CHECK(reporter, cache.GetRejectedCount() == 1);
+  CHECK(reporter, jumps.size() == 2 && HasJumpAt(jumps, 0x03) && HasJumpAt(jumps, 0x12) && !HasJumpAt(jumps, 0x13));
+  CHECK(reporter, cache.Find(key, analysis) && analysis.Jumps.size() == 1 && analysis.Jumps[0].Rva == 0x02);
+}
+
+void DisassemblerTests::TestLinearSweep(TestReporter& reporter)
+{
+  // 4 MB, so 4 threads decode 1 MB chunks. The chunk at 1 MB starts on the operand of a jz rel32, which decodes as
+  // jz +2; the chunk at 2 MB starts inside of int3 padding.
+  const DWORD chunkSize = 0x100000;
+  std::vector<BYTE> code;
+  AppendFunctions(code, chunkSize - 2);
+  Append(code, { 0x0F, 0x84, 0x74, 0x02, 0x00, 0x00 });                                // jz +0x274
+  AppendFunctions(code, 2 * chunkSize - 8);
+  Append(code, { 0x31, 0xC0, 0xEB, 0x01, 0x90, 0xC3 });                                // xor eax, eax; jmp +1; nop; ret
+  code.insert(code.end(), 16, 0xCC);
+  Pad(code, 16);
+  AppendFunctions(code, 4 * chunkSize);
+
+  PEFile peFile;
+  const PeSectionHeader* sectionHeader = nullptr;
+  if (!PEFixture::Write(_fileName.c_str(), code, {}) || !peFile.OpenFile(_fileName.c_str(), LoadMode::Buffer) ||
+    (sectionHeader = peFile.FindSectionByName(".nano")) == nullptr)
+  {
+    CHECK(reporter, false);
+    return;
+  }
+
+  std::vector<RelativeJump> expectedJumps;
+  std::set<DWORD> expectedCCs;
+  CHECK(reporter, ReferenceDisassembler::GetRelativeJumps(peFile, sectionHeader, expectedJumps));
+  CHECK(reporter, ReferenceDisassembler::GetCCs(peFile, sectionHeader, expectedCCs));
+  CHECK(reporter, HasJumpAt(expectedJumps, chunkSize - 2) && !HasJumpAt(expectedJumps, chunkSize));
+  CHECK(reporter, expectedCCs.count(2 * chunkSize) == 1);
+
+  Disassembler disassembler;
+  disassembler.SetAnalysisMode(AnalysisMode::LinearSweep);
+  for (DWORD threadCount : { 1, 4 })
+  {
+    disassembler.SetThreadCount(threadCount);
+    std::vector<RelativeJump> jumps;
+    std::vector<DWORD> ccRvas;
+    CHECK(reporter, disassembler.AnalyzeSection(peFile, sectionHeader, jumps, ccRvas));
+    CHECK(reporter, IsEqual(jumps, expectedJumps));
+    CHECK(reporter, ccRvas.size() == expectedCCs.size() && std::equal(ccRvas.begin(), ccRvas.end(), expectedCCs.begin()));
+  }
+}
+
+bool DisassemblerTests::Analyze(const std::vector<BYTE>& code, const std::vector<PEFixture::Function>& functions, std::vector<RelativeJump>& outJumps, std::vector<DWORD>& outFunctionStarts, AnalysisCache* cache, DWORD* outCachedCount)
+{
+  if (!PEFixture::Write(_fileName.c_str(), code, functions)) return false;
+  PEFile peFile;
+  if (!peFile.OpenFile(_fileName.c_str(), LoadMode::Buffer)) return false;
+  const PeSectionHeader* sectionHeader = peFile.FindSectionByName(".nano");
+  if (sectionHeader == nullptr) return false;
+
+  Disassembler disassembler;
+  disassembler.SetAnalysisMode(AnalysisMode::ControlFlow);
+  disassembler.SetThreadCount(1);
+  disassembler.SetAnalysisCache(cache);
+  std::vector<DWORD> ccRvas;
+  outJumps.clear();
+  if (!disassembler.AnalyzeSection(peFile, sectionHeader, outJumps, ccRvas)) return false;
+  outFunctionStarts = disassembler.GetFunctionStarts();
+  if (outCachedCount != nullptr) *outCachedCount = disassembler.GetCachedFunctionCount();
+  return disassembler.GetFunctionCount() == functions.size();
+}
+
+bool DisassemblerTests::HasJumpAt(const std::vector<RelativeJump>& jumps, DWORD rva)
+{
+  return std::any_of(jumps.begin(), jumps.end(), [&](const RelativeJump& jump) -> bool { return jump.Rva == rva; });
+}
+
+bool DisassemblerTests::IsEqual(const std::vector<RelativeJump>& jumps, const std::vector<RelativeJump>& expectedJumps)
+{
+  return std::equal(jumps.begin(), jumps.end(), expectedJumps.begin(), expectedJumps.end(), [](const RelativeJump& jump, const RelativeJump& expected) -> bool
+  {
+    return jump.Rva == expected.Rva && jump.Opcode == expected.Opcode && jump.OpcodeLength == expected.OpcodeLength && jump.JmpLength == expected.JmpLength;
+  });
+}
+
+void DisassemblerTests::AppendFunctions(std::vector<BYTE>& code, size_t end)
+{
+  // push rbp; test ecx, ecx; jnz +2; xor eax, eax; jmp +1; nop; pop rbp; ret
+  const std::initializer_list<BYTE> function = { 0x55, 0x85, 0xC9, 0x0F, 0x85, 0x02, 0x00, 0x00, 0x00, 0x31, 0xC0, 0xEB, 0x01, 0x90, 0x5D, 0xC3 };
+  while (code.size() + 2 * function.size() <= end)
+  {
+    Append(code, function);
+    Pad(code, 16);
+  }
+  code.resize(end, 0x90);
+}
+
+void DisassemblerTests::Pad(std::vector<BYTE>& code, DWORD alignment)
+{
+  // int3 up to the next boundary, at least one byte
+  do
+  {
+    code.push_back(0xCC);
+  } while (code.size() % alignment != 0);
+}
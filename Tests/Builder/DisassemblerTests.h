@@ -0,0 +1,39 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "PEFixture.h"
+#include "../../Builder/Disassembler/RelativeJump.h"
+
+class AnalysisCache;
+class TestReporter;
+
+// Control flow analysis on small hand-assembled sections: coverage of leaf functions between .pdata functions, jump
+// tables that must not be decoded and cached analyses that no longer match the code. The parallel linear sweep is
+// compared with the serial reference passes on a section whose chunk boundaries fall inside of instructions.
+class DisassemblerTests
+{
+public:
+  DisassemblerTests();
+  ~DisassemblerTests();
+
+  void Run(TestReporter& reporter);
+
+private:
+  void TestLeafFunction(TestReporter& reporter);
+  void TestJumpTable(TestReporter& reporter);
+  void TestCacheValidation(TestReporter& reporter);
+  void TestLinearSweep(TestReporter& reporter);
+
+  // Writes the fixture and analyzes .nano in control flow mode, with the cache if given; false if that failed
+  bool Analyze(const std::vector<BYTE>& code, const std::vector<PEFixture::Function>& functions, std::vector<RelativeJump>& outJumps, std::vector<DWORD>& outFunctionStarts, AnalysisCache* cache = nullptr, DWORD* outCachedCount = nullptr);
+  static bool HasJumpAt(const std::vector<RelativeJump>& jumps, DWORD rva);
+  static bool IsEqual(const std::vector<RelativeJump>& jumps, const std::vector<RelativeJump>& expectedJumps);
+  // Functions with a jcc, a jmp and int3 padding up to end, the rest are nops
+  static void AppendFunctions(std::vector<BYTE>& code, size_t end);
+  static void Append(std::vector<BYTE>& code, std::initializer_list<BYTE> bytes) { code.insert(code.end(), bytes); }
+  static void Pad(std::vector<BYTE>& code, DWORD alignment);
+
+private:
+  std::string _fileName;
+  std::string _cacheDirectory;
+};
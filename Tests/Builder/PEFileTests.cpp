@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include "PEFileTests.h"
+#include "PEFixture.h"
+#include "../Common/TestReporter.h"
+#include "../../Builder/PEFile/PEFile.h"
+#include "../../Builder/PEFile/ResourceAdder.h"
+
+PEFileTests::PEFileTests()
+{
+  _fileName = (std::filesystem::temp_directory_path() / "nanomites-pefile-test.exe").string();
+  _damagedFileName = (std::filesystem::temp_directory_path() / "nanomites-pefile-test-damaged.exe").string();
+}
+
+PEFileTests::~PEFileTests()
+{
+  std::error_code error;
+  std::filesystem::remove(_fileName, error);
+  std::filesystem::remove(_damagedFileName, error);
+}
+
+void PEFileTests::Run(TestReporter& reporter)
+{
+  if (reporter.Begin("pefile/validation")) TestValidation(reporter);
+  if (reporter.Begin("pefile/resources")) TestResources(reporter);
+}
+
+void PEFileTests::TestValidation(TestReporter& reporter)
+{
+  // xor eax, eax; ret
+  if (!PEFixture::Write(_fileName.c_str(), { 0x31, 0xC0, 0xC3 }, { { 0x00, 0x03 } }))
+  {
+    CHECK(reporter, false);
+    return;
+  }
+
+  PEFile peFile;
+  CHECK(reporter, peFile.OpenFile(_fileName.c_str(), LoadMode::Buffer));
+  CHECK(reporter, peFile.Is64Bit() && peFile.GetMachine() == PE_MACHINE_AMD64 && peFile.GetSectionCount() == 3);
+  CHECK(reporter, peFile.GetImageBase() == PEFixture::IMAGE_BASE);
+  const PeSectionHeader* nano = peFile.FindSectionByName(".nano");
+  CHECK(reporter, nano != nullptr && peFile.FindSectionByRva(PEFixture::NANO_RVA + 2) == nano);
+  CHECK(reporter, nano != nullptr && peFile.RvaToOffset(PEFixture::NANO_RVA + 2) == nano->PointerToRawData + 2);
+  CHECK(reporter, peFile.GetRvaPointer(PEFixture::NANO_RVA, 3) != nullptr && peFile.GetRvaPointer(PEFixture::NANO_RVA, 3)[2] == 0xC3);
+  // Not backed by the raw data of one section: the headers and the gap behind the raw data of .nano
+  CHECK(reporter, peFile.RvaToOffset(0x10) == 0);
+  CHECK(reporter, nano != nullptr && peFile.GetRvaPointer(PEFixture::NANO_RVA + nano->SizeOfRawData - 1, 2) == nullptr);
+  PEFile mappedFile;
+  CHECK(reporter, mappedFile.OpenFile(_fileName.c_str(), LoadMode::Mapping) && mappedFile.GetSectionCount() == 3);
+  mappedFile.Close();
+
+  CHECK(reporter, !OpenDamaged([](std::vector<BYTE>& image) { image.resize(sizeof(PeDosHeader) - 1); }));
+  CHECK(reporter, !OpenDamaged([](std::vector<BYTE>& image) { ((PeDosHeader*)image.data())->e_magic = 0x4D5A; }));
+  CHECK(reporter, !OpenDamaged([](std::vector<BYTE>& image) { ((PeDosHeader*)image.data())->e_lfanew = 0x7FFFFFF0; }));
+  CHECK(reporter, !OpenDamaged([](std::vector<BYTE>& image) { ((PeDosHeader*)image.data())->e_lfanew = 8; }));
+  CHECK(reporter, !OpenDamaged([](std::vector<BYTE>& image) { *(DWORD*)(image.data() + ((PeDosHeader*)image.data())->e_lfanew) = 0x00004551; }));
+  CHECK(reporter, !OpenDamaged([](std::vector<BYTE>& image) { GetOptionalHeader(image)->Magic = 0x107; }));
+  CHECK(reporter, !OpenDamaged([](std::vector<BYTE>& image) { GetFileHeader(image)->SizeOfOptionalHeader = 0x10; }));
+  CHECK(reporter, !OpenDamaged([](std::vector<BYTE>& image) { GetFileHeader(image)->NumberOfSections = 0xFFFF; }));
+  CHECK(reporter, !OpenDamaged([](std::vector<BYTE>& image) { GetOptionalHeader(image)->FileAlignment = 0x300; }));
+  CHECK(reporter, !OpenDamaged([](std::vector<BYTE>& image) { GetOptionalHeader(image)->SectionAlignment = 0; }));
+  // The raw data of .pdata ends behind the end of the file
+  CHECK(reporter, !OpenDamaged([](std::vector<BYTE>& image) { image.resize(image.size() - 1); }));
+  // Sanity check of the helper: an unchanged copy opens
+  CHECK(reporter, OpenDamaged([](std::vector<BYTE>&) {}));
+}
+
+void PEFileTests::TestResources(TestReporter& reporter)
+{
+  // The fixture gets a trailing .reloc section with one DIR64 relocation, as the linker emits it
+  const DWORD relocationRva = PEFixture::NANO_RVA + 0x10;
+  std::vector<BYTE> code(0x20, 0x90);
+  code.back() = 0xC3;
+  PEFile peFile;
+  const PeSectionHeader* relocationSection = nullptr;
+  if (!PEFixture::Write(_fileName.c_str(), code, {}) || !peFile.OpenFile(_fileName.c_str(), LoadMode::Buffer) ||
+    (relocationSection = peFile.AddSection(".reloc", sizeof(PeBaseRelocation) + 2 * sizeof(WORD), PE_SCN_CNT_INITIALIZED_DATA | PE_SCN_MEM_DISCARDABLE | PE_SCN_MEM_READ)) == nullptr)
+  {
+    CHECK(reporter, false);
+    return;
+  }
+  const DWORD relocationSize = sizeof(PeBaseRelocation) + 2 * sizeof(WORD);
+  BYTE* relocations = peFile.GetWritablePointer(relocationSection->PointerToRawData, relocationSize);
+  PeBaseRelocation block = { PEFixture::NANO_RVA, relocationSize };
+  const WORD entries[] = { (WORD)(PE_REL_BASED_DIR64 << 12 | (relocationRva - PEFixture::NANO_RVA)), PE_REL_BASED_ABSOLUTE };
+  memcpy(relocations, &block, sizeof(block));
+  memcpy(relocations + sizeof(block), entries, sizeof(entries));
+  peFile.SetDataDirectory(PE_DIRECTORY_ENTRY_BASERELOC, relocationSection->VirtualAddress, relocationSize);
+  CHECK(reporter, peFile.SaveFile(_fileName.c_str()));
+  peFile.Close();
+
+  // The first resource creates the resource section in front of .reloc
+  std::vector<BYTE> metadata = { 1, 2, 3, 4, 5 };
+  ResourceAdder resourceAdder;
+  CHECK(reporter, resourceAdder.AddResource(_fileName.c_str(), 1234, metadata.data(), (DWORD)metadata.size()));
+  std::vector<BYTE> data;
+  std::vector<DWORD> relocationRvas;
+  CHECK(reporter, peFile.OpenFile(_fileName.c_str(), LoadMode::Buffer) && peFile.GetSectionCount() == 5);
+  CHECK(reporter, ReadResource(peFile, 1234, data) && data == metadata);
+  CHECK(reporter, PEFile::GetSectionName(peFile.GetSectionHeader(3)) == ".rsrc" && PEFile::GetSectionName(peFile.GetSectionHeader(4)) == ".reloc");
+  CHECK(reporter, peFile.GetRelocations(relocationRvas) && relocationRvas == std::vector<DWORD>{ relocationRva });
+
+  // The second call reads the tree back, replaces 1234, adds 1235 and rebuilds the same section
+  std::vector<BYTE> sections = { 6, 7, 8 };
+  metadata.assign(300, 0xAB);
+  CHECK(reporter, resourceAdder.AddResources(peFile, { { 1234, metadata.data(), (DWORD)metadata.size() }, { 1235, sections.data(), (DWORD)sections.size() } }));
+  CHECK(reporter, peFile.SaveFile(_fileName.c_str()));
+  peFile.Close();
+  CHECK(reporter, peFile.OpenFile(_fileName.c_str(), LoadMode::Buffer) && peFile.GetSectionCount() == 5);
+  CHECK(reporter, ReadResource(peFile, 1234, data) && data == metadata);
+  CHECK(reporter, ReadResource(peFile, 1235, data) && data == sections);
+  CHECK(reporter, !ReadResource(peFile, 1236, data));
+  CHECK(reporter, peFile.FindSectionByName(".rsrc2") == nullptr && PEFile::GetSectionName(peFile.GetSectionHeader(4)) == ".reloc");
+  relocationRvas.clear();
+  CHECK(reporter, peFile.GetRelocations(relocationRvas) && relocationRvas == std::vector<DWORD>{ relocationRva });
+  peFile.Close();
+}
+
+bool PEFileTests::OpenDamaged(const std::function<void(std::vector<BYTE>&)>& damage)
+{
+  std::vector<BYTE> image;
+  {
+    std::ifstream input(_fileName, std::ios::binary);
+    image.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+  }
+  damage(image);
+  {
+    std::ofstream output(_damagedFileName, std::ios::binary | std::ios::trunc);
+    output.write((const char*)image.data(), image.size());
+    if (!output.good()) return false;
+  }
+
+  PEFile buffered, mapped;
+  const bool opened = buffered.OpenFile(_damagedFileName.c_str(), LoadMode::Buffer) || mapped.OpenFile(_damagedFileName.c_str(), LoadMode::Mapping);
+  mapped.Close();
+  return opened;
+}
+
+bool PEFileTests::ReadResource(const PEFile& peFile, WORD id, std::vector<BYTE>& outData)
+{
+  // Type, name and language directory, then the data entry
+  const PeDataDirectory directory = peFile.GetDataDirectory(PE_DIRECTORY_ENTRY_RESOURCE);
+  const BYTE* resources = peFile.GetRvaPointer(directory.VirtualAddress, directory.Size);
+  if (resources == nullptr) return false;
+  const DWORD ids[] = { PE_RT_RCDATA, id, PE_LANG_NEUTRAL };
+  DWORD offset = 0;
+  for (DWORD level = 0; level < 3; level++)
+  {
+    if (offset + sizeof(PeResourceDirectory) > directory.Size) return false;
+    const PeResourceDirectory* resourceDirectory = (const PeResourceDirectory*)(resources + offset);
+    const PeResourceDirectoryEntry* first = (const PeResourceDirectoryEntry*)(resourceDirectory + 1);
+    const PeResourceDirectoryEntry* last = first + resourceDirectory->NumberOfNamedEntries + resourceDirectory->NumberOfIdEntries;
+    if ((const BYTE*)last > resources + directory.Size) return false;
+    const PeResourceDirectoryEntry* entry = std::find_if(first, last, [&](const PeResourceDirectoryEntry& candidate) -> bool { return candidate.Name == ids[level]; });
+    if (entry == last) return false;
+    const bool isDirectory = (entry->OffsetToData & PE_RESOURCE_DATA_IS_DIRECTORY) != 0;
+    if (isDirectory != (level < 2)) return false;
+    offset = entry->OffsetToData & ~PE_RESOURCE_DATA_IS_DIRECTORY;
+  }
+
+  if (offset + sizeof(PeResourceDataEntry) > directory.Size) return false;
+  const PeResourceDataEntry* dataEntry = (const PeResourceDataEntry*)(resources + offset);
+  const BYTE* data = peFile.GetRvaPointer(dataEntry->OffsetToData, dataEntry->Size);
+  if (data == nullptr) return false;
+  outData.assign(data, data + dataEntry->Size);
+  return true;
+}
+
+PeFileHeader* PEFileTests::GetFileHeader(std::vector<BYTE>& image)
+{
+  return (PeFileHeader*)(image.data() + ((PeDosHeader*)image.data())->e_lfanew + sizeof(DWORD));
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+#include "../../Builder/PEFile/PEFormat.h"
+
+class PEFile;
+class TestReporter;
+
+// Validation of the PE parser on damaged copies of the fixture and the rebuild of the resource section, with a
+// trailing .reloc section that has to stay behind it.
+class PEFileTests
+{
+public:
+  PEFileTests();
+  ~PEFileTests();
+
+  void Run(TestReporter& reporter);
+
+private:
+  void TestValidation(TestReporter& reporter);
+  void TestResources(TestReporter& reporter);
+
+  // Writes the fixture, lets damage change its bytes and opens the result in both load modes; true if either opened
+  bool OpenDamaged(const std::function<void(std::vector<BYTE>&)>& damage);
+  // RT_RCDATA resource with the given ID in the neutral language, false if the tree has no such entry
+  static bool ReadResource(const PEFile& peFile, WORD id, std::vector<BYTE>& outData);
+  static PeFileHeader* GetFileHeader(std::vector<BYTE>& image);
+  static PeOptionalHeader64* GetOptionalHeader(std::vector<BYTE>& image) { return (PeOptionalHeader64*)(GetFileHeader(image) + 1); }
+
+private:
+  std::string _fileName;
+  std::string _damagedFileName;
+};
@@ -0,0 +1,81 @@
+#include <cstring>
+#include <fstream>
+#include "PEFixture.h"
+
+bool PEFixture::Write(const char* fileName, const std::vector<BYTE>& code, const std::vector<Function>& functions)
+{
+  const DWORD nanoRawSize = Align((DWORD)code.size(), FILE_ALIGNMENT);
+  const DWORD pdataRva = NANO_RVA + Align((DWORD)code.size(), SECTION_ALIGNMENT);
+  const DWORD tableSize = (DWORD)(functions.size() * sizeof(PeRuntimeFunction));
+  // All functions share the UNWIND_INFO behind the table (version 1, no codes)
+  const DWORD unwindInfoRva = pdataRva + tableSize;
+  const DWORD pdataRawSize = Align(tableSize + sizeof(DWORD), FILE_ALIGNMENT);
+
+  std::vector<BYTE> image(HEADERS_SIZE + FILE_ALIGNMENT + nanoRawSize + pdataRawSize, 0);
+  PeDosHeader* dosHeader = (PeDosHeader*)image.data();
+  dosHeader->e_magic = PE_DOS_SIGNATURE;
+  dosHeader->e_lfanew = sizeof(PeDosHeader);
+  *(DWORD*)(image.data() + dosHeader->e_lfanew) = PE_NT_SIGNATURE;
+
+  PeFileHeader* fileHeader = (PeFileHeader*)(image.data() + dosHeader->e_lfanew + sizeof(DWORD));
+  fileHeader->Machine = PE_MACHINE_AMD64;
+  fileHeader->NumberOfSections = 3;
+  fileHeader->SizeOfOptionalHeader = sizeof(PeOptionalHeader64);
+
+  PeOptionalHeader64* optionalHeader = (PeOptionalHeader64*)(fileHeader + 1);
+  optionalHeader->Magic = PE_OPTIONAL_HEADER64_MAGIC;
+  optionalHeader->AddressOfEntryPoint = TEXT_RVA;
+  optionalHeader->BaseOfCode = TEXT_RVA;
+  optionalHeader->ImageBase = IMAGE_BASE;
+  optionalHeader->SectionAlignment = SECTION_ALIGNMENT;
+  optionalHeader->FileAlignment = FILE_ALIGNMENT;
+  optionalHeader->MajorOperatingSystemVersion = 6;
+  optionalHeader->MajorSubsystemVersion = 6;
+  optionalHeader->SizeOfImage = pdataRva + Align(pdataRawSize, SECTION_ALIGNMENT);
+  optionalHeader->SizeOfHeaders = HEADERS_SIZE;
+  optionalHeader->Subsystem = 3; // Console
+  optionalHeader->NumberOfRvaAndSizes = PE_NUMBEROF_DIRECTORY_ENTRIES;
+  optionalHeader->DataDirectory[PE_DIRECTORY_ENTRY_EXCEPTION].VirtualAddress = functions.empty() ? 0 : pdataRva;
+  optionalHeader->DataDirectory[PE_DIRECTORY_ENTRY_EXCEPTION].Size = tableSize;
+
+  PeSectionHeader* sectionHeaders = (PeSectionHeader*)(optionalHeader + 1);
+  memcpy(sectionHeaders[0].Name, ".text", 5);
+  sectionHeaders[0].VirtualSize = 1;
+  sectionHeaders[0].VirtualAddress = TEXT_RVA;
+  sectionHeaders[0].SizeOfRawData = FILE_ALIGNMENT;
+  sectionHeaders[0].PointerToRawData = HEADERS_SIZE;
+  sectionHeaders[0].Characteristics = PE_SCN_CNT_CODE | PE_SCN_MEM_EXECUTE | PE_SCN_MEM_READ;
+
+  memcpy(sectionHeaders[1].Name, ".nano", 5);
+  sectionHeaders[1].VirtualSize = (DWORD)code.size();
+  sectionHeaders[1].VirtualAddress = NANO_RVA;
+  sectionHeaders[1].SizeOfRawData = nanoRawSize;
+  sectionHeaders[1].PointerToRawData = HEADERS_SIZE + FILE_ALIGNMENT;
+  sectionHeaders[1].Characteristics = PE_SCN_CNT_CODE | PE_SCN_MEM_EXECUTE | PE_SCN_MEM_READ;
+
+  memcpy(sectionHeaders[2].Name, ".pdata", 6);
+  sectionHeaders[2].VirtualSize = tableSize + sizeof(DWORD);
+  sectionHeaders[2].VirtualAddress = pdataRva;
+  sectionHeaders[2].SizeOfRawData = pdataRawSize;
+  sectionHeaders[2].PointerToRawData = HEADERS_SIZE + FILE_ALIGNMENT + nanoRawSize;
+  sectionHeaders[2].Characteristics = PE_SCN_CNT_INITIALIZED_DATA | PE_SCN_MEM_READ;
+
+  image[HEADERS_SIZE] = 0xC3;
+  // Padding behind the code is int3, as the linker emits it
+  memset(image.data() + sectionHeaders[1].PointerToRawData, 0xCC, nanoRawSize);
+  memcpy(image.data() + sectionHeaders[1].PointerToRawData, code.data(), code.size());
+
+  PeRuntimeFunction* entries = (PeRuntimeFunction*)(image.data() + sectionHeaders[2].PointerToRawData);
+  for (size_t i = 0; i < functions.size(); i++)
+  {
+    entries[i].BeginAddress = NANO_RVA + functions[i].Begin;
+    entries[i].EndAddress = NANO_RVA + functions[i].End;
+    entries[i].UnwindInfoAddress = unwindInfoRva;
+  }
+  image[sectionHeaders[2].PointerToRawData + tableSize] = 0x01;
+
+  std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) return false;
+  file.write((const char*)image.data(), image.size());
+  return file.good();
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <vector>
+#include "../../Builder/PEFile/PEFormat.h"
+
+// Writes a minimal PE32+ executable for the Builder tests: .text with a ret as entry point, the given code as .nano at
+// NANO_RVA and a .pdata entry for every given function. Ranges are relative to the start of .nano.
+class PEFixture
+{
+public:
+  struct Function
+  {
+    DWORD Begin;
+    DWORD End;
+  };
+
+  static bool Write(const char* fileName, const std::vector<BYTE>& code, const std::vector<Function>& functions);
+
+  static const DWORD NANO_RVA = 0x2000;
+  static const ULONGLONG IMAGE_BASE = 0x140000000;
+
+private:
+  static DWORD Align(DWORD value, DWORD alignment) { return (value + alignment - 1) & ~(alignment - 1); }
+
+private:
+  static const DWORD FILE_ALIGNMENT = 0x200;
+  static const DWORD SECTION_ALIGNMENT = 0x1000;
+  static const DWORD HEADERS_SIZE = 0x400;
+  static const DWORD TEXT_RVA = 0x1000;
+};
@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include "PatchWriterTests.h"
+#include "../Common/TestReporter.h"
+#include "../../Builder/FileWriter/PatchWriter.h"
+
+PatchWriterTests::PatchWriterTests()
+{
+  _fileName = (std::filesystem::temp_directory_path() / "nanomites-patchwriter-test.exe").string();
+  _journalName = _fileName + ".journal";
+
+  // Three blocks and a partial one; the runs cross a block boundary and one grows the file
+  _original.resize(3 * 4096 + 100);
+  for (size_t i = 0; i < _original.size(); i++) _original[i] = (BYTE)(i * 7);
+  _patches.push_back({ 10, std::vector<BYTE>(20, 0xAA) });
+  _patches.push_back({ 4090, std::vector<BYTE>(12, 0xBB) });
+  _patches.push_back({ 9000, std::vector<BYTE>(100, 0xCC) });
+  _patches.push_back({ (DWORD)_original.size(), std::vector<BYTE>(300, 0xDD) });
+
+  _patched = _original;
+  _patched.resize(_original.size() + 300);
+  for (const Patch& patch : _patches) std::copy(patch.Data.begin(), patch.Data.end(), _patched.begin() + patch.Offset);
+}
+
+PatchWriterTests::~PatchWriterTests()
+{
+  std::error_code error;
+  std::filesystem::remove(_fileName, error);
+  std::filesystem::remove(_journalName, error);
+}
+
+void PatchWriterTests::Run(TestReporter& reporter)
+{
+  if (reporter.Begin("patchwriter/commit")) TestCommit(reporter);
+  if (reporter.Begin("patchwriter/recover-matching-file")) TestRecoverMatchingFile(reporter);
+  if (reporter.Begin("patchwriter/recover-changed-file")) TestRecoverChangedFile(reporter);
+  if (reporter.Begin("patchwriter/torn-journal")) TestTornJournal(reporter);
+}
+
+void PatchWriterTests::TestCommit(TestReporter& reporter)
+{
+  std::vector<BYTE> data;
+  CHECK(reporter, WriteBytes(_fileName, _original));
+  {
+    PatchWriter writer;
+    CHECK(reporter, writer.Open(_fileName.c_str()));
+    for (const Patch& patch : _patches) writer.AddRun(patch.Offset, patch.Data.data(), (DWORD)patch.Data.size());
+    writer.SetFileSize((DWORD)_patched.size());
+    CHECK(reporter, writer.Apply());
+    CHECK(reporter, std::filesystem::exists(_journalName));
+    CHECK(reporter, writer.Commit());
+    CHECK(reporter, writer.GetRunCount() == _patches.size());
+  }
+  CHECK(reporter, ReadBytes(_fileName, data) && data == _patched);
+  CHECK(reporter, !std::filesystem::exists(_journalName));
+  // Nothing to recover
+  CHECK(reporter, PatchWriter::Recover(_fileName.c_str()));
+  CHECK(reporter, ReadBytes(_fileName, data) && data == _patched);
+
+  // A shrinking patch: the file is cut behind the last run
+  {
+    const BYTE byte = 0xEE;
+    PatchWriter writer;
+    CHECK(reporter, writer.Open(_fileName.c_str()));
+    writer.AddRun(0, &byte, 1);
+    writer.SetFileSize(4096);
+    CHECK(reporter, writer.Apply() && writer.Commit());
+  }
+  CHECK(reporter, ReadBytes(_fileName, data) && data.size() == 4096 && data[0] == 0xEE && std::equal(data.begin() + 1, data.end(), _patched.begin() + 1));
+}
+
+void PatchWriterTests::TestRecoverMatchingFile(TestReporter& reporter)
+{
+  // Crash after the journal was flushed but before the first write to the file: the file is unchanged
+  std::vector<BYTE> data;
+  std::filesystem::file_time_type lastWriteTime;
+  CHECK(reporter, ApplyWithoutCommit(lastWriteTime));
+  CHECK(reporter, RestoreOriginal(lastWriteTime));
+  CHECK(reporter, PatchWriter::Recover(_fileName.c_str()));
+  CHECK(reporter, ReadBytes(_fileName, data) && data == _patched);
+  CHECK(reporter, !std::filesystem::exists(_journalName));
+
+  // Crash while the runs were written: some blocks are patched, the others are not
+  CHECK(reporter, ApplyWithoutCommit(lastWriteTime));
+  CHECK(reporter, ReadBytes(_fileName, data));
+  std::copy(_original.begin() + 8192, _original.end(), data.begin() + 8192);
+  CHECK(reporter, WriteBytes(_fileName, data));
+  CHECK(reporter, PatchWriter::Recover(_fileName.c_str()));
+  CHECK(reporter, ReadBytes(_fileName, data) && data == _patched);
+  CHECK(reporter, !std::filesystem::exists(_journalName));
+
+  // Crash after all writes, before the journal was removed: replaying is harmless
+  CHECK(reporter, ApplyWithoutCommit(lastWriteTime));
+  CHECK(reporter, PatchWriter::Recover(_fileName.c_str()));
+  CHECK(reporter, ReadBytes(_fileName, data) && data == _patched);
+  CHECK(reporter, !std::filesystem::exists(_journalName));
+}
+
+void PatchWriterTests::TestRecoverChangedFile(TestReporter& reporter)
+{
+  // The file was relinked after the crash and has another size: the journal is removed, the file is not touched
+  std::vector<BYTE> data;
+  std::filesystem::file_time_type lastWriteTime;
+  std::vector<BYTE> relinked(_original.size() + 4096, 0x90);
+  CHECK(reporter, ApplyWithoutCommit(lastWriteTime));
+  CHECK(reporter, WriteBytes(_fileName, relinked));
+  CHECK(reporter, PatchWriter::Recover(_fileName.c_str()));
+  CHECK(reporter, ReadBytes(_fileName, data) && data == relinked);
+  CHECK(reporter, !std::filesystem::exists(_journalName));
+
+  // Same size, but another write time and other bytes in the patched blocks
+  relinked.assign(_original.size(), 0x90);
+  CHECK(reporter, ApplyWithoutCommit(lastWriteTime));
+  CHECK(reporter, WriteBytes(_fileName, relinked));
+  CHECK(reporter, PatchWriter::Recover(_fileName.c_str()));
+  CHECK(reporter, ReadBytes(_fileName, data) && data == relinked);
+  CHECK(reporter, !std::filesystem::exists(_journalName));
+
+  // Size and write time of the original, so the file claims to be unchanged, yet one block holds the patched bytes:
+  // the file is not the one of the journal
+  CHECK(reporter, ApplyWithoutCommit(lastWriteTime));
+  CHECK(reporter, RestoreOriginal(lastWriteTime));
+  CHECK(reporter, ReadBytes(_fileName, data));
+  std::copy(_patched.begin(), _patched.begin() + 4096, data.begin());
+  CHECK(reporter, WriteBytes(_fileName, data));
+  std::filesystem::last_write_time(_fileName, lastWriteTime);
+  const std::vector<BYTE> expected = data;
+  CHECK(reporter, PatchWriter::Recover(_fileName.c_str()));
+  CHECK(reporter, ReadBytes(_fileName, data) && data == expected);
+  CHECK(reporter, !std::filesystem::exists(_journalName));
+}
+
+void PatchWriterTests::TestTornJournal(TestReporter& reporter)
+{
+  // Crash while the journal was written, so the file is unchanged; a journal without its end or with a wrong hash is
+  // removed without touching the file
+  std::vector<BYTE> data, journal;
+  std::filesystem::file_time_type lastWriteTime;
+  CHECK(reporter, ApplyWithoutCommit(lastWriteTime));
+  CHECK(reporter, ReadBytes(_journalName, journal) && journal.size() > 64);
+  for (size_t size : { journal.size() - 1, journal.size() / 2, (size_t)8 })
+  {
+    CHECK(reporter, RestoreOriginal(lastWriteTime));
+    CHECK(reporter, WriteBytes(_journalName, std::vector<BYTE>(journal.begin(), journal.begin() + size)));
+    CHECK(reporter, PatchWriter::Recover(_fileName.c_str()));
+    CHECK(reporter, ReadBytes(_fileName, data) && data == _original);
+    CHECK(reporter, !std::filesystem::exists(_journalName));
+  }
+
+  // Complete length, but a byte of the data did not reach the disk
+  std::vector<BYTE> damaged = journal;
+  damaged[damaged.size() / 2] ^= 0xFF;
+  CHECK(reporter, RestoreOriginal(lastWriteTime));
+  CHECK(reporter, WriteBytes(_journalName, damaged));
+  CHECK(reporter, PatchWriter::Recover(_fileName.c_str()));
+  CHECK(reporter, ReadBytes(_fileName, data) && data == _original);
+  CHECK(reporter, !std::filesystem::exists(_journalName));
+}
+
+bool PatchWriterTests::ApplyWithoutCommit(std::filesystem::file_time_type& outLastWriteTime)
+{
+  std::error_code error;
+  std::filesystem::remove(_journalName, error);
+  if (!WriteBytes(_fileName, _original)) return false;
+  outLastWriteTime = std::filesystem::last_write_time(_fileName, error);
+  if (error) return false;
+
+  // The journal stays behind, the writer is destroyed as by a crash
+  PatchWriter writer;
+  if (!writer.Open(_fileName.c_str())) return false;
+  for (const Patch& patch : _patches) writer.AddRun(patch.Offset, patch.Data.data(), (DWORD)patch.Data.size());
+  writer.SetFileSize((DWORD)_patched.size());
+  return writer.Apply();
+}
+
+bool PatchWriterTests::RestoreOriginal(std::filesystem::file_time_type lastWriteTime)
+{
+  if (!WriteBytes(_fileName, _original)) return false;
+  std::error_code error;
+  std::filesystem::last_write_time(_fileName, lastWriteTime, error);
+  return !error;
+}
+
+bool PatchWriterTests::ReadBytes(const std::string& fileName, std::vector<BYTE>& outData)
+{
+  std::ifstream file(fileName, std::ios::binary);
+  if (!file.is_open()) return false;
+  outData.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  return true;
+}
+
+bool PatchWriterTests::WriteBytes(const std::string& fileName, const std::vector<BYTE>& data)
+{
+  std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) return false;
+  file.write((const char*)data.data(), data.size());
+  return file.good();
+}
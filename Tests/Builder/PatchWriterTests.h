@@ -0,0 +1,44 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "../../Builder/PEFile/PEFormat.h"
+
+class TestReporter;
+
+// In-place patching and the crash recovery of PatchWriter. A crash is simulated by applying the runs without Commit,
+// which leaves the journal behind, and by putting the file or the journal into the state it would have on disk.
+class PatchWriterTests
+{
+public:
+  PatchWriterTests();
+  ~PatchWriterTests();
+
+  void Run(TestReporter& reporter);
+
+private:
+  struct Patch
+  {
+    DWORD Offset;
+    std::vector<BYTE> Data;
+  };
+
+  void TestCommit(TestReporter& reporter);
+  void TestRecoverMatchingFile(TestReporter& reporter);
+  void TestRecoverChangedFile(TestReporter& reporter);
+  void TestTornJournal(TestReporter& reporter);
+
+  // Writes the original file, applies the patches without Commit and returns the last write time of the original
+  bool ApplyWithoutCommit(std::filesystem::file_time_type& outLastWriteTime);
+  // Puts the original bytes back, e.g. as if the crash happened before the first write to the file
+  bool RestoreOriginal(std::filesystem::file_time_type lastWriteTime);
+  static bool ReadBytes(const std::string& fileName, std::vector<BYTE>& outData);
+  static bool WriteBytes(const std::string& fileName, const std::vector<BYTE>& data);
+
+private:
+  std::string _fileName;
+  std::string _journalName;
+  std::vector<BYTE> _original;
+  std::vector<Patch> _patches;
+  std::vector<BYTE> _patched;     // _original with _patches applied
+};
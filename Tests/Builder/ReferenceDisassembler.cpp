@@ -0,0 +1,53 @@
+#include <algorithm>
+#include "ReferenceDisassembler.h"
+#include "../../Builder/Zydis/include/Zydis.h"
+
+bool ReferenceDisassembler::GetRelativeJumps(PEFile& peFile, const PeSectionHeader* sectionHeader, std::vector<RelativeJump>& result)
+{
+  const DWORD sectionLength = sectionHeader->SizeOfRawData;
+  const BYTE* section = peFile.GetPointer(sectionHeader->PointerToRawData, sectionLength);
+  if (section == nullptr) return false;
+  const ZydisMachineMode machineMode = peFile.Is64Bit() ? ZYDIS_MACHINE_MODE_LONG_64 : ZYDIS_MACHINE_MODE_LONG_COMPAT_32;
+  DWORD rva = 0;
+  while (rva < sectionLength)
+  {
+    const DWORD length = std::min((DWORD)ZYDIS_MAX_INSTRUCTION_LENGTH, sectionLength - rva);
+    ZydisDisassembledInstruction instructionInfo;
+    if (!ZYAN_SUCCESS(ZydisDisassembleIntel(machineMode, 0, section + rva, length, &instructionInfo)))
+    {
+      rva += 1; // Undecodable bytes are skipped one by one, as by the Disassembler
+      continue;
+    }
+
+    // Relative jumps (conditional or unconditional), calls are no jumps
+    const auto category = instructionInfo.info.meta.category;
+    const bool isJump = (category == ZYDIS_CATEGORY_COND_BR) || (category == ZYDIS_CATEGORY_UNCOND_BR);
+    const bool isRelative = (instructionInfo.info.attributes & ZYDIS_ATTRIB_IS_RELATIVE) != 0;
+    if (isJump && isRelative)
+    {
+      RelativeJump relativeJump;
+      relativeJump.Rva = rva;
+      relativeJump.Opcode = instructionInfo.info.opcode;
+      relativeJump.OpcodeLength = instructionInfo.info.length;
+      relativeJump.JmpLength = (DWORD)instructionInfo.info.raw.imm->value.u;
+
+      result.push_back(relativeJump);
+    }
+    rva += instructionInfo.info.length;
+  }
+
+  return true;
+}
+
+bool ReferenceDisassembler::GetCCs(PEFile& peFile, const PeSectionHeader* sectionHeader, std::set<DWORD>& rvas)
+{
+  const DWORD sectionLength = sectionHeader->SizeOfRawData;
+  const BYTE* section = peFile.GetPointer(sectionHeader->PointerToRawData, sectionLength);
+  if (section == nullptr) return false;
+  for (DWORD rva = 0; rva < sectionLength; rva++)
+  {
+    if (section[rva] == 0xCC) rvas.insert(rva);
+  }
+
+  return true;
+}
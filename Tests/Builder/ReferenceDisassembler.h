@@ -0,0 +1,14 @@
+#pragma once
+#include <set>
+#include <vector>
+#include "../../Builder/Disassembler/RelativeJump.h"
+#include "../../Builder/PEFile/PEFile.h"
+
+// The separate passes the Builder used before Disassembler::AnalyzeSection: a serial linear sweep with full
+// disassembly and a byte loop for 0xCC. Kept as the oracle of the tests and the baseline of the benchmarks.
+class ReferenceDisassembler
+{
+public:
+  static bool GetRelativeJumps(PEFile& peFile, const PeSectionHeader* sectionHeader, std::vector<RelativeJump>& result);
+  static bool GetCCs(PEFile& peFile, const PeSectionHeader* sectionHeader, std::set<DWORD>& rvas);
+};
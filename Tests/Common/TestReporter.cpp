@@ -0,0 +1,35 @@
+#include <iostream>
+#include "TestReporter.h"
+
+TestReporter::TestReporter()
+{
+  _testCount = 0;
+  _checkCount = 0;
+  _failureCount = 0;
+}
+
+TestReporter::~TestReporter()
+{
+}
+
+bool TestReporter::Begin(const std::string& name)
+{
+  if (!_filter.empty() && name.find(_filter) == std::string::npos) return false;
+  _testName = name;
+  _testCount++;
+  return true;
+}
+
+void TestReporter::Check(bool condition, const char* expression, const char* file, int line)
+{
+  _checkCount++;
+  if (condition) return;
+  _failureCount++;
+  std::cout << _testName << ": CHECK(" << expression << ") failed at " << file << ":" << line << std::endl;
+}
+
+bool TestReporter::PrintSummary() const
+{
+  std::cout << _testCount << " test(s), " << _checkCount << " check(s), " << _failureCount << " failed." << std::endl;
+  return _failureCount == 0;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include "../../Builder/PEFile/PEFormat.h"
+
+// Counts the checks of the test cases and prints every failed one with its location
+class TestReporter
+{
+public:
+  TestReporter();
+  ~TestReporter();
+
+  void SetFilter(const std::string& filter) { _filter = filter; }
+  // Starts the test case if its name contains the filter
+  bool Begin(const std::string& name);
+  void Check(bool condition, const char* expression, const char* file, int line);
+
+  // Prints the number of test cases and failed checks; false if a check failed
+  bool PrintSummary() const;
+
+private:
+  std::string _filter;
+  std::string _testName;
+  DWORD _testCount;
+  DWORD _checkCount;
+  DWORD _failureCount;
+};
+
+#define CHECK(reporter, condition) (reporter).Check((condition), #condition, __FILE__, __LINE__)
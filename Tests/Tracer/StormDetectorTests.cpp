@@ -0,0 +1,119 @@
+#include "StormDetectorTests.h"
+#include "../Common/TestReporter.h"
+#include "../../Nanomites/Tracer/NanomiteMetadata.h"
+#include "../../Nanomites/Tracer/TracerStatistics.h"
+
+StormDetectorTests::StormDetectorTests()
+{
+  const Nanomite sites[] = { { 0x1010, JE, 0x20, 2 }, { 0x1040, JMP, 0x100, 5 } };
+  _metadata.assign(sizeof(NanomiteMetadata) + sizeof(sites), 0);
+  NanomiteMetadata* metadata = reinterpret_cast<NanomiteMetadata*>(_metadata.data());
+  metadata->ItemCount = sizeof(sites) / sizeof(Nanomite);
+  memcpy(_metadata.data() + sizeof(NanomiteMetadata), sites, sizeof(sites));
+}
+
+StormDetectorTests::~StormDetectorTests()
+{
+}
+
+void StormDetectorTests::Run(TestReporter& reporter)
+{
+  if (reporter.Begin("storm-detector/below-threshold")) TestBelowThreshold(reporter);
+  if (reporter.Begin("storm-detector/threshold-crossed")) TestThresholdCrossed(reporter);
+  if (reporter.Begin("storm-detector/rate-limit")) TestRateLimit(reporter);
+}
+
+void StormDetectorTests::TestBelowThreshold(TestReporter& reporter)
+{
+  TracerStatistics statistics;
+  statistics.Initialize(reinterpret_cast<NanomiteMetadata*>(_metadata.data()));
+  StormDetector detector(&statistics, CreateSettings());
+
+  // 990 traps/s for ten seconds, just below the threshold
+  ULONGLONG nowMs = 1000;
+  detector.Sample(nowMs);
+  Storm(detector, statistics, nowMs, 100, 99);
+  CHECK(reporter, statistics.GetTraps() == 9900);
+  CHECK(reporter, _reports.empty());
+}
+
+void StormDetectorTests::TestThresholdCrossed(TestReporter& reporter)
+{
+  TracerStatistics statistics;
+  statistics.Initialize(reinterpret_cast<NanomiteMetadata*>(_metadata.data()));
+  StormDetector detector(&statistics, CreateSettings());
+
+  // A quiet second, then 2000 traps/s: the first sample above the threshold only arms the detector
+  ULONGLONG nowMs = 1000;
+  detector.Sample(nowMs);
+  Storm(detector, statistics, nowMs, 10, 20);
+  Storm(detector, statistics, nowMs, 1, 200);
+  CHECK(reporter, _reports.empty());
+
+  Storm(detector, statistics, nowMs, 1, 200);
+  CHECK(reporter, _reports.size() == 1);
+  if (_reports.size() != 1) return;
+  const StormReport& report = _reports.front();
+  CHECK(reporter, report.TrapsPerSecond == 2000);
+  CHECK(reporter, report.Threshold == 1000);
+  CHECK(reporter, report.SuppressedReports == 0);
+  // Ranked by the traps of the last interval, in traps per second
+  CHECK(reporter, report.HotSites.size() == 2);
+  if (report.HotSites.size() != 2) return;
+  CHECK(reporter, report.HotSites[0].Rva == 0x1040 && report.HotSites[0].Delta == 1500);
+  CHECK(reporter, report.HotSites[1].Rva == 0x1010 && report.HotSites[1].Delta == 500);
+}
+
+void StormDetectorTests::TestRateLimit(TestReporter& reporter)
+{
+  TracerStatistics statistics;
+  statistics.Initialize(reinterpret_cast<NanomiteMetadata*>(_metadata.data()));
+  StormDetector detector(&statistics, CreateSettings());
+
+  // Baseline at 1000, armed at 1100, reported at 1200; the samples up to 2100 fall into the rate limit
+  ULONGLONG nowMs = 1000;
+  detector.Sample(nowMs);
+  Storm(detector, statistics, nowMs, 11, 200);
+  CHECK(reporter, _reports.size() == 1);
+
+  Storm(detector, statistics, nowMs, 1, 200);
+  CHECK(reporter, _reports.size() == 2);
+  if (_reports.size() != 2) return;
+  CHECK(reporter, _reports[1].SuppressedReports == 9);
+  // The suppressed samples kept the site counters current, the report covers the last interval only
+  CHECK(reporter, !_reports[1].HotSites.empty() && _reports[1].HotSites[0].Delta == 1500);
+
+  // A quiet second disarms the detector; outside of the rate limit the next storm is reported once it is armed again
+  Storm(detector, statistics, nowMs, 10, 0);
+  Storm(detector, statistics, nowMs, 1, 200);
+  CHECK(reporter, _reports.size() == 2);
+  Storm(detector, statistics, nowMs, 1, 200);
+  CHECK(reporter, _reports.size() == 3);
+  if (_reports.size() == 3) CHECK(reporter, _reports[2].SuppressedReports == 0);
+}
+
+StormDetectorSettings StormDetectorTests::CreateSettings()
+{
+  _reports.clear();
+  StormDetectorSettings settings = StormDetector::DefaultSettings(1000);
+  settings.SampleIntervalMs = SAMPLE_INTERVAL_MS;
+  settings.MinReportIntervalMs = 1000;
+  settings.Callback = [this](const StormReport& report)
+  {
+    _reports.push_back(report);
+  };
+  return settings;
+}
+
+void StormDetectorTests::Storm(StormDetector& detector, TracerStatistics& statistics, ULONGLONG& nowMs, DWORD sampleCount, DWORD trapsPerSample)
+{
+  for (DWORD i = 0; i < sampleCount; i++)
+  {
+    for (DWORD trap = 0; trap < trapsPerSample; trap++)
+    {
+      statistics.OnTrap(trap % 4 == 0 ? 0 : 1);
+    }
+    nowMs += SAMPLE_INTERVAL_MS;
+    detector.Sample(nowMs);
+  }
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <Windows.h>
+#include <vector>
+#include "../../Nanomites/Tracer/Nanomite.h"
+#include "../../Nanomites/Tracer/StormDetector.h"
+
+class TestReporter;
+
+// Synthetic trap storms: the counters of a TracerStatistics are incremented directly and StormDetector::Sample is
+// called with a fake clock, so no exception handler or sampling thread is involved.
+class StormDetectorTests
+{
+public:
+  StormDetectorTests();
+  ~StormDetectorTests();
+
+  void Run(TestReporter& reporter);
+
+private:
+  void TestBelowThreshold(TestReporter& reporter);
+  void TestThresholdCrossed(TestReporter& reporter);
+  void TestRateLimit(TestReporter& reporter);
+
+  // Threshold 1000 traps/s, reports at most once per second; every report is appended to _reports
+  StormDetectorSettings CreateSettings();
+  // One sample every SAMPLE_INTERVAL_MS, trapsPerSample traps per interval of which a quarter hit site 0 and the rest site 1
+  static void Storm(StormDetector& detector, TracerStatistics& statistics, ULONGLONG& nowMs, DWORD sampleCount, DWORD trapsPerSample);
+
+private:
+  static const DWORD SAMPLE_INTERVAL_MS = 100;
+
+  std::vector<BYTE> _metadata; // NanomiteMetadata followed by the sites, as the Tracer reads resource 1234
+  std::vector<StormReport> _reports;
+};
@@ -0,0 +1,92 @@
+#include <atomic>
+#include <thread>
+#include "TracerStatisticsTests.h"
+#include "../Common/TestReporter.h"
+#include "../../Nanomites/Tracer/Nanomite.h"
+#include "../../Nanomites/Tracer/NanomiteMetadata.h"
+#include "../../Nanomites/Tracer/TracerStatistics.h"
+
+TracerStatisticsTests::TracerStatisticsTests()
+{
+}
+
+TracerStatisticsTests::~TracerStatisticsTests()
+{
+}
+
+void TracerStatisticsTests::Run(TestReporter& reporter)
+{
+  if (reporter.Begin("tracer-statistics/reinitialize")) TestReinitialize(reporter);
+  if (reporter.Begin("tracer-statistics/concurrent-reinitialize")) TestConcurrentReinitialize(reporter);
+}
+
+void TracerStatisticsTests::TestReinitialize(TestReporter& reporter)
+{
+  std::vector<BYTE> large = CreateMetadata(8);
+  std::vector<BYTE> small = CreateMetadata(2);
+  TracerStatistics statistics;
+  statistics.Initialize(reinterpret_cast<NanomiteMetadata*>(large.data()));
+  statistics.OnTrap(7);
+  CHECK(reporter, statistics.GetTraps() == 1 && statistics.GetSiteHits(7) == 1);
+
+  // A trap of the old table that arrives after the switch is counted, but not as a site of the new one
+  statistics.Initialize(reinterpret_cast<NanomiteMetadata*>(small.data()));
+  statistics.OnTrap(7);
+  statistics.OnTrap(1);
+  CHECK(reporter, statistics.GetSiteCount() == 2);
+  CHECK(reporter, statistics.GetTraps() == 2);
+  CHECK(reporter, statistics.GetSiteHits(0) == 0 && statistics.GetSiteHits(1) == 1);
+
+  statistics.Initialize(nullptr);
+  statistics.OnTrap(0);
+  CHECK(reporter, statistics.GetSiteCount() == 0 && statistics.GetTraps() == 1);
+}
+
+void TracerStatisticsTests::TestConcurrentReinitialize(TestReporter& reporter)
+{
+  // The threads trap on the sites of the larger table while the statistics switch between both tables
+  std::vector<BYTE> large = CreateMetadata(64);
+  std::vector<BYTE> small = CreateMetadata(1);
+  TracerStatistics statistics;
+  statistics.Initialize(reinterpret_cast<NanomiteMetadata*>(large.data()));
+
+  std::atomic<bool> stop(false);
+  std::vector<std::thread> threads;
+  for (DWORD t = 0; t < THREAD_COUNT; t++)
+  {
+    threads.emplace_back([&statistics, &stop, t]()
+    {
+      for (DWORD i = t; !stop.load(std::memory_order_relaxed); i++)
+      {
+        statistics.OnTrap(i % 64);
+      }
+    });
+  }
+  for (DWORD i = 0; i < INITIALIZE_COUNT; i++)
+  {
+    statistics.Initialize(reinterpret_cast<NanomiteMetadata*>((i % 2 == 0 ? small : large).data()));
+  }
+  stop = true;
+  for (auto& thread : threads) thread.join();
+
+  // The last table is the large one and counts on
+  CHECK(reporter, statistics.GetSiteCount() == 64);
+  const ULONGLONG siteHits = statistics.GetSiteHits(63);
+  statistics.OnTrap(63);
+  CHECK(reporter, statistics.GetSiteHits(63) == siteHits + 1);
+}
+
+std::vector<BYTE> TracerStatisticsTests::CreateMetadata(DWORD siteCount)
+{
+  std::vector<BYTE> metadata(sizeof(NanomiteMetadata) + siteCount * sizeof(Nanomite), 0);
+  reinterpret_cast<NanomiteMetadata*>(metadata.data())->ItemCount = siteCount;
+  Nanomite* sites = reinterpret_cast<Nanomite*>(metadata.data() + sizeof(NanomiteMetadata));
+  for (DWORD i = 0; i < siteCount; i++)
+  {
+    sites[i].Rva = 0x1000 + i * 0x10;
+    sites[i].JumpType = JE;
+    sites[i].JumpLength = 0x10;
+    sites[i].OpcodeLength = 2;
+  }
+  return metadata;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <Windows.h>
+#include <vector>
+
+class TestReporter;
+
+// Site counters of the Tracer while the exception handler is running: traps on other threads while the statistics
+// are initialized for other metadata, e.g. when the Tracer attaches to a second image.
+class TracerStatisticsTests
+{
+public:
+  TracerStatisticsTests();
+  ~TracerStatisticsTests();
+
+  void Run(TestReporter& reporter);
+
+private:
+  void TestReinitialize(TestReporter& reporter);
+  void TestConcurrentReinitialize(TestReporter& reporter);
+
+  // NanomiteMetadata followed by siteCount sites, as the Tracer reads resource 1234
+  static std::vector<BYTE> CreateMetadata(DWORD siteCount);
+
+private:
+  static const DWORD THREAD_COUNT = 4;
+  static const DWORD INITIALIZE_COUNT = 2000;
+};
@@ -0,0 +1,46 @@
+#include <iostream>
+#include <string>
+#include "Common/TestReporter.h"
+#include "Builder/AnalysisCacheTests.h"
+#include "Builder/BatchBuilderTests.h"
+#include "Builder/DensityPolicyTests.h"
+#include "Builder/DeterminismTests.h"
+#include "Builder/DisassemblerTests.h"
+#include "Builder/PEFileTests.h"
+#include "Builder/PatchWriterTests.h"
+#ifdef _WIN32
+#include "Tracer/StormDetectorTests.h"
+#include "Tracer/TracerStatisticsTests.h"
+#endif
+
+// --- main program --- Usage: Tests.exe [filter]
+// Runs the test cases whose name contains the filter; the exit code is non-zero if a check failed.
+int main(int argc, char* argv[])
+{
+  TestReporter reporter;
+  if (argc > 1) reporter.SetFilter(argv[1]);
+
+  DisassemblerTests disassemblerTests;
+  disassemblerTests.Run(reporter);
+  PEFileTests peFileTests;
+  peFileTests.Run(reporter);
+  PatchWriterTests patchWriterTests;
+  patchWriterTests.Run(reporter);
+  BatchBuilderTests batchBuilderTests;
+  batchBuilderTests.Run(reporter);
+  AnalysisCacheTests analysisCacheTests;
+  analysisCacheTests.Run(reporter);
+  DeterminismTests determinismTests;
+  determinismTests.Run(reporter);
+  DensityPolicyTests densityPolicyTests;
+  densityPolicyTests.Run(reporter);
+#ifdef _WIN32
+  // The Tracer is part of the Windows runtime
+  StormDetectorTests stormDetectorTests;
+  stormDetectorTests.Run(reporter);
+  TracerStatisticsTests tracerStatisticsTests;
+  tracerStatisticsTests.Run(reporter);
+#endif
+
+  return reporter.PrintSummary() ? EXIT_SUCCESS : EXIT_FAILURE;
+}